@@ -20,7 +20,7 @@
 
 #include "itkImage.h"
 #include "itkBinaryFunctors.h"
-#include "itkBinaryFunctorImageFilter.h"
+#include "itkBroadcastingBinaryFunctorImageFilter.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 
@@ -94,47 +94,49 @@ public:
     typedef itk::ImageFileReader< InputImage2Type >     Reader2Type;
     typedef itk::ImageFileWriter< OutputImageType >     WriterType;
 
-    /** Typedef's for the binary functor filters. */
-    typedef itk::BinaryFunctorImageFilter<
+    /** Typedef's for the binary functor filters. The second input may
+     * have size 1 along some axes, in which case it is broadcast.
+     */
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::ADDITION<InputPixel1Type, InputPixel2Type, OutputPixelType> > ADDITIONFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::MINUS<InputPixel1Type, InputPixel2Type, OutputPixelType> > MINUSFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::TIMES<InputPixel1Type, InputPixel2Type, OutputPixelType> > TIMESFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::DIVIDE<InputPixel1Type, InputPixel2Type, OutputPixelType> > DIVIDEFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::POWER<InputPixel1Type, InputPixel2Type, OutputPixelType> > POWERFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::MAXIMUM<InputPixel1Type, InputPixel2Type, OutputPixelType> > MAXIMUMFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::MINIMUM<InputPixel1Type, InputPixel2Type, OutputPixelType> > MINIMUMFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::ABSOLUTEDIFFERENCE<InputPixel1Type, InputPixel2Type, OutputPixelType> > ABSOLUTEDIFFERENCEFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::SQUAREDDIFFERENCE<InputPixel1Type, InputPixel2Type, OutputPixelType> > SQUAREDDIFFERENCEFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::BINARYMAGNITUDE<InputPixel1Type, InputPixel2Type, OutputPixelType> > BINARYMAGNITUDEFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::LOG<InputPixel1Type, InputPixel2Type, OutputPixelType> > LOGFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::WEIGHTEDADDITION<InputPixel1Type, InputPixel2Type, OutputPixelType> > WEIGHTEDADDITIONFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::MASK<InputPixel1Type, InputPixel2Type, OutputPixelType> > MASKFilterType;
-    typedef itk::BinaryFunctorImageFilter<
+    typedef itk::BroadcastingBinaryFunctorImageFilter<
       InputImage1Type, InputImage2Type, OutputImageType,
       itk::Functor::MASKNEGATED<InputPixel1Type, InputPixel2Type, OutputPixelType> > MASKNEGATEDFilterType;
 
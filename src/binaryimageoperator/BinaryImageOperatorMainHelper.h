@@ -90,9 +90,12 @@ int DetermineComponentTypes(
     return 1;
   }
 
-  if( inputDimension1 != inputDimension2 )
+  /** The second image may be of lower dimension than the first one,
+   * and may have size 1 along some axes. It is then broadcast.
+   */
+  if( inputDimension2 > inputDimension1 )
   {
-    std::cerr << "ERROR: the two input images are of different dimension."
+    std::cerr << "ERROR: the second input image should not be of higher dimension than the first."
       << "\n  Image " << inputFileNames[ 0 ] << " has dimension " << inputDimension1
       << "\n  Image " << inputFileNames[ 1 ] << " has dimension " << inputDimension2
       << std::endl;
@@ -100,26 +103,28 @@ int DetermineComponentTypes(
   }
   else
   {
-    inputDimension = inputDimension1;
+    inputDimension = inputDimension2;
   }
 
   for( unsigned int i = 0; i < inputDimension; ++i )
   {
-    if( imagesize1[ i ] != imagesize2[ i ] )
+    if( imagesize1[ i ] != imagesize2[ i ] && imagesize2[ i ] != 1 )
     {
-      std::cerr << "ERROR: the two input images have different sizes."
+      std::cerr << "ERROR: the two input images have incompatible sizes."
         << "\n  Image " << inputFileNames[ 0 ] << " has size [ ";
-      for( unsigned int j = 0; j < inputDimension; ++j )
+      for( unsigned int j = 0; j < inputDimension1; ++j )
       {
         std::cerr << imagesize1[ j ] << " ";
       }
       std::cerr << "]"
         << "\n  Image " << inputFileNames[ 1 ] << " has size [ ";
-      for( unsigned int j = 0; j < inputDimension; ++j )
+      for( unsigned int j = 0; j < inputDimension2; ++j )
       {
         std::cerr << imagesize2[ j ] << " ";
       }
-      std::cerr << "]" << std::endl;
+      std::cerr << "]"
+        << "\n  Along every axis the sizes should be equal, or the size of the second image should be 1."
+        << std::endl;
       return 1;
     }
   }
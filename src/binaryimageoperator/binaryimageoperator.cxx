@@ -44,6 +44,9 @@ std::string GetHelpString( void )
     << "Performs binary operations on two images." << std::endl
     << "Usage:\npxbinaryimageoperator\n"
     << "  -in      inputFilenames\n"
+    << "           The second image may be of lower dimension than the first, or have\n"
+    << "           size 1 along some axes. It is then broadcast along those axes, e.g.\n"
+    << "           to subtract a 2D bias field from every slice of a 3D image.\n"
     << "  [-out]   outputFilename, default in1 + ops + arg + in2 + .mhd\n"
     << "  -ops     binary operator of the following form:\n"
     << "           {+,-,*,/,^,%}\n"
@@ -127,7 +130,8 @@ int main( int argc, char **argv )
   itk::ImageIOBase::IOComponentType componentType1;
   itk::ImageIOBase::IOComponentType componentType2;
   itk::ImageIOBase::IOComponentType componentTypeOut;
-  DetermineComponentTypes( inputFileNames, componentType1, componentType2, componentTypeOut );
+  int retDCT = DetermineComponentTypes( inputFileNames, componentType1, componentType2, componentTypeOut );
+  if( retDCT ) return EXIT_FAILURE;
 
   /** Let the user override the output component type. */
   if( retopct )
@@ -157,7 +161,7 @@ int main( int argc, char **argv )
   ITKToolsBinaryImageOperatorBase * filter = NULL;
 
   unsigned int dim = 0;
-  itktools::GetImageDimension( inputFileNames[1], dim );
+  itktools::GetImageDimension( inputFileNames[0], dim );
 
   /** Short aliases. */
   itk::ImageIOBase::IOComponentType inCType1 = componentType1;
@@ -0,0 +1,116 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkBroadcastingBinaryFunctorImageFilter_h_
+#define __itkBroadcastingBinaryFunctorImageFilter_h_
+
+#include "itkBinaryFunctorImageFilter.h"
+
+
+namespace itk
+{
+
+/** \class BroadcastingBinaryFunctorImageFilter
+ * \brief A BinaryFunctorImageFilter where the second input may be smaller
+ * than the first one.
+ *
+ * Along every axis the second input must either have the same size as
+ * the first input, or size 1. In the latter case its single value is
+ * broadcast along that axis, without ever materializing the full sized
+ * image. A lower-dimensional image that is read as an image of the same
+ * dimension as the first input, e.g. a 2D bias field read as a 3D image,
+ * has size 1 along the trailing axes and is therefore applied to every
+ * slice of the first input.
+ *
+ * The output has the geometry of the first input. The physical space of
+ * the second input is not checked, only its size.
+ *
+ * If both inputs have the same size, this filter does the same as the
+ * BinaryFunctorImageFilter.
+ *
+ * \ingroup IntensityImageFilters
+ */
+template <class TInputImage1, class TInputImage2,
+  class TOutputImage, class TFunction>
+class BroadcastingBinaryFunctorImageFilter :
+  public BinaryFunctorImageFilter<TInputImage1, TInputImage2, TOutputImage, TFunction>
+{
+public:
+  /** Standard class typedefs. */
+  typedef BroadcastingBinaryFunctorImageFilter  Self;
+  typedef BinaryFunctorImageFilter<
+    TInputImage1, TInputImage2, TOutputImage, TFunction > Superclass;
+  typedef SmartPointer<Self>                    Pointer;
+  typedef SmartPointer<const Self>              ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( BroadcastingBinaryFunctorImageFilter, BinaryFunctorImageFilter );
+
+  /** Image related typedefs. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+    TOutputImage::ImageDimension );
+
+  /** Typedef to describe the input/output image types. */
+  typedef TInputImage1                                Input1ImageType;
+  typedef TInputImage2                                Input2ImageType;
+  typedef TOutputImage                                OutputImageType;
+  typedef typename Input1ImageType::PixelType         Input1PixelType;
+  typedef typename Input2ImageType::PixelType         Input2PixelType;
+  typedef typename OutputImageType::PixelType         OutputPixelType;
+  typedef typename OutputImageType::RegionType        OutputImageRegionType;
+  typedef typename Input2ImageType::RegionType        Input2ImageRegionType;
+  typedef typename OutputImageType::IndexType         IndexType;
+  typedef typename OutputImageType::SizeType          SizeType;
+  typedef TFunction                                   FunctorType;
+
+protected:
+  BroadcastingBinaryFunctorImageFilter(){};
+  virtual ~BroadcastingBinaryFunctorImageFilter(){};
+
+  /** Only check that the size of the second input can be broadcast. */
+  virtual void VerifyInputInformation( void );
+
+  /** The second input only needs the projection of the output region
+   * onto its non-broadcast axes.
+   */
+  virtual void GenerateInputRequestedRegion( void );
+
+  /** Apply the functor line by line. */
+  virtual void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId );
+
+  /** Determine per axis if the second input is broadcast along it. */
+  void GetBroadcastAxes( const Input2ImageType * input2,
+    bool broadcast[ ImageDimension ] ) const;
+
+private:
+  BroadcastingBinaryFunctorImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+}; // end class BroadcastingBinaryFunctorImageFilter
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkBroadcastingBinaryFunctorImageFilter.hxx"
+#endif
+
+#endif // end #ifndef __itkBroadcastingBinaryFunctorImageFilter_h_
@@ -0,0 +1,193 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkBroadcastingBinaryFunctorImageFilter_hxx_
+#define __itkBroadcastingBinaryFunctorImageFilter_hxx_
+
+#include "itkBroadcastingBinaryFunctorImageFilter.h"
+
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkProgressReporter.h"
+#include "vnl/vnl_math.h"
+
+
+namespace itk
+{
+
+/**
+ * ******************* GetBroadcastAxes *******************
+ */
+
+template <class TInputImage1, class TInputImage2, class TOutputImage, class TFunction>
+void
+BroadcastingBinaryFunctorImageFilter<TInputImage1, TInputImage2, TOutputImage, TFunction>
+::GetBroadcastAxes( const Input2ImageType * input2,
+  bool broadcast[ ImageDimension ] ) const
+{
+  const Input1ImageType * input1
+    = dynamic_cast<const Input1ImageType *>( this->ProcessObject::GetInput( 0 ) );
+  const SizeType size1 = input1->GetLargestPossibleRegion().GetSize();
+  const SizeType size2 = input2->GetLargestPossibleRegion().GetSize();
+
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    broadcast[ i ] = size2[ i ] == 1 && size1[ i ] != 1;
+  }
+
+} // end GetBroadcastAxes()
+
+
+/**
+ * ******************* VerifyInputInformation *******************
+ */
+
+template <class TInputImage1, class TInputImage2, class TOutputImage, class TFunction>
+void
+BroadcastingBinaryFunctorImageFilter<TInputImage1, TInputImage2, TOutputImage, TFunction>
+::VerifyInputInformation( void )
+{
+  const Input1ImageType * input1
+    = dynamic_cast<const Input1ImageType *>( this->ProcessObject::GetInput( 0 ) );
+  const Input2ImageType * input2
+    = dynamic_cast<const Input2ImageType *>( this->ProcessObject::GetInput( 1 ) );
+
+  /** A constant second input is always fine. */
+  if( input1 == 0 || input2 == 0 ) return;
+
+  const SizeType size1 = input1->GetLargestPossibleRegion().GetSize();
+  const SizeType size2 = input2->GetLargestPossibleRegion().GetSize();
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    if( size2[ i ] != size1[ i ] && size2[ i ] != 1 )
+    {
+      itkExceptionMacro( << "The second input of size " << size2
+        << " can not be broadcast to the first input of size " << size1
+        << ": along every axis the sizes should be equal, or the size of "
+        << "the second input should be 1." );
+    }
+  }
+
+} // end VerifyInputInformation()
+
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template <class TInputImage1, class TInputImage2, class TOutputImage, class TFunction>
+void
+BroadcastingBinaryFunctorImageFilter<TInputImage1, TInputImage2, TOutputImage, TFunction>
+::GenerateInputRequestedRegion( void )
+{
+  Input1ImageType * input1 = const_cast<Input1ImageType *>(
+    dynamic_cast<const Input1ImageType *>( this->ProcessObject::GetInput( 0 ) ) );
+  Input2ImageType * input2 = const_cast<Input2ImageType *>(
+    dynamic_cast<const Input2ImageType *>( this->ProcessObject::GetInput( 1 ) ) );
+  const OutputImageRegionType outputRegion = this->GetOutput()->GetRequestedRegion();
+
+  if( input1 ) input1->SetRequestedRegion( outputRegion );
+  if( !input2 ) return;
+
+  /** Project the output region onto the second input. */
+  bool broadcast[ ImageDimension ];
+  this->GetBroadcastAxes( input2, broadcast );
+  const Input2ImageRegionType largestRegion2 = input2->GetLargestPossibleRegion();
+  Input2ImageRegionType region2 = largestRegion2;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    if( !broadcast[ i ] )
+    {
+      region2.SetIndex( i, largestRegion2.GetIndex( i )
+        + ( outputRegion.GetIndex( i ) - input1->GetLargestPossibleRegion().GetIndex( i ) ) );
+      region2.SetSize( i, outputRegion.GetSize( i ) );
+    }
+  }
+  input2->SetRequestedRegion( region2 );
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* ThreadedGenerateData *******************
+ */
+
+template <class TInputImage1, class TInputImage2, class TOutputImage, class TFunction>
+void
+BroadcastingBinaryFunctorImageFilter<TInputImage1, TInputImage2, TOutputImage, TFunction>
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  const Input1ImageType * input1
+    = dynamic_cast<const Input1ImageType *>( this->ProcessObject::GetInput( 0 ) );
+  const Input2ImageType * input2
+    = dynamic_cast<const Input2ImageType *>( this->ProcessObject::GetInput( 1 ) );
+
+  /** Constant second inputs are handled by the superclass. */
+  if( input1 == 0 || input2 == 0 )
+  {
+    Superclass::ThreadedGenerateData( outputRegionForThread, threadId );
+    return;
+  }
+
+  OutputImageType * output = this->GetOutput();
+  const IndexType start1 = input1->GetLargestPossibleRegion().GetIndex();
+  const IndexType start2 = input2->GetLargestPossibleRegion().GetIndex();
+  bool broadcast[ ImageDimension ];
+  this->GetBroadcastAxes( input2, broadcast );
+
+  /** The functors have a non-const operator(). */
+  FunctorType functor = this->GetFunctor();
+
+  const SizeValueType lineLength = outputRegionForThread.GetSize( 0 );
+  const OffsetValueType stride2 = broadcast[ 0 ] ? 0 : 1;
+  ProgressReporter progress( this, threadId,
+    outputRegionForThread.GetNumberOfPixels() / vnl_math_max( lineLength, SizeValueType( 1 ) ) );
+
+  /** Loop over the lines of the output region. */
+  ImageLinearIteratorWithIndex<OutputImageType> lineIt( output, outputRegionForThread );
+  lineIt.SetDirection( 0 );
+  lineIt.GoToBegin();
+  while( !lineIt.IsAtEnd() )
+  {
+    /** The corresponding index in the second input. */
+    const IndexType index = lineIt.GetIndex();
+    IndexType index2;
+    for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+      index2[ i ] = broadcast[ i ] ? start2[ i ] : start2[ i ] + ( index[ i ] - start1[ i ] );
+    }
+
+    const Input1PixelType * in1 = input1->GetBufferPointer() + input1->ComputeOffset( index );
+    const Input2PixelType * in2 = input2->GetBufferPointer() + input2->ComputeOffset( index2 );
+    OutputPixelType * out = output->GetBufferPointer() + output->ComputeOffset( index );
+    for( SizeValueType i = 0; i < lineLength; ++i )
+    {
+      out[ i ] = functor( in1[ i ], *in2 );
+      in2 += stride2;
+    }
+
+    lineIt.NextLine();
+    progress.CompletedPixel();
+  }
+
+} // end ThreadedGenerateData()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBroadcastingBinaryFunctorImageFilter_hxx_
@@ -65,6 +65,11 @@ std::string GetHelpString( void )
     << "        default: 1e-5. Ignored by STAPLE and VOTE.\n"
     << "[-outs]  outputFilename0 outputFileName1 [...]: the output (soft) probabilistic\n"
     << "        segmentations for each label. These will be float images.\n"
+    << "[-outsk] labelsFilename probabilitiesFilename: instead of -outs, store only the\n"
+    << "        most probable classes of each pixel, as two vector images: the labels,\n"
+    << "        sorted by decreasing probability, and their probabilities.\n"
+    << "        Only for [VOTE_]MULTISTAPLE2.\n"
+    << "[-k]     the number of most probable classes stored by -outsk; default: 3.\n"
     << "[-outh]  outputFilename: the output hard segmentation, stored as a single\n"
     << "        unsigned char image, containing the label numbers.\n"
     << "       The value 'numberOfClasses' corresponds to 'undecided' (if two labels\n"
@@ -230,6 +235,36 @@ int main( int argc, char **argv )
       return EXIT_FAILURE;
     }
   }
+  std::vector< std::string > sparseOutputFileNames;
+  bool retoutsk = parser->GetCommandLineArgument( "-outsk", sparseOutputFileNames );
+  const bool sparseOutputSupported = combinationMethod == "MULTISTAPLE2"
+    || combinationMethod == "VOTE_MULTISTAPLE2";
+  if( retoutsk )
+  {
+    if( sparseOutputFileNames.size() != 2 || retouts )
+    {
+      std::cerr
+        << "ERROR: \"-outsk\" should be followed by 2 filenames, "
+        << "and can not be combined with \"-outs\"."
+        << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  unsigned int numberOfMostProbableClasses = 3;
+  bool retk = parser->GetCommandLineArgument( "-k", numberOfMostProbableClasses );
+  if( numberOfMostProbableClasses == 0 )
+  {
+    std::cerr << "ERROR: \"-k\" should be at least 1." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( ( retoutsk || retk ) && !sparseOutputSupported )
+  {
+    std::cerr
+      << "ERROR: \"-outsk\" and \"-k\" are only supported by the "
+      << "MULTISTAPLE2 and VOTE_MULTISTAPLE2 methods."
+      << std::endl;
+    return EXIT_FAILURE;
+  }
   parser->GetCommandLineArgument( "-outh", hardOutputFileName );
   parser->GetCommandLineArgument( "-outc", confusionOutputFileName );
 
@@ -311,6 +346,8 @@ int main( int argc, char **argv )
     filter->m_InValues = inValues;
     filter->m_OutValues = outValues;
     filter->m_UseCompression = useCompression;
+    filter->m_NumberOfMostProbableClasses = numberOfMostProbableClasses;
+    filter->m_SparseOutputFileNames = sparseOutputFileNames;
 
     filter->Run();
 
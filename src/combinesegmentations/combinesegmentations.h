@@ -61,6 +61,7 @@ public:
     this->m_UseMask = false;
     this->m_MaskDilationRadius = 1;
     this->m_UseCompression = false;
+    this->m_NumberOfMostProbableClasses = 0;
   };
   /** Destructor. */
   ~ITKToolsCombineSegmentationsBase(){};
@@ -82,6 +83,8 @@ public:
   std::vector< unsigned int > m_InValues;
   std::vector< unsigned int > m_OutValues;
   bool                        m_UseCompression;
+  unsigned int                m_NumberOfMostProbableClasses;
+  std::vector< std::string >  m_SparseOutputFileNames;
 
 }; // end class ITKToolsCombineSegmentationsBase
 
@@ -482,6 +485,11 @@ public:
       {
         multistaple2->SetGenerateProbabilisticSegmentations(true);
       }
+      else if( this->m_SparseOutputFileNames.size() > 0 )
+      {
+        multistaple2->SetGenerateProbabilisticSegmentations(true);
+        multistaple2->SetNumberOfMostProbableClasses( this->m_NumberOfMostProbableClasses );
+      }
 
       /** Set the termination threshold */
       std::cout << "TerminationUpdateThreshold = " << this->m_TerminationThreshold << std::endl;
@@ -518,6 +526,32 @@ public:
         }
       }
 
+      /** Write the sparse soft segmentation, i.e. the labels and
+       * probabilities of the most probable classes */
+      if( this->m_SparseOutputFileNames.size() > 0 )
+      {
+        typedef typename MultiLabelSTAPLE2Type::SparseLabelImageType       SparseLabelImageType;
+        typedef typename MultiLabelSTAPLE2Type::SparseProbabilityImageType SparseProbImageType;
+        typedef itk::ImageFileWriter< SparseLabelImageType >  SparseLabelImageWriterType;
+        typedef itk::ImageFileWriter< SparseProbImageType >   SparseProbImageWriterType;
+
+        std::cout << "Writing sparse soft segmentation..." << std::endl;
+        typename SparseLabelImageWriterType::Pointer labelWriter =
+          SparseLabelImageWriterType::New();
+        labelWriter->SetFileName( this->m_SparseOutputFileNames[ 0 ].c_str() );
+        labelWriter->SetInput( multistaple2->GetSparseLabelImage() );
+        labelWriter->SetUseCompression( this->m_UseCompression );
+        labelWriter->Update();
+
+        typename SparseProbImageWriterType::Pointer probWriter =
+          SparseProbImageWriterType::New();
+        probWriter->SetFileName( this->m_SparseOutputFileNames[ 1 ].c_str() );
+        probWriter->SetInput( multistaple2->GetSparseProbabilityImage() );
+        probWriter->SetUseCompression( this->m_UseCompression );
+        probWriter->Update();
+        std::cout << "Done writing sparse soft segmentation." << std::endl;
+      }
+
       /** Generate the confusion matrix */
       if( this->m_ConfusionOutputFileName != "" )
       {
@@ -23,6 +23,7 @@
 
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
 
 #include <vector>
 #include "itkArray.h"
@@ -300,9 +301,23 @@ namespace itk
     /** For multithreading: */
     ConfusionMatrixArrayArrayType      m_ConfusionMatrixArrays;
 
-    /** Determine maximum value among all input images' pixels */
+    /** Whether the number of classes is determined while voting, in the
+     * same pass over the inputs. This is done if it is not set by the user
+     * and nothing has to be allocated per class. */
+    bool m_ComputeNumberOfClassesWhileVoting;
+
+    /** The maximum label seen by each thread */
+    std::vector<InputPixelType>        m_ThreadMaximumLabels;
+
+    /** Determine maximum value among all input images' pixels, multithreaded */
     virtual InputPixelType ComputeMaximumInputValue();
 
+    /** Determine the maximum value in a part of the buffer of each input */
+    void ThreadedComputeMaximumInputValue( ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+    /** Static function used as a "callback" by the MultiThreader */
+    static ITK_THREAD_RETURN_TYPE MaximumInputValueThreaderCallback( void * arg );
+
     /** Allocate confusion matrix array(s) */
     virtual void AllocateConfusionMatrixArray();
 
@@ -21,6 +21,7 @@
 #include "itkLabelVoting2ImageFilter.h"
 
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -38,6 +39,7 @@ namespace itk
     this->m_LeastPreferredLabel = 1;
     this->m_MaskImage = 0;
     this->m_GenerateConfusionMatrix = false;
+    this->m_ComputeNumberOfClassesWhileVoting = false;
   } // end constructor
 
 
@@ -56,21 +58,61 @@ namespace itk
     LabelVoting2ImageFilter< TInputImage, TOutputImage, TWeights >
     ::ComputeMaximumInputValue()
   {
-    /** compute the maximum class label from the input data */
+    /** compute the maximum class label from the input data;
+     * each thread scans a part of the buffer of every input */
+    this->m_ThreadMaximumLabels.assign( this->GetNumberOfThreads(), 0 );
+    this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->GetMultiThreader()->SetSingleMethod(
+      MaximumInputValueThreaderCallback, this );
+    this->GetMultiThreader()->SingleMethodExecute();
+
+    InputPixelType maxLabel = 0;
+    for( unsigned int t = 0; t < this->m_ThreadMaximumLabels.size(); ++t )
+    {
+      maxLabel = vnl_math_max( maxLabel, this->m_ThreadMaximumLabels[t] );
+    }
+
+    return maxLabel;
+  } // end ComputeMaximumInputValue
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    ITK_THREAD_RETURN_TYPE
+    LabelVoting2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::MaximumInputValueThreaderCallback( void * arg )
+  {
+    typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+    ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+    Self * filter = static_cast<Self *>( info->UserData );
+
+    filter->ThreadedComputeMaximumInputValue( info->ThreadID, info->NumberOfThreads );
+
+    return ITK_THREAD_RETURN_VALUE;
+  } // end MaximumInputValueThreaderCallback
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    LabelVoting2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedComputeMaximumInputValue( ThreadIdType threadId, ThreadIdType numberOfThreads )
+  {
     InputPixelType maxLabel = 0;
     const unsigned int numberOfInputs = this->GetNumberOfInputs();
 
     for( unsigned int k = 0; k < numberOfInputs; ++k )
     {
-      InputConstIteratorType it
-        ( this->GetInput( k ), this->GetInput( k )->GetBufferedRegion() );
-
-      for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
-        maxLabel = vnl_math_max( maxLabel, it.Get() );
+      const InputPixelType * buffer = this->GetInput( k )->GetBufferPointer();
+      const SizeValueType numberOfPixels =
+        this->GetInput( k )->GetBufferedRegion().GetNumberOfPixels();
+      const SizeValueType begin = threadId * numberOfPixels / numberOfThreads;
+      const SizeValueType end = ( threadId + 1 ) * numberOfPixels / numberOfThreads;
+
+      for( SizeValueType i = begin; i < end; ++i )
+        maxLabel = vnl_math_max( maxLabel, buffer[ i ] );
     }
 
-    return maxLabel;
-  } // end ComputeMaximumInputValue
+    this->m_ThreadMaximumLabels[ threadId ] = maxLabel;
+  } // end ThreadedComputeMaximumInputValue
 
 
   template< typename TInputImage, typename TOutputImage, typename TWeights >
@@ -127,11 +169,21 @@ namespace itk
       this->GetGenerateProbabilisticSegmentations();
     const unsigned int numberOfInputs = this->GetNumberOfInputs();
 
-    /** Set some default values if necessary */
-    if( this->m_HasNumberOfClasses == false )
+    /** Set some default values if necessary. If possible, the number of
+     * classes is determined in the voting pass itself, which then grows
+     * its vote arrays on demand. */
+    this->m_ComputeNumberOfClassesWhileVoting = !this->m_HasNumberOfClasses
+      && !this->m_HasPriorPreference && !generateProbSeg
+      && !this->GetGenerateConfusionMatrix();
+    if( this->m_ComputeNumberOfClassesWhileVoting )
+    {
+      this->m_NumberOfClasses = 1;
+    }
+    else if( this->m_HasNumberOfClasses == false )
     {
       this->m_NumberOfClasses = this->ComputeMaximumInputValue() + 1;
     }
+    this->m_ThreadMaximumLabels.assign( this->GetNumberOfThreads(), 0 );
     if( ! this->m_HasPriorPreference )
     {
       this->m_PriorPreference.SetSize( this->m_NumberOfClasses );
@@ -191,7 +243,7 @@ namespace itk
     ::ThreadedGenerateData( const OutputImageRegionType &outputRegionForThread,
     ThreadIdType threadId)
   {
-    typedef Array<WeightsType>                  WType;
+    typedef std::vector<WeightsType>            WType;
     typedef std::vector<InputConstIteratorType> InputConstIteratorArrayType;
     typedef std::vector<ProbIteratorType>       ProbIteratorArrayType;
 
@@ -201,8 +253,14 @@ namespace itk
     const bool generateConfusionMatrix = this->GetGenerateConfusionMatrix();
     const unsigned int numberOfInputs = this->GetNumberOfInputs();
     const bool useMask = this->m_MaskImage.IsNotNull();
-    /** Votes by label, weighted by the observer trust */
-    WType W( this->m_NumberOfClasses );
+    const bool defaultPriorPreference = !this->m_HasPriorPreference;
+
+    /** Votes by label, weighted by the observer trust. Only the entries of
+     * the labels in votedLabels are nonzero, so only those are reset. */
+    WType W( this->m_NumberOfClasses, 0.0 );
+    std::vector<InputPixelType> votedLabels;
+    votedLabels.reserve( numberOfInputs + 1 );
+    InputPixelType maximumLabel = 0;
 
     /** create and initialize all input image iterators */
     InputConstIteratorArrayType it(numberOfInputs);
@@ -239,10 +297,28 @@ namespace itk
     /** Loop over the output pixels */
     for ( out.GoToBegin(); !out.IsAtEnd(); ++out )
     {
-      // reset number of votes per label for all labels
-      W.Fill(0.0);
+      // reset number of votes per label for the labels of the previous pixel
+      for( unsigned int v = 0; v < votedLabels.size(); ++v )
+      {
+        W[ votedLabels[ v ] ] = 0.0;
+      }
+      votedLabels.clear();
       OutputPixelType winningLabel = this->m_LeastPreferredLabel;
 
+      // read the labels, and make room for them in W
+      for( unsigned int i = 0; i < numberOfInputs; ++i )
+      {
+        const InputPixelType label = it[ i ].Get();
+        if( label > maximumLabel )
+        {
+          maximumLabel = label;
+          if( static_cast<SizeValueType>( label ) >= W.size() )
+          {
+            W.resize( static_cast<SizeValueType>( label ) + 1, 0.0 );
+          }
+        }
+      }
+
       bool insideMask = true;
       if(useMask)
       {
@@ -253,6 +329,7 @@ namespace itk
           insideMask = false;
           winningLabel = it[0].Get();
           W[ winningLabel ] = 1.0;
+          votedLabels.push_back( winningLabel );
           /** Set the winning label to the output pixel */
           out.Set( winningLabel );
           /** move the it iterators */
@@ -267,53 +344,87 @@ namespace itk
       if(insideMask)
       {
 
-        // count number of votes for the labels
+        // count number of votes for the labels, and remember which
+        // labels got votes; the other entries of W stay zero
         for( unsigned int i = 0; i < numberOfInputs; ++i )
         {
           const InputPixelType label = it[ i ].Get();
           W[label] += this->m_ObserverTrust( i );
+          if( std::find( votedLabels.begin(), votedLabels.end(), label ) == votedLabels.end() )
+          {
+            votedLabels.push_back( label );
+          }
         }
 
         /** normalize: */
-        WeightsType sumW = W.sum();
+        WeightsType sumW = 0.0;
+        for( unsigned int v = 0; v < votedLabels.size(); ++v )
+        {
+          sumW += W[ votedLabels[ v ] ];
+        }
         if( sumW )
         {
-          W /= sumW;
+          for( unsigned int v = 0; v < votedLabels.size(); ++v )
+          {
+            W[ votedLabels[ v ] ] /= sumW;
+          }
         }
 
         /** now determine the label with the maximum W, i.e.,
-        * determine the label with the most votes for this pixel */
+        * determine the label with the most votes for this pixel.
+        * Labels without votes can only win if no label got a
+        * positive vote, in which case all labels are checked. */
         WeightsType winningLabelW = 0.0;
-        for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+        for( unsigned int v = 0; v < votedLabels.size(); ++v )
         {
+          const OutputPixelType ci = votedLabels[ v ];
           if( W[ci] > winningLabelW )
           {
             winningLabelW = W[ci];
             winningLabel = ci;
           }
-          else
+          else if( ! (W[ci] < winningLabelW ) )
+          {
+            if( defaultPriorPreference ? ( ci < winningLabel )
+              : ( this->m_PriorPreference[ci] < this->m_PriorPreference[winningLabel] ) )
+            {
+              winningLabel = ci;
+            }
+          }
+        }
+        if( !( winningLabelW > 0.0 ) )
+        {
+          winningLabel = this->m_LeastPreferredLabel;
+          for ( OutputPixelType ci = 0; ci < W.size(); ++ci )
           {
-            if( ! (W[ci] < winningLabelW ) )
+            if( W[ci] > winningLabelW )
+            {
+              winningLabelW = W[ci];
+              winningLabel = ci;
+            }
+            else if( ! (W[ci] < winningLabelW ) )
             {
-              if( this->m_PriorPreference[ci] < this->m_PriorPreference[winningLabel] )
+              if( defaultPriorPreference ? ( ci < winningLabel )
+                : ( this->m_PriorPreference[ci] < this->m_PriorPreference[winningLabel] ) )
               {
                 winningLabel = ci;
               }
             }
-          }
-        } // next ci
+          } // next ci
+        }
 
         /** Set the winning label to the output pixel */
         out.Set( winningLabel );
 
-        /** Update the confusion matrix */
+        /** Update the confusion matrix, only for the labels with votes */
         if( generateConfusionMatrix )
         {
           for( unsigned int i = 0; i < numberOfInputs; ++i )
           {
             const InputPixelType label = it[ i ].Get();
-            for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+            for( unsigned int v = 0; v < votedLabels.size(); ++v )
             {
+              const InputPixelType ci = votedLabels[ v ];
               this->m_ConfusionMatrixArrays[threadId][ i ][label][ci] += W[ci];
             }
           }
@@ -339,6 +450,8 @@ namespace itk
 
     } // end loop over output pixels
 
+    this->m_ThreadMaximumLabels[ threadId ] = maximumLabel;
+
   } // end ThreadedGenerateData
 
 
@@ -351,6 +464,23 @@ namespace itk
 
     const unsigned int numberOfInputs = this->GetNumberOfInputs();
 
+    /** The number of classes follows from the labels seen while voting */
+    if( this->m_ComputeNumberOfClassesWhileVoting )
+    {
+      InputPixelType maxLabel = 0;
+      for( unsigned int t = 0; t < this->m_ThreadMaximumLabels.size(); ++t )
+      {
+        maxLabel = vnl_math_max( maxLabel, this->m_ThreadMaximumLabels[t] );
+      }
+      this->m_NumberOfClasses = maxLabel + 1;
+      this->m_PriorPreference.SetSize( this->m_NumberOfClasses );
+      for( unsigned int i = 0; i < this->m_NumberOfClasses; ++i )
+      {
+        this->m_PriorPreference[ i ] = i;
+      }
+      this->m_LeastPreferredLabel = this->m_NumberOfClasses - 1;
+    }
+
     if( this->GetGenerateConfusionMatrix() )
     {
 
@@ -20,9 +20,11 @@
 
 #include "itkImage.h"
 #include "itkImageToImageFilter.h"
+#include "itkVectorImage.h"
 
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
 
 #include <vector>
 #include "itkArray.h"
@@ -86,6 +88,12 @@ namespace itk
   * to combine 8 bit (i.e., byte) images into a 16 bit (i.e., short) output
   * image.
   *
+  * Optionally, probabilistic segmentations are produced: one image per class.
+  * For many classes this takes too much memory. With
+  * SetNumberOfMostProbableClasses( k ) only the k most probable classes of
+  * each pixel are kept, in two vector images of length k: the labels,
+  * sorted by decreasing probability, and their probabilities.
+  *
   * In addition to the combined image, the estimated confusion matrices for
   * each of the input segmentations can be obtained through the
   * GetConfusionMatrix member function.
@@ -110,6 +118,22 @@ namespace itk
   * converged. The algorithm makes no attempt to report its progress since the
   * number of iterations needed cannot be known in advance.
   *
+  * \par MULTITHREADING
+  * The E and M steps of each iteration are split over the threads by
+  * splitting the output region. Each thread accumulates into its own copy
+  * of the updated confusion matrices, which are added afterwards, always
+  * in the order of the threads. The result is therefore reproducible
+  * for a given number of threads.
+  *
+  * \par UNIQUE TUPLES
+  * Usually most voxels have one of a few combinations of rater labels, e.g.
+  * all raters say background. Unless prior probability images are given,
+  * the voxels are therefore first collapsed into the unique tuples of rater
+  * labels with their multiplicities, and the EM iterations run on those
+  * tuples instead of on the voxels. The final pass looks up the tuple of
+  * each voxel to get its output. This can be switched off with
+  * SetUseUniqueTuples( false ).
+  *
   * This code is largely based on the MultiLabelSTAPLEImageFilter code
   * written by Rohlfing.
   *
@@ -167,6 +191,14 @@ namespace itk
     /** Various typedefs */
     typedef Array<WeightsType>                      ObserverTrustType;
     typedef std::vector<ProbabilityImagePointer>    ProbabilisticSegmentationArrayType;
+    typedef VectorImage<
+      OutputPixelType,
+      InputImageType::ImageDimension >              SparseLabelImageType;
+    typedef typename SparseLabelImageType::Pointer  SparseLabelImagePointer;
+    typedef VectorImage<
+      WeightsType,
+      InputImageType::ImageDimension >              SparseProbabilityImageType;
+    typedef typename SparseProbabilityImageType::Pointer SparseProbabilityImagePointer;
     typedef Array<OutputPixelType>                  PriorPreferenceType;
 
     /** Typedefs for mask support */
@@ -182,6 +214,10 @@ namespace itk
     typedef ImageRegionIterator<
       ProbabilityImageType >                            ProbIteratorType;
     typedef ImageRegionConstIterator< MaskImageType >   MaskConstIteratorType;
+    typedef ImageRegionIterator<
+      SparseLabelImageType >                            SparseLabelIteratorType;
+    typedef ImageRegionIterator<
+      SparseProbabilityImageType >                      SparseProbIteratorType;
 
     /** Set/get/unset maximum number of iterations. */
     virtual void SetMaximumNumberOfIterations( const unsigned int mit )
@@ -322,6 +358,20 @@ namespace itk
     itkSetMacro( InitializeWithMajorityVoting, bool)
     itkGetConstMacro( InitializeWithMajorityVoting, bool)
 
+    /** Set whether the EM iterations run on the unique tuples of rater
+     * labels instead of on the voxels; default: true. This is ignored
+     * when prior probability images are supplied */
+    itkSetMacro( UseUniqueTuples, bool );
+    itkGetConstMacro( UseUniqueTuples, bool );
+    itkBooleanMacro( UseUniqueTuples );
+
+    /** Get the number of unique tuples of rater labels found in the last
+     * update, or 0 if they were not used */
+    virtual SizeValueType GetNumberOfUniqueTuples( void ) const
+    {
+      return this->m_TupleSet.Counts.size();
+    }
+
     /** Setting: turn on/off to whether a probabilistic segmentation
      * is generated; default: false */
     itkSetMacro(GenerateProbabilisticSegmentations, bool);
@@ -336,14 +386,31 @@ namespace itk
       return this->m_ProbabilisticSegmentationArray;
     }
 
+    /** Set/get the number of most probable classes that are kept per pixel,
+     * when probabilistic segmentations are generated. If larger than 0, the
+     * sparse label and probability images are produced instead of one image
+     * per class; default: 0 */
+    itkSetMacro( NumberOfMostProbableClasses, unsigned int );
+    itkGetConstMacro( NumberOfMostProbableClasses, unsigned int );
+
+    /** Get the labels and probabilities of the most probable classes. Only
+     * valid when SetGenerateProbabilisticSegmentations(true) and
+     * SetNumberOfMostProbableClasses(k > 0) have been invoked before
+     * updating this filter. */
+    itkGetObjectMacro( SparseLabelImage, SparseLabelImageType );
+    itkGetObjectMacro( SparseProbabilityImage, SparseProbabilityImageType );
+
     /** If you have inspected the probabilistic segmentations and want to get rid
      * of those float images sitting in your memory, call this function */
     virtual void CleanProbabilisticSegmentations( void )
     {
-      if( this->m_ProbabilisticSegmentationArray.size() > 0 )
+      if( this->m_ProbabilisticSegmentationArray.size() > 0
+        || this->m_SparseLabelImage.IsNotNull() )
       {
         this->m_ProbabilisticSegmentationArray =
           ProbabilisticSegmentationArrayType(0);
+        this->m_SparseLabelImage = 0;
+        this->m_SparseProbabilityImage = 0;
         this->Modified();
       }
     }
@@ -374,9 +441,13 @@ namespace itk
     /** Print some information, not really implemented */
     void PrintSelf(std::ostream&, Indent) const;
 
-    /** Determine maximum value among all input images' pixels */
+    /** Determine maximum value among all input images' pixels, multithreaded */
     virtual InputPixelType ComputeMaximumInputValue();
 
+    /** Determine the maximum value in a part of the buffer of each input */
+    virtual void ThreadedComputeMaximumInputValue(
+      ThreadIdType threadId, ThreadIdType numberOfThreads );
+
     /** Initialize the prior probabilities, if not supplied by the user */
     virtual void InitializePriorProbabilities();
 
@@ -384,6 +455,81 @@ namespace itk
     virtual void AllocateConfusionMatrixArray();
     virtual void InitializeConfusionMatrixArray();
 
+    /** Do the E step and accumulate the M step for a part of the image,
+     * into the confusion matrices of this thread */
+    virtual void ThreadedUpdateConfusionMatrices(
+      const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId );
+
+    /** Compute the output (and probabilistic segmentations) for a part
+     * of the image, based on the estimated confusion matrices */
+    virtual void ThreadedComputeOutput(
+      const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId );
+
+    /** Collapse the voxels (inside the mask) into the unique tuples of rater
+     * labels and their multiplicities. Each thread collects the tuples of a
+     * part of the image, the parts are merged in thread order. */
+    virtual void ComputeUniqueTuples( void );
+
+    /** Collect the unique tuples of a part of the image, into the tuple
+     * set of this thread */
+    virtual void ThreadedComputeUniqueTuples(
+      const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId );
+
+    /** Do the E step and accumulate the M step for a part of the unique
+     * tuples, into the confusion matrices of this thread */
+    virtual void ThreadedUpdateConfusionMatricesFromTuples(
+      ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+    /** Compute the probabilities and winning label of a part of the unique
+     * tuples, based on the estimated confusion matrices */
+    virtual void ThreadedComputeTupleOutputs(
+      ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+    /** A set of unique tuples of rater labels, stored one after the other,
+     * with their multiplicities and hashes. The tuples are found with an
+     * open addressing hash table, with linear probing, of which an entry
+     * is the index of a tuple plus one, or zero if it is empty. Its size
+     * is a power of two, and it is at most half full. */
+    struct TupleSetType
+    {
+      std::vector<InputPixelType>  Tuples;
+      std::vector<SizeValueType>   Counts;
+      std::vector<unsigned long>   Hashes;
+      std::vector<SizeValueType>   Table;
+    };
+
+    /** Find the index of a tuple of n rater labels in a set, or the
+     * number of tuples in the set if it is not there. */
+    static SizeValueType FindTuple( const TupleSetType & set,
+      const InputPixelType * tuple, unsigned long hash, unsigned int n );
+
+    /** Add count to the multiplicity of a tuple of n rater labels, adding
+     * the tuple to the set if it is new, and return its index. */
+    static SizeValueType AddTuple( TupleSetType & set,
+      const InputPixelType * tuple, unsigned long hash, unsigned int n,
+      SizeValueType count );
+
+    /** Remove all tuples from a set, and free its memory */
+    static void ClearTupleSet( TupleSetType & set );
+
+    /** A hash of a tuple of rater labels */
+    static unsigned long HashTuple( const InputPixelType * tuple, unsigned int n );
+
+    /** Compute the E step for one voxel or tuple, i.e. multiply the priors
+     * in W with the confusion matrix entries of the rater labels and
+     * normalize */
+    void ComputeWeights( const InputPixelType * tuple, Array<WeightsType> & W ) const;
+
+    /** Determine the label with the maximum W, using the prior preference
+     * in case of ties */
+    OutputPixelType ComputeWinningLabel( const Array<WeightsType> & W ) const;
+
+    /** Select the classes with the highest W, sorted by decreasing W. The
+     * size of labels and probabilities determines how many. */
+    void ComputeMostProbableClasses( const Array<WeightsType> & W,
+      VariableLengthVector<OutputPixelType> & labels,
+      VariableLengthVector<WeightsType> & probabilities ) const;
+
     /** The number of different labels found in the input segmentations */
     InputPixelType m_NumberOfClasses;
 
@@ -404,8 +550,31 @@ namespace itk
     std::vector<ConfusionMatrixType>   m_ConfusionMatrixArray;
     std::vector<ConfusionMatrixType>   m_UpdatedConfusionMatrixArray;
     ProbabilisticSegmentationArrayType m_ProbabilisticSegmentationArray;
+    SparseLabelImagePointer            m_SparseLabelImage;
+    SparseProbabilityImagePointer      m_SparseProbabilityImage;
     PriorPreferenceType                m_PriorPreference;
 
+    typedef std::vector<ConfusionMatrixType> ConfusionMatrixArrayType;
+    typedef std::vector<ConfusionMatrixArrayType> ConfusionMatrixArrayArrayType;
+
+    /** For multithreading: */
+    ConfusionMatrixArrayArrayType      m_ConfusionMatrixArrays;
+
+    /** The label with the highest priorPreference number */
+    OutputPixelType m_LeastPreferredLabel;
+
+    /** The unique tuples of rater labels, and those of each thread */
+    TupleSetType                       m_TupleSet;
+    std::vector<TupleSetType>          m_ThreadTupleSets;
+
+    /** Per tuple the probabilities of the classes and the winning label */
+    std::vector<WeightsType>           m_TupleWeights;
+    std::vector<OutputPixelType>       m_TupleLabels;
+    bool                               m_UsingTuples;
+
+    /** The maximum input label seen by each thread */
+    std::vector<InputPixelType>        m_ThreadMaximumLabels;
+
     /** Variables updated during iterating: */
     WeightsType m_MaximumConfusionMatrixElementUpdate;
     unsigned int m_ElapsedIterations;
@@ -414,12 +583,37 @@ namespace itk
     MultiLabelSTAPLE2ImageFilter(const Self&); //purposely not implemented
     void operator=(const Self&); //purposely not implemented
 
+    /** The passes over the image or the unique tuples that are split over
+     * the threads */
+    typedef enum {
+      MaximumInputValueStep,
+      ComputeUniqueTuplesStep,
+      UpdateConfusionMatricesStep,
+      UpdateConfusionMatricesFromTuplesStep,
+      ComputeTupleOutputsStep,
+      ComputeOutputStep
+    } ThreadStepType;
+
+    struct ThreadStruct
+    {
+      Self *          Filter;
+      ThreadStepType  Step;
+    };
+
+    /** Run a pass, splitting the output region over the threads */
+    void ExecuteStep( ThreadStepType step );
+
+    /** Static function used as a "callback" by the MultiThreader */
+    static ITK_THREAD_RETURN_TYPE ThreaderCallback( void * arg );
+
     /** Settings that can be accessed via the set/get member functions */
     unsigned int m_MaximumNumberOfIterations;
     bool m_GenerateProbabilisticSegmentations;
     WeightsType m_TerminationUpdateThreshold;
     MaskImagePointer m_MaskImage;
     bool m_InitializeWithMajorityVoting;
+    bool m_UseUniqueTuples;
+    unsigned int m_NumberOfMostProbableClasses;
 
 
   };
@@ -22,6 +22,7 @@
 #include "itkLabelVoting2ImageFilter.h"
 
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -44,6 +45,12 @@ namespace itk
     this->m_NumberOfClasses = 2;
     this->m_MaskImage = 0;
     this->m_InitializeWithMajorityVoting = false;
+    this->m_LeastPreferredLabel = 0;
+    this->m_UseUniqueTuples = true;
+    this->m_UsingTuples = false;
+    this->m_NumberOfMostProbableClasses = 0;
+    this->m_SparseLabelImage = 0;
+    this->m_SparseProbabilityImage = 0;
   } // end constructor
 
 
@@ -62,21 +69,45 @@ namespace itk
     MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
     ::ComputeMaximumInputValue()
   {
-    /** compute the maximum class label from the input data */
+    /** compute the maximum class label from the input data;
+     * each thread scans a part of the buffer of every input */
+    this->m_ThreadMaximumLabels.assign( this->GetNumberOfThreads(), 0 );
+    this->ExecuteStep( MaximumInputValueStep );
+
+    InputPixelType maxLabel = 0;
+    for( unsigned int t = 0; t < this->m_ThreadMaximumLabels.size(); ++t )
+    {
+      maxLabel = vnl_math_max( maxLabel, this->m_ThreadMaximumLabels[t] );
+    }
+    this->m_ThreadMaximumLabels.clear();
+
+    return maxLabel;
+  } // end ComputeMaximumInputValue
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedComputeMaximumInputValue(
+      ThreadIdType threadId, ThreadIdType numberOfThreads )
+  {
     InputPixelType maxLabel = 0;
     const unsigned int numberOfInputs = this->GetNumberOfInputs();
 
     for( unsigned int k = 0; k < numberOfInputs; ++k )
     {
-      InputConstIteratorType it
-        ( this->GetInput( k ), this->GetInput( k )->GetBufferedRegion() );
-
-      for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
-        maxLabel = vnl_math_max( maxLabel, it.Get() );
+      const InputPixelType * buffer = this->GetInput( k )->GetBufferPointer();
+      const SizeValueType numberOfPixels =
+        this->GetInput( k )->GetBufferedRegion().GetNumberOfPixels();
+      const SizeValueType begin = threadId * numberOfPixels / numberOfThreads;
+      const SizeValueType end = ( threadId + 1 ) * numberOfPixels / numberOfThreads;
+
+      for( SizeValueType i = begin; i < end; ++i )
+        maxLabel = vnl_math_max( maxLabel, buffer[ i ] );
     }
 
-    return maxLabel;
-  } // end ComputeMaximumInputValue
+    this->m_ThreadMaximumLabels[ threadId ] = maxLabel;
+  } // end ThreadedComputeMaximumInputValue
 
 
   template< typename TInputImage, typename TOutputImage, typename TWeights >
@@ -248,19 +279,12 @@ namespace itk
     MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
     ::GenerateData()
   {
-    typedef Array<WeightsType>                  WType;
-    typedef std::vector<InputConstIteratorType> InputConstIteratorArrayType;
-    typedef std::vector<ProbIteratorType>       ProbIteratorArrayType;
-    typedef std::vector<ProbConstIteratorType>  ProbConstIteratorArrayType;
-
     /** Initialize some variables */
     this->m_MaximumConfusionMatrixElementUpdate = 0.0;
     this->m_ElapsedIterations = 0;
     const bool generateProbSeg =
       this->GetGenerateProbabilisticSegmentations();
-    const bool useMask = this->m_MaskImage.IsNotNull();
     const unsigned int numberOfInputs = this->GetNumberOfInputs();
-    WType W( this->m_NumberOfClasses );
     OutputImagePointer output = this->GetOutput();
     this->AllocateOutputs();
 
@@ -284,12 +308,12 @@ namespace itk
     }
 
     /** Determine the least preferred label */
-    OutputPixelType leastPreferredLabel = 0;
+    this->m_LeastPreferredLabel = 0;
     for( unsigned int i= 0; i< this->m_NumberOfClasses; ++i )
     {
       if( this->m_PriorPreference[ i ] == (this->m_NumberOfClasses-1) )
       {
-        leastPreferredLabel = i;
+        this->m_LeastPreferredLabel = i;
       }
     }
 
@@ -298,8 +322,29 @@ namespace itk
     this->AllocateConfusionMatrixArray();
     this->InitializeConfusionMatrixArray();
 
-    /** If probabilistic segmentations are desired, allocate them */
-    if( generateProbSeg )
+    /** If probabilistic segmentations are desired, allocate them; either
+     * the sparse images of the most probable classes, or an image per class */
+    this->m_ProbabilisticSegmentationArray = ProbabilisticSegmentationArrayType(0);
+    this->m_SparseLabelImage = 0;
+    this->m_SparseProbabilityImage = 0;
+    const unsigned int numberOfMostProbableClasses = vnl_math_min(
+      this->m_NumberOfMostProbableClasses,
+      static_cast<unsigned int>( this->m_NumberOfClasses ) );
+    if( generateProbSeg && numberOfMostProbableClasses > 0 )
+    {
+      this->m_SparseLabelImage = SparseLabelImageType::New();
+      this->m_SparseLabelImage->SetRegions( output->GetRequestedRegion() );
+      this->m_SparseLabelImage->CopyInformation( output );
+      this->m_SparseLabelImage->SetVectorLength( numberOfMostProbableClasses );
+      this->m_SparseLabelImage->Allocate();
+
+      this->m_SparseProbabilityImage = SparseProbabilityImageType::New();
+      this->m_SparseProbabilityImage->SetRegions( output->GetRequestedRegion() );
+      this->m_SparseProbabilityImage->CopyInformation( output );
+      this->m_SparseProbabilityImage->SetVectorLength( numberOfMostProbableClasses );
+      this->m_SparseProbabilityImage->Allocate();
+    }
+    else if( generateProbSeg )
     {
       this->m_ProbabilisticSegmentationArray =
         ProbabilisticSegmentationArrayType( this->m_NumberOfClasses );
@@ -314,134 +359,50 @@ namespace itk
       }
     }
 
-    /** create and initialize all input image iterators */
-    InputConstIteratorArrayType it(numberOfInputs);
-    for( unsigned int k = 0; k < numberOfInputs; ++k )
+    /** Collapse the voxels into the unique tuples of rater labels. With
+     * prior probability images the voxels with equal tuples differ. */
+    this->m_UsingTuples = this->m_UseUniqueTuples
+      && !this->m_HasPriorProbabilityImageArray;
+    ClearTupleSet( this->m_TupleSet );
+    if( this->m_UsingTuples )
     {
-      it[k] = InputConstIteratorType
-        ( this->GetInput( k ), output->GetRequestedRegion() );
+      this->ComputeUniqueTuples();
     }
 
-    /** Create and initialize the prior prob image iterators */
-    ProbConstIteratorArrayType pit;
-    if( this->m_HasPriorProbabilityImageArray )
-    {
-      pit = ProbConstIteratorArrayType( this->m_NumberOfClasses );
-      for( unsigned int k = 0; k < this->m_NumberOfClasses; ++k )
-      {
-        pit[k] = ProbConstIteratorType(
-          this->m_PriorProbabilityImageArray[k], output->GetRequestedRegion() );
-      }
-    }
-
-    /** Create and initialize the output probabilistic segmentation image iterators */
-    ProbIteratorArrayType psit;
-    if( generateProbSeg )
-    {
-      psit = ProbIteratorArrayType( this->m_NumberOfClasses );
-      for( unsigned int k = 0; k < this->m_NumberOfClasses; ++k )
-      {
-        psit[k] = ProbIteratorType(
-          this->m_ProbabilisticSegmentationArray[k], output->GetRequestedRegion() );
-      }
-    }
-
-    /** Create and initialize the mask iterator */
-    MaskConstIteratorType mit;
-    const MaskPixelType zeroMaskPixel = itk::NumericTraits<MaskPixelType>::Zero;
-    if( useMask )
-    {
-      mit = MaskConstIteratorType(
-        this->m_MaskImage, this->GetOutput()->GetRequestedRegion() );
-    }
-
-    /** Create and initialize the output iterator */
-    OutputIteratorType out = OutputIteratorType( output, output->GetRequestedRegion() );
+    /** Allocate the updated confusion matrices of each thread */
+    const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+    this->m_ConfusionMatrixArrays = ConfusionMatrixArrayArrayType(
+      numberOfThreads, this->m_UpdatedConfusionMatrixArray );
 
     /** Start iterating! */
     while (  ( !this->m_HasMaximumNumberOfIterations ) ||
              ( this->m_ElapsedIterations < this->m_MaximumNumberOfIterations )   )
     {
-      /** reset updated confusion matrix */
-      for( unsigned int k = 0; k < numberOfInputs; ++k )
+      /** reset updated confusion matrices of all threads */
+      for( ThreadIdType t = 0; t < numberOfThreads; ++t )
       {
-        this->m_UpdatedConfusionMatrixArray[k].Fill( 0.0 );
-      }
-
-      /** Loop over voxels and do the E and M step
-       * use it[0] as indicator for image pixel count */
-      while ( ! it[0].IsAtEnd() )
-      {
-        if(useMask)
-        {
-          if( mit.Get() == zeroMaskPixel )
-          {
-            /** Move all iterators to the next pixel and go to the
-             * next cycle of the while loop */
-            ++mit;
-            for( unsigned int k = 0; k < numberOfInputs; ++k )
-            {
-              ++(it[k]);
-            }
-            if( this->m_HasPriorProbabilityImageArray )
-            {
-              for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
-              {
-                ++(pit[ci]);
-              }
-            }
-            continue;
-          } // end if mit==zero
-          /** Move the iterator to the next pixel */
-          ++mit;
-        } // end if useMask
-
-        /** the following is the E step for one pixel, only performed when this
-         * pixel is inside the mask */
-        if( this->m_HasPriorProbabilityImageArray )
-        {
-          for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
-          {
-            W[ci] = pit[ci].Get();
-            /** move already to next pixel */
-            ++(pit[ci]);
-          }
-        }
-        else
-        {
-          W = this->m_PriorProbabilities;
-        }
-
         for( unsigned int k = 0; k < numberOfInputs; ++k )
         {
-          const InputPixelType j = it[k].Get();
-          for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
-          {
-            W[ci] *= this->m_ConfusionMatrixArray[k][j][ci];
-          }
+          this->m_ConfusionMatrixArrays[t][k].Fill( 0.0 );
         }
+      }
 
-        // the following is the M step
-        /** normalize: */
-        WeightsType sumW = W.sum();
-        if( sumW )
-        {
-          W /= sumW;
-        }
+      /** Do the E and M step, each thread for a part of the unique tuples
+       * or of the voxels */
+      this->ExecuteStep( this->m_UsingTuples
+        ? UpdateConfusionMatricesFromTuplesStep : UpdateConfusionMatricesStep );
 
-        for( unsigned int k = 0; k < numberOfInputs; ++k )
+      /** Add the updated confusion matrices of all threads. This is always
+       * done in the order of the threads, so that the result does not
+       * depend on which thread finished first. */
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+        this->m_UpdatedConfusionMatrixArray[k].Fill( 0.0 );
+        for( ThreadIdType t = 0; t < numberOfThreads; ++t )
         {
-          const InputPixelType j = it[k].Get();
-          for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
-          {
-            this->m_UpdatedConfusionMatrixArray[k][j][ci] += W[ci];
-          }
-
-          // we're now done with this input pixel, so update.
-          ++(it[k]);
+          this->m_UpdatedConfusionMatrixArray[k] += this->m_ConfusionMatrixArrays[t][k];
         }
-
-      } // end loop over voxels
+      }
 
       /** Normalize matrix elements of each of the updated confusion matrices
        * with sum over all expert decisions. */
@@ -480,25 +441,6 @@ namespace itk
       /** We have finished this iteration */
       ++(this->m_ElapsedIterations);
 
-      /** reset all input iterators to start, to be prepared for next iteration
-       * or for generating the final segmentation, if the current iteration
-       * happened to be the last one */
-      if(useMask)
-      {
-        mit.GoToBegin();
-      }
-      for( unsigned int k = 0; k < numberOfInputs; ++k )
-      {
-        it[k].GoToBegin();
-      }
-      if( this->m_HasPriorProbabilityImageArray )
-      {
-        for( unsigned int k = 0; k < this->m_NumberOfClasses; ++k )
-        {
-          pit[k].GoToBegin();
-        }
-      }
-
       /** Allow user to do something */
       this->InvokeEvent( IterationEvent() );
       if( this->GetAbortGenerateData() )
@@ -515,13 +457,303 @@ namespace itk
 
     } // end for ( iteration )
 
+    this->m_ConfusionMatrixArrays.clear();
 
     /** now we'll build the combined output image based on the estimated
-     * confusion matrices */
-    for ( out.GoToBegin(); !out.IsAtEnd(); ++out )
+     * confusion matrices, scattering the results of the tuples if used */
+    if( this->m_UsingTuples )
+    {
+      const SizeValueType numberOfTuples = this->m_TupleSet.Counts.size();
+      this->m_TupleWeights.resize( numberOfTuples * this->m_NumberOfClasses );
+      this->m_TupleLabels.resize( numberOfTuples );
+      this->ExecuteStep( ComputeTupleOutputsStep );
+    }
+    this->ExecuteStep( ComputeOutputStep );
+
+    /** Free the tuples; only their multiplicities are kept */
+    std::vector<InputPixelType>().swap( this->m_TupleSet.Tuples );
+    std::vector<unsigned long>().swap( this->m_TupleSet.Hashes );
+    std::vector<SizeValueType>().swap( this->m_TupleSet.Table );
+    this->m_TupleWeights.clear();
+    this->m_TupleLabels.clear();
+
+  } // end GenerateData
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ExecuteStep( ThreadStepType step )
+  {
+    ThreadStruct str;
+    str.Filter = this;
+    str.Step = step;
+
+    this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->GetMultiThreader()->SetSingleMethod( ThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+  } // end ExecuteStep
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    ITK_THREAD_RETURN_TYPE
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreaderCallback( void * arg )
+  {
+    typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+    ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+    ThreadStruct * str = static_cast<ThreadStruct *>( info->UserData );
+    const ThreadIdType threadId = info->ThreadID;
+    const ThreadIdType threadCount = info->NumberOfThreads;
+
+    /** the scan of the input labels covers the buffers, not the region,
+     * and the passes over the unique tuples split the tuples */
+    if( str->Step == MaximumInputValueStep )
+    {
+      str->Filter->ThreadedComputeMaximumInputValue( threadId, threadCount );
+      return ITK_THREAD_RETURN_VALUE;
+    }
+    if( str->Step == UpdateConfusionMatricesFromTuplesStep )
+    {
+      str->Filter->ThreadedUpdateConfusionMatricesFromTuples( threadId, threadCount );
+      return ITK_THREAD_RETURN_VALUE;
+    }
+    if( str->Step == ComputeTupleOutputsStep )
     {
-      OutputPixelType winningLabel = leastPreferredLabel;
+      str->Filter->ThreadedComputeTupleOutputs( threadId, threadCount );
+      return ITK_THREAD_RETURN_VALUE;
+    }
 
+    /** execute the actual method with appropriate output region;
+     * first find out how many pieces extent can be split into. */
+    OutputImageRegionType splitRegion;
+    const ThreadIdType total =
+      str->Filter->SplitRequestedRegion( threadId, threadCount, splitRegion );
+    if( threadId >= total )
+    {
+      return ITK_THREAD_RETURN_VALUE;
+    }
+
+    switch( str->Step )
+    {
+      case MaximumInputValueStep:
+      case UpdateConfusionMatricesFromTuplesStep:
+      case ComputeTupleOutputsStep:
+        break;
+      case UpdateConfusionMatricesStep:
+        str->Filter->ThreadedUpdateConfusionMatrices( splitRegion, threadId );
+        break;
+      case ComputeUniqueTuplesStep:
+        str->Filter->ThreadedComputeUniqueTuples( splitRegion, threadId );
+        break;
+      case ComputeOutputStep:
+        str->Filter->ThreadedComputeOutput( splitRegion, threadId );
+        break;
+    }
+
+    return ITK_THREAD_RETURN_VALUE;
+  } // end ThreaderCallback
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedUpdateConfusionMatrices(
+      const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId )
+  {
+    typedef Array<WeightsType>                  WType;
+    typedef std::vector<InputConstIteratorType> InputConstIteratorArrayType;
+    typedef std::vector<ProbConstIteratorType>  ProbConstIteratorArrayType;
+
+    const bool useMask = this->m_MaskImage.IsNotNull();
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+    ConfusionMatrixArrayType & updatedConfusionMatrixArray =
+      this->m_ConfusionMatrixArrays[ threadId ];
+    WType W( this->m_NumberOfClasses );
+
+    /** create and initialize all input image iterators */
+    InputConstIteratorArrayType it(numberOfInputs);
+    for( unsigned int k = 0; k < numberOfInputs; ++k )
+    {
+      it[k] = InputConstIteratorType
+        ( this->GetInput( k ), outputRegionForThread );
+    }
+
+    /** Create and initialize the prior prob image iterators */
+    ProbConstIteratorArrayType pit;
+    if( this->m_HasPriorProbabilityImageArray )
+    {
+      pit = ProbConstIteratorArrayType( this->m_NumberOfClasses );
+      for( unsigned int k = 0; k < this->m_NumberOfClasses; ++k )
+      {
+        pit[k] = ProbConstIteratorType(
+          this->m_PriorProbabilityImageArray[k], outputRegionForThread );
+      }
+    }
+
+    /** Create and initialize the mask iterator */
+    MaskConstIteratorType mit;
+    const MaskPixelType zeroMaskPixel = itk::NumericTraits<MaskPixelType>::Zero;
+    if( useMask )
+    {
+      mit = MaskConstIteratorType( this->m_MaskImage, outputRegionForThread );
+    }
+
+    /** Loop over voxels and do the E and M step
+     * use it[0] as indicator for image pixel count */
+    while ( ! it[0].IsAtEnd() )
+    {
+      if(useMask)
+      {
+        if( mit.Get() == zeroMaskPixel )
+        {
+          /** Move all iterators to the next pixel and go to the
+           * next cycle of the while loop */
+          ++mit;
+          for( unsigned int k = 0; k < numberOfInputs; ++k )
+          {
+            ++(it[k]);
+          }
+          if( this->m_HasPriorProbabilityImageArray )
+          {
+            for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+            {
+              ++(pit[ci]);
+            }
+          }
+          continue;
+        } // end if mit==zero
+        /** Move the iterator to the next pixel */
+        ++mit;
+      } // end if useMask
+
+      /** the following is the E step for one pixel, only performed when this
+       * pixel is inside the mask */
+      if( this->m_HasPriorProbabilityImageArray )
+      {
+        for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+        {
+          W[ci] = pit[ci].Get();
+          /** move already to next pixel */
+          ++(pit[ci]);
+        }
+      }
+      else
+      {
+        W = this->m_PriorProbabilities;
+      }
+
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+        const InputPixelType j = it[k].Get();
+        for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+        {
+          W[ci] *= this->m_ConfusionMatrixArray[k][j][ci];
+        }
+      }
+
+      // the following is the M step
+      /** normalize: */
+      WeightsType sumW = W.sum();
+      if( sumW )
+      {
+        W /= sumW;
+      }
+
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+        const InputPixelType j = it[k].Get();
+        for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+        {
+          updatedConfusionMatrixArray[k][j][ci] += W[ci];
+        }
+
+        // we're now done with this input pixel, so update.
+        ++(it[k]);
+      }
+
+    } // end loop over voxels
+
+  } // end ThreadedUpdateConfusionMatrices
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedComputeOutput(
+      const OutputImageRegionType & outputRegionForThread, ThreadIdType itkNotUsed( threadId ) )
+  {
+    typedef Array<WeightsType>                  WType;
+    typedef std::vector<InputConstIteratorType> InputConstIteratorArrayType;
+    typedef std::vector<ProbIteratorType>       ProbIteratorArrayType;
+    typedef std::vector<ProbConstIteratorType>  ProbConstIteratorArrayType;
+
+    const bool generateProbSeg =
+      this->GetGenerateProbabilisticSegmentations();
+    const bool useMask = this->m_MaskImage.IsNotNull();
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+    WType W( this->m_NumberOfClasses );
+    std::vector<InputPixelType> tuple( numberOfInputs );
+
+    /** create and initialize all input image iterators */
+    InputConstIteratorArrayType it(numberOfInputs);
+    for( unsigned int k = 0; k < numberOfInputs; ++k )
+    {
+      it[k] = InputConstIteratorType
+        ( this->GetInput( k ), outputRegionForThread );
+    }
+
+    /** Create and initialize the prior prob image iterators */
+    ProbConstIteratorArrayType pit;
+    if( this->m_HasPriorProbabilityImageArray )
+    {
+      pit = ProbConstIteratorArrayType( this->m_NumberOfClasses );
+      for( unsigned int k = 0; k < this->m_NumberOfClasses; ++k )
+      {
+        pit[k] = ProbConstIteratorType(
+          this->m_PriorProbabilityImageArray[k], outputRegionForThread );
+      }
+    }
+
+    /** Create and initialize the output probabilistic segmentation image
+     * iterators, either of the sparse images or of an image per class */
+    const bool generateSparseProbSeg =
+      generateProbSeg && this->m_SparseLabelImage.IsNotNull();
+    ProbIteratorArrayType psit;
+    SparseLabelIteratorType slit;
+    SparseProbIteratorType spit;
+    VariableLengthVector<OutputPixelType> sparseLabels;
+    VariableLengthVector<WeightsType> sparseProbabilities;
+    if( generateSparseProbSeg )
+    {
+      slit = SparseLabelIteratorType( this->m_SparseLabelImage, outputRegionForThread );
+      spit = SparseProbIteratorType( this->m_SparseProbabilityImage, outputRegionForThread );
+      sparseLabels.SetSize( this->m_SparseLabelImage->GetVectorLength() );
+      sparseProbabilities.SetSize( this->m_SparseProbabilityImage->GetVectorLength() );
+    }
+    else if( generateProbSeg )
+    {
+      psit = ProbIteratorArrayType( this->m_NumberOfClasses );
+      for( unsigned int k = 0; k < this->m_NumberOfClasses; ++k )
+      {
+        psit[k] = ProbIteratorType(
+          this->m_ProbabilisticSegmentationArray[k], outputRegionForThread );
+      }
+    }
+
+    /** Create and initialize the mask iterator */
+    MaskConstIteratorType mit;
+    const MaskPixelType zeroMaskPixel = itk::NumericTraits<MaskPixelType>::Zero;
+    if( useMask )
+    {
+      mit = MaskConstIteratorType( this->m_MaskImage, outputRegionForThread );
+    }
+
+    /** Create and initialize the output iterator */
+    OutputIteratorType out = OutputIteratorType( this->GetOutput(), outputRegionForThread );
+
+    for ( out.GoToBegin(); !out.IsAtEnd(); ++out )
+    {
       bool insideMask = true;
       if(useMask)
       {
@@ -531,7 +763,7 @@ namespace itk
         {
           insideMask = false;
           W.Fill( 0.0 );
-          winningLabel = it[0].Get();
+          const OutputPixelType winningLabel = it[0].Get();
           W[ winningLabel ] = 1.0;
           /** Set the winning label to the output pixel */
           out.Set( winningLabel );
@@ -551,7 +783,28 @@ namespace itk
         ++mit;
       } // end if useMask
 
-      if( insideMask )
+      if( insideMask && this->m_UsingTuples )
+      {
+        /** Look up the results of the tuple of this pixel */
+        for( unsigned int k = 0; k < numberOfInputs; ++k )
+        {
+          tuple[k] = it[k].Get();
+          ++(it[k]);
+        }
+        const SizeValueType t = FindTuple( this->m_TupleSet,
+          &tuple[0], HashTuple( &tuple[0], numberOfInputs ), numberOfInputs );
+        if( generateProbSeg )
+        {
+          for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+          {
+            W[ci] = this->m_TupleWeights[ t * this->m_NumberOfClasses + ci ];
+          }
+        }
+
+        /** Set the winning label to the output pixel */
+        out.Set( this->m_TupleLabels[ t ] );
+      }
+      else if( insideMask )
       {
         // basically, we'll repeat the E step from above
         if( this->m_HasPriorProbabilityImageArray )
@@ -569,61 +822,370 @@ namespace itk
 
         for( unsigned int k = 0; k < numberOfInputs; ++k )
         {
-          const InputPixelType j = it[k].Get();
-          for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
-          {
-            W[ci] *= this->m_ConfusionMatrixArray[k][j][ci];
-          }
+          tuple[k] = it[k].Get();
           ++(it[k]);
         }
+        this->ComputeWeights( &tuple[0], W );
+
+        /** Set the winning label to the output pixel */
+        out.Set( this->ComputeWinningLabel( W ) );
+      } // end if insideMask
+
 
-        /** normalize: */
-        WeightsType sumW = W.sum();
-        if( sumW )
+      /** copy the W values into the probabilistic segmentation images
+       * and move the psit iterators; for the sparse images only the most
+       * probable classes */
+      if( generateSparseProbSeg )
+      {
+        this->ComputeMostProbableClasses( W, sparseLabels, sparseProbabilities );
+        slit.Set( sparseLabels );
+        spit.Set( sparseProbabilities );
+        ++slit;
+        ++spit;
+      }
+      else if( generateProbSeg )
+      {
+        for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
         {
-          W /= sumW;
+          psit[ci].Set( W[ci] );
+          ++(psit[ci]);
         }
+      }
 
-        // now determine the label with the maximum W
-        WeightsType winningLabelW = 0.0;
-        for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+    } // end loop over output pixels
+
+  } // end ThreadedComputeOutput
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ComputeUniqueTuples()
+  {
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+
+    /** Collect the tuples of each part of the image */
+    this->m_ThreadTupleSets.assign( this->GetNumberOfThreads(), TupleSetType() );
+    this->ExecuteStep( ComputeUniqueTuplesStep );
+
+    /** Merge them in thread order, so that the order of the tuples, and
+     * with that the result of the iterations, does not depend on the
+     * number of threads more than necessary */
+    for( unsigned int t = 0; t < this->m_ThreadTupleSets.size(); ++t )
+    {
+      const TupleSetType & threadSet = this->m_ThreadTupleSets[ t ];
+      for( SizeValueType i = 0; i < threadSet.Counts.size(); ++i )
+      {
+        AddTuple( this->m_TupleSet, &threadSet.Tuples[ i * numberOfInputs ],
+          threadSet.Hashes[ i ], numberOfInputs, threadSet.Counts[ i ] );
+      }
+      ClearTupleSet( this->m_ThreadTupleSets[ t ] );
+    }
+    this->m_ThreadTupleSets.clear();
+
+  } // end ComputeUniqueTuples
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedComputeUniqueTuples(
+      const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId )
+  {
+    typedef std::vector<InputConstIteratorType> InputConstIteratorArrayType;
+
+    TupleSetType & set = this->m_ThreadTupleSets[ threadId ];
+    const bool useMask = this->m_MaskImage.IsNotNull();
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+    std::vector<InputPixelType> tuple( numberOfInputs );
+
+    /** create and initialize all input image iterators */
+    InputConstIteratorArrayType it(numberOfInputs);
+    for( unsigned int k = 0; k < numberOfInputs; ++k )
+    {
+      it[k] = InputConstIteratorType
+        ( this->GetInput( k ), outputRegionForThread );
+    }
+
+    /** Create and initialize the mask iterator */
+    MaskConstIteratorType mit;
+    const MaskPixelType zeroMaskPixel = itk::NumericTraits<MaskPixelType>::Zero;
+    if( useMask )
+    {
+      mit = MaskConstIteratorType(
+        this->m_MaskImage, outputRegionForThread );
+    }
+
+    /** Neighbouring voxels often have the same tuple, so first compare
+     * with the tuple of the previous voxel before hashing */
+    SizeValueType previous = 0;
+    while ( ! it[0].IsAtEnd() )
+    {
+      bool insideMask = true;
+      if( useMask )
+      {
+        insideMask = mit.Get() != zeroMaskPixel;
+        ++mit;
+      }
+
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+        tuple[k] = it[k].Get();
+        ++(it[k]);
+      }
+      if( !insideMask ) continue;
+
+      if( !set.Counts.empty() && std::equal( tuple.begin(), tuple.end(),
+        set.Tuples.begin() + previous * numberOfInputs ) )
+      {
+        ++set.Counts[ previous ];
+        continue;
+      }
+
+      previous = AddTuple( set, &tuple[0],
+        HashTuple( &tuple[0], numberOfInputs ), numberOfInputs, 1 );
+    } // end loop over voxels
+
+  } // end ThreadedComputeUniqueTuples
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    SizeValueType
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::FindTuple( const TupleSetType & set, const InputPixelType * tuple,
+      unsigned long hash, unsigned int n )
+  {
+    if( set.Table.empty() ) return set.Counts.size();
+
+    const SizeValueType mask = set.Table.size() - 1;
+    for( SizeValueType slot = hash & mask; set.Table[ slot ] != 0; slot = ( slot + 1 ) & mask )
+    {
+      const SizeValueType index = set.Table[ slot ] - 1;
+      if( set.Hashes[ index ] == hash
+        && std::equal( tuple, tuple + n, set.Tuples.begin() + index * n ) )
+      {
+        return index;
+      }
+    }
+    return set.Counts.size();
+  } // end FindTuple
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    SizeValueType
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::AddTuple( TupleSetType & set, const InputPixelType * tuple,
+      unsigned long hash, unsigned int n, SizeValueType count )
+  {
+    /** Keep the table at most half full; when it grows, reinsert all tuples
+     * using their stored hashes */
+    if( 2 * ( set.Counts.size() + 1 ) > set.Table.size() )
+    {
+      const SizeValueType size = vnl_math_max(
+        static_cast<SizeValueType>( 1024 ), 2 * static_cast<SizeValueType>( set.Table.size() ) );
+      const SizeValueType mask = size - 1;
+      set.Table.assign( size, 0 );
+      for( SizeValueType i = 0; i < set.Counts.size(); ++i )
+      {
+        SizeValueType slot = set.Hashes[ i ] & mask;
+        while( set.Table[ slot ] != 0 ) slot = ( slot + 1 ) & mask;
+        set.Table[ slot ] = i + 1;
+      }
+    }
+
+    const SizeValueType mask = set.Table.size() - 1;
+    SizeValueType slot = hash & mask;
+    for( ; set.Table[ slot ] != 0; slot = ( slot + 1 ) & mask )
+    {
+      const SizeValueType index = set.Table[ slot ] - 1;
+      if( set.Hashes[ index ] == hash
+        && std::equal( tuple, tuple + n, set.Tuples.begin() + index * n ) )
+      {
+        set.Counts[ index ] += count;
+        return index;
+      }
+    }
+
+    /** A new tuple */
+    set.Table[ slot ] = set.Counts.size() + 1;
+    set.Tuples.insert( set.Tuples.end(), tuple, tuple + n );
+    set.Counts.push_back( count );
+    set.Hashes.push_back( hash );
+    return set.Counts.size() - 1;
+  } // end AddTuple
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ClearTupleSet( TupleSetType & set )
+  {
+    std::vector<InputPixelType>().swap( set.Tuples );
+    std::vector<SizeValueType>().swap( set.Counts );
+    std::vector<unsigned long>().swap( set.Hashes );
+    std::vector<SizeValueType>().swap( set.Table );
+  } // end ClearTupleSet
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    unsigned long
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::HashTuple( const InputPixelType * tuple, unsigned int n )
+  {
+    /** FNV-1a on the labels */
+    unsigned long hash = 2166136261ul;
+    for( unsigned int k = 0; k < n; ++k )
+    {
+      hash = ( hash ^ static_cast<unsigned long>( tuple[k] ) ) * 16777619ul;
+    }
+    return hash;
+  } // end HashTuple
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ComputeWeights( const InputPixelType * tuple, Array<WeightsType> & W ) const
+  {
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+    for( unsigned int k = 0; k < numberOfInputs; ++k )
+    {
+      const InputPixelType j = tuple[k];
+      for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+      {
+        W[ci] *= this->m_ConfusionMatrixArray[k][j][ci];
+      }
+    }
+
+    /** normalize: */
+    WeightsType sumW = W.sum();
+    if( sumW )
+    {
+      W /= sumW;
+    }
+  } // end ComputeWeights
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    typename TOutputImage::PixelType
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ComputeWinningLabel( const Array<WeightsType> & W ) const
+  {
+    OutputPixelType winningLabel = this->m_LeastPreferredLabel;
+    WeightsType winningLabelW = 0.0;
+    for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+    {
+      if( W[ci] > winningLabelW )
+      {
+        winningLabelW = W[ci];
+        winningLabel = ci;
+      }
+      else
+      {
+        if( ! (W[ci] < winningLabelW ) )
         {
-          if( W[ci] > winningLabelW )
+          if( this->m_PriorPreference[ci] < this->m_PriorPreference[winningLabel] )
           {
-            winningLabelW = W[ci];
             winningLabel = ci;
           }
-          else
-          {
-            if( ! (W[ci] < winningLabelW ) )
-            {
-              if( this->m_PriorPreference[ci] < this->m_PriorPreference[winningLabel] )
-              {
-                winningLabel = ci;
-              }
-            }
-          }
-        } // next ci
+        }
+      }
+    } // next ci
 
-        /** Set the winning label to the output pixel */
-        out.Set( winningLabel );
-      } // end if insideMask
+    return winningLabel;
+  } // end ComputeWinningLabel
 
 
-      /** copy the W values into the probabilistic segmentation images
-       * and move the psit iterators */
-      if( generateProbSeg )
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ComputeMostProbableClasses( const Array<WeightsType> & W,
+      VariableLengthVector<OutputPixelType> & labels,
+      VariableLengthVector<WeightsType> & probabilities ) const
+  {
+    /** Insertion into a sorted list of the k largest W's. Among equal W's
+     * the lowest class comes first. */
+    const unsigned int k = labels.GetSize();
+    unsigned int numberOfSelected = 0;
+    for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+    {
+      const WeightsType w = W[ci];
+      if( numberOfSelected == k && !( w > probabilities[ k - 1 ] ) )
       {
+        continue;
+      }
+
+      unsigned int pos = numberOfSelected < k ? numberOfSelected++ : k - 1;
+      while( pos > 0 && w > probabilities[ pos - 1 ] )
+      {
+        probabilities[ pos ] = probabilities[ pos - 1 ];
+        labels[ pos ] = labels[ pos - 1 ];
+        --pos;
+      }
+      probabilities[ pos ] = w;
+      labels[ pos ] = ci;
+    } // next ci
+  } // end ComputeMostProbableClasses
+
+
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedUpdateConfusionMatricesFromTuples(
+      ThreadIdType threadId, ThreadIdType numberOfThreads )
+  {
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+    const SizeValueType numberOfTuples = this->m_TupleSet.Counts.size();
+    const SizeValueType firstTuple = numberOfTuples * threadId / numberOfThreads;
+    const SizeValueType endTuple = numberOfTuples * ( threadId + 1 ) / numberOfThreads;
+    ConfusionMatrixArrayType & updatedConfusionMatrixArray =
+      this->m_ConfusionMatrixArrays[ threadId ];
+    Array<WeightsType> W( this->m_NumberOfClasses );
+
+    for( SizeValueType t = firstTuple; t < endTuple; ++t )
+    {
+      /** the E step for all voxels with this tuple at once */
+      const InputPixelType * tuple = &this->m_TupleSet.Tuples[ t * numberOfInputs ];
+      W = this->m_PriorProbabilities;
+      this->ComputeWeights( tuple, W );
+
+      /** the M step, weighted with the multiplicity of the tuple */
+      W *= static_cast<WeightsType>( this->m_TupleSet.Counts[ t ] );
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+        const InputPixelType j = tuple[k];
         for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
         {
-          psit[ci].Set( W[ci] );
-          ++(psit[ci]);
+          updatedConfusionMatrixArray[k][j][ci] += W[ci];
         }
       }
+    }
+  } // end ThreadedUpdateConfusionMatricesFromTuples
 
-    } // end loop over output pixels
 
-  } // end GenerateData
+  template< typename TInputImage, typename TOutputImage, typename TWeights >
+    void
+    MultiLabelSTAPLE2ImageFilter< TInputImage, TOutputImage, TWeights >
+    ::ThreadedComputeTupleOutputs(
+      ThreadIdType threadId, ThreadIdType numberOfThreads )
+  {
+    const unsigned int numberOfInputs = this->GetNumberOfInputs();
+    const SizeValueType numberOfTuples = this->m_TupleSet.Counts.size();
+    const SizeValueType firstTuple = numberOfTuples * threadId / numberOfThreads;
+    const SizeValueType endTuple = numberOfTuples * ( threadId + 1 ) / numberOfThreads;
+    Array<WeightsType> W( this->m_NumberOfClasses );
+
+    for( SizeValueType t = firstTuple; t < endTuple; ++t )
+    {
+      W = this->m_PriorProbabilities;
+      this->ComputeWeights( &this->m_TupleSet.Tuples[ t * numberOfInputs ], W );
+      for ( OutputPixelType ci = 0; ci < this->m_NumberOfClasses; ++ci )
+      {
+        this->m_TupleWeights[ t * this->m_NumberOfClasses + ci ] = W[ci];
+      }
+      this->m_TupleLabels[ t ] = this->ComputeWinningLabel( W );
+    }
+  } // end ThreadedComputeTupleOutputs
 
 } // end namespace itk
 
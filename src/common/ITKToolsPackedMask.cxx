@@ -0,0 +1,68 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#include "ITKToolsPackedMask.h"
+
+#include <fstream>
+
+
+namespace itktools
+{
+
+/**
+ * ***************** GetPackedMaskMagic ************************
+ */
+
+std::string GetPackedMaskMagic( void )
+{
+  return "ITKToolsPackedMask1\n";
+} // end GetPackedMaskMagic()
+
+
+/**
+ * ***************** GetPackedMaskDimension ************************
+ */
+
+unsigned int GetPackedMaskDimension( const std::string & filename )
+{
+  std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
+  if( !in.is_open() ) return 0;
+
+  const std::string magic = GetPackedMaskMagic();
+  std::string header( magic.size(), '\0' );
+  in.read( &header[ 0 ], magic.size() );
+  if( !in.good() || header != magic ) return 0;
+
+  itk::uint32_t dimension = 0;
+  in.read( reinterpret_cast<char *>( &dimension ), sizeof( dimension ) );
+  if( !in.good() ) return 0;
+
+  return static_cast<unsigned int>( dimension );
+
+} // end GetPackedMaskDimension()
+
+
+/**
+ * ***************** IsPackedMaskFile ************************
+ */
+
+bool IsPackedMaskFile( const std::string & filename )
+{
+  return GetPackedMaskDimension( filename ) != 0;
+} // end IsPackedMaskFile()
+
+} // end namespace itktools
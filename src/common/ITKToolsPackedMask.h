@@ -0,0 +1,187 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __ITKToolsPackedMask_h_
+#define __ITKToolsPackedMask_h_
+
+#include "itkImage.h"
+#include "itkIntTypes.h"
+
+#include <string>
+#include <vector>
+
+
+namespace itktools
+{
+
+/** \class PackedMask
+ * \brief A binary mask that stores one bit per voxel.
+ *
+ * The voxels are packed in the linear buffer order of the corresponding
+ * itk::Image (x fastest) into 64-bit words. Logical operations on two
+ * masks can therefore be performed on 64 voxels at a time, and the number
+ * of voxels inside the mask is obtained with a population count.
+ * Any nonzero voxel value is considered to be inside the mask.
+ *
+ * The bits in the last word that lie beyond the number of voxels are
+ * always kept zero. Functions that may set them, should call ClearTail().
+ */
+
+template< unsigned int VDimension >
+class PackedMask
+{
+public:
+  /** Typedefs. */
+  typedef PackedMask                                Self;
+  typedef itk::uint64_t                             WordType;
+  typedef std::vector<WordType>                     WordContainerType;
+  typedef itk::ImageBase<VDimension>                ImageBaseType;
+  typedef typename ImageBaseType::SizeType          SizeType;
+  typedef typename ImageBaseType::SizeValueType     SizeValueType;
+  typedef typename ImageBaseType::SpacingType       SpacingType;
+  typedef typename ImageBaseType::PointType         PointType;
+  typedef typename ImageBaseType::DirectionType     DirectionType;
+  typedef typename ImageBaseType::RegionType        RegionType;
+
+  /** The number of voxels per word. */
+  static const unsigned int BitsPerWord = 64;
+
+  PackedMask();
+  ~PackedMask(){};
+
+  /** Copy the geometry of an image and allocate an empty mask. */
+  void CopyInformation( const ImageBaseType * image );
+
+  /** Copy the geometry of another mask and allocate an empty mask. */
+  void CopyInformation( const Self & other );
+
+  /** Set the size and allocate an empty mask. */
+  void SetSize( const SizeType & size );
+
+  /** Pack an image. Nonzero voxels are set. */
+  template< class TImage >
+  void Pack( const TImage * image );
+
+  /** Pack a part of a buffer, starting at the linear voxel offset.
+   * Used for streaming the mask in from disk.
+   */
+  template< class TPixel >
+  void PackBuffer( const TPixel * buffer,
+    const SizeValueType & offset, const SizeValueType & count );
+
+  /** Unpack to an image with values 0 and 1. The image is allocated. */
+  template< class TImage >
+  void Unpack( TImage * image ) const;
+
+  /** Get and set individual voxels by linear offset. */
+  bool GetBit( const SizeValueType & offset ) const
+  {
+    return ( this->m_Words[ offset / BitsPerWord ]
+      >> ( offset % BitsPerWord ) ) & 1;
+  }
+  void SetBit( const SizeValueType & offset )
+  {
+    this->m_Words[ offset / BitsPerWord ]
+      |= static_cast<WordType>( 1 ) << ( offset % BitsPerWord );
+  }
+
+  /** Zero the bits in the last word beyond the number of voxels. */
+  void ClearTail( void );
+
+  /** Count the number of voxels inside the mask. */
+  SizeValueType CountNonZero( void ) const;
+
+  /** Check if the mask has the same size as another mask. */
+  bool SameSize( const Self & other ) const;
+
+  /** Get the geometry. */
+  const SizeType & GetSize( void ) const { return this->m_Size; }
+  const SpacingType & GetSpacing( void ) const { return this->m_Spacing; }
+  const PointType & GetOrigin( void ) const { return this->m_Origin; }
+  const DirectionType & GetDirection( void ) const { return this->m_Direction; }
+  void SetSpacing( const SpacingType & spacing ) { this->m_Spacing = spacing; }
+  void SetOrigin( const PointType & origin ) { this->m_Origin = origin; }
+  void SetDirection( const DirectionType & direction ) { this->m_Direction = direction; }
+  SizeValueType GetNumberOfVoxels( void ) const { return this->m_NumberOfVoxels; }
+
+  /** Get the packed words. */
+  WordContainerType & GetWords( void ) { return this->m_Words; }
+  const WordContainerType & GetWords( void ) const { return this->m_Words; }
+
+private:
+  SizeType            m_Size;
+  SpacingType         m_Spacing;
+  PointType           m_Origin;
+  DirectionType       m_Direction;
+  SizeValueType       m_NumberOfVoxels;
+  WordContainerType   m_Words;
+
+}; // end class PackedMask
+
+
+/** Count the number of set bits in a word. */
+inline unsigned int PopCount( itk::uint64_t word )
+{
+#if defined( __GNUC__ )
+  return static_cast<unsigned int>( __builtin_popcountll( word ) );
+#else
+  word = word - ( ( word >> 1 ) & 0x5555555555555555ULL );
+  word = ( word & 0x3333333333333333ULL ) + ( ( word >> 2 ) & 0x3333333333333333ULL );
+  word = ( word + ( word >> 4 ) ) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<unsigned int>( ( word * 0x0101010101010101ULL ) >> 56 );
+#endif
+} // end PopCount()
+
+
+/** Return the magic string that starts every packed mask file. */
+std::string GetPackedMaskMagic( void );
+
+/** Check if a file is a packed mask file. */
+bool IsPackedMaskFile( const std::string & filename );
+
+/** Get the dimension of a packed mask file. Returns 0 if the file
+ * is not a packed mask file.
+ */
+unsigned int GetPackedMaskDimension( const std::string & filename );
+
+/** Read a packed mask. The file may either be a packed mask file,
+ * or any image that ITK can read. In the latter case the image is
+ * streamed in and packed, if the ImageIO supports streaming.
+ */
+template< unsigned int VDimension >
+void ReadPackedMask( const std::string & filename,
+  PackedMask<VDimension> & mask );
+
+/** Write a packed mask. If the extension of the file name is ".pmask"
+ * the packed representation is written, otherwise the mask is
+ * unpacked to an image of the given pixel type.
+ */
+template< class TPixel, unsigned int VDimension >
+void WritePackedMask( const std::string & filename,
+  const PackedMask<VDimension> & mask, const bool & useCompression = false );
+
+/** Read a mask image, which may be stored as a packed mask. This allows
+ * all tools that take a mask to also take packed masks.
+ */
+template< class TMaskImage >
+typename TMaskImage::Pointer ReadMaskImage( const std::string & filename );
+
+} // end namespace itktools
+
+#include "ITKToolsPackedMask.hxx"
+
+#endif // end #ifndef __ITKToolsPackedMask_h_
@@ -0,0 +1,478 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __ITKToolsPackedMask_hxx_
+#define __ITKToolsPackedMask_hxx_
+
+#include "ITKToolsPackedMask.h"
+
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "vnl/vnl_math.h"
+#include <itksys/SystemTools.hxx>
+
+#include <fstream>
+
+
+namespace itktools
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< unsigned int VDimension >
+PackedMask< VDimension >
+::PackedMask()
+{
+  this->m_Size.Fill( 0 );
+  this->m_Spacing.Fill( 1.0 );
+  this->m_Origin.Fill( 0.0 );
+  this->m_Direction.SetIdentity();
+  this->m_NumberOfVoxels = 0;
+} // end Constructor
+
+
+/**
+ * ******************* CopyInformation *******************
+ */
+
+template< unsigned int VDimension >
+void
+PackedMask< VDimension >
+::CopyInformation( const ImageBaseType * image )
+{
+  this->m_Spacing   = image->GetSpacing();
+  this->m_Origin    = image->GetOrigin();
+  this->m_Direction = image->GetDirection();
+  this->SetSize( image->GetLargestPossibleRegion().GetSize() );
+} // end CopyInformation()
+
+
+/**
+ * ******************* CopyInformation *******************
+ */
+
+template< unsigned int VDimension >
+void
+PackedMask< VDimension >
+::CopyInformation( const Self & other )
+{
+  this->m_Spacing   = other.m_Spacing;
+  this->m_Origin    = other.m_Origin;
+  this->m_Direction = other.m_Direction;
+  this->SetSize( other.m_Size );
+} // end CopyInformation()
+
+
+/**
+ * ******************* SetSize *******************
+ */
+
+template< unsigned int VDimension >
+void
+PackedMask< VDimension >
+::SetSize( const SizeType & size )
+{
+  this->m_Size = size;
+  this->m_NumberOfVoxels = 1;
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    this->m_NumberOfVoxels *= size[ i ];
+  }
+
+  const SizeValueType numberOfWords
+    = ( this->m_NumberOfVoxels + BitsPerWord - 1 ) / BitsPerWord;
+  this->m_Words.assign( numberOfWords, 0 );
+} // end SetSize()
+
+
+/**
+ * ******************* Pack *******************
+ */
+
+template< unsigned int VDimension >
+template< class TImage >
+void
+PackedMask< VDimension >
+::Pack( const TImage * image )
+{
+  this->CopyInformation( image );
+  this->PackBuffer( image->GetBufferPointer(), 0, this->m_NumberOfVoxels );
+} // end Pack()
+
+
+/**
+ * ******************* PackBuffer *******************
+ */
+
+template< unsigned int VDimension >
+template< class TPixel >
+void
+PackedMask< VDimension >
+::PackBuffer( const TPixel * buffer,
+  const SizeValueType & offset, const SizeValueType & count )
+{
+  const TPixel zero = itk::NumericTraits<TPixel>::Zero;
+  SizeValueType i = 0;
+  SizeValueType position = offset;
+  while( i < count )
+  {
+    /** Assemble complete words at once, if aligned. */
+    if( position % BitsPerWord == 0 && count - i >= BitsPerWord )
+    {
+      WordType word = 0;
+      for( unsigned int b = 0; b < BitsPerWord; ++b )
+      {
+        word |= static_cast<WordType>( buffer[ i + b ] != zero ) << b;
+      }
+      this->m_Words[ position / BitsPerWord ] = word;
+      i += BitsPerWord;
+      position += BitsPerWord;
+    }
+    else
+    {
+      if( buffer[ i ] != zero ) this->SetBit( position );
+      ++i;
+      ++position;
+    }
+  }
+} // end PackBuffer()
+
+
+/**
+ * ******************* Unpack *******************
+ */
+
+template< unsigned int VDimension >
+template< class TImage >
+void
+PackedMask< VDimension >
+::Unpack( TImage * image ) const
+{
+  typedef typename TImage::PixelType PixelType;
+
+  RegionType region;
+  region.SetSize( this->m_Size );
+  image->SetRegions( region );
+  image->SetSpacing( this->m_Spacing );
+  image->SetOrigin( this->m_Origin );
+  image->SetDirection( this->m_Direction );
+  image->Allocate();
+
+  PixelType * out = image->GetBufferPointer();
+  const SizeValueType numberOfWords = this->m_Words.size();
+  for( SizeValueType w = 0; w < numberOfWords; ++w )
+  {
+    const WordType word = this->m_Words[ w ];
+    const SizeValueType start = w * BitsPerWord;
+    const SizeValueType end = vnl_math_min(
+      start + BitsPerWord, this->m_NumberOfVoxels );
+    for( SizeValueType i = start; i < end; ++i )
+    {
+      out[ i ] = static_cast<PixelType>( ( word >> ( i - start ) ) & 1 );
+    }
+  }
+} // end Unpack()
+
+
+/**
+ * ******************* ClearTail *******************
+ */
+
+template< unsigned int VDimension >
+void
+PackedMask< VDimension >
+::ClearTail( void )
+{
+  const unsigned int remainder = this->m_NumberOfVoxels % BitsPerWord;
+  if( remainder != 0 && !this->m_Words.empty() )
+  {
+    this->m_Words.back() &= ( static_cast<WordType>( 1 ) << remainder ) - 1;
+  }
+} // end ClearTail()
+
+
+/**
+ * ******************* CountNonZero *******************
+ */
+
+template< unsigned int VDimension >
+typename PackedMask< VDimension >::SizeValueType
+PackedMask< VDimension >
+::CountNonZero( void ) const
+{
+  SizeValueType count = 0;
+  const SizeValueType numberOfWords = this->m_Words.size();
+  for( SizeValueType w = 0; w < numberOfWords; ++w )
+  {
+    count += PopCount( this->m_Words[ w ] );
+  }
+  return count;
+} // end CountNonZero()
+
+
+/**
+ * ******************* SameSize *******************
+ */
+
+template< unsigned int VDimension >
+bool
+PackedMask< VDimension >
+::SameSize( const Self & other ) const
+{
+  return this->m_Size == other.m_Size;
+} // end SameSize()
+
+
+/**
+ * ******************* ReadPackedMask *******************
+ */
+
+template< unsigned int VDimension >
+void ReadPackedMask( const std::string & filename,
+  PackedMask<VDimension> & mask )
+{
+  typedef PackedMask<VDimension>                    MaskType;
+  typedef typename MaskType::WordType               WordType;
+  typedef typename MaskType::SizeType               SizeType;
+  typedef typename MaskType::SpacingType            SpacingType;
+  typedef typename MaskType::PointType              PointType;
+  typedef typename MaskType::DirectionType          DirectionType;
+  typedef typename MaskType::RegionType             RegionType;
+  typedef typename MaskType::SizeValueType          SizeValueType;
+
+  /** Read a packed mask file. */
+  const unsigned int dimension = GetPackedMaskDimension( filename );
+  if( dimension != 0 )
+  {
+    if( dimension != VDimension )
+    {
+      itkGenericExceptionMacro( << "The packed mask " << filename
+        << " has dimension " << dimension << ", but " << VDimension
+        << " was expected." );
+    }
+
+    std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
+    in.seekg( GetPackedMaskMagic().size() + sizeof( itk::uint32_t ) );
+
+    SizeType size; SpacingType spacing; PointType origin; DirectionType direction;
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      itk::uint64_t s = 0;
+      in.read( reinterpret_cast<char *>( &s ), sizeof( s ) );
+      size[ i ] = static_cast<SizeValueType>( s );
+    }
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      in.read( reinterpret_cast<char *>( &spacing[ i ] ), sizeof( double ) );
+    }
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      in.read( reinterpret_cast<char *>( &origin[ i ] ), sizeof( double ) );
+    }
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      for( unsigned int j = 0; j < VDimension; ++j )
+      {
+        in.read( reinterpret_cast<char *>( &direction[ i ][ j ] ), sizeof( double ) );
+      }
+    }
+
+    mask.SetSize( size );
+    mask.SetSpacing( spacing );
+    mask.SetOrigin( origin );
+    mask.SetDirection( direction );
+    if( !mask.GetWords().empty() )
+    {
+      in.read( reinterpret_cast<char *>( &mask.GetWords()[ 0 ] ),
+        mask.GetWords().size() * sizeof( WordType ) );
+    }
+    if( !in.good() )
+    {
+      itkGenericExceptionMacro( << "Error while reading packed mask " << filename );
+    }
+    mask.ClearTail();
+    return;
+  }
+
+  /** Otherwise read a normal image. float is used to make sure no nonzero
+   * value is cast to zero.
+   */
+  typedef itk::Image<float, VDimension>             ImageType;
+  typedef itk::ImageFileReader<ImageType>           ReaderType;
+
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    filename.c_str(), itk::ImageIOFactory::ReadMode );
+  if( imageIO.IsNull() )
+  {
+    itkGenericExceptionMacro( << "Could not create an ImageIO for " << filename );
+  }
+  imageIO->SetFileName( filename.c_str() );
+  imageIO->ReadImageInformation();
+
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( filename.c_str() );
+  reader->SetImageIO( imageIO );
+  reader->UpdateOutputInformation();
+
+  ImageType * image = reader->GetOutput();
+  mask.CopyInformation( image );
+
+  /** If streaming is not supported, read at once. */
+  if( !imageIO->CanStreamRead() || VDimension == 1 )
+  {
+    reader->Update();
+    mask.PackBuffer( image->GetBufferPointer(), 0, mask.GetNumberOfVoxels() );
+    return;
+  }
+
+  /** Stream the image in, in slabs along the last dimension. */
+  const RegionType largestRegion = image->GetLargestPossibleRegion();
+  const SizeValueType numberOfSlices = largestRegion.GetSize( VDimension - 1 );
+  const SizeValueType sliceSize = mask.GetNumberOfVoxels()
+    / vnl_math_max( numberOfSlices, static_cast<SizeValueType>( 1 ) );
+  const SizeValueType slabVoxels = 16 * 1024 * 1024;
+  const SizeValueType slicesPerSlab = vnl_math_max(
+    static_cast<SizeValueType>( 1 ), slabVoxels / vnl_math_max( sliceSize,
+    static_cast<SizeValueType>( 1 ) ) );
+
+  for( SizeValueType start = 0; start < numberOfSlices; start += slicesPerSlab )
+  {
+    RegionType slab = largestRegion;
+    slab.SetIndex( VDimension - 1, largestRegion.GetIndex( VDimension - 1 ) + start );
+    slab.SetSize( VDimension - 1, vnl_math_min( slicesPerSlab, numberOfSlices - start ) );
+
+    image->SetRequestedRegion( slab );
+    image->Update();
+
+    const float * slabBuffer = image->GetBufferPointer()
+      + image->ComputeOffset( slab.GetIndex() );
+    mask.PackBuffer( slabBuffer, start * sliceSize, slab.GetNumberOfPixels() );
+  }
+
+} // end ReadPackedMask()
+
+
+/**
+ * ******************* WritePackedMask *******************
+ */
+
+template< class TPixel, unsigned int VDimension >
+void WritePackedMask( const std::string & filename,
+  const PackedMask<VDimension> & mask, const bool & useCompression )
+{
+  typedef PackedMask<VDimension>                    MaskType;
+  typedef typename MaskType::WordType               WordType;
+
+  /** Write an image of type TPixel. */
+  const std::string extension
+    = itksys::SystemTools::GetFilenameLastExtension( filename );
+  if( extension != ".pmask" )
+  {
+    typedef itk::Image<TPixel, VDimension>          ImageType;
+    typedef itk::ImageFileWriter<ImageType>         WriterType;
+
+    typename ImageType::Pointer image = ImageType::New();
+    mask.Unpack( image.GetPointer() );
+
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetFileName( filename.c_str() );
+    writer->SetInput( image );
+    writer->SetUseCompression( useCompression );
+    writer->Update();
+    return;
+  }
+
+  /** Write the packed mask. The data is stored in host byte order. */
+  std::ofstream out( filename.c_str(), std::ios::out | std::ios::binary );
+  if( !out.is_open() )
+  {
+    itkGenericExceptionMacro( << "Could not open " << filename << " for writing." );
+  }
+
+  const std::string magic = GetPackedMaskMagic();
+  out.write( magic.c_str(), magic.size() );
+  const itk::uint32_t dimension = VDimension;
+  out.write( reinterpret_cast<const char *>( &dimension ), sizeof( dimension ) );
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    const itk::uint64_t s = mask.GetSize()[ i ];
+    out.write( reinterpret_cast<const char *>( &s ), sizeof( s ) );
+  }
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    out.write( reinterpret_cast<const char *>( &mask.GetSpacing()[ i ] ), sizeof( double ) );
+  }
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    out.write( reinterpret_cast<const char *>( &mask.GetOrigin()[ i ] ), sizeof( double ) );
+  }
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    for( unsigned int j = 0; j < VDimension; ++j )
+    {
+      const double d = mask.GetDirection()[ i ][ j ];
+      out.write( reinterpret_cast<const char *>( &d ), sizeof( double ) );
+    }
+  }
+  if( !mask.GetWords().empty() )
+  {
+    out.write( reinterpret_cast<const char *>( &mask.GetWords()[ 0 ] ),
+      mask.GetWords().size() * sizeof( WordType ) );
+  }
+  if( !out.good() )
+  {
+    itkGenericExceptionMacro( << "Error while writing packed mask " << filename );
+  }
+
+} // end WritePackedMask()
+
+
+/**
+ * ******************* ReadMaskImage *******************
+ */
+
+template< class TMaskImage >
+typename TMaskImage::Pointer ReadMaskImage( const std::string & filename )
+{
+  typename TMaskImage::Pointer maskImage;
+  if( IsPackedMaskFile( filename ) )
+  {
+    PackedMask<TMaskImage::ImageDimension> mask;
+    ReadPackedMask( filename, mask );
+    maskImage = TMaskImage::New();
+    mask.Unpack( maskImage.GetPointer() );
+  }
+  else
+  {
+    typedef itk::ImageFileReader<TMaskImage> ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( filename.c_str() );
+    reader->Update();
+    maskImage = reader->GetOutput();
+    maskImage->DisconnectPipeline();
+  }
+
+  return maskImage;
+
+} // end ReadMaskImage()
+
+} // end namespace itktools
+
+#endif // end #ifndef __ITKToolsPackedMask_hxx_
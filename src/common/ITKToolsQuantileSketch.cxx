@@ -0,0 +1,231 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#include "ITKToolsQuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+
+namespace itktools
+{
+
+/**
+ * ***************** Constructor ************************
+ */
+
+QuantileSketch::QuantileSketch( unsigned int k )
+{
+  this->m_K = std::max( k, 8u );
+  this->m_Levels.resize( 1 );
+  this->m_NumberOfRetainedValues = 0;
+  this->m_Count = 0;
+  this->m_Minimum = std::numeric_limits<double>::max();
+  this->m_Maximum = -std::numeric_limits<double>::max();
+  this->m_RandomState = 0x9e3779b9u;
+  this->UpdateMaximumNumberOfRetainedValues();
+
+} // end Constructor
+
+
+/**
+ * ***************** GetCapacity ************************
+ */
+
+std::size_t
+QuantileSketch::GetCapacity( std::size_t level ) const
+{
+  const std::size_t depth = this->m_Levels.size() - 1 - level;
+  const double capacity = std::ceil(
+    this->m_K * std::pow( 2.0 / 3.0, static_cast<double>( depth ) ) );
+  return std::max( static_cast<std::size_t>( capacity ), static_cast<std::size_t>( 2 ) );
+
+} // end GetCapacity()
+
+
+/**
+ * ***************** UpdateMaximumNumberOfRetainedValues ************************
+ */
+
+void
+QuantileSketch::UpdateMaximumNumberOfRetainedValues( void )
+{
+  this->m_MaximumNumberOfRetainedValues = 0;
+  for( std::size_t h = 0; h < this->m_Levels.size(); ++h )
+  {
+    this->m_MaximumNumberOfRetainedValues += this->GetCapacity( h );
+  }
+
+} // end UpdateMaximumNumberOfRetainedValues()
+
+
+/**
+ * ***************** Compress ************************
+ */
+
+void
+QuantileSketch::Compress( void )
+{
+  while( this->m_NumberOfRetainedValues >= this->m_MaximumNumberOfRetainedValues )
+  {
+    /** Find the lowest level that is full. */
+    std::size_t h = 0;
+    while( this->m_Levels[ h ].size() < this->GetCapacity( h ) ) ++h;
+
+    if( h + 1 == this->m_Levels.size() )
+    {
+      this->m_Levels.resize( h + 2 );
+      this->UpdateMaximumNumberOfRetainedValues();
+    }
+
+    /** Sort; with an odd number of values, the largest one stays. */
+    std::vector<double> & level = this->m_Levels[ h ];
+    std::vector<double> & nextLevel = this->m_Levels[ h + 1 ];
+    std::sort( level.begin(), level.end() );
+    const std::size_t numberOfPairs = level.size() / 2;
+
+    /** Promote either the even or the odd values, at random. */
+    this->m_RandomState = this->m_RandomState * 1664525u + 1013904223u;
+    const std::size_t offset = ( this->m_RandomState >> 31 ) & 1u;
+    for( std::size_t i = 0; i < numberOfPairs; ++i )
+    {
+      nextLevel.push_back( level[ 2 * i + offset ] );
+    }
+
+    const bool odd = ( level.size() % 2 ) == 1;
+    if( odd ) level[ 0 ] = level.back();
+    level.resize( odd ? 1 : 0 );
+    this->m_NumberOfRetainedValues -= numberOfPairs;
+  }
+
+} // end Compress()
+
+
+/**
+ * ***************** Merge ************************
+ */
+
+void
+QuantileSketch::Merge( const Self & other )
+{
+  if( other.m_Count == 0 ) return;
+
+  if( other.m_Levels.size() > this->m_Levels.size() )
+  {
+    this->m_Levels.resize( other.m_Levels.size() );
+    this->UpdateMaximumNumberOfRetainedValues();
+  }
+
+  for( std::size_t h = 0; h < other.m_Levels.size(); ++h )
+  {
+    this->m_Levels[ h ].insert( this->m_Levels[ h ].end(),
+      other.m_Levels[ h ].begin(), other.m_Levels[ h ].end() );
+    this->m_NumberOfRetainedValues += other.m_Levels[ h ].size();
+  }
+
+  this->m_Count += other.m_Count;
+  this->m_Minimum = std::min( this->m_Minimum, other.m_Minimum );
+  this->m_Maximum = std::max( this->m_Maximum, other.m_Maximum );
+
+  this->Compress();
+
+} // end Merge()
+
+
+/**
+ * ***************** GetQuantiles ************************
+ */
+
+std::vector<double>
+QuantileSketch::GetQuantiles( const std::vector<double> & q ) const
+{
+  std::vector<double> quantiles( q.size(), 0.0 );
+  if( this->m_Count == 0 ) return quantiles;
+
+  /** Collect the retained values with their weights, sorted by value. */
+  std::vector< std::pair<double, CountType> > weighted;
+  weighted.reserve( this->m_NumberOfRetainedValues );
+  for( std::size_t h = 0; h < this->m_Levels.size(); ++h )
+  {
+    const CountType weight = static_cast<CountType>( 1 ) << h;
+    for( std::size_t i = 0; i < this->m_Levels[ h ].size(); ++i )
+    {
+      weighted.push_back( std::make_pair( this->m_Levels[ h ][ i ], weight ) );
+    }
+  }
+  std::sort( weighted.begin(), weighted.end() );
+
+  CountType totalWeight = 0;
+  for( std::size_t i = 0; i < weighted.size(); ++i )
+  {
+    totalWeight += weighted[ i ].second;
+  }
+
+  for( std::size_t j = 0; j < q.size(); ++j )
+  {
+    if( q[ j ] <= 0.0 ) { quantiles[ j ] = this->m_Minimum; continue; }
+    if( q[ j ] >= 1.0 ) { quantiles[ j ] = this->m_Maximum; continue; }
+
+    /** The first value whose cumulative weight reaches the rank. */
+    const double rank = q[ j ] * static_cast<double>( totalWeight );
+    CountType cumulative = 0;
+    quantiles[ j ] = this->m_Maximum;
+    for( std::size_t i = 0; i < weighted.size(); ++i )
+    {
+      cumulative += weighted[ i ].second;
+      if( static_cast<double>( cumulative ) >= rank )
+      {
+        quantiles[ j ] = weighted[ i ].first;
+        break;
+      }
+    }
+  }
+
+  return quantiles;
+
+} // end GetQuantiles()
+
+
+/**
+ * ***************** GetQuantile ************************
+ */
+
+double
+QuantileSketch::GetQuantile( const double & q ) const
+{
+  return this->GetQuantiles( std::vector<double>( 1, q ) )[ 0 ];
+
+} // end GetQuantile()
+
+
+/**
+ * ***************** GetNormalizedRankError ************************
+ *
+ * Empirical fit of the rank error of the KLL sketch, as published
+ * with the Apache DataSketches implementation.
+ */
+
+double
+QuantileSketch::GetNormalizedRankError( unsigned int k )
+{
+  return 2.296 / std::pow( static_cast<double>( std::max( k, 8u ) ), 0.9723 );
+
+} // end GetNormalizedRankError()
+
+} // end namespace itktools
@@ -0,0 +1,123 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __ITKToolsQuantileSketch_h_
+#define __ITKToolsQuantileSketch_h_
+
+#include "itkIntTypes.h"
+
+#include <vector>
+
+
+namespace itktools
+{
+
+/** \class QuantileSketch
+ * \brief A mergeable sketch to estimate quantiles of a stream of values.
+ *
+ * This is a KLL sketch (Karnin, Lang and Liberty, "Optimal quantile
+ * approximation in streams", 2016). Values are stored in a hierarchy of
+ * compactors; a full compactor is sorted, and every other value is promoted
+ * to the next level with twice the weight. The capacity of level h, counted
+ * from the top, is K (2/3)^h, so the memory is O(K) values, independent
+ * of the number of values inserted.
+ *
+ * Sketches that are filled separately, for example by different threads,
+ * can be merged, after which they behave as a sketch of all values.
+ *
+ * The error is expressed as a normalized rank error: an estimated
+ * q-quantile has a true rank within ( q +/- epsilon ) n. With 99%
+ * confidence, epsilon is about 2.3 / K^0.97, see GetNormalizedRankError();
+ * for the default K = 200 this is 1.3%. The minimum and the maximum
+ * are exact.
+ */
+
+class QuantileSketch
+{
+public:
+  /** Typedefs. */
+  typedef QuantileSketch                  Self;
+  typedef itk::uint64_t                   CountType;
+
+  /** Constructor, K determines the accuracy. */
+  QuantileSketch( unsigned int k = 200 );
+  ~QuantileSketch(){};
+
+  /** Insert a value. */
+  void Insert( const double & value )
+  {
+    if( value < this->m_Minimum ) this->m_Minimum = value;
+    if( value > this->m_Maximum ) this->m_Maximum = value;
+    ++this->m_Count;
+    this->m_Levels[ 0 ].push_back( value );
+    if( ++this->m_NumberOfRetainedValues >= this->m_MaximumNumberOfRetainedValues )
+    {
+      this->Compress();
+    }
+  }
+
+  /** Merge another sketch into this one. */
+  void Merge( const Self & other );
+
+  /** Estimate the q-quantile, 0 <= q <= 1. */
+  double GetQuantile( const double & q ) const;
+
+  /** Estimate several quantiles at once. */
+  std::vector<double> GetQuantiles( const std::vector<double> & q ) const;
+
+  /** Get the number of inserted values. */
+  CountType GetCount( void ) const { return this->m_Count; }
+
+  /** Get the exact minimum and maximum of the inserted values. */
+  double GetMinimum( void ) const { return this->m_Minimum; }
+  double GetMaximum( void ) const { return this->m_Maximum; }
+
+  /** Get K. */
+  unsigned int GetK( void ) const { return this->m_K; }
+
+  /** The normalized rank error of a single quantile, at 99% confidence. */
+  static double GetNormalizedRankError( unsigned int k );
+
+protected:
+
+  /** Compact the lowest level that is full. */
+  void Compress( void );
+
+  /** The capacity of a level. */
+  std::size_t GetCapacity( std::size_t level ) const;
+
+  /** Recompute the maximum number of retained values after the number
+   * of levels has changed.
+   */
+  void UpdateMaximumNumberOfRetainedValues( void );
+
+private:
+
+  unsigned int                        m_K;
+  std::vector< std::vector<double> >  m_Levels;
+  std::size_t                         m_NumberOfRetainedValues;
+  std::size_t                         m_MaximumNumberOfRetainedValues;
+  CountType                           m_Count;
+  double                              m_Minimum;
+  double                              m_Maximum;
+  itk::uint32_t                       m_RandomState;
+
+}; // end class QuantileSketch
+
+} // end namespace itktools
+
+#endif // end #ifndef __ITKToolsQuantileSketch_h_
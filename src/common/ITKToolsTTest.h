@@ -0,0 +1,53 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __ITKToolsTTest_h_
+#define __ITKToolsTTest_h_
+
+#include "vnl/vnl_math.h"
+
+
+namespace itktools
+{
+
+/** Compute the t-value of the two-sample equal variance t-test from the
+ * number of samples, the sum and the sum of squares of each group:
+ *   SS_k = sumOfSquares_k - sum_k^2 / n_k,
+ *   s^2 = ( SS_1 + SS_2 ) / ( n_1 + n_2 - 2 ),
+ *   t = ( mean_1 - mean_2 ) / sqrt( s^2 ( 1 / n_1 + 1 / n_2 ) ).
+ * The degrees of freedom are n_1 + n_2 - 2. Returns 0 when the pooled
+ * variance is not positive. This is inlined, since pxvoxelttest calls it
+ * for every voxel and permutation.
+ */
+
+inline double ComputeTwoSampleTValue(
+  const double n1, const double sum1, const double sumOfSquares1,
+  const double n2, const double sum2, const double sumOfSquares2 )
+{
+  const double ss = ( sumOfSquares1 - sum1 * sum1 / n1 )
+    + ( sumOfSquares2 - sum2 * sum2 / n2 );
+  const double variance = ss / ( n1 + n2 - 2.0 );
+  if( !( variance > 0.0 ) ) return 0.0;
+
+  return ( sum1 / n1 - sum2 / n2 )
+    / vcl_sqrt( variance * ( 1.0 / n1 + 1.0 / n2 ) );
+
+} // end ComputeTwoSampleTValue()
+
+} // end namespace itktools
+
+#endif // end #ifndef __ITKToolsTTest_h_
@@ -53,7 +53,13 @@ std::string GetHelpString( void )
     << "-r1    \tInteger radius of window, dimension 1\n"
     << "[-r2]  \tInteger radius of window, dimension 2\n"
     << "[-LUT] \tUse Lookup-table <true, false>;\n"
-    << "default = true; Faster, but requires more memory.";
+    << "default = true; Faster, but requires more memory.\n"
+    << "[-tiled]\tUse contrast limited adaptive histogram equalization on\n"
+    << "       \ta grid of tiles of size 2 * radius + 1. Much faster for large\n"
+    << "       \tradii; the cost does not depend on the radius.\n"
+    << "       \talpha sets the clip limit to 1 / alpha (alpha = 0: no clipping),\n"
+    << "       \tbeta is the weight of the input image in the output.\n"
+    << "[-bins]\tNumber of histogram bins for -tiled, default 256.";
 
   return ss.str();
 
@@ -105,6 +111,11 @@ int main( int argc, char** argv )
   std::vector<unsigned int> radius;
   parser->GetCommandLineArgument( "-r", radius );
 
+  const bool useTiles = parser->ArgumentExists( "-tiled" );
+
+  unsigned int numberOfBins = 256;
+  parser->GetCommandLineArgument( "-bins", numberOfBins );
+
   /** Determine image properties. */
   itk::ImageIOBase::IOPixelType pixelType = itk::ImageIOBase::UNKNOWNPIXELTYPE;
   itk::ImageIOBase::IOComponentType componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
@@ -140,6 +151,8 @@ int main( int argc, char** argv )
     filter->m_Beta = beta;
     filter->m_LookUpTable = lookUpTable;
     filter->m_Radius = radius;
+    filter->m_UseTiles = useTiles;
+    filter->m_NumberOfBins = numberOfBins;
 
     filter->Run();
 
@@ -28,6 +28,7 @@
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkAdaptiveHistogramEqualizationImageFilter.h"
+#include "itkTiledAdaptiveHistogramEqualizationImageFilter.h"
 
 
 /** \class ITKToolsContrastEnhanceImageBase
@@ -47,6 +48,8 @@ public:
     this->m_InputFileName = "";
     this->m_OutputFileName = "";
     this->m_LookUpTable = false;
+    this->m_UseTiles = false;
+    this->m_NumberOfBins = 256;
   };
   /** Destructor. */
   ~ITKToolsContrastEnhanceImageBase(){};
@@ -58,6 +61,8 @@ public:
   float m_Beta;
   bool m_LookUpTable;
   std::vector<unsigned int> m_Radius;
+  bool m_UseTiles;
+  unsigned int m_NumberOfBins;
 
 }; // end class ITKToolsContrastEnhanceImageBase
 
@@ -79,15 +84,16 @@ public:
   ITKToolsContrastEnhanceImage(){};
   ~ITKToolsContrastEnhanceImage(){};
 
+  /** Typedefs. */
+  typedef itk::Image< TComponentType, VDimension >  ImageType;
+  typedef itk::ImageToImageFilter<
+    ImageType, ImageType >                          EnhancerBaseType;
+
   /** Run function. */
   void Run( void )
   {
-    typedef itk::Image< TComponentType, VDimension > ImageType;
     typedef itk::ImageFileReader<ImageType>       ReaderType;
-    typedef itk::AdaptiveHistogramEqualizationImageFilter<
-      ImageType >                                 EnhancerType;
     typedef itk::ImageFileWriter<ImageType>       WriterType;
-    typedef typename EnhancerType::ImageSizeType  RadiusType;
 
     /** vars */
     itk::Size<VDimension> radiusSize;
@@ -102,11 +108,22 @@ public:
     reader->Update();
 
     /** Setup pipeline and configure its components */
-    typename EnhancerType::Pointer enhancer = EnhancerType::New();
-    enhancer->SetUseLookupTable( this->m_LookUpTable );
-    enhancer->SetAlpha( this->m_Alpha );
-    enhancer->SetBeta( this->m_Beta );
-    enhancer->SetRadius( radiusSize );
+    typename EnhancerBaseType::Pointer enhancer;
+    if( this->m_UseTiles )
+    {
+      enhancer = this->CreateTiledEnhancer( radiusSize );
+    }
+    else
+    {
+      typedef itk::AdaptiveHistogramEqualizationImageFilter<
+        ImageType >                                 EnhancerType;
+      typename EnhancerType::Pointer adaptiveEnhancer = EnhancerType::New();
+      adaptiveEnhancer->SetUseLookupTable( this->m_LookUpTable );
+      adaptiveEnhancer->SetAlpha( this->m_Alpha );
+      adaptiveEnhancer->SetBeta( this->m_Beta );
+      adaptiveEnhancer->SetRadius( radiusSize );
+      enhancer = adaptiveEnhancer;
+    }
     enhancer->SetInput( reader->GetOutput() );
 
     typename WriterType::Pointer writer = WriterType::New();
@@ -116,6 +133,27 @@ public:
 
   } // end Run()
 
+  /** Create the tiled contrast limited enhancer. The radius gives the
+   * tile size 2 * radius + 1, alpha the clip limit 1 / alpha, with
+   * alpha = 0 meaning no clipping, and beta the weight of the input.
+   * As for the AdaptiveHistogramEqualizationImageFilter, alpha = beta = 0
+   * is plain (local) histogram equalization and alpha = beta = 1 leaves
+   * the image unchanged.
+   */
+  typename EnhancerBaseType::Pointer CreateTiledEnhancer(
+    const itk::Size<VDimension> & radiusSize )
+  {
+    typedef itk::TiledAdaptiveHistogramEqualizationImageFilter<
+      ImageType >                                   EnhancerType;
+    typename EnhancerType::Pointer tiledEnhancer = EnhancerType::New();
+    tiledEnhancer->SetRadius( radiusSize );
+    tiledEnhancer->SetClipLimit( this->m_Alpha > 0.0f ? 1.0 / this->m_Alpha : 0.0 );
+    tiledEnhancer->SetBlend( this->m_Beta );
+    tiledEnhancer->SetNumberOfBins( this->m_NumberOfBins );
+    return tiledEnhancer.GetPointer();
+
+  } // end CreateTiledEnhancer()
+
 }; // end class ITKToolsContrastEnhanceImage
 
 
@@ -0,0 +1,164 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkTiledAdaptiveHistogramEqualizationImageFilter_h_
+#define __itkTiledAdaptiveHistogramEqualizationImageFilter_h_
+
+#include "itkImageToImageFilter.h"
+#include "vnl/vnl_math.h"
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class TiledAdaptiveHistogramEqualizationImageFilter
+ * \brief Contrast limited adaptive histogram equalization on a grid of tiles.
+ *
+ * The image is divided into a grid of tiles of size 2 * radius + 1. For
+ * every tile a histogram is computed, clipped at ClipLimit times the mean
+ * bin count, with the clipped counts redistributed over all bins, and
+ * converted to a mapping from intensity to equalized intensity. A pixel is
+ * mapped by (bi/tri)linear interpolation between the mappings of the
+ * neighbouring tile centers. The result is blended with the input:
+ *   output = Blend * input + ( 1 - Blend ) * equalized.
+ *
+ * In contrast to the AdaptiveHistogramEqualizationImageFilter, which
+ * computes a histogram of the neighbourhood of every pixel, the cost is
+ * linear in the number of pixels and does not depend on the radius.
+ * The tile mappings are computed in parallel over the tiles.
+ *
+ * A ClipLimit of 1 gives a nearly linear mapping, larger values give more
+ * contrast, and a ClipLimit of 0 switches clipping off.
+ *
+ * \ingroup IntensityImageFilters
+ */
+template <class TImage>
+class TiledAdaptiveHistogramEqualizationImageFilter :
+  public ImageToImageFilter<TImage,TImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef TiledAdaptiveHistogramEqualizationImageFilter Self;
+  typedef ImageToImageFilter<TImage,TImage>             Superclass;
+  typedef SmartPointer<Self>                            Pointer;
+  typedef SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( TiledAdaptiveHistogramEqualizationImageFilter, ImageToImageFilter );
+
+  /** Image related typedefs. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TImage::ImageDimension );
+
+  /** Typedef to describe the input/output image types. */
+  typedef TImage                                  ImageType;
+  typedef typename ImageType::PixelType           PixelType;
+  typedef typename ImageType::RegionType          RegionType;
+  typedef typename ImageType::IndexType           IndexType;
+  typedef typename ImageType::SizeType            SizeType;
+  typedef RegionType                              OutputImageRegionType;
+
+  /** Set/Get the radius of the tiles. */
+  itkSetMacro( Radius, SizeType );
+  itkGetConstReferenceMacro( Radius, SizeType );
+
+  /** Set/Get the maximum slope of the tile mappings, relative to a linear
+   * mapping. Default 4. Use 0 for no clipping.
+   */
+  itkSetMacro( ClipLimit, double );
+  itkGetConstMacro( ClipLimit, double );
+
+  /** Set/Get the weight of the input in the output. Default 0. */
+  itkSetClampMacro( Blend, double, 0.0, 1.0 );
+  itkGetConstMacro( Blend, double );
+
+  /** Set/Get the number of histogram bins. Default 256. */
+  itkSetMacro( NumberOfBins, unsigned int );
+  itkGetConstMacro( NumberOfBins, unsigned int );
+
+protected:
+  TiledAdaptiveHistogramEqualizationImageFilter();
+  ~TiledAdaptiveHistogramEqualizationImageFilter(){};
+  void PrintSelf( std::ostream& os, Indent indent ) const;
+
+  /** The tiles need the whole input. */
+  virtual void GenerateInputRequestedRegion( void );
+
+  /** Compute the mappings of all tiles, in parallel over the tiles. */
+  virtual void BeforeThreadedGenerateData( void );
+
+  /** Map the pixels by interpolating the tile mappings. */
+  virtual void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId );
+
+  /** Compute the clipped mapping of a single tile. */
+  void ComputeTileMapping( SizeValueType tile );
+
+private:
+  TiledAdaptiveHistogramEqualizationImageFilter(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  /** Thread callback that computes the mappings of every
+   * NumberOfThreads-th tile.
+   */
+  static ITK_THREAD_RETURN_TYPE TileThreaderCallback( void * arg );
+
+  /** Returns the histogram bin of a value. */
+  unsigned int GetBin( double value ) const
+  {
+    const double bin = ( value - this->m_Minimum ) * this->m_BinScale + 0.5;
+    return bin <= 0.0 ? 0u : vnl_math_min(
+      static_cast<unsigned int>( bin ), this->m_NumberOfBins - 1 );
+  }
+
+  SizeType      m_Radius;
+  double        m_ClipLimit;
+  double        m_Blend;
+  unsigned int  m_NumberOfBins;
+
+  /** Computed in BeforeThreadedGenerateData. */
+  double        m_Minimum;
+  double        m_Maximum;
+  double        m_BinScale;
+  SizeType      m_TileSize;
+  SizeType      m_NumberOfTiles;
+  SizeValueType m_TotalNumberOfTiles;
+
+  /** The mappings of the tiles, m_NumberOfBins values per tile. */
+  std::vector<float> m_TileMappings;
+
+  /** Per axis and per coordinate the two neighbouring tiles and the
+   * interpolation weight of the second one.
+   */
+  std::vector<SizeValueType> m_LowerTile[ ImageDimension ];
+  std::vector<SizeValueType> m_UpperTile[ ImageDimension ];
+  std::vector<float>         m_UpperWeight[ ImageDimension ];
+
+}; // end class TiledAdaptiveHistogramEqualizationImageFilter
+
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTiledAdaptiveHistogramEqualizationImageFilter.hxx"
+#endif
+
+#endif // end #ifndef __itkTiledAdaptiveHistogramEqualizationImageFilter_h_
@@ -0,0 +1,321 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkTiledAdaptiveHistogramEqualizationImageFilter_hxx_
+#define __itkTiledAdaptiveHistogramEqualizationImageFilter_hxx_
+
+#include "itkTiledAdaptiveHistogramEqualizationImageFilter.h"
+
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIterator.h"
+#include "itkMinimumMaximumImageCalculator.h"
+#include "itkMultiThreader.h"
+#include "itkProgressReporter.h"
+
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template <class TImage>
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::TiledAdaptiveHistogramEqualizationImageFilter()
+{
+  this->m_Radius.Fill( 8 );
+  this->m_ClipLimit = 4.0;
+  this->m_Blend = 0.0;
+  this->m_NumberOfBins = 256;
+
+  this->m_Minimum = 0.0;
+  this->m_Maximum = 0.0;
+  this->m_BinScale = 0.0;
+  this->m_TileSize.Fill( 1 );
+  this->m_NumberOfTiles.Fill( 1 );
+  this->m_TotalNumberOfTiles = 1;
+
+} // end Constructor
+
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template <class TImage>
+void
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::GenerateInputRequestedRegion( void )
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  ImageType * input = const_cast<ImageType *>( this->GetInput() );
+  if( input )
+  {
+    input->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template <class TImage>
+void
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::BeforeThreadedGenerateData( void )
+{
+  const ImageType * input = this->GetInput();
+  const RegionType region = input->GetLargestPossibleRegion();
+
+  /** The intensity range of the histograms. */
+  typedef MinimumMaximumImageCalculator<ImageType> CalculatorType;
+  typename CalculatorType::Pointer calculator = CalculatorType::New();
+  calculator->SetImage( input );
+  calculator->Compute();
+  this->m_Minimum = static_cast<double>( calculator->GetMinimum() );
+  this->m_Maximum = static_cast<double>( calculator->GetMaximum() );
+  this->m_NumberOfBins = vnl_math_max( this->m_NumberOfBins, 2u );
+  this->m_BinScale = this->m_Maximum > this->m_Minimum
+    ? ( this->m_NumberOfBins - 1 ) / ( this->m_Maximum - this->m_Minimum ) : 0.0;
+
+  /** Setup the grid of tiles. */
+  this->m_TotalNumberOfTiles = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    this->m_TileSize[ d ] = 2 * this->m_Radius[ d ] + 1;
+    this->m_NumberOfTiles[ d ] = ( region.GetSize()[ d ] + this->m_TileSize[ d ] - 1 )
+      / this->m_TileSize[ d ];
+    this->m_TotalNumberOfTiles *= this->m_NumberOfTiles[ d ];
+  }
+
+  /** Per coordinate the neighbouring tile centers, of which the lower one
+   * is the nearest center at or below the coordinate.
+   */
+  SizeValueType stride = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    const SizeValueType size = region.GetSize()[ d ];
+    const SizeValueType lastTile = this->m_NumberOfTiles[ d ] - 1;
+    this->m_LowerTile[ d ].resize( size );
+    this->m_UpperTile[ d ].resize( size );
+    this->m_UpperWeight[ d ].resize( size );
+    for( SizeValueType x = 0; x < size; ++x )
+    {
+      double g = ( x + 0.5 ) / this->m_TileSize[ d ] - 0.5;
+      g = vnl_math_max( 0.0, vnl_math_min( g, static_cast<double>( lastTile ) ) );
+      const SizeValueType lower = static_cast<SizeValueType>( g );
+      const SizeValueType upper = vnl_math_min( lower + 1, lastTile );
+      this->m_LowerTile[ d ][ x ] = lower * stride;
+      this->m_UpperTile[ d ][ x ] = upper * stride;
+      this->m_UpperWeight[ d ][ x ] = static_cast<float>( g - lower );
+    }
+    stride *= this->m_NumberOfTiles[ d ];
+  }
+
+  /** Compute the mappings of all tiles. */
+  this->m_TileMappings.resize( this->m_TotalNumberOfTiles * this->m_NumberOfBins );
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod( TileThreaderCallback, this );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ******************* TileThreaderCallback *******************
+ */
+
+template <class TImage>
+ITK_THREAD_RETURN_TYPE
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::TileThreaderCallback( void * arg )
+{
+  typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  Self * filter = static_cast<Self *>( info->UserData );
+
+  for( SizeValueType tile = info->ThreadID; tile < filter->m_TotalNumberOfTiles;
+    tile += info->NumberOfThreads )
+  {
+    filter->ComputeTileMapping( tile );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end TileThreaderCallback()
+
+
+/**
+ * ******************* ComputeTileMapping *******************
+ */
+
+template <class TImage>
+void
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::ComputeTileMapping( SizeValueType tile )
+{
+  const ImageType * input = this->GetInput();
+  const RegionType largestRegion = input->GetLargestPossibleRegion();
+  const unsigned int numberOfBins = this->m_NumberOfBins;
+
+  /** The region of the tile. */
+  RegionType region;
+  SizeValueType remainder = tile;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    const SizeValueType t = remainder % this->m_NumberOfTiles[ d ];
+    remainder /= this->m_NumberOfTiles[ d ];
+    const SizeValueType begin = t * this->m_TileSize[ d ];
+    region.SetIndex( d, largestRegion.GetIndex()[ d ] + begin );
+    region.SetSize( d, vnl_math_min( this->m_TileSize[ d ],
+      largestRegion.GetSize()[ d ] - begin ) );
+  }
+
+  /** The histogram of the tile. */
+  std::vector<double> histogram( numberOfBins, 0.0 );
+  ImageRegionConstIterator<ImageType> it( input, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    histogram[ this->GetBin( static_cast<double>( it.Get() ) ) ] += 1.0;
+  }
+  const double count = static_cast<double>( region.GetNumberOfPixels() );
+
+  /** Clip the histogram and redistribute the excess over all bins. */
+  if( this->m_ClipLimit > 0.0 )
+  {
+    const double limit = vnl_math_max( 1.0, this->m_ClipLimit * count / numberOfBins );
+    double excess = 0.0;
+    for( unsigned int b = 0; b < numberOfBins; ++b )
+    {
+      if( histogram[ b ] > limit )
+      {
+        excess += histogram[ b ] - limit;
+        histogram[ b ] = limit;
+      }
+    }
+    const double increment = excess / numberOfBins;
+    for( unsigned int b = 0; b < numberOfBins; ++b )
+    {
+      histogram[ b ] += increment;
+    }
+  }
+
+  /** The mapping is the normalized cumulative histogram. */
+  float * mapping = &this->m_TileMappings[ tile * numberOfBins ];
+  const double scale = ( this->m_Maximum - this->m_Minimum ) / count;
+  double cumulative = 0.0;
+  for( unsigned int b = 0; b < numberOfBins; ++b )
+  {
+    cumulative += histogram[ b ];
+    mapping[ b ] = static_cast<float>( this->m_Minimum + scale * cumulative );
+  }
+
+} // end ComputeTileMapping()
+
+
+/**
+ * ******************* ThreadedGenerateData *******************
+ */
+
+template <class TImage>
+void
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  const ImageType * input = this->GetInput();
+  const IndexType start = input->GetLargestPossibleRegion().GetIndex();
+  const unsigned int numberOfBins = this->m_NumberOfBins;
+  const unsigned int numberOfCorners = 1u << ImageDimension;
+  const double blend = this->m_Blend;
+  const float * mappings = &this->m_TileMappings[ 0 ];
+
+  ImageRegionConstIteratorWithIndex<ImageType> it( input, outputRegionForThread );
+  ImageRegionIterator<ImageType> ot( this->GetOutput(), outputRegionForThread );
+
+  // support progress methods/callbacks
+  ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+  for( it.GoToBegin(), ot.GoToBegin(); !it.IsAtEnd(); ++it, ++ot )
+  {
+    const IndexType index = it.GetIndex();
+    const double value = static_cast<double>( it.Get() );
+    const unsigned int bin = this->GetBin( value );
+
+    /** Interpolate the mappings of the 2^D neighbouring tiles. */
+    double equalized = 0.0;
+    for( unsigned int corner = 0; corner < numberOfCorners; ++corner )
+    {
+      SizeValueType tile = 0;
+      double weight = 1.0;
+      for( unsigned int d = 0; d < ImageDimension; ++d )
+      {
+        const SizeValueType x = index[ d ] - start[ d ];
+        const float w = this->m_UpperWeight[ d ][ x ];
+        if( corner & ( 1u << d ) )
+        {
+          tile += this->m_UpperTile[ d ][ x ];
+          weight *= w;
+        }
+        else
+        {
+          tile += this->m_LowerTile[ d ][ x ];
+          weight *= 1.0 - w;
+        }
+      }
+      equalized += weight * mappings[ tile * numberOfBins + bin ];
+    }
+
+    double result = blend * value + ( 1.0 - blend ) * equalized;
+    result = vnl_math_max( static_cast<double>( NumericTraits<PixelType>::NonpositiveMin() ),
+      vnl_math_min( static_cast<double>( NumericTraits<PixelType>::max() ), result ) );
+    ot.Set( static_cast<PixelType>( vnl_math_rnd( result ) ) );
+
+    progress.CompletedPixel();
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template <class TImage>
+void
+TiledAdaptiveHistogramEqualizationImageFilter<TImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Radius: " << this->m_Radius << std::endl;
+  os << indent << "ClipLimit: " << this->m_ClipLimit << std::endl;
+  os << indent << "Blend: " << this->m_Blend << std::endl;
+  os << indent << "NumberOfBins: " << this->m_NumberOfBins << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkTiledAdaptiveHistogramEqualizationImageFilter_hxx_
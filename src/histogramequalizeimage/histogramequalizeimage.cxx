@@ -44,7 +44,7 @@ std::string GetHelpString( void )
     << "pxhistogramequalizeimage\n"
     << "  -in      inputFileName\n"
     << "  -out     outputFileName\n"
-    << "  -[mask]  maskFileName\n"
+    << "  -[mask]  maskFileName, may be a packed mask (.pmask)\n"
     << "Supported: 2D, 3D, (unsigned) char, (unsigned) short, (unsigned) int";
 
   return ss.str();
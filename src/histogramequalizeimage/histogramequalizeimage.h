@@ -23,6 +23,7 @@
 #include "itkImageFileReader.h"
 #include "itkHistogramEqualizationImageFilter.h"
 #include "itkImageFileWriter.h"
+#include "ITKToolsPackedMask.h"
 
 
 /** \class ITKToolsHistogramEqualizeImageBase
@@ -80,7 +81,6 @@ public:
     typedef typename ImageType::RegionType          RegionType;
     typedef typename ImageType::PointType           PointType;
     typedef itk::ImageFileReader<ImageType>         ReaderType;
-    typedef itk::ImageFileReader<MaskImageType>     MaskReaderType;
     typedef itk::ImageFileWriter<ImageType>         WriterType;
     typedef typename ReaderType::Pointer            ReaderPointer;
     typedef typename WriterType::Pointer            WriterPointer;
@@ -96,20 +96,18 @@ public:
     reader->SetFileName( this->m_InputFileName.c_str() );
     reader->Update();
 
-    /** Try to read mask image */
-    typename MaskReaderType::Pointer maskReader;
+    /** Try to read mask image, which may be a packed mask. */
+    typename MaskImageType::Pointer maskImage;
     if( this->m_MaskFileName != "" )
     {
-      maskReader = MaskReaderType::New();
-      maskReader->SetFileName( this->m_MaskFileName.c_str() );
-      maskReader->Update();
+      maskImage = itktools::ReadMaskImage<MaskImageType>( this->m_MaskFileName );
     }
 
     /** Setup pipeline and configure its components */
     enhancer->SetInput( reader->GetOutput() );
     if( this->m_MaskFileName != "" )
     {
-      enhancer->SetMask( maskReader->GetOutput() );
+      enhancer->SetMask( maskImage );
     }
     writer->SetInput( enhancer->GetOutput() );
     writer->SetFileName( this->m_OutputFileName.c_str() );
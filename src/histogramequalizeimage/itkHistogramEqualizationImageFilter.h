@@ -20,6 +20,8 @@
 
 #include "itkImageToImageFilter.h"
 #include "itkArray.h"
+#include <vector>
+#include <utility>
 
 
 namespace itk
@@ -32,6 +34,15 @@ namespace itk
  * In contrast to the AdaptiveHistogramEqualizationImageFilter it is not adaptive
  * and therefore faster.
  *
+ * The minimum, maximum and histogram are computed by multiple threads, each
+ * on its own part of the image and with its own histogram, which are merged
+ * afterwards. For 8 and 16 bit integer pixel types the histogram spans the
+ * full range of the type, so that pixels are binned directly and a single
+ * pass over the image suffices; the minimum and maximum follow from the
+ * histogram. When a histogram per thread would take too much memory, each
+ * thread sorts the values of its part of the image instead, and these are
+ * merged into a single histogram, of which each thread fills a slice.
+ *
  * \ingroup IntensityImageFilters
  *
  */
@@ -106,10 +117,44 @@ protected:
   double              m_MeanFrequency;
   MaskImagePointer    m_Mask;
 
+  /** Per thread results of the histogram computation. For very wide
+   * ranges there is a single histogram, and per thread the sorted values
+   * with their counts. */
+  typedef std::vector<SizeValueType>  HistogramType;
+  typedef std::vector< std::pair<long, SizeValueType> > ValueCountsType;
+  std::vector<HistogramType>          m_ThreadHistograms;
+  std::vector<ValueCountsType>        m_ThreadValueCounts;
+  std::vector<InputImagePixelType>    m_ThreadMin;
+  std::vector<InputImagePixelType>    m_ThreadMax;
+
   /** Initialize some accumulators before the threads run.
-   * Create a LUT */
+   * Compute the histogram with multiple threads and create a LUT. */
   virtual void BeforeThreadedGenerateData( void );
 
+  /** Compute the minimum and maximum of the valid pixels in a region. */
+  void ThreadedComputeMinimumMaximum(
+    const OutputImageRegionType & region, ThreadIdType threadId );
+
+  /** Add the valid pixels of a region to the histogram of a thread. The
+   * histogram starts at the given offset, which is the minimum of the image,
+   * or the minimum of the pixel type for the direct binning of 8 and 16 bit
+   * integers.
+   */
+  void ThreadedComputeHistogram(
+    const OutputImageRegionType & region, ThreadIdType threadId, long offset );
+
+  /** Sort the valid pixels of a region, and store the distinct values
+   * with their counts for a thread.
+   */
+  void ThreadedComputeValueCounts(
+    const OutputImageRegionType & region, ThreadIdType threadId );
+
+  /** Add the value counts of all threads that fall in a slice of the bins
+   * to the single shared histogram.
+   */
+  void ThreadedMergeValueCounts(
+    long offset, SizeValueType firstBin, SizeValueType endBin );
+
   /** Tally accumulated in threads. */
   virtual void AfterThreadedGenerateData( void );
 
@@ -120,6 +165,28 @@ protected:
 
 private:
   HistogramEqualizationImageFilter(const Self&); //purposely not implemented
+
+  /** Holds the arguments of the histogram threads. */
+  typedef enum {
+    MinimumMaximumStep,
+    HistogramStep,
+    ValueCountsStep,
+    MergeValueCountsStep
+  } HistogramStepType;
+
+  struct HistogramThreadStruct
+  {
+    Self *            Filter;
+    HistogramStepType Step;
+    long              Offset;
+  };
+
+  /** Thread callback that calls ThreadedComputeMinimumMaximum,
+   * ThreadedComputeHistogram or ThreadedComputeValueCounts on a part of
+   * the requested region, or ThreadedMergeValueCounts on a part of the bins.
+   */
+  static ITK_THREAD_RETURN_TYPE HistogramThreaderCallback( void * arg );
+
   void operator=(const Self&); //purposely not implemented
 
 }; // end class HistogramEqualizationImageFilter
@@ -24,6 +24,9 @@
 #include "itkImageRegionConstIterator.h"
 #include "itkNumericTraits.h"
 #include "itkProgressReporter.h"
+#include "itkMultiThreader.h"
+
+#include <algorithm>
 
 
 namespace itk {
@@ -49,95 +52,134 @@ void
 HistogramEqualizationImageFilter<TImage>
 ::BeforeThreadedGenerateData( void )
 {
-  typedef ImageRegionConstIterator<InputImageType>   ImageIteratorType;
-  typedef ImageRegionConstIterator<MaskImageType>    MaskIteratorType;
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
 
-  /** Use a mask or not */
-  bool useMask = false;
-  if( this->GetMask() )
-  {
-    useMask = true;
-  }
+  /** 8 and 16 bit integers are binned directly over the range of the type. */
+  const bool directBinning = NumericTraits<InputImagePixelType>::is_integer
+    && sizeof( InputImagePixelType ) <= 2;
 
-  /** Compute minimum and maximum of the input image */
-  ImageIteratorType it( this->GetInput(), this->GetOutput()->GetRequestedRegion() );
-  MaskIteratorType maskIt;
-  if( useMask )
+  HistogramThreadStruct str;
+  str.Filter = this;
+  this->m_ThreadMin.assign( numberOfThreads, NumericTraits<InputImagePixelType>::max() );
+  this->m_ThreadMax.assign( numberOfThreads, NumericTraits<InputImagePixelType>::NonpositiveMin() );
+
+  long offset = 0;
+  unsigned int numberOfHistogramBins = 0;
+  if( directBinning )
   {
-    maskIt = MaskIteratorType( this->GetMask(), this->GetOutput()->GetRequestedRegion() );
-    maskIt.GoToBegin();
+    offset = static_cast<long>( NumericTraits<InputImagePixelType>::NonpositiveMin() );
+    numberOfHistogramBins = static_cast<unsigned int>(
+      static_cast<long>( NumericTraits<InputImagePixelType>::max() ) - offset + 1 );
   }
-
-  InputImagePixelType tempmin = itk::NumericTraits<InputImagePixelType>::max();
-  InputImagePixelType tempmax =
-    itk::NumericTraits<InputImagePixelType>::NonpositiveMin();
-
-  unsigned long numberOfValidPixels = 0;
-  it.GoToBegin();
-  while ( !it.IsAtEnd() )
+  else
   {
-    bool validPixel = true;
-    if( useMask )
+    /** Compute minimum and maximum of the input image. */
+    str.Step = MinimumMaximumStep;
+    this->GetMultiThreader()->SetNumberOfThreads( numberOfThreads );
+    this->GetMultiThreader()->SetSingleMethod( HistogramThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+
+    InputImagePixelType tempmin = NumericTraits<InputImagePixelType>::max();
+    InputImagePixelType tempmax = NumericTraits<InputImagePixelType>::NonpositiveMin();
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
     {
-      validPixel = static_cast<bool>( maskIt.Value() );
-      ++maskIt;
+      if( this->m_ThreadMin[ i ] < tempmin ) tempmin = this->m_ThreadMin[ i ];
+      if( this->m_ThreadMax[ i ] > tempmax ) tempmax = this->m_ThreadMax[ i ];
     }
-    if( validPixel )
+    /** The histogram and the LUT cover the whole intensity range. */
+    const double range = static_cast<double>( tempmax )
+      - static_cast<double>( tempmin ) + 1.0;
+    const double maximumNumberOfBins = static_cast<double>( 1UL << 28 );
+    if( !( range <= maximumNumberOfBins ) )
     {
-      ++numberOfValidPixels;
-      const InputImagePixelType & current = it.Value();
-      if( current < tempmin )
-      {
-        tempmin = current;
-      }
-      if( current > tempmax )
+      itkExceptionMacro( << "The intensity range [" << tempmin << ", " << tempmax
+        << "] is too large for a histogram with a bin per intensity; at most "
+        << maximumNumberOfBins << " bins are supported." );
+    }
+    offset = static_cast<long>( tempmin );
+    numberOfHistogramBins = static_cast<unsigned int>( range );
+  }
+
+  /** Compute the histogram of the input image. Each thread bins its part
+   * of the image in its own histogram, and these are merged, as long as
+   * the histograms of all threads together stay within 2^24 bins. For very
+   * wide ranges each thread sorts the values of its part of the image
+   * instead, and the threads merge these into a single histogram, each
+   * filling a slice of the bins.
+   */
+  const double maximumNumberOfThreadBins = static_cast<double>( 1UL << 24 );
+  const bool histogramPerThread = static_cast<double>( numberOfHistogramBins )
+    * static_cast<double>( numberOfThreads ) <= maximumNumberOfThreadBins;
+  str.Offset = offset;
+  if( histogramPerThread )
+  {
+    this->m_ThreadHistograms.assign( numberOfThreads,
+      HistogramType( numberOfHistogramBins, 0 ) );
+    str.Step = HistogramStep;
+    this->GetMultiThreader()->SetNumberOfThreads( numberOfThreads );
+    this->GetMultiThreader()->SetSingleMethod( HistogramThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+
+    /** Merge the histograms. */
+    HistogramType & merged = this->m_ThreadHistograms[ 0 ];
+    for( ThreadIdType i = 1; i < numberOfThreads; ++i )
+    {
+      const HistogramType & threadHistogram = this->m_ThreadHistograms[ i ];
+      for( unsigned int j = 0; j < numberOfHistogramBins; ++j )
       {
-        tempmax = current;
+        merged[ j ] += threadHistogram[ j ];
       }
     }
-    ++it;
   }
+  else
+  {
+    this->m_ThreadValueCounts.assign( numberOfThreads, ValueCountsType() );
+    str.Step = ValueCountsStep;
+    this->GetMultiThreader()->SetNumberOfThreads( numberOfThreads );
+    this->GetMultiThreader()->SetSingleMethod( HistogramThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+
+    this->m_ThreadHistograms.assign( 1, HistogramType( numberOfHistogramBins, 0 ) );
+    str.Step = MergeValueCountsStep;
+    this->GetMultiThreader()->SetNumberOfThreads( numberOfThreads );
+    this->GetMultiThreader()->SetSingleMethod( HistogramThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+    this->m_ThreadValueCounts.clear();
+  }
+  HistogramType & merged = this->m_ThreadHistograms[ 0 ];
 
+  /** With direct binning the minimum and maximum follow from the histogram. */
+  unsigned int firstBin = 0;
+  unsigned int lastBin = numberOfHistogramBins - 1;
+  if( directBinning )
+  {
+    while( firstBin < lastBin && merged[ firstBin ] == 0 ) ++firstBin;
+    while( lastBin > firstBin && merged[ lastBin ] == 0 ) --lastBin;
+  }
+  const InputImagePixelType tempmin = static_cast<InputImagePixelType>( offset + firstBin );
   this->m_Min = tempmin;
-  this->m_Max = tempmax;
+  this->m_Max = static_cast<InputImagePixelType>( offset + lastBin );
+
+  SizeValueType numberOfValidPixels = 0;
+  for( unsigned int j = firstBin; j <= lastBin; ++j )
+  {
+    numberOfValidPixels += merged[ j ];
+  }
 
   /** Compute the number of bins and the ideal number of times a intensity value
    * should occur in the image */
-  this->m_NumberOfBins = tempmax - tempmin + 1;
+  this->m_NumberOfBins = lastBin - firstBin + 1;
   this->m_MeanFrequency =
     static_cast<double>( numberOfValidPixels ) /
     static_cast<double>( this->m_NumberOfBins );
 
-  /** Compute the histogram of the input image */
-  typedef itk::Array<unsigned long> HistogramType;
-  HistogramType hist( this->m_NumberOfBins );
-  hist.Fill( 0 );
-  it.GoToBegin();
-  if( useMask )
-  {
-    maskIt.GoToBegin();
-  }
-  while ( !it.IsAtEnd() )
-  {
-    bool validPixel = true;
-    if( useMask )
-    {
-      validPixel = static_cast<bool>( maskIt.Value() );
-      ++maskIt;
-    }
-    if( validPixel )
-    {
-      // assuming integer pixel type of binsize 1
-      hist[ static_cast<unsigned int>( it.Value() - tempmin ) ]++;
-    }
-    ++it;
-  }
-
   /** convert it to a cumulative histogram */
+  HistogramType hist( merged.begin() + firstBin, merged.begin() + lastBin + 1 );
   for( unsigned int i = 1; i < this->m_NumberOfBins; i++ )
   {
     hist[ i ] += hist[i-1];
   }
+  this->m_ThreadHistograms.clear();
 
   /** Compute LUT */
   this->m_LUT.SetSize(this->m_NumberOfBins);
@@ -152,6 +194,208 @@ HistogramEqualizationImageFilter<TImage>
 } // end BeforeThreadedGenerateData()
 
 
+template<class TImage>
+ITK_THREAD_RETURN_TYPE
+HistogramEqualizationImageFilter<TImage>
+::HistogramThreaderCallback( void * arg )
+{
+  typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  HistogramThreadStruct * str = static_cast<HistogramThreadStruct *>( info->UserData );
+  const ThreadIdType threadId = info->ThreadID;
+
+  /** Every thread fills a slice of the bins of the shared histogram. */
+  if( str->Step == MergeValueCountsStep )
+  {
+    const SizeValueType numberOfBins = str->Filter->m_ThreadHistograms[ 0 ].size();
+    const SizeValueType numberOfThreads = info->NumberOfThreads;
+    str->Filter->ThreadedMergeValueCounts( str->Offset,
+      threadId * numberOfBins / numberOfThreads,
+      ( threadId + 1 ) * numberOfBins / numberOfThreads );
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  /** Split the requested region of the output, as in the ImageSource. */
+  OutputImageRegionType splitRegion;
+  const ThreadIdType total = str->Filter->SplitRequestedRegion(
+    threadId, info->NumberOfThreads, splitRegion );
+  if( threadId < total )
+  {
+    if( str->Step == HistogramStep )
+    {
+      str->Filter->ThreadedComputeHistogram( splitRegion, threadId, str->Offset );
+    }
+    else if( str->Step == ValueCountsStep )
+    {
+      str->Filter->ThreadedComputeValueCounts( splitRegion, threadId );
+    }
+    else
+    {
+      str->Filter->ThreadedComputeMinimumMaximum( splitRegion, threadId );
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end HistogramThreaderCallback()
+
+
+template<class TImage>
+void
+HistogramEqualizationImageFilter<TImage>
+::ThreadedComputeMinimumMaximum(
+  const OutputImageRegionType & region, ThreadIdType threadId )
+{
+  typedef ImageRegionConstIterator<InputImageType>   ImageIteratorType;
+  typedef ImageRegionConstIterator<MaskImageType>    MaskIteratorType;
+
+  InputImagePixelType tempmin = NumericTraits<InputImagePixelType>::max();
+  InputImagePixelType tempmax = NumericTraits<InputImagePixelType>::NonpositiveMin();
+
+  ImageIteratorType it( this->GetInput(), region );
+  if( this->GetMask() )
+  {
+    MaskIteratorType maskIt( this->GetMask(), region );
+    for( ; !it.IsAtEnd(); ++it, ++maskIt )
+    {
+      if( !maskIt.Value() ) continue;
+      const InputImagePixelType current = it.Value();
+      if( current < tempmin ) tempmin = current;
+      if( current > tempmax ) tempmax = current;
+    }
+  }
+  else
+  {
+    for( ; !it.IsAtEnd(); ++it )
+    {
+      const InputImagePixelType current = it.Value();
+      if( current < tempmin ) tempmin = current;
+      if( current > tempmax ) tempmax = current;
+    }
+  }
+
+  this->m_ThreadMin[ threadId ] = tempmin;
+  this->m_ThreadMax[ threadId ] = tempmax;
+
+} // end ThreadedComputeMinimumMaximum()
+
+
+template<class TImage>
+void
+HistogramEqualizationImageFilter<TImage>
+::ThreadedComputeHistogram(
+  const OutputImageRegionType & region, ThreadIdType threadId, long offset )
+{
+  typedef ImageRegionConstIterator<InputImageType>   ImageIteratorType;
+  typedef ImageRegionConstIterator<MaskImageType>    MaskIteratorType;
+
+  // assuming integer pixel type of binsize 1
+  SizeValueType * hist = &this->m_ThreadHistograms[ threadId ][ 0 ];
+
+  ImageIteratorType it( this->GetInput(), region );
+  if( this->GetMask() )
+  {
+    MaskIteratorType maskIt( this->GetMask(), region );
+    for( ; !it.IsAtEnd(); ++it, ++maskIt )
+    {
+      if( maskIt.Value() )
+      {
+        ++hist[ static_cast<long>( it.Value() ) - offset ];
+      }
+    }
+  }
+  else
+  {
+    for( ; !it.IsAtEnd(); ++it )
+    {
+      ++hist[ static_cast<long>( it.Value() ) - offset ];
+    }
+  }
+
+} // end ThreadedComputeHistogram()
+
+
+template<class TImage>
+void
+HistogramEqualizationImageFilter<TImage>
+::ThreadedComputeValueCounts(
+  const OutputImageRegionType & region, ThreadIdType threadId )
+{
+  typedef ImageRegionConstIterator<InputImageType>   ImageIteratorType;
+  typedef ImageRegionConstIterator<MaskImageType>    MaskIteratorType;
+
+  // assuming integer pixel type of binsize 1
+  std::vector<long> values;
+  values.reserve( region.GetNumberOfPixels() );
+
+  ImageIteratorType it( this->GetInput(), region );
+  if( this->GetMask() )
+  {
+    MaskIteratorType maskIt( this->GetMask(), region );
+    for( ; !it.IsAtEnd(); ++it, ++maskIt )
+    {
+      if( maskIt.Value() )
+      {
+        values.push_back( static_cast<long>( it.Value() ) );
+      }
+    }
+  }
+  else
+  {
+    for( ; !it.IsAtEnd(); ++it )
+    {
+      values.push_back( static_cast<long>( it.Value() ) );
+    }
+  }
+
+  /** Sort, and store every distinct value once with its count. */
+  std::sort( values.begin(), values.end() );
+  ValueCountsType & valueCounts = this->m_ThreadValueCounts[ threadId ];
+  for( std::size_t i = 0; i < values.size(); ++i )
+  {
+    if( valueCounts.empty() || valueCounts.back().first != values[ i ] )
+    {
+      valueCounts.push_back( std::make_pair( values[ i ], static_cast<SizeValueType>( 1 ) ) );
+    }
+    else
+    {
+      ++valueCounts.back().second;
+    }
+  }
+
+} // end ThreadedComputeValueCounts()
+
+
+template<class TImage>
+void
+HistogramEqualizationImageFilter<TImage>
+::ThreadedMergeValueCounts(
+  long offset, SizeValueType firstBin, SizeValueType endBin )
+{
+  if( firstBin >= endBin ) return;
+
+  SizeValueType * hist = &this->m_ThreadHistograms[ 0 ][ 0 ];
+  const long first = offset + static_cast<long>( firstBin );
+  const long end = offset + static_cast<long>( endBin );
+
+  /** The value counts of a thread are sorted, so the slice is found by
+   * a binary search.
+   */
+  for( std::size_t t = 0; t < this->m_ThreadValueCounts.size(); ++t )
+  {
+    const ValueCountsType & valueCounts = this->m_ThreadValueCounts[ t ];
+    typename ValueCountsType::const_iterator it = std::lower_bound(
+      valueCounts.begin(), valueCounts.end(),
+      std::make_pair( first, static_cast<SizeValueType>( 0 ) ) );
+    for( ; it != valueCounts.end() && it->first < end; ++it )
+    {
+      hist[ it->first - offset ] += it->second;
+    }
+  }
+
+} // end ThreadedMergeValueCounts()
+
+
 template<class TImage>
 void
 HistogramEqualizationImageFilter<TImage>
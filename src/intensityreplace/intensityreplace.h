@@ -21,7 +21,7 @@
 #include "ITKToolsBase.h"
 
 #include "itkImageFileReader.h"
-#include "itkChangeLabelImageFilter.h"
+#include "itkIntensityReplaceImageFilter.h"
 #include "itkImageFileWriter.h"
 
 
@@ -82,7 +82,7 @@ public:
     typedef itk::Image< OutputPixelType, Dimension >        OutputImageType;
 
     typedef itk::ImageFileReader< InputImageType >          ReaderType;
-    typedef itk::ChangeLabelImageFilter<
+    typedef itk::IntensityReplaceImageFilter<
       InputImageType, OutputImageType >                     ReplaceFilterType;
     typedef itk::ImageFileWriter< OutputImageType >         WriterType;
 
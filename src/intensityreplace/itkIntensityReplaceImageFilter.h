@@ -0,0 +1,144 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkIntensityReplaceImageFilter_h_
+#define __itkIntensityReplaceImageFilter_h_
+
+#include "itkImageToImageFilter.h"
+
+#include <map>
+#include <vector>
+
+
+namespace itk
+{
+
+/** \class IntensityReplaceImageFilter
+ * \brief Replace a set of intensity values by other values.
+ *
+ * This filter does the same as the ChangeLabelImageFilter, but avoids
+ * a std::map lookup per voxel. For integer pixel types a dense lookup
+ * table is built once, before the threads run. For 8 and 16 bit types
+ * the table covers the whole range of the pixel type, so that no range
+ * check is needed; for larger types it covers the range of the values
+ * to be replaced, if that range is not larger than MaximumTableSize,
+ * nor than MaximumTableSizePerReplacement times the number of values
+ * to be replaced.
+ * Otherwise, and for floating point types, a sorted flat array of the
+ * values to be replaced is searched with a binary search.
+ *
+ * Values that are not replaced are cast to the output pixel type.
+ *
+ * \ingroup IntensityImageFilters
+ */
+template <class TInputImage, class TOutputImage>
+class IntensityReplaceImageFilter:
+    public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef IntensityReplaceImageFilter                     Self;
+  typedef ImageToImageFilter<TInputImage, TOutputImage>   Superclass;
+  typedef SmartPointer<Self>                              Pointer;
+  typedef SmartPointer<const Self>                        ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( IntensityReplaceImageFilter, ImageToImageFilter );
+
+  /** Image related typedefs. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+    TInputImage::ImageDimension );
+
+  /** Typedef to describe the input/output image types. */
+  typedef TInputImage                               InputImageType;
+  typedef TOutputImage                              OutputImageType;
+  typedef typename InputImageType::PixelType        InputPixelType;
+  typedef typename OutputImageType::PixelType       OutputPixelType;
+  typedef typename OutputImageType::RegionType      OutputImageRegionType;
+
+  /** Typedef for the change map. */
+  typedef std::map<InputPixelType, OutputPixelType> ChangeMapType;
+
+  /** Set a single intensity replacement. */
+  void SetChange( const InputPixelType & original, const OutputPixelType & result );
+
+  /** Clear all replacements. */
+  void ClearChangeMap( void );
+
+  /** Get the change map. */
+  const ChangeMapType & GetChangeMap( void ) const
+  {
+    return this->m_ChangeMap;
+  }
+
+  /** Set/Get the maximum number of entries of the dense lookup table.
+   * Default 2^24.
+   */
+  itkSetMacro( MaximumTableSize, unsigned long );
+  itkGetConstMacro( MaximumTableSize, unsigned long );
+
+  /** Set/Get the maximum number of entries of the dense lookup table per
+   * value to be replaced, so that a few sparse replacements do not build
+   * a huge table. Not used for 8 and 16 bit types. Default 4096.
+   */
+  itkSetMacro( MaximumTableSizePerReplacement, unsigned long );
+  itkGetConstMacro( MaximumTableSizePerReplacement, unsigned long );
+
+protected:
+  IntensityReplaceImageFilter();
+  ~IntensityReplaceImageFilter(){};
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Build the lookup table or the sorted arrays. */
+  virtual void BeforeThreadedGenerateData( void );
+
+  /** Multi-thread version GenerateData. Replaces the values line by line. */
+  virtual void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId );
+
+private:
+  IntensityReplaceImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & );              // purposely not implemented
+
+  ChangeMapType   m_ChangeMap;
+  unsigned long   m_MaximumTableSize;
+  unsigned long   m_MaximumTableSizePerReplacement;
+
+  /** The dense lookup table, covering [m_TableMinimum, m_TableMaximum]. */
+  bool                          m_UseTable;
+  bool                          m_TableCoversPixelType;
+  InputPixelType                m_TableMinimum;
+  InputPixelType                m_TableMaximum;
+  std::vector<OutputPixelType>  m_Table;
+
+  /** The sorted values to be replaced, and their replacements. */
+  std::vector<InputPixelType>   m_SortedOriginals;
+  std::vector<OutputPixelType>  m_SortedResults;
+
+}; // end class IntensityReplaceImageFilter
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkIntensityReplaceImageFilter.hxx"
+#endif
+
+#endif // end #ifndef __itkIntensityReplaceImageFilter_h_
@@ -0,0 +1,269 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkIntensityReplaceImageFilter_hxx_
+#define __itkIntensityReplaceImageFilter_hxx_
+
+#include "itkIntensityReplaceImageFilter.h"
+
+#include "itkImageLinearConstIteratorWithIndex.h"
+#include "itkNumericTraits.h"
+#include "itkProgressReporter.h"
+
+#include <algorithm>
+
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template <class TInputImage, class TOutputImage>
+IntensityReplaceImageFilter<TInputImage, TOutputImage>
+::IntensityReplaceImageFilter()
+{
+  this->m_MaximumTableSize = 1UL << 24;
+  this->m_MaximumTableSizePerReplacement = 4096;
+  this->m_UseTable = false;
+  this->m_TableCoversPixelType = false;
+  this->m_TableMinimum = NumericTraits<InputPixelType>::Zero;
+  this->m_TableMaximum = NumericTraits<InputPixelType>::Zero;
+} // end Constructor
+
+
+/**
+ * ******************* SetChange *******************
+ */
+
+template <class TInputImage, class TOutputImage>
+void
+IntensityReplaceImageFilter<TInputImage, TOutputImage>
+::SetChange( const InputPixelType & original, const OutputPixelType & result )
+{
+  typename ChangeMapType::iterator it = this->m_ChangeMap.find( original );
+  if( it == this->m_ChangeMap.end() || it->second != result )
+  {
+    this->m_ChangeMap[ original ] = result;
+    this->Modified();
+  }
+} // end SetChange()
+
+
+/**
+ * ******************* ClearChangeMap *******************
+ */
+
+template <class TInputImage, class TOutputImage>
+void
+IntensityReplaceImageFilter<TInputImage, TOutputImage>
+::ClearChangeMap( void )
+{
+  if( !this->m_ChangeMap.empty() )
+  {
+    this->m_ChangeMap.clear();
+    this->Modified();
+  }
+} // end ClearChangeMap()
+
+
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template <class TInputImage, class TOutputImage>
+void
+IntensityReplaceImageFilter<TInputImage, TOutputImage>
+::BeforeThreadedGenerateData( void )
+{
+  this->m_UseTable = false;
+  this->m_TableCoversPixelType = false;
+  this->m_Table.clear();
+  this->m_SortedOriginals.clear();
+  this->m_SortedResults.clear();
+
+  /** Try to build a dense lookup table for integer types. */
+  if( NumericTraits<InputPixelType>::is_integer && !this->m_ChangeMap.empty() )
+  {
+    InputPixelType tableMinimum = this->m_ChangeMap.begin()->first;
+    InputPixelType tableMaximum = this->m_ChangeMap.rbegin()->first;
+    if( sizeof( InputPixelType ) <= 2 )
+    {
+      tableMinimum = NumericTraits<InputPixelType>::NonpositiveMin();
+      tableMaximum = NumericTraits<InputPixelType>::max();
+      this->m_TableCoversPixelType = true;
+    }
+
+    const double tableSize = static_cast<double>( tableMaximum )
+      - static_cast<double>( tableMinimum ) + 1.0;
+    const double maximumTableSize = std::min(
+      static_cast<double>( this->m_MaximumTableSize ),
+      static_cast<double>( this->m_MaximumTableSizePerReplacement )
+      * static_cast<double>( this->m_ChangeMap.size() ) );
+    if( this->m_TableCoversPixelType || tableSize <= maximumTableSize )
+    {
+      this->m_UseTable = true;
+      this->m_TableMinimum = tableMinimum;
+      this->m_TableMaximum = tableMaximum;
+
+      /** Initialize with the identity, then fill in the replacements.
+       * The value is not incremented past the last entry, which may be
+       * the maximum of the pixel type.
+       */
+      const std::size_t numberOfEntries = static_cast<std::size_t>( tableSize );
+      this->m_Table.resize( numberOfEntries );
+      InputPixelType value = tableMinimum;
+      for( std::size_t i = 0; i < numberOfEntries; ++i )
+      {
+        this->m_Table[ i ] = static_cast<OutputPixelType>( value );
+        if( i + 1 < numberOfEntries ) ++value;
+      }
+
+      typename ChangeMapType::const_iterator it;
+      for( it = this->m_ChangeMap.begin(); it != this->m_ChangeMap.end(); ++it )
+      {
+        this->m_Table[ static_cast<std::size_t>( it->first - tableMinimum ) ] = it->second;
+      }
+      return;
+    }
+  }
+
+  /** Otherwise use sorted flat arrays. The map is already sorted. */
+  this->m_TableCoversPixelType = false;
+  this->m_SortedOriginals.reserve( this->m_ChangeMap.size() );
+  this->m_SortedResults.reserve( this->m_ChangeMap.size() );
+  typename ChangeMapType::const_iterator it;
+  for( it = this->m_ChangeMap.begin(); it != this->m_ChangeMap.end(); ++it )
+  {
+    this->m_SortedOriginals.push_back( it->first );
+    this->m_SortedResults.push_back( it->second );
+  }
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ******************* ThreadedGenerateData *******************
+ */
+
+template <class TInputImage, class TOutputImage>
+void
+IntensityReplaceImageFilter<TInputImage, TOutputImage>
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  typedef ImageLinearConstIteratorWithIndex<OutputImageType> LineIteratorType;
+
+  const InputImageType * inputImage = this->GetInput();
+  OutputImageType * outputImage = this->GetOutput();
+
+  const std::size_t lineLength = outputRegionForThread.GetSize( 0 );
+  if( lineLength == 0 ) return;
+  const std::size_t numberOfLines
+    = outputRegionForThread.GetNumberOfPixels() / lineLength;
+
+  // support progress methods/callbacks
+  ProgressReporter progress( this, threadId, numberOfLines );
+
+  const InputPixelType * inputBuffer = inputImage->GetBufferPointer();
+  OutputPixelType * outputBuffer = outputImage->GetBufferPointer();
+
+  const InputPixelType tableMinimum = this->m_TableMinimum;
+  const InputPixelType tableMaximum = this->m_TableMaximum;
+  const OutputPixelType * table = this->m_Table.empty() ? 0 : &this->m_Table[ 0 ];
+  const std::size_t numberOfOriginals = this->m_SortedOriginals.size();
+  const InputPixelType * originals
+    = numberOfOriginals == 0 ? 0 : &this->m_SortedOriginals[ 0 ];
+
+  /** Loop over the lines in the x-direction. */
+  LineIteratorType lineIt( outputImage, outputRegionForThread );
+  lineIt.SetDirection( 0 );
+  lineIt.GoToBegin();
+  while( !lineIt.IsAtEnd() )
+  {
+    const InputPixelType * in = inputBuffer
+      + inputImage->ComputeOffset( lineIt.GetIndex() );
+    OutputPixelType * out = outputBuffer
+      + outputImage->ComputeOffset( lineIt.GetIndex() );
+
+    if( this->m_UseTable && this->m_TableCoversPixelType )
+    {
+      /** No range check needed. */
+      for( std::size_t i = 0; i < lineLength; ++i )
+      {
+        out[ i ] = table[ static_cast<std::size_t>( in[ i ] - tableMinimum ) ];
+      }
+    }
+    else if( this->m_UseTable )
+    {
+      for( std::size_t i = 0; i < lineLength; ++i )
+      {
+        const InputPixelType value = in[ i ];
+        out[ i ] = ( value >= tableMinimum && value <= tableMaximum )
+          ? table[ static_cast<std::size_t>( value - tableMinimum ) ]
+          : static_cast<OutputPixelType>( value );
+      }
+    }
+    else
+    {
+      for( std::size_t i = 0; i < lineLength; ++i )
+      {
+        const InputPixelType value = in[ i ];
+        const InputPixelType * found = std::lower_bound(
+          originals, originals + numberOfOriginals, value );
+        if( found != originals + numberOfOriginals && *found == value )
+        {
+          out[ i ] = this->m_SortedResults[ found - originals ];
+        }
+        else
+        {
+          out[ i ] = static_cast<OutputPixelType>( value );
+        }
+      }
+    }
+
+    lineIt.NextLine();
+    progress.CompletedPixel();
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template <class TInputImage, class TOutputImage>
+void
+IntensityReplaceImageFilter<TInputImage, TOutputImage>
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Number of replacements: " << this->m_ChangeMap.size() << std::endl;
+  os << indent << "MaximumTableSize: " << this->m_MaximumTableSize << std::endl;
+  os << indent << "MaximumTableSizePerReplacement: "
+    << this->m_MaximumTableSizePerReplacement << std::endl;
+  os << indent << "UseTable: " << this->m_UseTable << std::endl;
+
+} // end PrintSelf()
+
+} // end namespace itk
+
+#endif // end #ifndef __itkIntensityReplaceImageFilter_hxx_
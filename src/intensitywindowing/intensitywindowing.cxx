@@ -44,6 +44,8 @@ std::string GetHelpString( void )
     << "  -w       windowMinimum windowMaximum\n"
     << "  [-pt]    pixel type of input and output images\n"
     << "           default: automatically determined from the first input image.\n"
+    << "  [-s]     number of streams, default 1.\n"
+    << "           If larger than 1, the image is windowed out-of-core, slab by slab.\n"
     << "Supported: 2D, 3D, (unsigned) char, (unsigned) short, (unsigned) int, float.";
 
   return ss.str();
@@ -112,6 +114,10 @@ int main( int argc, char **argv )
     return EXIT_FAILURE;
   }
 
+  /** Support for streaming. */
+  unsigned int numberOfStreams = 1;
+  parser->GetCommandLineArgument( "-s", numberOfStreams );
+
   /** Determine image properties. */
   itk::ImageIOBase::IOPixelType pixelType = itk::ImageIOBase::UNKNOWNPIXELTYPE;
   itk::ImageIOBase::IOComponentType componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
@@ -156,6 +162,7 @@ int main( int argc, char **argv )
     filter->m_OutputFileName = outputFileName;
     filter->m_InputFileName = inputFileName;
     filter->m_Window = window;
+    filter->m_NumberOfStreams = numberOfStreams;
 
     filter->Run();
 
@@ -40,6 +40,7 @@ public:
   {
     this->m_InputFileName = "";
     this->m_OutputFileName = "";
+    this->m_NumberOfStreams = 1;
   };
   /** Destructor. */
   ~ITKToolsIntensityWindowingBase(){};
@@ -48,6 +49,7 @@ public:
   std::string m_InputFileName;
   std::string m_OutputFileName;
   std::vector<double> m_Window;
+  unsigned int m_NumberOfStreams;
 
 }; // end class ITKToolsIntensityWindowingBase
 
@@ -95,9 +97,13 @@ public:
     windowfilter->SetOutputMinimum( min );
     windowfilter->SetOutputMaximum( max );
 
-    /** Connect and execute the pipeline. */
+    /** Connect and execute the pipeline. The windowing is a pixel-wise
+     * operation, so with multiple streams only one slab of the input
+     * needs to be in memory at a time.
+     */
     windowfilter->SetInput( reader->GetOutput() );
     writer->SetInput( windowfilter->GetOutput() );
+    writer->SetNumberOfStreamDivisions( this->m_NumberOfStreams );
     writer->Update();
 
   } // end Run()
@@ -106,6 +106,7 @@ public:
   }
 };
 
+/** Copies the first input, used for NOT_NOT = A. */
 template< class TInput1, class TInput2=TInput1, class TOutput=TInput1 >
 class DUMMY
 {
@@ -114,7 +115,7 @@ public:
   ~DUMMY() {};
   inline TOutput operator()( const TInput1 & A, const TInput2 & B)
   {
-    return static_cast<TOutput>( true );
+    return static_cast<TOutput>( A );
   }
 };
 
@@ -201,5 +202,47 @@ struct BinaryLogicalFunctorFactory
 };
 
 
+/** Word-at-a-time versions of the binary logical functors, used for
+ * bit-packed masks. Every word holds 64 voxels. The DUMMY operator
+ * (NOT_NOT) simply copies the first input.
+ */
+template< class TWord >
+void ApplyPackedBinaryLogicalOperator( BinaryFunctorEnum filterType,
+  const TWord * A, const TWord * B, TWord * out, const std::size_t numberOfWords )
+{
+  std::size_t i = 0;
+  switch( filterType )
+  {
+  case AND:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = A[ i ] & B[ i ];
+    break;
+  case OR:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = A[ i ] | B[ i ];
+    break;
+  case XOR:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = A[ i ] ^ B[ i ];
+    break;
+  case ANDNOT:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = A[ i ] & ~B[ i ];
+    break;
+  case ORNOT:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = A[ i ] | ~B[ i ];
+    break;
+  case NOT_XOR:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = ~( A[ i ] ^ B[ i ] );
+    break;
+  case NOT_OR:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = ~( A[ i ] | B[ i ] );
+    break;
+  case NOT_AND:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = ~( A[ i ] & B[ i ] );
+    break;
+  case DUMMY:
+    for( i = 0; i < numberOfWords; ++i ) out[ i ] = A[ i ];
+    break;
+  }
+} // end ApplyPackedBinaryLogicalOperator()
+
+
 #endif
 
@@ -26,6 +26,7 @@
 
 #include "itkCommandLineArgumentParser.h"
 #include "ITKToolsHelpers.h"
+#include "ITKToolsPackedMask.h"
 #include "logicalimageoperator.h"
 
 
@@ -61,10 +62,15 @@ std::string GetHelpString( void )
     << "             NOT_NOT = A\n"
     << "           Internally this expression is simplified.\n"
     << "  [-z]     compression flag; if provided, the output image is compressed\n"
+    << "  [-packed] perform the operation on bit-packed masks, 64 voxels at a time.\n"
+    << "           Nonzero voxels are considered true, for RGB images the luminance.\n"
+    << "           This mode is selected automatically when an input is a packed mask.\n"
+    << "           The output is written as a packed mask if its extension is .pmask;\n"
+    << "           the number of voxels in the output mask is printed.\n"
     << "  [-arg]   argument, necessary for some ops\n"
     << "  [-dim]   dimension, default: automatically determined from inputimage1\n"
     << "  [-pt]    pixelType, default: automatically determined from inputimage1\n"
-    << "Supported: 2D, 3D, (unsigned) short, (unsigned) char.\n"
+    << "Supported: 2D, 3D, (unsigned) short, (unsigned) char, packed masks.\n"
     << "NOTE: for historical reasons this functionality is not part of the unary or binary image operator." << std::endl;
 
   return ss.str();
@@ -107,6 +113,7 @@ int main( int argc, char **argv )
   bool retarg = parser->GetCommandLineArgument( "-arg", argument );
 
   const bool useCompression = parser->ArgumentExists( "-z" );
+  bool packed = parser->ArgumentExists( "-packed" );
 
   /** Check if the required arguments are given. */
   if( inputFileNames.size() != 2 && ops != "NOT" && ops != "NOT_NOT" && ops != "EQUAL" )
@@ -161,9 +168,44 @@ int main( int argc, char **argv )
   itk::ImageIOBase::IOComponentType componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
   unsigned int dim = 0;
   unsigned int numberOfComponents = 0;
-  bool retgip = itktools::GetImageProperties(
-    inputFileName1, pixelType, componentType, dim, numberOfComponents );
-  if( !retgip ) return EXIT_FAILURE;
+  if( itktools::IsPackedMaskFile( inputFileName1 ) )
+  {
+    /** Packed masks are unpacked to unsigned char, if needed. */
+    dim = itktools::GetPackedMaskDimension( inputFileName1 );
+    componentType = itk::ImageIOBase::UCHAR;
+    numberOfComponents = 1;
+    packed = true;
+  }
+  else
+  {
+    bool retgip = itktools::GetImageProperties(
+      inputFileName1, pixelType, componentType, dim, numberOfComponents );
+    if( !retgip ) return EXIT_FAILURE;
+  }
+  if( inputFileName2 != "" && itktools::IsPackedMaskFile( inputFileName2 ) )
+  {
+    packed = true;
+  }
+  if( itksys::SystemTools::GetFilenameLastExtension( outputFileName ) == ".pmask" )
+  {
+    packed = true;
+  }
+
+  /** Check that packed masks are scalar and the operator is supported.
+   * RGB(A) images are read as their luminance.
+   */
+  const bool isRGB = pixelType == itk::ImageIOBase::RGB
+    || pixelType == itk::ImageIOBase::RGBA;
+  if( packed && numberOfComponents != 1 && !isRGB )
+  {
+    std::cerr << "ERROR: Packed masks are only supported for scalar images." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( packed && ops == "EQUAL" )
+  {
+    std::cerr << "ERROR: The operator \"EQUAL\" is not supported on packed masks." << std::endl;
+    return EXIT_FAILURE;
+  }
 
   /** Class that does the work. */
   ITKToolsLogicalImageOperatorBase * filter = NULL;
@@ -198,6 +240,7 @@ int main( int argc, char **argv )
     filter->m_UseCompression = useCompression;
     filter->m_Argument = argument;
     filter->m_Unary = unary;
+    filter->m_Packed = packed;
 
     filter->Run();
 
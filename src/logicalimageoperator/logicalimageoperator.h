@@ -29,7 +29,9 @@
 #include "itkVectorIndexSelectionCastImageFilter.h"
 #include "itkComposeImageFilter.h"
 #include "itkImageFileWriter.h"
+#include "ITKToolsPackedMask.h"
 
+#include <algorithm>
 #include <map>
 #include <utility>
 #include <vector>
@@ -55,6 +57,7 @@ public:
     this->m_UseCompression = false;
     this->m_Argument = 0.0f;
     this->m_Unary = false;
+    this->m_Packed = false;
   };
   /** Destructor. */
   ~ITKToolsLogicalImageOperatorBase(){};
@@ -67,6 +70,7 @@ public:
   bool m_UseCompression;
   double m_Argument;
   bool m_Unary; // is the operator to be performed unary? (else it is binary)
+  bool m_Packed; // perform the operation on bit-packed masks
 
 }; // end class ITKToolsLogicalImageOperatorBase
 
@@ -88,10 +92,17 @@ public:
   ITKToolsLogicalImageOperator(){};
   ~ITKToolsLogicalImageOperator(){};
 
+  /** A pair indicating which functor should be used for an operator,
+   * and whether the arguments should be swapped.
+   */
+  typedef std::pair< BinaryFunctorEnum, bool >        BinaryOperatorType;
+  typedef std::map<std::string, BinaryOperatorType>   BinaryOperatorMapType;
+
   /** Run function. */
   void Run( void )
   {
-    if( this->m_Unary ) this->RunUnary();
+    if( this->m_Packed ) this->RunPacked();
+    else if( this->m_Unary ) this->RunUnary();
     else this->RunBinary();
 
   } // end Run()
@@ -176,61 +187,13 @@ public:
     typedef itk::ImageFileReader< VectorImageType >       ReaderType;
     typedef itk::ImageFileWriter< VectorImageType >       WriterType;
 
-    /** A pair indicating which functor should be used for an operator,
-     * and whether the arguments should be swapped.
-     */
-    typedef std::pair< BinaryFunctorEnum, bool >        BinaryOperatorType;
-    typedef std::map<std::string, BinaryOperatorType>   BinaryOperatorMapType;
-
     /** Declarations. */
     typename ReaderType::Pointer reader1 = ReaderType::New();
     typename ReaderType::Pointer reader2 = ReaderType::New();
     typename WriterType::Pointer writer = WriterType::New();
 
-    /** Available SimpleOperatorTypes are defined in itkLogicalFunctors.h:
-     * AND, OR, XOR, NOT_AND, NOT_OR, NOT_XOR, ANDNOT, ORNOT
-     *
-     * The Simplification map (simpmap) defines for every possible logical
-     * operation of the form
-     *   [not]( ([not] A) [{&,|,^} ([not] B])] )
-     * a simplified version.
-     *
-     * example1: A ^ (!B) = XORNOT(A,B) = NOT_XOR(A,B) = ! (A ^ B)
-     * example2: (!A) & B = NOTAND(A,B) = ANDNOT(B,A) = B & (!A)
-     */
-
     BinaryOperatorMapType binaryOperatorMap;
-    binaryOperatorMap["AND"]        = BinaryOperatorType(AND, false);
-    binaryOperatorMap["OR"]         = BinaryOperatorType(OR, false);
-    binaryOperatorMap["XOR"]        = BinaryOperatorType(XOR, false);
-    binaryOperatorMap["ANDNOT"]     = BinaryOperatorType(ANDNOT, false);
-    binaryOperatorMap["ORNOT"]      = BinaryOperatorType(ORNOT, false);
-    binaryOperatorMap["XORNOT"]     = BinaryOperatorType(NOT_XOR, false);
-
-    binaryOperatorMap["NOTAND"]     = BinaryOperatorType(ANDNOT, true);
-    binaryOperatorMap["NOTOR"]      = BinaryOperatorType(ORNOT, true);
-    binaryOperatorMap["NOTXOR"]     = BinaryOperatorType(NOT_XOR, false);
-
-    binaryOperatorMap["NOTANDNOT"]  = BinaryOperatorType(NOT_OR, false);
-    binaryOperatorMap["NOTORNOT"]   = BinaryOperatorType(NOT_AND, false);
-    binaryOperatorMap["NOTXORNOT"]  = BinaryOperatorType(XOR, false);
-
-    binaryOperatorMap["NOT_AND"]    = BinaryOperatorType(NOT_AND, false);
-    binaryOperatorMap["NOT_OR"]     = BinaryOperatorType(NOT_OR, false);
-    binaryOperatorMap["NOT_XOR"]    = BinaryOperatorType(NOT_XOR, false);
-    binaryOperatorMap["NOT_NOT"]    = BinaryOperatorType(DUMMY, false);
-
-    binaryOperatorMap["NOT_ANDNOT"] = BinaryOperatorType(ORNOT, true);
-    binaryOperatorMap["NOT_ORNOT"]  = BinaryOperatorType(ANDNOT, true);
-    binaryOperatorMap["NOT_XORNOT"] = BinaryOperatorType(XOR, false);
-
-    binaryOperatorMap["NOT_NOTAND"] = BinaryOperatorType(ORNOT, false);
-    binaryOperatorMap["NOT_NOTOR"]  = BinaryOperatorType(ANDNOT, false);
-    binaryOperatorMap["NOT_NOTXOR"] = BinaryOperatorType(XOR, false);
-
-    binaryOperatorMap["NOT_NOTANDNOT"] = BinaryOperatorType(OR, false);
-    binaryOperatorMap["NOT_NOTORNOT"]  = BinaryOperatorType(AND, false);
-    binaryOperatorMap["NOT_NOTXORNOT"] = BinaryOperatorType(NOT_XOR, false);
+    this->CreateBinaryOperatorMap( binaryOperatorMap );
 
     /** Read the images. */
     reader1->SetFileName( this->m_InputFileName1.c_str() );
@@ -320,6 +283,136 @@ public:
 
   } // end RunBinary()
 
+  /** CreateBinaryOperatorMap. */
+  void CreateBinaryOperatorMap( BinaryOperatorMapType & binaryOperatorMap )
+  {
+    /** Available SimpleOperatorTypes are defined in itkLogicalFunctors.h:
+     * AND, OR, XOR, NOT_AND, NOT_OR, NOT_XOR, ANDNOT, ORNOT
+     *
+     * The Simplification map (simpmap) defines for every possible logical
+     * operation of the form
+     *   [not]( ([not] A) [{&,|,^} ([not] B])] )
+     * a simplified version.
+     *
+     * example1: A ^ (!B) = XORNOT(A,B) = NOT_XOR(A,B) = ! (A ^ B)
+     * example2: (!A) & B = NOTAND(A,B) = ANDNOT(B,A) = B & (!A)
+     */
+
+    binaryOperatorMap["AND"]        = BinaryOperatorType(AND, false);
+    binaryOperatorMap["OR"]         = BinaryOperatorType(OR, false);
+    binaryOperatorMap["XOR"]        = BinaryOperatorType(XOR, false);
+    binaryOperatorMap["ANDNOT"]     = BinaryOperatorType(ANDNOT, false);
+    binaryOperatorMap["ORNOT"]      = BinaryOperatorType(ORNOT, false);
+    binaryOperatorMap["XORNOT"]     = BinaryOperatorType(NOT_XOR, false);
+
+    binaryOperatorMap["NOTAND"]     = BinaryOperatorType(ANDNOT, true);
+    binaryOperatorMap["NOTOR"]      = BinaryOperatorType(ORNOT, true);
+    binaryOperatorMap["NOTXOR"]     = BinaryOperatorType(NOT_XOR, false);
+
+    binaryOperatorMap["NOTANDNOT"]  = BinaryOperatorType(NOT_OR, false);
+    binaryOperatorMap["NOTORNOT"]   = BinaryOperatorType(NOT_AND, false);
+    binaryOperatorMap["NOTXORNOT"]  = BinaryOperatorType(XOR, false);
+
+    binaryOperatorMap["NOT_AND"]    = BinaryOperatorType(NOT_AND, false);
+    binaryOperatorMap["NOT_OR"]     = BinaryOperatorType(NOT_OR, false);
+    binaryOperatorMap["NOT_XOR"]    = BinaryOperatorType(NOT_XOR, false);
+    binaryOperatorMap["NOT_NOT"]    = BinaryOperatorType(DUMMY, false);
+
+    binaryOperatorMap["NOT_ANDNOT"] = BinaryOperatorType(ORNOT, true);
+    binaryOperatorMap["NOT_ORNOT"]  = BinaryOperatorType(ANDNOT, true);
+    binaryOperatorMap["NOT_XORNOT"] = BinaryOperatorType(XOR, false);
+
+    binaryOperatorMap["NOT_NOTAND"] = BinaryOperatorType(ORNOT, false);
+    binaryOperatorMap["NOT_NOTOR"]  = BinaryOperatorType(ANDNOT, false);
+    binaryOperatorMap["NOT_NOTXOR"] = BinaryOperatorType(XOR, false);
+
+    binaryOperatorMap["NOT_NOTANDNOT"] = BinaryOperatorType(OR, false);
+    binaryOperatorMap["NOT_NOTORNOT"]  = BinaryOperatorType(AND, false);
+    binaryOperatorMap["NOT_NOTXORNOT"] = BinaryOperatorType(NOT_XOR, false);
+
+  } // end CreateBinaryOperatorMap()
+
+  /** RunPacked. Perform the operation on bit-packed masks,
+   * 64 voxels at a time. Nonzero voxels are considered true.
+   */
+  void RunPacked( void )
+  {
+    typedef itktools::PackedMask<VDimension>          PackedMaskType;
+    typedef typename PackedMaskType::WordType         WordType;
+
+    PackedMaskType mask1, mask2, outputMask;
+
+    /** Read the masks. */
+    std::cout << "Reading mask1: " << this->m_InputFileName1 << std::endl;
+    itktools::ReadPackedMask( this->m_InputFileName1, mask1 );
+    std::cout << "Done reading mask1." << std::endl;
+
+    BinaryOperatorType logicalOperator( DUMMY, false );
+    if( this->m_Unary )
+    {
+      if( this->m_Ops != "NOT" )
+      {
+        std::cerr << "ERROR: The operator " << this->m_Ops
+          << " is not supported on packed masks." << std::endl;
+        return;
+      }
+    }
+    else
+    {
+      std::cout << "Reading mask2: " << this->m_InputFileName2 << std::endl;
+      itktools::ReadPackedMask( this->m_InputFileName2, mask2 );
+      std::cout << "Done reading mask2." << std::endl;
+
+      if( !mask1.SameSize( mask2 ) )
+      {
+        std::cerr << "ERROR: The masks do not have the same size." << std::endl;
+        return;
+      }
+
+      BinaryOperatorMapType binaryOperatorMap;
+      this->CreateBinaryOperatorMap( binaryOperatorMap );
+      if( binaryOperatorMap.count( this->m_Ops ) == 0 )
+      {
+        std::cerr << "ERROR: The desired operator is unknown: " << this->m_Ops << std::endl;
+        return;
+      }
+      logicalOperator = binaryOperatorMap[ this->m_Ops ];
+    }
+
+    std::cout
+      << "Performing logical operation, "
+      << this->m_Ops
+      << ", on packed masks..."
+      << std::endl;
+
+    outputMask.CopyInformation( mask1 );
+    const std::size_t numberOfWords = outputMask.GetWords().size();
+    if( numberOfWords != 0 )
+    {
+      const WordType * A = &mask1.GetWords()[ 0 ];
+      WordType * out = &outputMask.GetWords()[ 0 ];
+      if( this->m_Unary )
+      {
+        for( std::size_t i = 0; i < numberOfWords; ++i ) out[ i ] = ~A[ i ];
+      }
+      else
+      {
+        const WordType * B = &mask2.GetWords()[ 0 ];
+        if( logicalOperator.second ) std::swap( A, B );
+        ApplyPackedBinaryLogicalOperator( logicalOperator.first, A, B, out, numberOfWords );
+      }
+    }
+    outputMask.ClearTail();
+
+    std::cout << "Number of voxels in the output mask: "
+      << outputMask.CountNonZero() << std::endl;
+
+    /** Write the mask to disk. */
+    itktools::WritePackedMask<TComponentType>(
+      this->m_OutputFileName, outputMask, this->m_UseCompression );
+
+  } // end RunPacked()
+
 }; // end class ITKToolsLogicalImageOperator
 
 
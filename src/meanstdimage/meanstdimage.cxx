@@ -41,7 +41,7 @@ std::string GetHelpString( void )
     << "Usage:\n"
     << "pxmeanstdimage\n"
     << "  -in        list of inputFilenames\n"
-	<< "  -inMask    list of inputMaskFilenames\n"
+	<< "  -inMask    list of inputMaskFilenames, may be packed masks (.pmask)\n"
     << "  [-outmean] outputFilename for mean image; always written as float\n"
     << "  [-outstd]  outputFilename for standard deviation image; always written as float,\n"
 	<< "  [-popstd]  population standard deviation flag; if provided, use population standard deviation\n"
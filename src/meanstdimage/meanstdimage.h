@@ -21,6 +21,7 @@
 #include "ITKToolsBase.h"
 
 #include "itkImage.h"
+#include "itkMultiThreader.h"
 #include <string>
 #include <vector>
 
@@ -82,6 +83,32 @@ public:
   /** Typedef. */
   typedef itk::Image< TComponentType, VDimension >  InputImageType;
   typedef itk::Image< float, VDimension >           OutputImageType;
+  typedef typename InputImageType::Pointer          InputImagePointer;
+  typedef itk::MultiThreader::ThreadInfoStruct      ThreadInfoType;
+
+  /** Holds an input image and its mask, which are read by a separate
+   * thread while the previous image is being accumulated.
+   */
+  struct PrefetchStruct
+  {
+    std::string       InputFileName;
+    std::string       MaskFileName;
+    InputImagePointer Input;
+    InputImagePointer Mask;
+    std::string       ErrorMessage;
+  };
+
+  /** Holds the buffers for the multi-threaded accumulation. */
+  struct AccumulateStruct
+  {
+    float *                 Mean;
+    float *                 M2;
+    float *                 Count;
+    const TComponentType *  Input;
+    const TComponentType *  Mask;
+    float                   ImageCount;
+    itk::SizeValueType      NumberOfPixels;
+  };
 
   /** Run function. */
   void Run( void )
@@ -106,6 +133,19 @@ public:
     const bool calc_std, const std::string & outputFileNameStd,
 	const bool population_std, const bool use_compression);
 
+  /** Read an input image and optionally its mask. Errors are stored in
+   * the struct, since this function may be called from the prefetch thread.
+   */
+  static void ReadInput( PrefetchStruct & input );
+
+  /** Thread callback that reads the next input. */
+  static ITK_THREAD_RETURN_TYPE PrefetchCallback( void * arg );
+
+  /** Thread callback that updates the running mean and M2 with a
+   * contiguous part of an image.
+   */
+  static ITK_THREAD_RETURN_TYPE AccumulateCallback( void * arg );
+
 }; // end class MeanStdImage
 
 #include "meanstdimage.hxx"
@@ -20,6 +20,10 @@
 
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
+#include "ITKToolsPackedMask.h"
+
+#include <cmath>
+#include <sstream>
 
 template< unsigned int VDimension, class TComponentType >
 void
@@ -35,197 +39,251 @@ ITKToolsMeanStdImage< VDimension, TComponentType >
   const bool use_compression)
 {
   /** TYPEDEF's. */
-  typedef typename InputImageType::Pointer              ImagePointer;
   typedef typename OutputImageType::Pointer             OutImagePointer;
-  typedef itk::ImageFileReader< InputImageType >        ReaderType;
   typedef itk::ImageFileWriter< OutputImageType >       WriterType;
-  typedef typename InputImageType::PixelType            PixelType;
-  typedef typename ReaderType::Pointer                  ReaderPointer;
   typedef typename WriterType::Pointer                  WriterPointer;
 
   /** DECLARATION'S. */
   const unsigned int nrInputs = inputFileNames.size();
   const unsigned int nrMasks = inputMaskFileNames.size();
-  
-  ReaderPointer inReader;
-  ReaderPointer inMaskReader;
-  WriterPointer writer_mean = WriterType::New();
-  WriterPointer writer_std = WriterType::New();
-  
+  if( nrInputs == 0 ) return;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  itk::MultiThreader::Pointer prefetcher = itk::MultiThreader::New();
+
+  /** Read the first image. */
+  PrefetchStruct current;
+  current.InputFileName = inputFileNames[ 0 ];
+  if( nrMasks != 0 ) current.MaskFileName = inputMaskFileNames[ 0 ];
+  ReadInput( current );
+  if( current.ErrorMessage != "" )
+  {
+    itkGenericExceptionMacro( << current.ErrorMessage );
+  }
+
+  /** Create the running mean, the running sum of squared deviations M2,
+   * and, if masks are used, the number of images per voxel.
+   * The output std image reuses the M2 buffer.
+   */
   OutImagePointer mean = OutputImageType::New();
-  OutImagePointer sq_mean = OutputImageType::New();
   OutImagePointer std = OutputImageType::New();
   OutImagePointer nr_images = OutputImageType::New();
-  
-  itk::ImageRegionConstIterator<InputImageType> input_iterator;
-  itk::ImageRegionConstIterator<InputImageType> mask_iterator;
-  itk::ImageRegionIterator<OutputImageType> mean_iterator;
-  itk::ImageRegionIterator<OutputImageType> sq_mean_iterator;
-  itk::ImageRegionIterator<OutputImageType> std_iterator;
-  itk::ImageRegionIterator<OutputImageType> nr_images_iterator;
-
-  /** Create temporary & output images */
-  inReader = ReaderType::New();
-  inReader->SetFileName( inputFileNames[0].c_str() );
-  inReader->Update();
-
-  mean->CopyInformation( inReader->GetOutput() );
-  sq_mean->CopyInformation( inReader->GetOutput() );
-  std->CopyInformation( inReader->GetOutput() );
-
-  mean->SetRegions( inReader->GetOutput()->GetLargestPossibleRegion().GetSize() );
-  sq_mean->SetRegions( inReader->GetOutput()->GetLargestPossibleRegion().GetSize() );
-  std->SetRegions( inReader->GetOutput()->GetLargestPossibleRegion().GetSize() );
 
+  mean->CopyInformation( current.Input );
+  mean->SetRegions( current.Input->GetLargestPossibleRegion().GetSize() );
   mean->Allocate();
-  sq_mean->Allocate();
-  std->Allocate();
-
   mean->FillBuffer( 0.0 );
-  sq_mean->FillBuffer( 0.0 );
+
+  std->CopyInformation( current.Input );
+  std->SetRegions( current.Input->GetLargestPossibleRegion().GetSize() );
+  std->Allocate();
   std->FillBuffer( 0.0 );
-  
-  mean_iterator = itk::ImageRegionIterator<OutputImageType>( mean, mean->GetRequestedRegion() );
-  sq_mean_iterator = itk::ImageRegionIterator<OutputImageType>( sq_mean, sq_mean->GetRequestedRegion() );
-  std_iterator = itk::ImageRegionIterator<OutputImageType>( std, std->GetRequestedRegion() );
-  
-  /** Checking if there are masks and initialising the iterator*/
-  if (nrMasks != 0 )
+
+  if( nrMasks != 0 )
   {
-    inMaskReader = ReaderType::New();
-    inMaskReader->SetFileName( inputMaskFileNames[0].c_str() );
-    inMaskReader->Update();
-	
-    nr_images->CopyInformation( inReader->GetOutput() );
-    nr_images->SetRegions( inReader->GetOutput()->GetLargestPossibleRegion().GetSize() );
+    nr_images->CopyInformation( current.Input );
+    nr_images->SetRegions( current.Input->GetLargestPossibleRegion().GetSize() );
     nr_images->Allocate();
-    nr_images->FillBuffer(0);
-	nr_images_iterator = itk::ImageRegionIterator<OutputImageType>( nr_images, nr_images->GetRequestedRegion() );
+    nr_images->FillBuffer( 0.0 );
   }
-  /** Loop over all images and create sum(X) and sum(X^2) which is required for E(X) and E(X^2) */
+  const itk::SizeValueType numberOfPixels
+    = mean->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  /** Loop over all images and update the mean and M2 with Welford's method,
+   * while the next image is read on a separate thread.
+   */
   for( unsigned int i = 0; i < nrInputs; ++i )
   {
-    std::cout << "Reading image " << inputFileNames[ i ].c_str() << std::endl;
-    inReader = ReaderType::New();
-    inReader->SetFileName( inputFileNames[ i ].c_str() );
-    inReader->Update();
-	
-    input_iterator = itk::ImageRegionConstIterator<InputImageType>(
-      inReader->GetOutput(), inReader->GetOutput()->GetRequestedRegion() );	
-	  
-    input_iterator.GoToBegin();
-    mean_iterator.GoToBegin();
-    sq_mean_iterator.GoToBegin();
-	
-	/** Reading the masks if needed*/
-	if (nrMasks != 0 )
-	{
-	  std::cout << "Reading mask " << inputMaskFileNames[ i ].c_str() << std::endl;
-	  inMaskReader = ReaderType::New();
-      inMaskReader->SetFileName( inputMaskFileNames[ i ].c_str() );
-      inMaskReader->Update();
-	  
-
-	  mask_iterator = itk::ImageRegionConstIterator<InputImageType>(
-        inMaskReader->GetOutput(), inMaskReader->GetOutput()->GetRequestedRegion() );
-
-	  mask_iterator.GoToBegin();
-	  nr_images_iterator.GoToBegin();
-	}
-	/** Create two maps for calculating the mean and std: sum(X) and sum(X^2) */
-    for (; !mean_iterator.IsAtEnd(); ++mean_iterator, ++sq_mean_iterator, ++input_iterator)
-    {	
-      /** Calculating the mean if there are no masks or if the mask is not zero in current voxel*/  	
-	  if (nrMasks == 0 || mask_iterator.Get() !=0)
-	  {
-	    mean_iterator.Set( mean_iterator.Get() + input_iterator.Get() );
-	    if( calc_std )
-  	      sq_mean_iterator.Set( sq_mean_iterator.Get() + (input_iterator.Get() * input_iterator.Get()) );
-
-	  }
-	  if (nrMasks != 0)
-	  {
-	    /** If masks are used, the number of the images used for the mean for each voxel is updated*/
-	    if (mask_iterator.Get() != 0 )
-		{
-		  nr_images_iterator.Set( nr_images_iterator.Get() + 1);
-		}  
-		/** Update iterators if we are in fact using masks*/
-		++mask_iterator;
-		++nr_images_iterator;
-	  }
-	}
+    if( current.ErrorMessage != "" )
+    {
+      itkGenericExceptionMacro( << current.ErrorMessage );
+    }
+    if( current.Input->GetLargestPossibleRegion().GetSize()
+      != mean->GetLargestPossibleRegion().GetSize()
+      || ( nrMasks != 0 && current.Mask->GetLargestPossibleRegion().GetSize()
+      != mean->GetLargestPossibleRegion().GetSize() ) )
+    {
+      itkGenericExceptionMacro( << "ERROR: The size of " << current.InputFileName
+        << " or its mask differs from the first image!" );
+    }
+
+    /** Start reading the next image. */
+    PrefetchStruct next;
+    int prefetchThreadId = -1;
+    if( i + 1 < nrInputs )
+    {
+      next.InputFileName = inputFileNames[ i + 1 ];
+      if( nrMasks != 0 ) next.MaskFileName = inputMaskFileNames[ i + 1 ];
+      prefetchThreadId = prefetcher->SpawnThread( PrefetchCallback, &next );
+    }
+
+    /** Accumulate the current image. */
+    std::cout << "Adding image " << current.InputFileName.c_str() << std::endl;
+    AccumulateStruct str;
+    str.Mean = mean->GetBufferPointer();
+    str.M2 = std->GetBufferPointer();
+    str.Count = nrMasks != 0 ? nr_images->GetBufferPointer() : 0;
+    str.Input = current.Input->GetBufferPointer();
+    str.Mask = nrMasks != 0 ? current.Mask->GetBufferPointer() : 0;
+    str.ImageCount = static_cast<float>( i + 1 );
+    str.NumberOfPixels = numberOfPixels;
+    threader->SetSingleMethod( AccumulateCallback, &str );
+    threader->SingleMethodExecute();
+
+    /** Wait for the next image, and release the current one. */
+    if( prefetchThreadId >= 0 )
+    {
+      prefetcher->TerminateThread( prefetchThreadId );
+    }
+    current = next;
   }
 
-  /** Calculate mean and standard deviation using:
-      mean = ( SUM(X) / N )
-      std  = sqrt( E(X^2) - (E(X))^2 ) for population standard deviation
-      std  = sqrt(N / (N-1)) * sqrt( E(X^2) - (E(X))^2 ) for sample standard deviation
+  /** Calculate the standard deviation from M2:
+      std = sqrt( M2 / N )       for population standard deviation
+      std = sqrt( M2 / (N - 1) ) for sample standard deviation
+    Voxels with too few images get a standard deviation of zero.
   */
-  mean_iterator.GoToBegin();
-  sq_mean_iterator.GoToBegin();
-  std_iterator.GoToBegin();
-  nr_images_iterator.GoToBegin();
-  
-  /** Denominator for the 1/N calculations and sample_std_factor N/(N-1) to get sample std from population std */
-  float denominator( 1.0f / nrInputs );
-  float sample_std_factor = std::sqrt(((float) nrInputs) / ((float) nrInputs - 1));
-
-  for (; !mean_iterator.IsAtEnd(); ++mean_iterator, ++sq_mean_iterator, ++std_iterator)
+  if( calc_std )
   {
-    if (nrMasks != 0)
-	{
-	  if (nr_images_iterator.Get() > 1)
-	  {
-	    denominator = 1 / nr_images_iterator.Get();
-	    sample_std_factor = std::sqrt(((float) nr_images_iterator.Get()) / ((float) nr_images_iterator.Get() - 1));
-	  }
-	  else
-	  {
-	    denominator = nr_images_iterator.Get();
-	    sample_std_factor = 0;
-	  }
-	  ++nr_images_iterator;
-	}
-	
-	/** Calculate mean and mean of squares */
-	mean_iterator.Set( denominator * mean_iterator.Get() );
-	sq_mean_iterator.Set( denominator * sq_mean_iterator.Get() );
-	
-	/** Calculate standard deviation */
-	
-	if (calc_std)
-	{
-	  if (population_std) // Calculate either sample or population standard deviation
-	  { 
-	    std_iterator.Set( std::sqrt(
-	      (float) std::abs( sq_mean_iterator.Get() - (mean_iterator.Get() * mean_iterator.Get() ) ) ) );
-	  } 
-	  else
-	  {
-	    std_iterator.Set( sample_std_factor * std::sqrt(
-	      (float) std::abs( sq_mean_iterator.Get() - (mean_iterator.Get() * mean_iterator.Get() ) ) ) );
-	  }
-	}
+    float * m2 = std->GetBufferPointer();
+    const float * count = nrMasks != 0 ? nr_images->GetBufferPointer() : 0;
+    for( itk::SizeValueType j = 0; j < numberOfPixels; ++j )
+    {
+      const float n = count ? count[ j ] : static_cast<float>( nrInputs );
+      const float denominator = population_std ? n : n - 1.0f;
+      m2[ j ] = denominator > 0.0f ? std::sqrt( m2[ j ] / denominator ) : 0.0f;
+    }
   }
-  
+
   /** Write the output images */
   if( calc_mean )
   {
+    WriterPointer writer_mean = WriterType::New();
     writer_mean->SetFileName( outputFileNameMean.c_str() );
     writer_mean->SetInput( mean );
-	writer_mean->SetUseCompression( use_compression );
+    writer_mean->SetUseCompression( use_compression );
     writer_mean->Update();
   }
 
   if( calc_std )
   {
+    WriterPointer writer_std = WriterType::New();
     writer_std->SetFileName( outputFileNameStd.c_str() );
     writer_std->SetInput( std );
-	writer_std->SetUseCompression( use_compression );
+    writer_std->SetUseCompression( use_compression );
     writer_std->Update();
   }
 
 } // end MeanStdImage()
 
+
+/**
+ * ******************* ReadInput *******************
+ */
+
+template< unsigned int VDimension, class TComponentType >
+void
+ITKToolsMeanStdImage< VDimension, TComponentType >
+::ReadInput( PrefetchStruct & input )
+{
+  try
+  {
+    typedef itk::ImageFileReader< InputImageType > ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( input.InputFileName.c_str() );
+    reader->Update();
+    input.Input = reader->GetOutput();
+    input.Input->DisconnectPipeline();
+
+    if( input.MaskFileName != "" )
+    {
+      input.Mask = itktools::ReadMaskImage<InputImageType>( input.MaskFileName );
+    }
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::ostringstream message;
+    message << excp;
+    input.ErrorMessage = message.str();
+  }
+
+} // end ReadInput()
+
+
+/**
+ * ******************* PrefetchCallback *******************
+ */
+
+template< unsigned int VDimension, class TComponentType >
+ITK_THREAD_RETURN_TYPE
+ITKToolsMeanStdImage< VDimension, TComponentType >
+::PrefetchCallback( void * arg )
+{
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  PrefetchStruct * input = static_cast<PrefetchStruct *>( info->UserData );
+  ReadInput( *input );
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end PrefetchCallback()
+
+
+/**
+ * ******************* AccumulateCallback *******************
+ */
+
+template< unsigned int VDimension, class TComponentType >
+ITK_THREAD_RETURN_TYPE
+ITKToolsMeanStdImage< VDimension, TComponentType >
+::AccumulateCallback( void * arg )
+{
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  const AccumulateStruct * str
+    = static_cast<AccumulateStruct *>( info->UserData );
+
+  const itk::SizeValueType chunk = str->NumberOfPixels / info->NumberOfThreads;
+  const itk::SizeValueType begin = info->ThreadID * chunk;
+  const itk::SizeValueType end = ( info->ThreadID == info->NumberOfThreads - 1 )
+    ? str->NumberOfPixels : begin + chunk;
+
+  float * mean = str->Mean;
+  float * m2 = str->M2;
+  const TComponentType * input = str->Input;
+
+  /** Welford's update: with n the number of values including x,
+   *   delta = x - mean, mean += delta / n, M2 += delta * (x - mean).
+   */
+  if( str->Mask == 0 )
+  {
+    const double n = str->ImageCount;
+    for( itk::SizeValueType j = begin; j < end; ++j )
+    {
+      const double x = static_cast<double>( input[ j ] );
+      const double delta = x - mean[ j ];
+      const double newMean = mean[ j ] + delta / n;
+      m2[ j ] += static_cast<float>( delta * ( x - newMean ) );
+      mean[ j ] = static_cast<float>( newMean );
+    }
+  }
+  else
+  {
+    const TComponentType * mask = str->Mask;
+    float * count = str->Count;
+    for( itk::SizeValueType j = begin; j < end; ++j )
+    {
+      if( mask[ j ] == 0 ) continue;
+
+      const double n = count[ j ] + 1.0;
+      const double x = static_cast<double>( input[ j ] );
+      const double delta = x - mean[ j ];
+      const double newMean = mean[ j ] + delta / n;
+      m2[ j ] += static_cast<float>( delta * ( x - newMean ) );
+      mean[ j ] = static_cast<float>( newMean );
+      count[ j ] = static_cast<float>( n );
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end AccumulateCallback()
+
 #endif // end #ifndef __meanstdimage_hxx_
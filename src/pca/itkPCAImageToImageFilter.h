@@ -24,6 +24,7 @@
 #include "itkImageToImageFilter.h"
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
 
 
 namespace itk
@@ -43,6 +44,18 @@ namespace itk
  * to perform some matrix manipulations. This filter gives the same output
  * as the Matlab function princomp.
  *
+ * The mean and the covariance matrix are accumulated in two passes over
+ * blocks of pixels, and the principal components are written block by
+ * block to the outputs. The centered data is never stored as a whole,
+ * so apart from the inputs and outputs the memory use only depends on
+ * the number of feature images and the block size. The passes are
+ * multi-threaded; each thread sums into its own covariance matrix.
+ *
+ * A previously fitted model, i.e. the mean of the feature images and the
+ * eigen values and vectors, can be set with SetModel(). The filter then
+ * skips the analysis and only projects the inputs on the eigen vectors,
+ * in a single pass over the pixels.
+ *
  * \ingroup ??
  */
 
@@ -98,6 +111,29 @@ public:
   virtual void SetNumberOfPrincipalComponentsRequired( unsigned int n );
   itkGetConstMacro( NumberOfPrincipalComponentsRequired, unsigned int );
 
+  /** Set/Get the number of pixels that is processed at once by a thread.
+   * Default 4096.
+   */
+  itkSetClampMacro( BlockSize, unsigned long, 1, NumericTraits<unsigned long>::max() );
+  itkGetConstMacro( BlockSize, unsigned long );
+
+  /** Set a fitted model, so that the inputs are only projected on it.
+   * The mean has one entry per feature image, the eigen vectors are
+   * the columns of a square matrix, sorted by decreasing eigen value.
+   */
+  virtual void SetModel( const VectorOfDoubleType & mean,
+    const VectorOfDoubleType & eigenValues,
+    const MatrixOfDoubleType & eigenVectors );
+
+  /** Forget the model set with SetModel(), and fit a new one. */
+  virtual void ClearModel( void );
+
+  /** Get whether a model was set with SetModel(). */
+  itkGetConstMacro( UseModel, bool );
+
+  /** Get the mean of the feature images. */
+  itkGetConstReferenceMacro( MeanOfFeatureImages, VectorOfDoubleType );
+
   /** Get the eigen values. */
   itkGetConstReferenceMacro( EigenValues, VectorOfDoubleType );
 
@@ -146,23 +182,58 @@ private:
   /** Private functions to perform the PCA. */
   virtual void PerformPCA( void );
   virtual void CalculateMeanOfFeatureImages( void );
-  virtual void CenterFeatureImages( void );
   virtual void CalculateCovarianceMatrix( void );
   virtual void PerformEigenAnalysis( void );
+  virtual void ComputePrincipalComponents( void );
+
+  /** The passes over the pixels, that are split over the threads. */
+  typedef enum {
+    MeanStep,
+    CovarianceStep,
+    PrincipalComponentsStep
+  } ThreadStepType;
+
+  struct ThreadStruct
+  {
+    Self *          Filter;
+    ThreadStepType  Step;
+  };
+
+  /** Run a pass, splitting the blocks of pixels over the threads. */
+  void ExecuteStep( ThreadStepType step );
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void * arg );
+
+  /** Copy the pixels of a block to the rows of a matrix, minus the mean.
+   * Rows beyond the end of the image are set to zero.
+   */
+  void GetCenteredBlock( unsigned long block, MatrixOfDoubleType & centered ) const;
+
+  /** The passes for a range of blocks. */
+  void ThreadedCalculateMean( unsigned long begin, unsigned long end, ThreadIdType threadId );
+  void ThreadedCalculateCovariance( unsigned long begin, unsigned long end, ThreadIdType threadId );
+  void ThreadedComputePrincipalComponents( unsigned long begin, unsigned long end );
 
   /** Private variables to store results. */
   VectorOfDoubleType    m_MeanOfFeatureImages;
-  MatrixOfDoubleType    m_CenteredFeatureImages;
 
   MatrixOfDoubleType    m_CovarianceMatrix;
   MatrixOfDoubleType    m_EigenVectors;
   VectorOfDoubleType    m_EigenValues;
   VectorOfDoubleType    m_NormalisedEigenValues;
-  MatrixOfDoubleType    m_PrincipalComponents;
 
   unsigned int          m_NumberOfPixels;
   unsigned int          m_NumberOfFeatureImages;
   unsigned int          m_NumberOfPrincipalComponentsRequired;
+  unsigned long         m_BlockSize;
+  bool                  m_UseModel;
+
+  /** Temporaries of the passes: the buffers and per thread partial sums. */
+  std::vector< const InputImagePixelType * >  m_InputBuffers;
+  std::vector< OutputImagePixelType * >       m_OutputBuffers;
+  std::vector< VectorOfDoubleType >           m_ThreadSums;
+  std::vector< MatrixOfDoubleType >           m_ThreadCovarianceMatrices;
 
 }; // end class PCAImageToImageFilter
 
@@ -23,6 +23,7 @@
 #include "vnl/vnl_math.h"
 #include <vnl/algo/vnl_symmetric_eigensystem.h>
 #include <vnl/vnl_fastops.h>
+#include <algorithm>
 
 namespace itk
 {
@@ -36,17 +37,17 @@ namespace itk
     ::PCAImageToImageFilter( void )
   {
     this->m_MeanOfFeatureImages.set_size( 0 );
-    this->m_CenteredFeatureImages.set_size( 0, 0 );
 
     this->m_CovarianceMatrix.set_size( 0, 0 );
     this->m_EigenVectors.set_size( 0, 0 );
     this->m_EigenValues.set_size( 0 );
     this->m_NormalisedEigenValues.set_size( 0 );
-    this->m_PrincipalComponents.set_size( 0, 0 );
 
     this->m_NumberOfPixels = 0;
     this->m_NumberOfFeatureImages = 0;
     this->m_NumberOfPrincipalComponentsRequired = 0;
+    this->m_BlockSize = 4096;
+    this->m_UseModel = false;
 
   } // end Constructor()
 
@@ -195,6 +196,54 @@ namespace itk
   } // end SetNumberOfFeatureImages()
 
 
+  /**
+   * ********************* SetModel ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::SetModel( const VectorOfDoubleType & mean,
+      const VectorOfDoubleType & eigenValues,
+      const MatrixOfDoubleType & eigenVectors )
+  {
+    const unsigned int n = mean.size();
+    if( eigenValues.size() != n || eigenVectors.rows() != n || eigenVectors.cols() != n )
+    {
+      itkExceptionMacro( << "The model should have as many eigen values and "
+        << "square eigen vector matrix dimensions as means (" << n << ")" );
+    }
+
+    this->m_MeanOfFeatureImages = mean;
+    this->m_EigenValues = eigenValues;
+    this->m_EigenVectors = eigenVectors;
+    this->m_NormalisedEigenValues = eigenValues;
+    this->m_NormalisedEigenValues.normalize();
+    this->m_CovarianceMatrix.set_size( 0, 0 );
+    this->m_UseModel = true;
+    this->Modified();
+
+  } // end SetModel()
+
+
+  /**
+   * ********************* ClearModel ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ClearModel( void )
+  {
+    if( this->m_UseModel )
+    {
+      this->m_UseModel = false;
+      this->Modified();
+    }
+
+  } // end ClearModel()
+
+
   /**
    * ********************* GenerateData ****************************
    */
@@ -207,7 +256,7 @@ namespace itk
     /** Do the principal component analysis. */
     this->PerformPCA();
 
-    /** Allocate memory for each output. ??Why here? */
+    /** Allocate memory for each output. */
     unsigned int numberOfOutputs =
       static_cast<unsigned int>( this->GetNumberOfOutputs() );
 
@@ -218,32 +267,10 @@ namespace itk
       output->Allocate();
     }
 
-    /** Create the output images. This is a matter of converting
-     * the vnl_matrix of principal components to images.
+    /** Create the output images, by projecting the centered
+     * feature images on the eigen vectors, block by block.
      */
-    for( unsigned int i = 0; i < numberOfOutputs; ++i )
-    {
-      /** Extract one column vector at a time. This is faster
-       * than extracting the column every time, but comes at
-       * the cost of some additional memory use.
-       */
-
-      /** Create iterator. */
-      OutputImageIterator iter( this->GetOutput( i ), this->GetOutput( i )->GetRequestedRegion() );
-      iter.GoToBegin();
-      unsigned int pix = 0;
-
-      /** Fill this output with a principal component. */
-      while ( !iter.IsAtEnd() )
-      {
-        iter.Set( static_cast< OutputImagePixelType >( this->m_PrincipalComponents[ pix ][ i ] ) );
-        ++iter;
-        ++pix;
-      }
-    }
-
-    /** Maybe remove principal components? */
-    //this->m_PrincipalComponents.set_size( 0, 0 );
+    this->ComputePrincipalComponents();
 
   } // end GenerateData()
 
@@ -260,9 +287,35 @@ namespace itk
     /** Get the number of pixels. */
     this->m_NumberOfPixels = this->GetInput( 0 )->GetBufferedRegion().GetNumberOfPixels();
 
+    /** The passes read the input buffers directly. */
+    const typename InputImageType::SizeType size
+      = this->GetInput( 0 )->GetBufferedRegion().GetSize();
+    this->m_InputBuffers.resize( this->m_NumberOfFeatureImages );
+    for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; ++i )
+    {
+      if( this->GetInput( i )->GetBufferedRegion().GetSize() != size )
+      {
+        itkExceptionMacro( << "The buffered region of input " << i
+          << " does not have the size of the buffered region of input 0" );
+      }
+      this->m_InputBuffers[ i ] = this->GetInput( i )->GetBufferPointer();
+    }
+
     this->CheckNumberOfOutputs();
+
+    /** With a fitted model only the projection remains. */
+    if( this->m_UseModel )
+    {
+      if( this->m_MeanOfFeatureImages.size() != this->m_NumberOfFeatureImages )
+      {
+        itkExceptionMacro( << "The model has " << this->m_MeanOfFeatureImages.size()
+          << " feature images, but the number of inputs is "
+          << this->m_NumberOfFeatureImages );
+      }
+      return;
+    }
+
     this->CalculateMeanOfFeatureImages();
-    this->CenterFeatureImages();
     this->CalculateCovarianceMatrix();
     this->PerformEigenAnalysis();
 
@@ -309,79 +362,25 @@ namespace itk
     PCAImageToImageFilter< TInputImage, TOutputImage >
     ::CalculateMeanOfFeatureImages( void )
   {
-    /** Get pointers to the input and setup iterators. */
-    std::vector< InputImageConstPointer >   inputImages( this->m_NumberOfFeatureImages );
-    std::vector< InputImageConstIterator >  iterators( this->m_NumberOfFeatureImages );
-
-    for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; i++ )
-    {
-      inputImages[ i ] = this->GetInput( i );
+    /** Each thread sums a range of blocks. */
+    const unsigned int numberOfThreads = this->GetNumberOfThreads();
+    this->m_ThreadSums.assign( numberOfThreads,
+      VectorOfDoubleType( this->m_NumberOfFeatureImages, 0.0 ) );
+    this->ExecuteStep( MeanStep );
 
-      iterators[ i ] = InputImageConstIterator(
-        inputImages[ i ], inputImages[ i ]->GetBufferedRegion() );
-      iterators[ i ].GoToBegin();
-    }
-
-    /** Calculate for each training image its mean. */
+    /** Combine the sums of the threads. */
     this->m_MeanOfFeatureImages.set_size( this->m_NumberOfFeatureImages );
     this->m_MeanOfFeatureImages.fill( 0.0 );
-
-    for( unsigned int im = 0; im < this->m_NumberOfFeatureImages; ++im )
+    for( unsigned int i = 0; i < numberOfThreads; ++i )
     {
-      for( unsigned int pix = 0; pix < this->m_NumberOfPixels; pix++ )
-      {
-        this->m_MeanOfFeatureImages[ im ] += iterators[ im ].Get();
-        ++iterators[ im ];
-      }
+      this->m_MeanOfFeatureImages += this->m_ThreadSums[ i ];
     }
     this->m_MeanOfFeatureImages /= this->m_NumberOfPixels;
+    this->m_ThreadSums.clear();
 
   } // end CalculateMeanOfFeatureImages()
 
 
-  /**
-   * ********************* CenterFeatureImages ****************************
-   */
-
-  template< class TInputImage, class TOutputImage >
-    void
-    PCAImageToImageFilter< TInputImage, TOutputImage >
-    ::CenterFeatureImages( void )
-  {
-    /** Get pointers to the input and setup iterators. */
-    std::vector< InputImageConstIterator >  iterators( this->m_NumberOfFeatureImages );
-
-    for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; i++ )
-    {
-      iterators[ i ] = InputImageConstIterator(
-        this->GetInput( i ), this->GetInput( i )->GetBufferedRegion() );
-      iterators[ i ].GoToBegin();
-    }
-
-    /** Set the proper size of the centered training images. */
-    this->m_CenteredFeatureImages.set_size(
-      this->m_NumberOfPixels, this->m_NumberOfFeatureImages );
-
-    /** Center the training images by subtracting the mean. */
-    for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; ++i )
-    {
-      for( unsigned int pix = 0; pix < this->m_NumberOfPixels; pix++ )
-      {
-
-        this->m_CenteredFeatureImages[ pix ][ i ] =
-          (iterators[ i ]).Get() - this->m_MeanOfFeatureImages[ i ];
-        ++iterators[ i ];
-      }
-    }
-
-    /** TODO: Try to remove the input images, for memory efficiency.
-     * However, this also depends on other references to the input.
-     * We could try an InPlaceImageFilter.
-     */
-
-  } // end CenterFeatureImages()
-
-
   /**
    * ********************* CalculateCovarianceMatrix ****************************
    */
@@ -392,13 +391,24 @@ namespace itk
     ::CalculateCovarianceMatrix( void )
   {
     /** Calculate the inner product of the centered training data.
-     * The slow and memory consuming alternative is:
-     * this->m_CovarianceMatrix =
-     *   this->m_CenteredTrainingImages.transpose() *
-     *   this->m_CenteredTrainingImages;
-     * The vnl function AtA is fast and memory efficient.
+     * Each thread adds the inner products of its blocks to its own
+     * matrix, so that the centered data is never stored as a whole.
      */
-    vnl_fastops::AtA( this->m_CovarianceMatrix, this->m_CenteredFeatureImages );
+    const unsigned int numberOfThreads = this->GetNumberOfThreads();
+    this->m_ThreadCovarianceMatrices.assign( numberOfThreads,
+      MatrixOfDoubleType( this->m_NumberOfFeatureImages,
+        this->m_NumberOfFeatureImages, 0.0 ) );
+    this->ExecuteStep( CovarianceStep );
+
+    /** Combine the matrices of the threads. */
+    this->m_CovarianceMatrix.set_size(
+      this->m_NumberOfFeatureImages, this->m_NumberOfFeatureImages );
+    this->m_CovarianceMatrix.fill( 0.0 );
+    for( unsigned int i = 0; i < numberOfThreads; ++i )
+    {
+      this->m_CovarianceMatrix += this->m_ThreadCovarianceMatrices[ i ];
+    }
+    this->m_ThreadCovarianceMatrices.clear();
 
     /** Divide. */
     if( this->m_NumberOfPixels != 1 )
@@ -437,16 +447,224 @@ namespace itk
     this->m_NormalisedEigenValues = this->m_EigenValues;
     this->m_NormalisedEigenValues.normalize();
 
-    /** Calculate the principal components.
-     * This is done by multiplying the training data with the eigen vectors.
+  } // end PerformEigenAnalysis()
+
+
+  /**
+   * ********************* ComputePrincipalComponents ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ComputePrincipalComponents( void )
+  {
+    /** Get the output buffers. The outputs have the size of the inputs. */
+    const unsigned int numberOfOutputs =
+      static_cast<unsigned int>( this->GetNumberOfOutputs() );
+    this->m_OutputBuffers.resize( numberOfOutputs );
+    for( unsigned int i = 0; i < numberOfOutputs; ++i )
+    {
+      if( this->GetOutput( i )->GetBufferedRegion().GetNumberOfPixels()
+        != this->m_NumberOfPixels )
+      {
+        itkExceptionMacro( << "The buffered region of output " << i
+          << " does not have the size of the buffered region of input 0" );
+      }
+      this->m_OutputBuffers[ i ] = this->GetOutput( i )->GetBufferPointer();
+    }
+
+    /** Calculate the principal components. This is done by multiplying
+     * the centered training data with the eigen vectors, block by block.
      */
-    this->m_PrincipalComponents =
-      this->m_CenteredFeatureImages * this->m_EigenVectors;
+    this->ExecuteStep( PrincipalComponentsStep );
 
-    /** The CenteredFeatureImages can now be removed for memory efficiency. */
-    this->m_CenteredFeatureImages.set_size( 0, 0 );
+    this->m_InputBuffers.clear();
+    this->m_OutputBuffers.clear();
 
-  } // end PerformEigenAnalysis()
+  } // end ComputePrincipalComponents()
+
+
+  /**
+   * ********************* ExecuteStep ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ExecuteStep( ThreadStepType step )
+  {
+    ThreadStruct str;
+    str.Filter = this;
+    str.Step = step;
+
+    this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->GetMultiThreader()->SetSingleMethod( ThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+
+  } // end ExecuteStep()
+
+
+  /**
+   * ********************* ThreaderCallback ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    ITK_THREAD_RETURN_TYPE
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ThreaderCallback( void * arg )
+  {
+    typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+    ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+    ThreadStruct * str = static_cast<ThreadStruct *>( info->UserData );
+    const ThreadIdType threadId = info->ThreadID;
+    const ThreadIdType numberOfThreads = info->NumberOfThreads;
+
+    /** Each thread gets a contiguous range of blocks. */
+    const unsigned long blockSize = str->Filter->m_BlockSize;
+    const unsigned long numberOfBlocks
+      = ( str->Filter->m_NumberOfPixels + blockSize - 1 ) / blockSize;
+    const unsigned long begin = threadId * numberOfBlocks / numberOfThreads;
+    const unsigned long end = ( threadId + 1 ) * numberOfBlocks / numberOfThreads;
+    if( begin >= end ) return ITK_THREAD_RETURN_VALUE;
+
+    switch( str->Step )
+    {
+      case MeanStep:
+        str->Filter->ThreadedCalculateMean( begin, end, threadId );
+        break;
+      case CovarianceStep:
+        str->Filter->ThreadedCalculateCovariance( begin, end, threadId );
+        break;
+      case PrincipalComponentsStep:
+        str->Filter->ThreadedComputePrincipalComponents( begin, end );
+        break;
+    }
+
+    return ITK_THREAD_RETURN_VALUE;
+
+  } // end ThreaderCallback()
+
+
+  /**
+   * ********************* GetCenteredBlock ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::GetCenteredBlock( unsigned long block, MatrixOfDoubleType & centered ) const
+  {
+    const unsigned long first = block * this->m_BlockSize;
+    const unsigned long last = vnl_math_min(
+      first + this->m_BlockSize, static_cast<unsigned long>( this->m_NumberOfPixels ) );
+
+    /** Copy feature image by feature image, reading each buffer contiguously. */
+    for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; ++i )
+    {
+      const InputImagePixelType * buffer = this->m_InputBuffers[ i ];
+      const double mean = this->m_MeanOfFeatureImages[ i ];
+      unsigned long row = 0;
+      for( unsigned long pix = first; pix < last; ++pix, ++row )
+      {
+        centered[ row ][ i ] = static_cast<double>( buffer[ pix ] ) - mean;
+      }
+      for( ; row < centered.rows(); ++row )
+      {
+        centered[ row ][ i ] = 0.0;
+      }
+    }
+
+  } // end GetCenteredBlock()
+
+
+  /**
+   * ********************* ThreadedCalculateMean ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ThreadedCalculateMean( unsigned long begin, unsigned long end, ThreadIdType threadId )
+  {
+    VectorOfDoubleType & sums = this->m_ThreadSums[ threadId ];
+    const unsigned long first = begin * this->m_BlockSize;
+    const unsigned long last = vnl_math_min(
+      end * this->m_BlockSize, static_cast<unsigned long>( this->m_NumberOfPixels ) );
+
+    for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; ++i )
+    {
+      const InputImagePixelType * buffer = this->m_InputBuffers[ i ];
+      double sum = 0.0;
+      for( unsigned long pix = first; pix < last; ++pix )
+      {
+        sum += buffer[ pix ];
+      }
+      sums[ i ] = sum;
+    }
+
+  } // end ThreadedCalculateMean()
+
+
+  /**
+   * ********************* ThreadedCalculateCovariance ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ThreadedCalculateCovariance( unsigned long begin, unsigned long end, ThreadIdType threadId )
+  {
+    MatrixOfDoubleType & covariance = this->m_ThreadCovarianceMatrices[ threadId ];
+    MatrixOfDoubleType centered( this->m_BlockSize, this->m_NumberOfFeatureImages );
+
+    /** The zero rows of the last block do not contribute. */
+    for( unsigned long block = begin; block < end; ++block )
+    {
+      this->GetCenteredBlock( block, centered );
+      vnl_fastops::inc_X_by_AtA( covariance, centered );
+    }
+
+  } // end ThreadedCalculateCovariance()
+
+
+  /**
+   * ********************* ThreadedComputePrincipalComponents ****************************
+   */
+
+  template< class TInputImage, class TOutputImage >
+    void
+    PCAImageToImageFilter< TInputImage, TOutputImage >
+    ::ThreadedComputePrincipalComponents( unsigned long begin, unsigned long end )
+  {
+    const unsigned int numberOfOutputs = this->m_OutputBuffers.size();
+    MatrixOfDoubleType centered( this->m_BlockSize, this->m_NumberOfFeatureImages );
+
+    for( unsigned long block = begin; block < end; ++block )
+    {
+      this->GetCenteredBlock( block, centered );
+
+      const unsigned long first = block * this->m_BlockSize;
+      const unsigned long last = vnl_math_min(
+        first + this->m_BlockSize, static_cast<unsigned long>( this->m_NumberOfPixels ) );
+      for( unsigned int pc = 0; pc < numberOfOutputs; ++pc )
+      {
+        OutputImagePixelType * buffer = this->m_OutputBuffers[ pc ];
+        unsigned long row = 0;
+        for( unsigned long pix = first; pix < last; ++pix, ++row )
+        {
+          const double * values = centered[ row ];
+          double component = 0.0;
+          for( unsigned int i = 0; i < this->m_NumberOfFeatureImages; ++i )
+          {
+            component += values[ i ] * this->m_EigenVectors[ i ][ pc ];
+          }
+          buffer[ pix ] = static_cast< OutputImagePixelType >( component );
+        }
+      }
+    }
+
+  } // end ThreadedComputePrincipalComponents()
 
 
   /**
@@ -468,6 +686,10 @@ namespace itk
       << this->m_NumberOfFeatureImages << std::endl;
     os << indent << "NumberOfPixels: "
       << this->m_NumberOfPixels << std::endl;
+    os << indent << "BlockSize: "
+      << this->m_BlockSize << std::endl;
+    os << indent << "UseModel: "
+      << this->m_UseModel << std::endl;
 
     os << indent << "CovarianceMatrix: " << std::endl;
     for( unsigned int i = 0; i < this->m_CovarianceMatrix.size(); i++ )
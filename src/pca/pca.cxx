@@ -44,6 +44,9 @@ std::string GetHelpString( void )
     << "  [-of]    outputFormat, default mhd\n"
     << "  [-opc]   the number of principal components that you want to output, default all\n"
     << "  [-opct]  output pixel component type, default derived from the input image\n"
+    << "  [-om]    output model filename, to save the mean, eigen values and eigen vectors\n"
+    << "  [-im]    input model filename, to project the inputs on a saved model\n"
+    << "           instead of fitting a new one\n"
     << "Supported: 2D, 3D, (unsigned) char, (unsigned) short, (unsigned) int, (unsigned) long, float, double.";
 
   return ss.str();
@@ -94,6 +97,12 @@ int main( int argc, char **argv )
   std::string componentTypeString = "";
   bool retopct = parser->GetCommandLineArgument( "-opct", componentTypeString );
 
+  std::string inputModelFileName = "";
+  parser->GetCommandLineArgument( "-im", inputModelFileName );
+
+  std::string outputModelFileName = "";
+  parser->GetCommandLineArgument( "-om", outputModelFileName );
+
   /** Check that numberOfOutputs <= numberOfInputs. */
   if( numberOfPCs > inputFileNames.size() )
   {
@@ -160,6 +169,8 @@ int main( int argc, char **argv )
     filter->m_OutputDirectory = outputDirectory;
     filter->m_OutputFormat = outputFormat;
     filter->m_NumberOfPCs = numberOfPCs;
+    filter->m_InputModelFileName = inputModelFileName;
+    filter->m_OutputModelFileName = outputModelFileName;
 
     filter->Run();
 
@@ -22,6 +22,8 @@
 
 #include <itksys/SystemTools.hxx>
 #include <sstream>
+#include <fstream>
+#include <iomanip>
 #include "itkPCAImageToImageFilter.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
@@ -42,6 +44,8 @@ public:
     this->m_OutputDirectory = "";
     this->m_OutputFormat = "mhd";
     this->m_NumberOfPCs = 0;
+    this->m_InputModelFileName = "";
+    this->m_OutputModelFileName = "";
   };
   /** Destructor. */
   ~ITKToolsPCABase(){};
@@ -51,6 +55,8 @@ public:
   std::string m_OutputFormat;
   std::string m_OutputDirectory;
   unsigned int m_NumberOfPCs;
+  std::string m_InputModelFileName;
+  std::string m_OutputModelFileName;
 
 }; // end class ITKToolsPCABase
 
@@ -95,6 +101,21 @@ public:
     pcaEstimator->SetNumberOfFeatureImages( noInputs );
     pcaEstimator->SetNumberOfPrincipalComponentsRequired( this->m_NumberOfPCs );
 
+    /** Only project the inputs on a previously fitted model. */
+    if( this->m_InputModelFileName != "" )
+    {
+      VectorOfDoubleType mean, eigenValues;
+      MatrixOfDoubleType eigenVectors;
+      this->ReadModel( mean, eigenValues, eigenVectors );
+      if( mean.size() != noInputs )
+      {
+        itkGenericExceptionMacro( << "The model in " << this->m_InputModelFileName
+          << " has " << mean.size() << " feature images, but "
+          << noInputs << " inputs were given." );
+      }
+      pcaEstimator->SetModel( mean, eigenValues, eigenVectors );
+    }
+
     /** For all inputs... */
     std::vector<ReaderPointer> readers( noInputs );
     for( unsigned int i = 0; i < noInputs; ++i )
@@ -111,6 +132,13 @@ public:
     /** Do the PCA analysis. */
     pcaEstimator->Update();
 
+    /** Save the fitted model, to project other images on it later. */
+    if( this->m_OutputModelFileName != "" )
+    {
+      this->WriteModel( pcaEstimator->GetMeanOfFeatureImages(),
+        pcaEstimator->GetEigenValues(), pcaEstimator->GetEigenVectors() );
+    }
+
     /** Get eigenvalues and vectors, and print it to screen. */
     //pcaEstimator->Print( std::cout );
     VectorOfDoubleType vec = pcaEstimator->GetEigenValues();
@@ -147,6 +175,78 @@ public:
     }
   } // end Run()
 
+  /** Write the mean, the eigen values and the eigen vectors (as rows of
+   * the matrix with the vectors in its columns) to a text file.
+   */
+  void WriteModel( const vnl_vector<double> & mean,
+    const vnl_vector<double> & eigenValues,
+    const vnl_matrix<double> & eigenVectors ) const
+  {
+    std::ofstream model( this->m_OutputModelFileName.c_str() );
+    if( !model.is_open() )
+    {
+      itkGenericExceptionMacro( << "Could not open " << this->m_OutputModelFileName << " for writing." );
+    }
+
+    const unsigned int n = mean.size();
+    model << std::setprecision( 17 );
+    model << "NumberOfFeatureImages " << n << "\n";
+    model << "Mean";
+    for( unsigned int i = 0; i < n; ++i ) model << " " << mean[ i ];
+    model << "\nEigenValues";
+    for( unsigned int i = 0; i < n; ++i ) model << " " << eigenValues[ i ];
+    model << "\nEigenVectors\n";
+    for( unsigned int i = 0; i < n; ++i )
+    {
+      for( unsigned int j = 0; j < n; ++j )
+      {
+        model << eigenVectors[ i ][ j ] << ( j + 1 < n ? " " : "\n" );
+      }
+    }
+
+  } // end WriteModel()
+
+  /** Read a model written by WriteModel(). */
+  void ReadModel( vnl_vector<double> & mean,
+    vnl_vector<double> & eigenValues,
+    vnl_matrix<double> & eigenVectors ) const
+  {
+    std::ifstream model( this->m_InputModelFileName.c_str() );
+    if( !model.is_open() )
+    {
+      itkGenericExceptionMacro( << "Could not open " << this->m_InputModelFileName << " for reading." );
+    }
+
+    std::string keyword[ 4 ];
+    unsigned int n = 0;
+    model >> keyword[ 0 ] >> n;
+    if( !model || keyword[ 0 ] != "NumberOfFeatureImages" || n == 0 )
+    {
+      itkGenericExceptionMacro( << this->m_InputModelFileName << " is not a PCA model file." );
+    }
+
+    mean.set_size( n );
+    eigenValues.set_size( n );
+    eigenVectors.set_size( n, n );
+    model >> keyword[ 1 ];
+    for( unsigned int i = 0; i < n; ++i ) model >> mean[ i ];
+    model >> keyword[ 2 ];
+    for( unsigned int i = 0; i < n; ++i ) model >> eigenValues[ i ];
+    model >> keyword[ 3 ];
+    for( unsigned int i = 0; i < n; ++i )
+    {
+      for( unsigned int j = 0; j < n; ++j ) model >> eigenVectors[ i ][ j ];
+    }
+
+    if( !model || keyword[ 1 ] != "Mean" || keyword[ 2 ] != "EigenValues"
+      || keyword[ 3 ] != "EigenVectors" )
+    {
+      itkGenericExceptionMacro( << "Could not read the PCA model in "
+        << this->m_InputModelFileName << "." );
+    }
+
+  } // end ReadModel()
+
 }; // end class ITKToolsPCA
 
 
@@ -45,6 +45,10 @@ std::string GetHelpString( void )
     << "  [-mv]    mean variance, default: 0.0 1.0\n"
     << "  [-opct]  pixel type of input and output images;\n"
     << "           default: automatically determined from the first input image.\n"
+    << "  [-s]     number of streams, default 1.\n"
+    << "           If larger than 1, scalar images are processed out-of-core in two passes:\n"
+    << "           the statistics are computed slab by slab, after which the rescaled\n"
+    << "           image is streamed to disk.\n"
     << "Either \"-mm\" or \"-mv\" need to be specified.\n"
     << "Supported: 2D, 3D, (unsigned) char, (unsigned) short, (unsigned) int, float.\n"
     << "When applied to vector images, this program performs the operation on each channel separately.";
@@ -128,6 +132,10 @@ int main( int argc, char **argv )
     }
   }
 
+  /** Support for streaming. */
+  unsigned int numberOfStreams = 1;
+  parser->GetCommandLineArgument( "-s", numberOfStreams );
+
   /** Check which option is selected. */
   bool valuesAreExtrema = true;
   if( retmv ) valuesAreExtrema = false;
@@ -141,6 +149,14 @@ int main( int argc, char **argv )
     inputFileName, pixelType, componentType, dim, numberOfComponents );
   if( !retgip ) return EXIT_FAILURE;
 
+  /** Streaming is only implemented for scalar images. */
+  if( numberOfStreams > 1 && numberOfComponents > 1 )
+  {
+    std::cerr << "WARNING: streaming is not supported for vector images, "
+      << "the image is processed in memory." << std::endl;
+    numberOfStreams = 1;
+  }
+
   /** If the option -mv is used then output is float. */
   if( retmv )
   {
@@ -197,6 +213,7 @@ int main( int argc, char **argv )
     filter->m_OutputFileName = outputFileName;
     filter->m_Values = values;
     filter->m_ValuesAreExtrema = valuesAreExtrema;
+    filter->m_NumberOfStreams = numberOfStreams;
 
     filter->Run();
 
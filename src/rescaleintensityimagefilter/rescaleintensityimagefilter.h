@@ -23,10 +23,13 @@
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkMultiThreader.h"
 #include "itkComposeImageFilter.h"
 #include "itkRescaleIntensityImageFilter.h"
 #include "itkShiftScaleImageFilter.h"
 #include "itkStatisticsImageFilter.h"
+#include "itkUnaryFunctorImageFilter.h"
 #include "itkVectorIndexSelectionCastImageFilter.h"
 
 #include "vnl/vnl_math.h"
@@ -47,6 +50,7 @@ public:
     this->m_InputFileName = "";
     this->m_OutputFileName = "";
     this->m_ValuesAreExtrema = false;
+    this->m_NumberOfStreams = 1;
   };
   /** Destructor. */
   ~ITKToolsRescaleIntensityImageFilterBase(){};
@@ -56,6 +60,7 @@ public:
   std::string m_OutputFileName;
   std::vector<double> m_Values;
   bool m_ValuesAreExtrema;
+  unsigned int m_NumberOfStreams;
 
 }; // end class ITKToolsRescaleIntensityImageFilterBase
 
@@ -80,6 +85,13 @@ public:
   /** Run function. */
   void Run( void )
   {
+    /** Out-of-core volumes are processed in two streamed passes. */
+    if( this->m_NumberOfStreams > 1 )
+    {
+      this->RunStreamed();
+      return;
+    }
+
     /** TYPEDEF's. */
     typedef itk::Image<TComponentType, VDimension>        ScalarImageType;
     typedef itk::VectorImage<TComponentType, VDimension>  VectorImageType;
@@ -186,6 +198,216 @@ public:
 
   } // end Run()
 
+
+  /** Scalar image typedefs for the streamed passes. */
+  typedef itk::Image<TComponentType, VDimension>        ScalarImageType;
+  typedef typename ScalarImageType::PixelType           PixelType;
+  typedef typename ScalarImageType::RegionType          RegionType;
+  typedef typename RegionType::SizeValueType            SizeValueType;
+
+  /** Per thread accumulators of the statistics pass. */
+  struct ScanStruct
+  {
+    const PixelType *   Buffer;
+    SizeValueType       NumberOfPixels;
+    std::vector<double> Minimum;
+    std::vector<double> Maximum;
+    std::vector<double> Sum;
+    std::vector<double> SumOfSquares;
+  };
+
+
+  /** Scan a contiguous chunk of the current slab. */
+  static ITK_THREAD_RETURN_TYPE ScanCallback( void * arg )
+  {
+    itk::MultiThreader::ThreadInfoStruct * info
+      = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+    ScanStruct * str = static_cast<ScanStruct *>( info->UserData );
+    const itk::ThreadIdType threadId = info->ThreadID;
+    const itk::ThreadIdType numberOfThreads = info->NumberOfThreads;
+
+    /** Determine the chunk of this thread. */
+    const SizeValueType chunk = ( str->NumberOfPixels + numberOfThreads - 1 ) / numberOfThreads;
+    const SizeValueType begin = vnl_math_min( str->NumberOfPixels, threadId * chunk );
+    const SizeValueType end = vnl_math_min( str->NumberOfPixels, begin + chunk );
+
+    /** Plain loop over the buffer, so that the compiler can vectorize it. */
+    const PixelType * buffer = str->Buffer;
+    double minimum = str->Minimum[ threadId ];
+    double maximum = str->Maximum[ threadId ];
+    double sum = 0.0;
+    double sumOfSquares = 0.0;
+    for( SizeValueType i = begin; i < end; ++i )
+    {
+      const double value = static_cast<double>( buffer[ i ] );
+      minimum = value < minimum ? value : minimum;
+      maximum = value > maximum ? value : maximum;
+      sum += value;
+      sumOfSquares += value * value;
+    }
+
+    str->Minimum[ threadId ] = minimum;
+    str->Maximum[ threadId ] = maximum;
+    str->Sum[ threadId ] += sum;
+    str->SumOfSquares[ threadId ] += sumOfSquares;
+
+    return ITK_THREAD_RETURN_VALUE;
+
+  } // end ScanCallback()
+
+
+  /** First pass: stream the input in slabs along the last dimension and
+   * compute the minimum, maximum, mean and standard deviation.
+   */
+  void ComputeStreamedStatistics( double & minimum, double & maximum,
+    double & mean, double & sigma )
+  {
+    typedef itk::ImageFileReader< ScalarImageType >     ReaderType;
+
+    itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+      this->m_InputFileName.c_str(), itk::ImageIOFactory::ReadMode );
+    if( imageIO.IsNull() )
+    {
+      itkGenericExceptionMacro( << "Could not create an ImageIO for "
+        << this->m_InputFileName );
+    }
+
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( this->m_InputFileName.c_str() );
+    reader->SetImageIO( imageIO );
+    reader->UpdateOutputInformation();
+
+    ScalarImageType * image = reader->GetOutput();
+    const RegionType largestRegion = image->GetLargestPossibleRegion();
+    const SizeValueType numberOfSlices = largestRegion.GetSize( VDimension - 1 );
+    SizeValueType numberOfSlabs = this->m_NumberOfStreams;
+    if( !imageIO->CanStreamRead() ) numberOfSlabs = 1;
+    numberOfSlabs = vnl_math_max( static_cast<SizeValueType>( 1 ),
+      vnl_math_min( numberOfSlabs, numberOfSlices ) );
+    const SizeValueType slicesPerSlab = ( numberOfSlices + numberOfSlabs - 1 ) / numberOfSlabs;
+
+    /** Setup the threaded scan. */
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    const itk::ThreadIdType numberOfThreads = threader->GetNumberOfThreads();
+    ScanStruct str;
+    str.Minimum.resize( numberOfThreads, itk::NumericTraits<double>::max() );
+    str.Maximum.resize( numberOfThreads, itk::NumericTraits<double>::NonpositiveMin() );
+    str.Sum.resize( numberOfThreads, 0.0 );
+    str.SumOfSquares.resize( numberOfThreads, 0.0 );
+    threader->SetSingleMethod( ScanCallback, &str );
+
+    for( SizeValueType start = 0; start < numberOfSlices; start += slicesPerSlab )
+    {
+      RegionType slab = largestRegion;
+      slab.SetIndex( VDimension - 1, largestRegion.GetIndex( VDimension - 1 ) + start );
+      slab.SetSize( VDimension - 1, vnl_math_min( slicesPerSlab, numberOfSlices - start ) );
+
+      image->SetRequestedRegion( slab );
+      image->Update();
+
+      str.Buffer = image->GetBufferPointer() + image->ComputeOffset( slab.GetIndex() );
+      str.NumberOfPixels = slab.GetNumberOfPixels();
+      threader->SingleMethodExecute();
+    }
+
+    /** Merge the per thread results. */
+    double sum = 0.0;
+    double sumOfSquares = 0.0;
+    minimum = itk::NumericTraits<double>::max();
+    maximum = itk::NumericTraits<double>::NonpositiveMin();
+    for( itk::ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      minimum = vnl_math_min( minimum, str.Minimum[ i ] );
+      maximum = vnl_math_max( maximum, str.Maximum[ i ] );
+      sum += str.Sum[ i ];
+      sumOfSquares += str.SumOfSquares[ i ];
+    }
+
+    /** Same (unbiased) estimates as the StatisticsImageFilter. */
+    const double count = static_cast<double>( largestRegion.GetNumberOfPixels() );
+    mean = sum / count;
+    const double variance = count > 1.0
+      ? ( sumOfSquares - sum * sum / count ) / ( count - 1.0 ) : 0.0;
+    sigma = vcl_sqrt( vnl_math_max( variance, 0.0 ) );
+
+  } // end ComputeStreamedStatistics()
+
+
+  /** Two-pass streamed version of Run() for scalar images: the statistics
+   * are gathered slab by slab, after which the linear intensity mapping
+   * is streamed from the reader to the writer.
+   */
+  void RunStreamed( void )
+  {
+    typedef itk::Functor::IntensityLinearTransform<
+      PixelType, PixelType >                              FunctorType;
+    typedef itk::UnaryFunctorImageFilter<
+      ScalarImageType, ScalarImageType, FunctorType >     MapperType;
+    typedef itk::ImageFileReader< ScalarImageType >       ReaderType;
+    typedef itk::ImageFileWriter< ScalarImageType >       WriterType;
+
+    /** First pass. */
+    double inputMinimum, inputMaximum, mean, sigma;
+    this->ComputeStreamedStatistics( inputMinimum, inputMaximum, mean, sigma );
+
+    /** Determine the linear mapping output = factor * input + offset. */
+    double factor = 1.0;
+    double offset = 0.0;
+    PixelType outputMinimum = itk::NumericTraits<PixelType>::NonpositiveMin();
+    PixelType outputMaximum = itk::NumericTraits<PixelType>::max();
+    if( this->m_ValuesAreExtrema )
+    {
+      if( this->m_Values[ 0 ] != 0.0 || this->m_Values[ 1 ] != 0.0 )
+      {
+        outputMinimum = static_cast<PixelType>( this->m_Values[ 0 ] );
+        outputMaximum = static_cast<PixelType>( this->m_Values[ 1 ] );
+      }
+
+      /** Same conventions as the RescaleIntensityImageFilter. */
+      const double outputRange = static_cast<double>( outputMaximum )
+        - static_cast<double>( outputMinimum );
+      if( inputMinimum != inputMaximum )
+      {
+        factor = outputRange / ( inputMaximum - inputMinimum );
+      }
+      else if( inputMaximum != 0.0 )
+      {
+        factor = outputRange / inputMaximum;
+      }
+      else
+      {
+        factor = 0.0;
+      }
+      offset = static_cast<double>( outputMinimum ) - inputMinimum * factor;
+    }
+    else
+    {
+      /** Same as the ShiftScaleImageFilter with the shift and scale of Run(). */
+      const double scale = vcl_sqrt( this->m_Values[ 1 ] ) / sigma;
+      const double shift = this->m_Values[ 0 ] * sigma / vcl_sqrt( this->m_Values[ 1 ] ) - mean;
+      factor = scale;
+      offset = shift * scale;
+    }
+
+    /** Second pass: stream the mapping to disk. */
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( this->m_InputFileName.c_str() );
+
+    typename MapperType::Pointer mapper = MapperType::New();
+    mapper->SetInput( reader->GetOutput() );
+    mapper->GetFunctor().SetFactor( factor );
+    mapper->GetFunctor().SetOffset( offset );
+    mapper->GetFunctor().SetMinimum( outputMinimum );
+    mapper->GetFunctor().SetMaximum( outputMaximum );
+
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( mapper->GetOutput() );
+    writer->SetFileName( this->m_OutputFileName.c_str() );
+    writer->SetNumberOfStreamDivisions( this->m_NumberOfStreams );
+    writer->Update();
+
+  } // end RunStreamed()
+
 }; // end class ITKToolsRescaleIntensityFilter
 
 
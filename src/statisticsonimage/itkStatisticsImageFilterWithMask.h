@@ -165,6 +165,19 @@ public:
   itkSetObjectMacro(Mask, MaskType);
   itkGetConstObjectMacro(Mask, MaskType);
 
+  /** Also compute the mean and standard deviation of the logarithm of the
+   * pixel values, in the same pass. Default: false.
+   */
+  itkSetMacro( ComputeLogStatistics, bool );
+  itkGetConstMacro( ComputeLogStatistics, bool );
+  itkBooleanMacro( ComputeLogStatistics );
+
+  /** Return the mean and standard deviation of the logarithm of the
+   * pixel values. Only valid if ComputeLogStatistics is on.
+   */
+  itkGetConstMacro( LogMean, RealType );
+  itkGetConstMacro( LogSigma, RealType );
+
 protected:
   StatisticsImageFilter();
   ~StatisticsImageFilter(){};
@@ -189,18 +202,42 @@ protected:
   // Override since the filter produces all of its output
   void EnlargeOutputRequestedRegion( DataObject *data );
 
+  /** Kernel for a contiguous span of values: computes the sum, the absolute
+   * sum, the minimum and maximum, and the sum of squared deviations from
+   * the mean of the span. Written with independent partial results, so
+   * that the compiler can vectorize it.
+   */
+  static void ComputeSpanStatistics( const RealType * values, SizeValueType n,
+    RealType & sum, RealType & absoluteSum, RealType & M2,
+    RealType & minimum, RealType & maximum );
+
+  /** Merge count, sum and M2 of a span into those of a thread, with the
+   * pairwise update of Chan et al.
+   */
+  static void MergeStatistics( SizeValueType & count, RealType & sum, RealType & M2,
+    SizeValueType countB, RealType sumB, RealType M2B );
+
   MaskPointer m_Mask;
+  bool        m_ComputeLogStatistics;
+  RealType    m_LogMean;
+  RealType    m_LogSigma;
 
 private:
   StatisticsImageFilter(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
-  Array<RealType>  m_ThreadSum;
-  Array<RealType>  m_ThreadAbsoluteSum;
-  Array<RealType>  m_SumOfSquares;
-  Array<long>      m_Count;
-  Array<PixelType> m_ThreadMin;
-  Array<PixelType> m_ThreadMax;
+  /** Per thread results. M2 is the sum of squared deviations from the
+   * mean of the thread, which is much less prone to cancellation than
+   * the sum of squares.
+   */
+  Array<RealType>       m_ThreadSum;
+  Array<RealType>       m_ThreadAbsoluteSum;
+  Array<RealType>       m_ThreadM2;
+  Array<RealType>       m_ThreadLogSum;
+  Array<RealType>       m_ThreadLogM2;
+  Array<SizeValueType>  m_Count;
+  Array<PixelType>      m_ThreadMin;
+  Array<PixelType>      m_ThreadMax;
 
 } ; // end of class
 
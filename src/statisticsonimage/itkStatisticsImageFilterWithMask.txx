@@ -36,16 +36,19 @@
 
 #include "itkStatisticsImageFilterWithMask.h"
 
-#include "itkImageRegionConstIterator.h"
+#include "itkImageLinearConstIteratorWithIndex.h"
 #include "itkNumericTraits.h"
 #include "itkProgressReporter.h"
 
+#include <vector>
+
 
 namespace itk {
 
 template<class TInputImage>
 StatisticsImageFilter<TInputImage>
-::StatisticsImageFilter(): m_ThreadSum(1), m_ThreadAbsoluteSum(1), m_SumOfSquares(1), m_Count(1), m_ThreadMin(1), m_ThreadMax(1)
+::StatisticsImageFilter(): m_ThreadSum(1), m_ThreadAbsoluteSum(1), m_ThreadM2(1),
+  m_ThreadLogSum(1), m_ThreadLogM2(1), m_Count(1), m_ThreadMin(1), m_ThreadMax(1)
 {
   // first output is a copy of the image, DataObject created by
   // superclass
@@ -76,6 +79,9 @@ StatisticsImageFilter<TInputImage>
   this->GetSumOutput()->Set( NumericTraits<RealType>::Zero );
 
   this->m_Mask = 0;
+  this->m_ComputeLogStatistics = false;
+  this->m_LogMean = NumericTraits<RealType>::max();
+  this->m_LogSigma = NumericTraits<RealType>::max();
 }
 
 
@@ -273,17 +279,21 @@ StatisticsImageFilter<TInputImage>
 
   // Resize the thread temporaries
   this->m_Count.SetSize(numberOfThreads);
-  this->m_SumOfSquares.SetSize(numberOfThreads);
+  this->m_ThreadM2.SetSize(numberOfThreads);
   this->m_ThreadSum.SetSize(numberOfThreads);
   this->m_ThreadAbsoluteSum.SetSize(numberOfThreads);
+  this->m_ThreadLogSum.SetSize(numberOfThreads);
+  this->m_ThreadLogM2.SetSize(numberOfThreads);
   this->m_ThreadMin.SetSize(numberOfThreads);
   this->m_ThreadMax.SetSize(numberOfThreads);
 
   // Initialize the temporaries
-  this->m_Count.Fill(NumericTraits<long>::Zero);
+  this->m_Count.Fill(NumericTraits<SizeValueType>::Zero);
   this->m_ThreadSum.Fill(NumericTraits<RealType>::Zero);
   this->m_ThreadAbsoluteSum.Fill(NumericTraits<RealType>::Zero);
-  this->m_SumOfSquares.Fill(NumericTraits<RealType>::Zero);
+  this->m_ThreadM2.Fill(NumericTraits<RealType>::Zero);
+  this->m_ThreadLogSum.Fill(NumericTraits<RealType>::Zero);
+  this->m_ThreadLogM2.Fill(NumericTraits<RealType>::Zero);
   this->m_ThreadMin.Fill(NumericTraits<PixelType>::max());
   this->m_ThreadMax.Fill(NumericTraits<PixelType>::NonpositiveMin());
 
@@ -294,10 +304,6 @@ void
 StatisticsImageFilter<TInputImage>
 ::AfterThreadedGenerateData( void )
 {
-  int i;
-  long count;
-  RealType sumOfSquares;
-
   int numberOfThreads = this->GetNumberOfThreads();
 
   PixelType minimum;
@@ -306,22 +312,25 @@ StatisticsImageFilter<TInputImage>
   RealType  absmean;
   RealType  sigma;
   RealType  variance;
-  RealType  sum;
-  RealType  abssum;
 
-  sum = sumOfSquares = abssum = NumericTraits<RealType>::Zero;
-  count = 0;
+  SizeValueType count = 0;
+  SizeValueType logCount = 0;
+  RealType sum = NumericTraits<RealType>::Zero;
+  RealType abssum = NumericTraits<RealType>::Zero;
+  RealType M2 = NumericTraits<RealType>::Zero;
+  RealType logSum = NumericTraits<RealType>::Zero;
+  RealType logM2 = NumericTraits<RealType>::Zero;
 
-  // Find the min/max over all threads and accumulate count, sum and
-  // sum of squares
+  // Find the min/max over all threads and merge count, sum and M2
   minimum = NumericTraits<PixelType>::max();
   maximum = NumericTraits<PixelType>::NonpositiveMin();
-  for( i = 0; i < numberOfThreads; i++ )
+  for( int i = 0; i < numberOfThreads; i++ )
     {
-    count += this->m_Count[ i ];
-    sum += this->m_ThreadSum[ i ];
     abssum += this->m_ThreadAbsoluteSum[ i ];
-    sumOfSquares += this->m_SumOfSquares[ i ];
+    MergeStatistics( logCount, logSum, logM2,
+      this->m_Count[ i ], this->m_ThreadLogSum[ i ], this->m_ThreadLogM2[ i ] );
+    MergeStatistics( count, sum, M2,
+      this->m_Count[ i ], this->m_ThreadSum[ i ], this->m_ThreadM2[ i ] );
 
     if( this->m_ThreadMin[ i ] < minimum)
       {
@@ -337,12 +346,20 @@ StatisticsImageFilter<TInputImage>
   absmean = abssum / static_cast<RealType>( count );
 
   // unbiased estimate
-  variance = (sumOfSquares - (sum*sum / static_cast<RealType>(count)))
-    / (static_cast<RealType>(count) - 1);
+  variance = M2 / ( static_cast<RealType>( count ) - 1 );
   // in case of numerical errors the variance might be <0.
   variance = vnl_math_max(0.0, variance);
   sigma = vcl_sqrt(variance);
 
+  // the same for the logarithm of the pixel values
+  if( this->m_ComputeLogStatistics )
+  {
+    this->m_LogMean = logSum / static_cast<RealType>( count );
+    RealType logVariance = logM2 / ( static_cast<RealType>( count ) - 1 );
+    logVariance = vnl_math_max( 0.0, logVariance );
+    this->m_LogSigma = vcl_sqrt( logVariance );
+  }
+
   // Set the outputs
   this->GetMinimumOutput()->Set( minimum );
   this->GetMaximumOutput()->Set( maximum );
@@ -353,87 +370,185 @@ StatisticsImageFilter<TInputImage>
   this->GetSumOutput()->Set( sum );
 }
 
+
+template<class TInputImage>
+void
+StatisticsImageFilter<TInputImage>
+::MergeStatistics( SizeValueType & count, RealType & sum, RealType & M2,
+  SizeValueType countB, RealType sumB, RealType M2B )
+{
+  if( countB == 0 ) return;
+  if( count == 0 )
+  {
+    count = countB; sum = sumB; M2 = M2B;
+    return;
+  }
+
+  const RealType n = static_cast<RealType>( count );
+  const RealType nB = static_cast<RealType>( countB );
+  const RealType delta = sumB / nB - sum / n;
+  M2 += M2B + delta * delta * n * nB / ( n + nB );
+  sum += sumB;
+  count += countB;
+
+} // end MergeStatistics()
+
+
+template<class TInputImage>
+void
+StatisticsImageFilter<TInputImage>
+::ComputeSpanStatistics( const RealType * values, SizeValueType n,
+  RealType & sum, RealType & absoluteSum, RealType & M2,
+  RealType & minimum, RealType & maximum )
+{
+  // first pass: four independent partial results
+  RealType s[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  RealType a[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  RealType mn[ 4 ], mx[ 4 ];
+  for( unsigned int j = 0; j < 4; ++j )
+  {
+    mn[ j ] = NumericTraits<RealType>::max();
+    mx[ j ] = NumericTraits<RealType>::NonpositiveMin();
+  }
+
+  const SizeValueType n4 = n - n % 4;
+  for( SizeValueType i = 0; i < n4; i += 4 )
+  {
+    for( unsigned int j = 0; j < 4; ++j )
+    {
+      const RealType v = values[ i + j ];
+      s[ j ] += v;
+      a[ j ] += v < 0 ? -v : v;
+      mn[ j ] = v < mn[ j ] ? v : mn[ j ];
+      mx[ j ] = v > mx[ j ] ? v : mx[ j ];
+    }
+  }
+  for( SizeValueType i = n4; i < n; ++i )
+  {
+    const RealType v = values[ i ];
+    s[ 0 ] += v;
+    a[ 0 ] += v < 0 ? -v : v;
+    mn[ 0 ] = v < mn[ 0 ] ? v : mn[ 0 ];
+    mx[ 0 ] = v > mx[ 0 ] ? v : mx[ 0 ];
+  }
+
+  sum = ( s[ 0 ] + s[ 1 ] ) + ( s[ 2 ] + s[ 3 ] );
+  absoluteSum = ( a[ 0 ] + a[ 1 ] ) + ( a[ 2 ] + a[ 3 ] );
+  minimum = vnl_math_min( vnl_math_min( mn[ 0 ], mn[ 1 ] ), vnl_math_min( mn[ 2 ], mn[ 3 ] ) );
+  maximum = vnl_math_max( vnl_math_max( mx[ 0 ], mx[ 1 ] ), vnl_math_max( mx[ 2 ], mx[ 3 ] ) );
+
+  // second pass, on data that is still in cache: deviations from the mean
+  const RealType mean = sum / static_cast<RealType>( n );
+  RealType d[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+  for( SizeValueType i = 0; i < n4; i += 4 )
+  {
+    for( unsigned int j = 0; j < 4; ++j )
+    {
+      const RealType dev = values[ i + j ] - mean;
+      d[ j ] += dev * dev;
+    }
+  }
+  for( SizeValueType i = n4; i < n; ++i )
+  {
+    const RealType dev = values[ i ] - mean;
+    d[ 0 ] += dev * dev;
+  }
+  M2 = ( d[ 0 ] + d[ 1 ] ) + ( d[ 2 ] + d[ 3 ] );
+
+} // end ComputeSpanStatistics()
+
+
 template<class TInputImage>
 void
 StatisticsImageFilter<TInputImage>
 ::ThreadedGenerateData( const RegionType& outputRegionForThread, ThreadIdType threadId )
 {
-  RealType realValue;
-  PixelType value;
+  typedef typename MaskType::PixelType MaskPixelType;
+
+  const TInputImage * input = this->GetInput();
+  const PixelType * inputBuffer = input->GetBufferPointer();
+  const MaskPixelType * maskBuffer
+    = this->m_Mask.IsNull() ? 0 : this->m_Mask->GetBufferPointer();
+  const bool computeLog = this->m_ComputeLogStatistics;
 
+  SizeValueType count = 0;
   RealType sum = NumericTraits< RealType >::Zero;
   RealType absoluteSum = NumericTraits< RealType >::Zero;
-  RealType sumOfSquares = NumericTraits< RealType >::Zero;
-  SizeValueType count = NumericTraits< SizeValueType >::Zero;
+  RealType M2 = NumericTraits< RealType >::Zero;
+  SizeValueType logCount = 0;
+  RealType logSum = NumericTraits< RealType >::Zero;
+  RealType logM2 = NumericTraits< RealType >::Zero;
   PixelType min = NumericTraits< PixelType >::max();
   PixelType max = NumericTraits< PixelType >::NonpositiveMin();
 
-  // support progress methods/callbacks
-  ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+  // the values of a line, converted to the real type; in the masked
+  // case only the values inside the mask
+  const SizeValueType lineLength = outputRegionForThread.GetSize( 0 );
+  std::vector<RealType> values( lineLength );
+
+  // support progress methods/callbacks, per line
+  ProgressReporter progress( this, threadId,
+    outputRegionForThread.GetNumberOfPixels() / vnl_math_max( lineLength, SizeValueType( 1 ) ) );
 
-  if( this->m_Mask.IsNull() )
+  ImageLinearConstIteratorWithIndex<TInputImage> lineIt( input, outputRegionForThread );
+  lineIt.SetDirection( 0 );
+  lineIt.GoToBegin();
+  while( !lineIt.IsAtEnd() )
   {
-    ImageRegionConstIterator<TInputImage> it( this->GetInput(), outputRegionForThread );
+    const IndexType index = lineIt.GetIndex();
+    const PixelType * line = inputBuffer + input->ComputeOffset( index );
 
-    // do the work
-    while( !it.IsAtEnd() )
+    SizeValueType n = 0;
+    if( maskBuffer == 0 )
     {
-      value = it.Get();
-      realValue = static_cast<RealType>( value );
-      if( value < min )
+      for( SizeValueType i = 0; i < lineLength; ++i )
       {
-        min = value;
+        values[ i ] = static_cast<RealType>( line[ i ] );
       }
-      if( value > max )
+      n = lineLength;
+    }
+    else
+    {
+      const MaskPixelType * maskLine = maskBuffer + this->m_Mask->ComputeOffset( index );
+      for( SizeValueType i = 0; i < lineLength; ++i )
       {
-        max = value;
+        values[ n ] = static_cast<RealType>( line[ i ] );
+        n += maskLine[ i ] ? 1 : 0;
       }
+    }
 
-      sum += realValue;
-      absoluteSum += vnl_math_abs(realValue);
-      sumOfSquares += (realValue * realValue);
-      ++count;
-      ++it;
-      progress.CompletedPixel();
-    } // end while
-  } //end if
-  else
-  { //use a mask
-    ImageRegionConstIterator< InputImageType > itIm(
-      this->GetInput(), outputRegionForThread );
-    ImageRegionConstIterator< MaskType > itMask(
-      this->m_Mask, outputRegionForThread );
-    itIm.GoToBegin();
-    itMask.GoToBegin();
-    // do the work
-    while ( !itIm.IsAtEnd() )
+    if( n > 0 )
     {
-      if( itMask.Value() )
+      RealType lineSum, lineAbsoluteSum, lineM2, lineMin, lineMax;
+      ComputeSpanStatistics( &values[ 0 ], n,
+        lineSum, lineAbsoluteSum, lineM2, lineMin, lineMax );
+      MergeStatistics( count, sum, M2, n, lineSum, lineM2 );
+      absoluteSum += lineAbsoluteSum;
+      // the extremes are pixel values, so the conversion back is exact
+      if( static_cast<PixelType>( lineMin ) < min ) min = static_cast<PixelType>( lineMin );
+      if( static_cast<PixelType>( lineMax ) > max ) max = static_cast<PixelType>( lineMax );
+
+      if( computeLog )
       {
-        value = itIm.Get();
-        realValue = static_cast<RealType>( value );
-        if( value < min )
+        for( SizeValueType i = 0; i < n; ++i )
         {
-          min = value;
+          values[ i ] = vcl_log( values[ i ] );
         }
-        if( value > max )
-        {
-          max = value;
-        }
-
-        sum += realValue;
-        absoluteSum += vnl_math_abs(realValue);
-        sumOfSquares += (realValue * realValue);
-        ++count;
+        ComputeSpanStatistics( &values[ 0 ], n,
+          lineSum, lineAbsoluteSum, lineM2, lineMin, lineMax );
+        MergeStatistics( logCount, logSum, logM2, n, lineSum, lineM2 );
       }
-      ++itIm; ++itMask;
-      progress.CompletedPixel();
-    } // end while
-  } // end else
+    }
+
+    lineIt.NextLine();
+    progress.CompletedPixel();
+  }
 
   this->m_ThreadSum[threadId] = sum;
   this->m_ThreadAbsoluteSum[threadId] = absoluteSum;
-  this->m_SumOfSquares[threadId] = sumOfSquares;
+  this->m_ThreadM2[threadId] = M2;
+  this->m_ThreadLogSum[threadId] = logSum;
+  this->m_ThreadLogM2[threadId] = logM2;
   this->m_Count[threadId] = count;
   this->m_ThreadMin[threadId] = min;
   this->m_ThreadMax[threadId] = max;
@@ -48,12 +48,27 @@ std::string GetHelpString( void )
     << "  [-mask]  MaskFileName, mask should have the same size as the input image\n"
     << "           and be of pixeltype (convertable to) unsigned char,\n"
     << "           1 = within mask, 0 = outside mask;\n"
+    << "           packed masks (.pmask, see pxlogicalimageoperator) are also accepted;\n"
     << "  [-b]     NumberOfBins to use for histogram, default: 100;\n"
     << "           for an accurate estimate of median and quartiles\n"
     << "           for integer images, choose the number of bins\n"
     << "           much larger (~100x) than the number of gray values.\n"
     << "           if equal 0, then the intensity range (max - min) is chosen.\n"
-    << "  [-s]     select which to compute {arithmetic, geometric, histogram}, default all;\n"
+    << "  [-s]     select which to compute {arithmetic, geometric, histogram, percentiles},\n"
+    << "           default all but percentiles;\n"
+    << "  [-p]     percentiles to compute, in %, e.g. -p 1 5 50 95 99; default: 50 (median)\n"
+    << "           if -s percentiles, otherwise no percentiles are computed.\n"
+    << "           By default, the percentiles are estimated in a single multi-threaded pass\n"
+    << "           with mergeable quantile sketches. The rank error is printed, and is about\n"
+    << "           2.3 / K^0.97 of the number of pixels with 99% confidence.\n"
+    << "  [-pk]    sketch size K, default 200, i.e. a rank error of about 1.3%.\n"
+    << "  [-exact] compute the percentiles exactly, by multi-threaded radix selection;\n"
+    << "           this takes a few more passes over the image.\n"
+    << "  [-labels] label image, of integer type and the same size as the input image;\n"
+    << "           if given, count, mean, std, min, max and sum are computed for every label\n"
+    << "           in one pass, together with the percentiles given by -p (estimated).\n"
+    << "  [-csv]   output file name for the label statistics table (CSV);\n"
+    << "           default: printed to screen.\n"
     << "Supported: 2D, 3D, 4D, float, (unsigned) short, (unsigned) char, 1, 2 or 3 components per pixel.\n"
     << "For 4D, only 1 or 4 components per pixel are supported.";
 
@@ -102,15 +117,39 @@ int main( int argc, char ** argv )
   std::string select = "";
   bool rets = parser->GetCommandLineArgument( "-s", select );
 
+  std::vector<double> percentiles;
+  parser->GetCommandLineArgument( "-p", percentiles );
+
+  unsigned int sketchSize = 200;
+  parser->GetCommandLineArgument( "-pk", sketchSize );
+
+  const bool exactPercentiles = parser->ArgumentExists( "-exact" );
+
+  std::string labelFileName = "";
+  parser->GetCommandLineArgument( "-labels", labelFileName );
+
+  std::string labelOutputFileName = "";
+  parser->GetCommandLineArgument( "-csv", labelOutputFileName );
+
   /** Check selection. */
   if( rets && ( select != "arithmetic" && select != "geometric"
-    && select != "histogram" ) )
+    && select != "histogram" && select != "percentiles" ) )
   {
-    std::cerr << "ERROR: -s should be one of {arithmetic, geometric, histogram}"
+    std::cerr << "ERROR: -s should be one of {arithmetic, geometric, histogram, percentiles}"
       << std::endl;
     return EXIT_FAILURE;
   }
 
+  /** Check percentiles. */
+  for( std::size_t i = 0; i < percentiles.size(); ++i )
+  {
+    if( percentiles[ i ] < 0.0 || percentiles[ i ] > 100.0 )
+    {
+      std::cerr << "ERROR: the percentiles should be between 0 and 100." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   /** Determine image properties. */
   itk::ImageIOBase::IOPixelType pixelType = itk::ImageIOBase::UNKNOWNPIXELTYPE;
   itk::ImageIOBase::IOComponentType componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
@@ -158,6 +197,11 @@ int main( int argc, char ** argv )
     filter->m_HistogramOutputFileName = histogramOutputFileName;
     filter->m_NumberOfBins = numberOfBins;
     filter->m_Select = select;
+    filter->m_Percentiles = percentiles;
+    filter->m_ExactPercentiles = exactPercentiles;
+    filter->m_SketchSize = sketchSize;
+    filter->m_LabelFileName = labelFileName;
+    filter->m_LabelOutputFileName = labelOutputFileName;
 
     filter->Run();
 
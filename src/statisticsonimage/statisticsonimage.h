@@ -20,9 +20,11 @@
 
 #include "ITKToolsBase.h"
 
-#include "itkImageToImageFilter.h"
+#include "itkImage.h"
+#include "itkHistogram.h"
+#include "itkMultiThreader.h"
 #include "itkStatisticsImageFilterWithMask.h"
-#include "itkScalarImageToHistogramGenerator2.h"
+#include "ITKToolsQuantileSketch.h"
 
 
 /** \class ITKToolsStatisticsOnImageBase
@@ -42,6 +44,10 @@ public:
     this->m_HistogramOutputFileName = "";
     this->m_NumberOfBins = 0;
     this->m_Select = "";
+    this->m_ExactPercentiles = false;
+    this->m_SketchSize = 200;
+    this->m_LabelFileName = "";
+    this->m_LabelOutputFileName = "";
   };
   /** Destructor. */
   ~ITKToolsStatisticsOnImageBase(){};
@@ -52,6 +58,11 @@ public:
   std::string m_HistogramOutputFileName;
   unsigned int m_NumberOfBins;
   std::string m_Select;
+  std::vector<double> m_Percentiles;
+  bool m_ExactPercentiles;
+  unsigned int m_SketchSize;
+  std::string m_LabelFileName;
+  std::string m_LabelOutputFileName;
 
 }; // end class StatisticsOnImageBase
 
@@ -85,12 +96,13 @@ public:
   /** Typedefs */
   typedef double                                      InternalPixelType;
   typedef itk::Image<InternalPixelType, VDimension>   InternalImageType;
-  typedef itk::ImageToImageFilter<
-    InternalImageType, InternalImageType>             BaseFilterType;
+  typedef unsigned char                               MaskPixelType;
+  typedef itk::Image<MaskPixelType, VDimension>       MaskImageType;
   typedef itk::StatisticsImageFilter<
     InternalImageType >                               StatisticsFilterType;
-  typedef itk::Statistics::ScalarImageToHistogramGenerator2<
-    InternalImageType >                               HistogramGeneratorType;
+  typedef itk::Statistics::Histogram< double >        HistogramType;
+  typedef int                                         LabelPixelType;
+  typedef itk::Image<LabelPixelType, VDimension>      LabelImageType;
 
   /** Run function. */
   void Run( void );
@@ -98,10 +110,9 @@ public:
   /** Helper function. */
   void ComputeStatistics(
     InternalImageType * inputImage,
-    BaseFilterType * maskerOrCopier,
+    const MaskImageType * maskImage,
     StatisticsFilterType * statistics,
-    HistogramGeneratorType * histogramGenerator,
-    unsigned int numberOfBins, // Type is defined in ScalarImageToHistogramGenerator2
+    unsigned int numberOfBins,
     const std::string & histogramOutputFileName,
     const std::string & select );
 
@@ -112,6 +123,112 @@ public:
     const unsigned int & numberOfBins,
     InternalPixelType & histogramMax );
 
+  /** Fill the histogram directly from the image buffer, skipping the
+   * pixels outside the mask, in a multi-threaded pass.
+   */
+  void ComputeHistogram(
+    const InternalImageType * inputImage,
+    const MaskImageType * maskImage,
+    HistogramType * histogram );
+
+  /** Compute the statistics of every label of the label image in one
+   * multi-threaded pass, and write them as a CSV table.
+   */
+  void ComputeLabelStatistics(
+    const InternalImageType * inputImage,
+    const MaskImageType * maskImage );
+
+protected:
+
+  /** The raw buffer passes index the mask with the pixel index of the
+   * input image, so they need the same buffered region. Throws if not.
+   */
+  static void CheckMaskRegion(
+    const InternalImageType * inputImage,
+    const MaskImageType * maskImage );
+
+  /** Running statistics of a single label. The variance is updated
+   * with Welford's method and merged with the method of Chan et al.
+   */
+  struct LabelAccumulator
+  {
+    itk::uint64_t Count;
+    double        Mean;
+    double        M2;
+    double        Sum;
+    double        Minimum;
+    double        Maximum;
+  };
+
+  /** The labels found by a single thread, in order of appearance, with
+   * their statistics. The labels are looked up in an open addressing hash
+   * table, so that the memory depends on the number of distinct labels,
+   * not on their range.
+   */
+  struct LabelThreadData
+  {
+    std::vector<LabelPixelType>           Labels;
+    std::vector<LabelAccumulator>         Accumulators;
+    std::vector<itktools::QuantileSketch> Sketches;
+
+    /** The hash table, a power of two in size; an index of 0 is empty,
+     * otherwise it is the index in Labels plus one.
+     */
+    std::vector<LabelPixelType>           HashLabels;
+    std::vector<std::size_t>              HashIndices;
+  };
+
+  /** Struct to pass the label statistics job to the threads. */
+  struct LabelThreadStruct
+  {
+    const InternalPixelType * ImageBuffer;
+    const LabelPixelType *    LabelBuffer;
+    const MaskPixelType *     MaskBuffer;
+    std::size_t               NumberOfPixels;
+    bool                      ComputePercentiles;
+    unsigned int              SketchSize;
+
+    std::vector<LabelThreadData> ThreadData;
+  };
+
+  /** Thread callback for ComputeLabelStatistics(). */
+  static ITK_THREAD_RETURN_TYPE LabelThreaderCallback( void * arg );
+
+  /** Find the index of a label in the data of a thread, or the number of
+   * labels of that thread if it was not found.
+   */
+  static std::size_t FindLabel( const LabelThreadData & data,
+    const LabelPixelType & label );
+
+  /** Find the index of a label in the data of a thread, adding it,
+   * and a sketch if needed, if it is new.
+   */
+  static std::size_t FindOrAddLabel( LabelThreadData & data,
+    const LabelPixelType & label, const LabelThreadStruct & str );
+
+  /** The bucket of a label in a hash table of the given size minus one. */
+  static std::size_t HashLabel( const LabelPixelType & label, std::size_t mask )
+  {
+    itk::uint32_t h = static_cast<itk::uint32_t>( label );
+    h ^= h >> 16;
+    h *= 0x45d9f3bU;
+    h ^= h >> 16;
+    return static_cast<std::size_t>( h ) & mask;
+  }
+
+  /** Struct to pass the histogram job to the threads. */
+  struct HistogramThreadStruct
+  {
+    const InternalPixelType * ImageBuffer;
+    const MaskPixelType *     MaskBuffer;
+    std::size_t               NumberOfPixels;
+    std::vector<double>       BinMinima;
+    std::vector< std::vector<itk::SizeValueType> > Frequencies;
+  };
+
+  /** Thread callback for ComputeHistogram(). */
+  static ITK_THREAD_RETURN_TYPE HistogramThreaderCallback( void * arg );
+
 }; // end class ITKToolsStatisticsOnImage
 
 #include "statisticsonimage.hxx"
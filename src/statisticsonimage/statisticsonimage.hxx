@@ -19,12 +19,14 @@
 #define __statisticsonimage_hxx_
 
 #include "itkImageFileReader.h"
-#include "itkCastImageFilter.h"
 #include "itkVectorMagnitudeImageFilter.h"
-#include "itkMaskImageFilter.h"
-#include "itkLogImageFilter.h"
+#include "ITKToolsPackedMask.h"
+
+#include <algorithm>
+#include <fstream>
 
 #include "statisticsprinters.h"
+#include "statisticsquantiles.h"
 
 
 /**
@@ -39,59 +41,31 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
   /** Typedefs. */
   typedef TComponentType ScalarPixelType;
 
-  typedef unsigned char MaskPixelType;
   typedef itk::Vector<TComponentType, VNumberOfComponents>  VectorPixelType;
   typedef itk::Image<ScalarPixelType, VDimension>     ScalarImageType;
   typedef itk::Image<VectorPixelType, VDimension>     VectorImageType;
-  typedef itk::Image<MaskPixelType, VDimension>       MaskImageType;
 
   typedef itk::ImageFileReader< ScalarImageType >     ScalarReaderType;
   typedef itk::ImageFileReader< InternalImageType >   InternalScalarReaderType;
   typedef itk::ImageFileReader< VectorImageType >     VectorReaderType;
-  typedef itk::ImageFileReader< MaskImageType >       MaskReaderType;
-  typedef itk::CastImageFilter<
-    InternalImageType, InternalImageType>             CopierType;
   typedef itk::VectorMagnitudeImageFilter<
     VectorImageType, InternalImageType >              MagnitudeFilterType;
 
-  typedef itk::MaskImageFilter< InternalImageType,
-    MaskImageType, InternalImageType >                MaskerType;
-  typedef typename
-    HistogramGeneratorType::HistogramType             HistogramType;
-
   /** Create StatisticsFilter. */
   typename StatisticsFilterType::Pointer statistics
     = StatisticsFilterType::New();
 
   /** Read mask */
-  typename MaskReaderType::Pointer maskReader;
-  typename BaseFilterType::Pointer maskerOrCopier
-    = (CopierType::New()).GetPointer();
+  typename MaskImageType::Pointer maskImage;
   if( this->m_MaskFileName != "" )
   {
-    /** Read mask */
-    maskReader = MaskReaderType::New();
-    maskReader->SetFileName( this->m_MaskFileName.c_str() );
-    maskReader->Update();
+    /** Read mask, which may be a packed mask. */
+    maskImage = itktools::ReadMaskImage<MaskImageType>( this->m_MaskFileName );
 
     /** Set mask. */
-    statistics->SetMask( maskReader->GetOutput() );
-
-    /** Prepare filter that applies masking to an image by
-    * replacing all pixels that fall outside the mask by
-    * -infinity. Needed for histogram.
-    */
-    typename MaskerType::Pointer maskFilter = MaskerType::New();
-    maskFilter->SetInput2( maskReader->GetOutput() );
-    maskFilter->SetOutsideValue(
-      itk::NumericTraits<InternalPixelType>::NonpositiveMin() );
-    maskerOrCopier = maskFilter.GetPointer();
+    statistics->SetMask( maskImage );
   }
 
-  /** Create histogram generator. */
-  typename HistogramGeneratorType::Pointer histogramGenerator
-    = HistogramGeneratorType::New();
-
   /** For scalar images. */
   if( VNumberOfComponents == 1 )
   {
@@ -105,9 +79,8 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
     /** Call the generic ComputeStatistics function. */
     this->ComputeStatistics(
       reader->GetOutput(),
-      maskerOrCopier,
+      maskImage,
       statistics,
-      histogramGenerator,
       this->m_NumberOfBins,
       this->m_HistogramOutputFileName,
       this->m_Select );
@@ -129,9 +102,8 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
     /** Call the generic ComputeStatistics function */
     this->ComputeStatistics(
       magnitudeFilter->GetOutput(),
-      maskerOrCopier,
+      maskImage,
       statistics,
-      histogramGenerator,
       this->m_NumberOfBins,
       this->m_HistogramOutputFileName,
       this->m_Select );
@@ -143,15 +115,14 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
 /**
  * ************************ ComputeStatistics **************************
  *
- * Generic template function that computes statistics on an input image
- * Assumes that the number of histogram bins and the marginal scale are set
- * in the histogramGenerator, that the maskerOrCopier has been initialized
- * to a (dummy) caster or to a MaskFilterType with mask set, and that the
- * statistics filter has been initialized.
+ * Generic template function that computes statistics on an input image.
+ * Assumes that the statistics filter has been initialized, with the mask
+ * set if there is one.
  *
- * This function is only to be used by the StatisticsOnImage function.
- * It is quite specific and not really well over thought. Introduced to avoid
- * duplication of code.
+ * The arithmetic and geometric statistics are computed in a single fused
+ * pass over the image. The histogram is computed in a second pass over
+ * the same buffer, since its range depends on the minimum and maximum.
+ * No temporary images are created.
  */
 
 template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
@@ -159,20 +130,29 @@ void
 ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
 ::ComputeStatistics(
   InternalImageType * inputImage,
-  BaseFilterType * maskerOrCopier,
+  const MaskImageType * maskImage,
   StatisticsFilterType * statistics,
-  HistogramGeneratorType * histogramGenerator,
-  unsigned int numberOfBins, // Type is defined in ScalarImageToHistogramGenerator2
+  unsigned int numberOfBins,
   const std::string & histogramOutputFileName,
   const std::string & select )
 {
-  typedef typename
-    HistogramGeneratorType::HistogramType             HistogramType;
-  typedef typename HistogramGeneratorType::RealPixelType   RealPixelType;
   typedef typename StatisticsFilterType::PixelType    PixelType;
-  typedef InternalImageType                           InputImageType;
-  typedef itk::LogImageFilter<
-    InputImageType, InputImageType>                   LogFilterType;
+
+  /** Per label statistics replace the global ones. */
+  if( this->m_LabelFileName != "" )
+  {
+    this->ComputeLabelStatistics( inputImage, maskImage );
+    return;
+  }
+
+  /** Compute all statistics that are needed in one pass. */
+  const bool computeGeometric = select == "geometric" || select == "";
+  if( select != "percentiles" )
+  {
+    statistics->SetInput( inputImage );
+    statistics->SetComputeLogStatistics( computeGeometric );
+    statistics->Update();
+  }
 
   /** Arithmetic mean */
   PixelType maxPixelValue = 1;
@@ -181,15 +161,11 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
   {
     std::cout << "Computing arithmetic statistics ..." << std::endl;
 
-    statistics->SetInput( inputImage );
-    statistics->Update();
-
     /** Only print if not histogram selected. */
     if( select != "histogram" )
     {
       PrintStatistics<StatisticsFilterType>( statistics );
     }
-    if( select == "arithmetic" ) return;
 
     /** Save for later use for the histogram bin size. */
     maxPixelValue = statistics->GetMaximum();
@@ -197,34 +173,16 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
   }
 
   /** Geometric mean/std: */
-  if( select == "geometric" || select == "" )
+  if( computeGeometric )
   {
     std::cout << "Computing geometric statistics ..." << std::endl;
 
-    typename LogFilterType::Pointer logger = LogFilterType::New();
-    logger->SetInput( inputImage );
-    statistics->SetInput( logger->GetOutput() );
-    statistics->Update();
-
     PrintGeometricStatistics<StatisticsFilterType>( statistics );
-
-    if( select == "geometric" ) return;
   }
 
   /** Histogram statistics. */
   if( select == "histogram" || select == "" )
   {
-    /** Prepare for the histogram. */
-    maskerOrCopier->SetInput( inputImage );
-    std::string maskerOrCopierName = maskerOrCopier->GetNameOfClass();
-    if( maskerOrCopierName == "MaskImageFilter" )
-    {
-      std::cout << "Replacing all pixels outside the mask by -infinity,\n  ";
-      std::cout << "to make sure they are not included in the histogram ..."
-        << std::endl;
-    }
-    maskerOrCopier->Update();
-
     /** If the user specified 0, the number of bins is equal to the intensity range. */
     if( numberOfBins == 0 )
     {
@@ -238,20 +196,469 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
     /** Computing histogram statistics. */
     std::cout << "Computing histogram statistics ..." << std::endl;
 
-    histogramGenerator->SetAutoMinMax( false );
-    histogramGenerator->SetNumberOfBins( numberOfBins );
-    histogramGenerator->SetHistogramMin( static_cast<RealPixelType>( minPixelValue ) );
-    histogramGenerator->SetHistogramMax( histogramMax );
-    histogramGenerator->SetInput( maskerOrCopier->GetOutput() );
-    histogramGenerator->Compute();
+    typename HistogramType::SizeType size( 1 );
+    size.Fill( numberOfBins );
+    typename HistogramType::MeasurementVectorType lowerBound( 1 );
+    typename HistogramType::MeasurementVectorType upperBound( 1 );
+    lowerBound.Fill( minPixelValue );
+    upperBound.Fill( histogramMax );
 
-    PrintHistogramStatistics<HistogramType>(
-      histogramGenerator->GetOutput(), histogramOutputFileName );
+    typename HistogramType::Pointer histogram = HistogramType::New();
+    histogram->SetMeasurementVectorSize( 1 );
+    histogram->Initialize( size, lowerBound, upperBound );
+    this->ComputeHistogram( inputImage, maskImage, histogram );
+
+    PrintHistogramStatistics<HistogramType>( histogram, histogramOutputFileName );
+  }
+
+  /** Percentiles, estimated with quantile sketches or computed exactly. */
+  if( select == "percentiles" || !this->m_Percentiles.empty() )
+  {
+    std::vector<double> percentiles = this->m_Percentiles;
+    if( percentiles.empty() ) percentiles.push_back( 50.0 );
+    std::vector<double> fractions( percentiles.size() );
+    for( std::size_t i = 0; i < percentiles.size(); ++i )
+    {
+      fractions[ i ] = percentiles[ i ] / 100.0;
+    }
+
+    this->CheckMaskRegion( inputImage, maskImage );
+    const InternalPixelType * imageBuffer = inputImage->GetBufferPointer();
+    const MaskPixelType * maskBuffer = maskImage ? maskImage->GetBufferPointer() : 0;
+    const std::size_t numberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+    std::vector<double> quantiles;
+    itk::uint64_t count = 0;
+    if( this->m_ExactPercentiles )
+    {
+      std::cout << "Computing exact percentiles ..." << std::endl;
+      count = ComputeExactQuantiles( imageBuffer, maskBuffer, numberOfPixels,
+        fractions, quantiles );
+      PrintPercentiles( percentiles, quantiles, count, 0.0 );
+    }
+    else
+    {
+      std::cout << "Estimating percentiles ..." << std::endl;
+      count = ComputeApproximateQuantiles( imageBuffer, maskBuffer, numberOfPixels,
+        fractions, quantiles, this->m_SketchSize );
+      PrintPercentiles( percentiles, quantiles, count,
+        itktools::QuantileSketch::GetNormalizedRankError( this->m_SketchSize ) );
+    }
   }
 
 } // end ComputeStatistics()
 
 
+/**
+ * ************************ CheckMaskRegion **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+void
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::CheckMaskRegion(
+  const InternalImageType * inputImage,
+  const MaskImageType * maskImage )
+{
+  if( maskImage
+    && maskImage->GetBufferedRegion() != inputImage->GetBufferedRegion() )
+  {
+    itkGenericExceptionMacro( << "The mask image should have the same region as the input image.\n"
+      << "Input region: " << inputImage->GetBufferedRegion()
+      << "Mask region: " << maskImage->GetBufferedRegion() );
+  }
+
+} // end CheckMaskRegion()
+
+
+/**
+ * ************************ ComputeLabelStatistics **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+void
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::ComputeLabelStatistics(
+  const InternalImageType * inputImage,
+  const MaskImageType * maskImage )
+{
+  typedef itk::ImageFileReader< LabelImageType >      LabelReaderType;
+
+  /** Read the label image. */
+  typename LabelReaderType::Pointer labelReader = LabelReaderType::New();
+  labelReader->SetFileName( this->m_LabelFileName.c_str() );
+  labelReader->Update();
+  const LabelImageType * labelImage = labelReader->GetOutput();
+
+  if( labelImage->GetLargestPossibleRegion().GetSize()
+    != inputImage->GetLargestPossibleRegion().GetSize() )
+  {
+    itkGenericExceptionMacro( << "The label image should have the same size as the input image." );
+  }
+
+  std::cout << "Computing label statistics ..." << std::endl;
+
+  this->CheckMaskRegion( inputImage, maskImage );
+  LabelThreadStruct str;
+  str.ImageBuffer = inputImage->GetBufferPointer();
+  str.LabelBuffer = labelImage->GetBufferPointer();
+  str.MaskBuffer = maskImage ? maskImage->GetBufferPointer() : 0;
+  str.NumberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+
+  /** Every thread collects its own labels and their statistics in a
+   * single pass; no label range or unique labels are determined first.
+   */
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::ThreadIdType numberOfThreads = threader->GetNumberOfThreads();
+  const bool computePercentiles = !this->m_Percentiles.empty();
+  str.ComputePercentiles = computePercentiles;
+  str.SketchSize = this->m_SketchSize;
+  str.ThreadData.resize( numberOfThreads );
+
+  threader->SetSingleMethod( LabelThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  /** Collect the distinct labels of all threads, in ascending order. */
+  std::vector<LabelPixelType> labels;
+  for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    labels.insert( labels.end(),
+      str.ThreadData[ t ].Labels.begin(), str.ThreadData[ t ].Labels.end() );
+  }
+  std::sort( labels.begin(), labels.end() );
+  labels.erase( std::unique( labels.begin(), labels.end() ), labels.end() );
+  const std::size_t numberOfLabels = labels.size();
+
+  /** Merge the thread results, in thread order. */
+  LabelAccumulator empty;
+  empty.Count = 0;
+  empty.Mean = empty.M2 = empty.Sum = 0.0;
+  empty.Minimum = itk::NumericTraits<double>::max();
+  empty.Maximum = itk::NumericTraits<double>::NonpositiveMin();
+  std::vector<LabelAccumulator> total( numberOfLabels, empty );
+  std::vector<itktools::QuantileSketch> sketches;
+  if( computePercentiles )
+  {
+    sketches.resize( numberOfLabels, itktools::QuantileSketch( this->m_SketchSize ) );
+  }
+  for( std::size_t l = 0; l < numberOfLabels; ++l )
+  {
+    bool first = true;
+    for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+    {
+      const LabelThreadData & data = str.ThreadData[ t ];
+      const std::size_t index = FindLabel( data, labels[ l ] );
+      if( index == data.Labels.size() ) continue;
+
+      const LabelAccumulator & other = data.Accumulators[ index ];
+      LabelAccumulator & acc = total[ l ];
+      if( first )
+      {
+        acc = other;
+        if( computePercentiles ) sketches[ l ] = data.Sketches[ index ];
+        first = false;
+        continue;
+      }
+      const double n1 = static_cast<double>( acc.Count );
+      const double n2 = static_cast<double>( other.Count );
+      const double delta = other.Mean - acc.Mean;
+      acc.Count += other.Count;
+      acc.Mean += delta * n2 / ( n1 + n2 );
+      acc.M2 += other.M2 + delta * delta * n1 * n2 / ( n1 + n2 );
+      acc.Sum += other.Sum;
+      acc.Minimum = vnl_math_min( acc.Minimum, other.Minimum );
+      acc.Maximum = vnl_math_max( acc.Maximum, other.Maximum );
+      if( computePercentiles )
+      {
+        sketches[ l ].Merge( data.Sketches[ index ] );
+      }
+    }
+  }
+
+  /** Write the table. */
+  std::ofstream outputFile;
+  if( this->m_LabelOutputFileName != "" )
+  {
+    outputFile.open( this->m_LabelOutputFileName.c_str() );
+    if( !outputFile.is_open() )
+    {
+      itkGenericExceptionMacro( << "ERROR: Output file for label statistics cannot be opened!" );
+    }
+    std::cout << "Label statistics are written to file: "
+      << this->m_LabelOutputFileName << " ..." << std::endl;
+  }
+  std::ostream & out = outputFile.is_open()
+    ? static_cast<std::ostream &>( outputFile ) : std::cout;
+
+  std::vector<double> fractions( this->m_Percentiles.size() );
+  for( std::size_t i = 0; i < fractions.size(); ++i )
+  {
+    fractions[ i ] = this->m_Percentiles[ i ] / 100.0;
+  }
+
+  out << std::setprecision( 10 );
+  out << "label,count,mean,std,min,max,sum";
+  for( std::size_t i = 0; i < this->m_Percentiles.size(); ++i )
+  {
+    out << ",p" << this->m_Percentiles[ i ];
+  }
+  out << std::endl;
+  for( std::size_t l = 0; l < numberOfLabels; ++l )
+  {
+    const LabelAccumulator & acc = total[ l ];
+    if( acc.Count == 0 ) continue;
+
+    const LabelPixelType label = labels[ l ];
+    const double sigma = acc.Count > 1
+      ? vcl_sqrt( acc.M2 / static_cast<double>( acc.Count - 1 ) ) : 0.0;
+    out << label << "," << acc.Count << "," << acc.Mean << "," << sigma
+      << "," << acc.Minimum << "," << acc.Maximum << "," << acc.Sum;
+    if( computePercentiles )
+    {
+      const std::vector<double> quantiles = sketches[ l ].GetQuantiles( fractions );
+      for( std::size_t i = 0; i < quantiles.size(); ++i )
+      {
+        out << "," << quantiles[ i ];
+      }
+    }
+    out << std::endl;
+  }
+
+} // end ComputeLabelStatistics()
+
+
+/**
+ * ************************ LabelThreaderCallback **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+ITK_THREAD_RETURN_TYPE
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::LabelThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * info
+    = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  LabelThreadStruct * str = static_cast<LabelThreadStruct *>( info->UserData );
+  const itk::ThreadIdType threadId = info->ThreadID;
+  const itk::ThreadIdType numberOfThreads = info->NumberOfThreads;
+
+  /** Determine the chunk of this thread. */
+  const std::size_t chunk = ( str->NumberOfPixels + numberOfThreads - 1 ) / numberOfThreads;
+  const std::size_t begin = vnl_math_min( str->NumberOfPixels, threadId * chunk );
+  const std::size_t end = vnl_math_min( str->NumberOfPixels, begin + chunk );
+
+  /** Consecutive pixels often have the same label, so the last one is
+   * remembered to skip most hash table lookups.
+   */
+  LabelThreadData & data = str->ThreadData[ threadId ];
+  bool hasPreviousLabel = false;
+  LabelPixelType previousLabel = 0;
+  std::size_t index = 0;
+
+  for( std::size_t i = begin; i < end; ++i )
+  {
+    if( str->MaskBuffer && !str->MaskBuffer[ i ] ) continue;
+
+    const LabelPixelType label = str->LabelBuffer[ i ];
+    if( !hasPreviousLabel || label != previousLabel )
+    {
+      index = FindOrAddLabel( data, label, *str );
+      previousLabel = label;
+      hasPreviousLabel = true;
+    }
+
+    const double value = str->ImageBuffer[ i ];
+    LabelAccumulator & acc = data.Accumulators[ index ];
+    ++acc.Count;
+    const double delta = value - acc.Mean;
+    acc.Mean += delta / static_cast<double>( acc.Count );
+    acc.M2 += delta * ( value - acc.Mean );
+    acc.Sum += value;
+    acc.Minimum = value < acc.Minimum ? value : acc.Minimum;
+    acc.Maximum = value > acc.Maximum ? value : acc.Maximum;
+    if( str->ComputePercentiles ) data.Sketches[ index ].Insert( value );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end LabelThreaderCallback()
+
+
+/**
+ * ************************ FindLabel **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+std::size_t
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::FindLabel( const LabelThreadData & data, const LabelPixelType & label )
+{
+  if( data.HashIndices.empty() ) return data.Labels.size();
+
+  const std::size_t mask = data.HashIndices.size() - 1;
+  for( std::size_t bucket = HashLabel( label, mask ); ; bucket = ( bucket + 1 ) & mask )
+  {
+    if( data.HashIndices[ bucket ] == 0 ) return data.Labels.size();
+    if( data.HashLabels[ bucket ] == label ) return data.HashIndices[ bucket ] - 1;
+  }
+
+} // end FindLabel()
+
+
+/**
+ * ************************ FindOrAddLabel **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+std::size_t
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::FindOrAddLabel( LabelThreadData & data, const LabelPixelType & label,
+  const LabelThreadStruct & str )
+{
+  /** Keep the hash table at most half full; rehash all labels if it grows. */
+  if( 2 * ( data.Labels.size() + 1 ) > data.HashIndices.size() )
+  {
+    const std::size_t size = vnl_math_max(
+      static_cast<std::size_t>( 64 ), 2 * data.HashIndices.size() );
+    const std::size_t mask = size - 1;
+    data.HashLabels.assign( size, 0 );
+    data.HashIndices.assign( size, 0 );
+    for( std::size_t l = 0; l < data.Labels.size(); ++l )
+    {
+      std::size_t bucket = HashLabel( data.Labels[ l ], mask );
+      while( data.HashIndices[ bucket ] != 0 ) bucket = ( bucket + 1 ) & mask;
+      data.HashLabels[ bucket ] = data.Labels[ l ];
+      data.HashIndices[ bucket ] = l + 1;
+    }
+  }
+
+  const std::size_t mask = data.HashIndices.size() - 1;
+  std::size_t bucket = HashLabel( label, mask );
+  while( data.HashIndices[ bucket ] != 0 )
+  {
+    if( data.HashLabels[ bucket ] == label ) return data.HashIndices[ bucket ] - 1;
+    bucket = ( bucket + 1 ) & mask;
+  }
+
+  /** A new label. */
+  LabelAccumulator empty;
+  empty.Count = 0;
+  empty.Mean = empty.M2 = empty.Sum = 0.0;
+  empty.Minimum = itk::NumericTraits<double>::max();
+  empty.Maximum = itk::NumericTraits<double>::NonpositiveMin();
+  data.Labels.push_back( label );
+  data.Accumulators.push_back( empty );
+  if( str.ComputePercentiles )
+  {
+    data.Sketches.push_back( itktools::QuantileSketch( str.SketchSize ) );
+  }
+  data.HashLabels[ bucket ] = label;
+  data.HashIndices[ bucket ] = data.Labels.size();
+  return data.Labels.size() - 1;
+
+} // end FindOrAddLabel()
+
+
+/**
+ * ************************ ComputeHistogram **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+void
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::ComputeHistogram(
+  const InternalImageType * inputImage,
+  const MaskImageType * maskImage,
+  HistogramType * histogram )
+{
+  const unsigned int numberOfBins = histogram->GetSize( 0 );
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::ThreadIdType numberOfThreads = threader->GetNumberOfThreads();
+
+  /** Setup the job. The image and mask buffers have the same size,
+   * so that they can be traversed in memory order.
+   */
+  this->CheckMaskRegion( inputImage, maskImage );
+  HistogramThreadStruct str;
+  str.ImageBuffer = inputImage->GetBufferPointer();
+  str.MaskBuffer = maskImage ? maskImage->GetBufferPointer() : 0;
+  str.NumberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+  str.BinMinima.resize( numberOfBins + 1 );
+  for( unsigned int i = 0; i < numberOfBins; ++i )
+  {
+    str.BinMinima[ i ] = histogram->GetBinMin( 0, i );
+  }
+  str.BinMinima[ numberOfBins ] = histogram->GetBinMax( 0, numberOfBins - 1 );
+  str.Frequencies.resize( numberOfThreads,
+    std::vector<itk::SizeValueType>( numberOfBins, 0 ) );
+
+  threader->SetSingleMethod( HistogramThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  /** Merge the thread results. */
+  for( unsigned int i = 0; i < numberOfBins; ++i )
+  {
+    itk::SizeValueType frequency = 0;
+    for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+    {
+      frequency += str.Frequencies[ t ][ i ];
+    }
+    histogram->SetFrequency( i, frequency );
+  }
+
+} // end ComputeHistogram()
+
+
+/**
+ * ************************ HistogramThreaderCallback **************************
+ */
+
+template< unsigned int VDimension, unsigned int VNumberOfComponents, class TComponentType >
+ITK_THREAD_RETURN_TYPE
+ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
+::HistogramThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * info
+    = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  HistogramThreadStruct * str = static_cast<HistogramThreadStruct *>( info->UserData );
+  const itk::ThreadIdType threadId = info->ThreadID;
+  const itk::ThreadIdType numberOfThreads = info->NumberOfThreads;
+
+  /** Determine the chunk of this thread. */
+  const std::size_t chunk = ( str->NumberOfPixels + numberOfThreads - 1 ) / numberOfThreads;
+  const std::size_t begin = vnl_math_min( str->NumberOfPixels, threadId * chunk );
+  const std::size_t end = vnl_math_min( str->NumberOfPixels, begin + chunk );
+
+  const std::vector<double> & binMinima = str->BinMinima;
+  const std::size_t numberOfBins = binMinima.size() - 1;
+  const double lowerBound = binMinima[ 0 ];
+  const double upperBound = binMinima[ numberOfBins ];
+  const double scale = static_cast<double>( numberOfBins ) / ( upperBound - lowerBound );
+  std::vector<itk::SizeValueType> & frequencies = str->Frequencies[ threadId ];
+
+  for( std::size_t i = begin; i < end; ++i )
+  {
+    if( str->MaskBuffer && !str->MaskBuffer[ i ] ) continue;
+
+    /** Values outside the histogram range are not counted. */
+    const double value = str->ImageBuffer[ i ];
+    if( !( value >= lowerBound && value < upperBound ) ) continue;
+
+    /** Direct bin computation, corrected for round-off such that
+     * the bin boundaries of the histogram are respected exactly.
+     */
+    std::size_t bin = static_cast<std::size_t>( ( value - lowerBound ) * scale );
+    if( bin >= numberOfBins ) bin = numberOfBins - 1;
+    while( bin > 0 && value < binMinima[ bin ] ) --bin;
+    while( bin + 1 < numberOfBins && value >= binMinima[ bin + 1 ] ) ++bin;
+    ++frequencies[ bin ];
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end HistogramThreaderCallback()
+
+
 /**
  * ******************* DetermineHistogramMaximum *******************
  */
@@ -310,8 +717,8 @@ ITKToolsStatisticsOnImage< VDimension, VNumberOfComponents, TComponentType >
   {
     /** Overflow occurred; maximum was already maximum of pixeltype;
      * We could solve this somehow (by adding a ClipBinsAtUpperBound(bool)
-     * function to the itkScalarImageToHistogramGenerator2, and calling it
-     * with argument 'false'), but the situation is quite unlikely; anyway,
+     * option to ComputeHistogram(), that includes the upper bound in the
+     * last bin), but the situation is quite unlikely; anyway,
      * mostly something is going wrong when a float image has value
      * infinity somewhere.
      */
@@ -21,8 +21,10 @@
 
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <vector>
 
-/** this file defines three function that print statistics information */
+/** this file defines functions that print statistics information */
 
 /**
  * Print the results of an itk::StatisticsImageFilter
@@ -45,9 +47,9 @@ void PrintStatistics( const TStatisticsFilter * statistics )
 
 
 /**
- * Print the results of an itk::StatisticsImageFilter
- * Assume that statistics were calculated on the log
- * of the actual image. exp gives the Geometric mean.
+ * Print the geometric statistics of an itk::StatisticsImageFilter,
+ * computed with ComputeLogStatistics on. exp of the mean of the log
+ * gives the Geometric mean.
  */
 
 template<class TStatisticsFilter>
@@ -55,8 +57,8 @@ void PrintGeometricStatistics( const TStatisticsFilter * statistics )
 {
   /** Print to screen. */
   std::cout << std::setprecision(10);
-  double geometricmean = vcl_exp( statistics->GetMean() );
-  double geometricstdev = vcl_exp( statistics->GetSigma() );
+  double geometricmean = vcl_exp( statistics->GetLogMean() );
+  double geometricstdev = vcl_exp( statistics->GetLogSigma() );
   std::cout << "\tgeometric mean : " << geometricmean << std::endl;
   std::cout << "\tgeometric stdev: " << geometricstdev << std::endl;
 
@@ -138,4 +140,37 @@ void PrintHistogramStatistics( const THistogram * histogram,
 } // end PrintHistogramStatistics()
 
 
+/**
+ * Print percentiles. The normalized rank error is 0 for exact percentiles.
+ */
+
+inline void PrintPercentiles( const std::vector<double> & percentiles,
+  const std::vector<double> & values, const itk::uint64_t & count,
+  const double & rankError )
+{
+  std::cout << std::setprecision( 10 );
+  std::cout << "\tnumber of pixels:\t" << count << std::endl;
+  if( rankError > 0.0 )
+  {
+    std::cout << "\trank error:      \t" << 100.0 * rankError
+      << "% (99% confidence)" << std::endl;
+  }
+  for( std::size_t i = 0; i < percentiles.size(); ++i )
+  {
+    std::ostringstream name;
+    if( percentiles[ i ] == 50.0 )
+    {
+      name << "median:";
+    }
+    else
+    {
+      name << "percentile " << percentiles[ i ] << ":";
+    }
+    std::cout << "\t" << std::left << std::setw( 17 ) << name.str()
+      << std::right << "\t" << values[ i ] << std::endl;
+  }
+
+} // end PrintPercentiles()
+
+
 #endif // #ifndef __statisticsprinters_h
@@ -0,0 +1,449 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __statisticsquantiles_h_
+#define __statisticsquantiles_h_
+
+#include "itkIntTypes.h"
+#include "itkMultiThreader.h"
+#include "ITKToolsQuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/** this file defines functions that compute quantiles of an image buffer,
+ * either approximately with mergeable sketches, or exactly with a
+ * multi-threaded radix selection. Pixels for which the mask is zero are
+ * skipped, as are NaN values.
+ */
+
+
+/** Struct to pass a quantile job to the threads. */
+template<class TPixel, class TMask>
+struct QuantileThreadStruct
+{
+  const TPixel *  ImageBuffer;
+  const TMask *   MaskBuffer;
+  std::size_t     NumberOfPixels;
+
+  /** Sketch per thread. */
+  std::vector<itktools::QuantileSketch> Sketches;
+
+  /** Per target: the key prefix and the number of bits of the next digit. */
+  std::vector<itk::uint64_t>  Prefixes;
+  std::vector<unsigned int>   PrefixBits;
+  std::vector<unsigned int>   DigitBits;
+
+  /** Per thread, per target: a histogram of the next digit,
+   * or the gathered values.
+   */
+  std::vector< std::vector< std::vector<itk::uint64_t> > >  Histograms;
+  std::vector< std::vector< std::vector<double> > >         Values;
+};
+
+
+/**
+ * Map a double to an unsigned integer with the same ordering.
+ */
+
+inline itk::uint64_t QuantileKey( const double & value )
+{
+  const itk::uint64_t signBit = static_cast<itk::uint64_t>( 1 ) << 63;
+  itk::uint64_t bits;
+  std::memcpy( &bits, &value, sizeof( bits ) );
+  return ( bits & signBit ) ? ~bits : ( bits | signBit );
+}
+
+
+/**
+ * The inverse of QuantileKey().
+ */
+
+inline double QuantileKeyToValue( const itk::uint64_t & key )
+{
+  const itk::uint64_t signBit = static_cast<itk::uint64_t>( 1 ) << 63;
+  const itk::uint64_t bits = ( key & signBit ) ? ( key & ~signBit ) : ~key;
+  double value;
+  std::memcpy( &value, &bits, sizeof( value ) );
+  return value;
+}
+
+
+/**
+ * Get the chunk of the buffer of a thread.
+ */
+
+inline void GetQuantileThreadChunk( std::size_t numberOfPixels,
+  itk::ThreadIdType threadId, itk::ThreadIdType numberOfThreads,
+  std::size_t & begin, std::size_t & end )
+{
+  const std::size_t chunk = ( numberOfPixels + numberOfThreads - 1 ) / numberOfThreads;
+  begin = std::min( numberOfPixels, threadId * chunk );
+  end = std::min( numberOfPixels, begin + chunk );
+}
+
+
+/**
+ * Thread callback that fills a sketch per thread.
+ */
+
+template<class TPixel, class TMask>
+ITK_THREAD_RETURN_TYPE QuantileSketchThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * info
+    = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  QuantileThreadStruct<TPixel, TMask> * str
+    = static_cast<QuantileThreadStruct<TPixel, TMask> *>( info->UserData );
+
+  std::size_t begin, end;
+  GetQuantileThreadChunk( str->NumberOfPixels, info->ThreadID, info->NumberOfThreads, begin, end );
+
+  itktools::QuantileSketch & sketch = str->Sketches[ info->ThreadID ];
+  for( std::size_t i = begin; i < end; ++i )
+  {
+    if( str->MaskBuffer && !str->MaskBuffer[ i ] ) continue;
+    const double value = static_cast<double>( str->ImageBuffer[ i ] );
+    if( value != value ) continue;
+    sketch.Insert( value );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end QuantileSketchThreaderCallback()
+
+
+/**
+ * Thread callback that computes, for every target, the histogram of the
+ * next digit of the keys that match the prefix of that target.
+ */
+
+template<class TPixel, class TMask>
+ITK_THREAD_RETURN_TYPE QuantileRadixThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * info
+    = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  QuantileThreadStruct<TPixel, TMask> * str
+    = static_cast<QuantileThreadStruct<TPixel, TMask> *>( info->UserData );
+
+  std::size_t begin, end;
+  GetQuantileThreadChunk( str->NumberOfPixels, info->ThreadID, info->NumberOfThreads, begin, end );
+
+  std::vector< std::vector<itk::uint64_t> > & histograms = str->Histograms[ info->ThreadID ];
+  const std::size_t numberOfTargets = str->Prefixes.size();
+  for( std::size_t i = begin; i < end; ++i )
+  {
+    if( str->MaskBuffer && !str->MaskBuffer[ i ] ) continue;
+    const double value = static_cast<double>( str->ImageBuffer[ i ] );
+    if( value != value ) continue;
+    const itk::uint64_t key = QuantileKey( value );
+
+    for( std::size_t t = 0; t < numberOfTargets; ++t )
+    {
+      const unsigned int prefixBits = str->PrefixBits[ t ];
+      if( prefixBits > 0 && ( key >> ( 64 - prefixBits ) ) != str->Prefixes[ t ] ) continue;
+      const unsigned int digitBits = str->DigitBits[ t ];
+      const itk::uint64_t digit = ( key >> ( 64 - prefixBits - digitBits ) )
+        & ( ( static_cast<itk::uint64_t>( 1 ) << digitBits ) - 1 );
+      ++histograms[ t ][ digit ];
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end QuantileRadixThreaderCallback()
+
+
+/**
+ * Thread callback that gathers, for every target, the values
+ * of which the key matches the prefix of that target.
+ */
+
+template<class TPixel, class TMask>
+ITK_THREAD_RETURN_TYPE QuantileGatherThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * info
+    = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  QuantileThreadStruct<TPixel, TMask> * str
+    = static_cast<QuantileThreadStruct<TPixel, TMask> *>( info->UserData );
+
+  std::size_t begin, end;
+  GetQuantileThreadChunk( str->NumberOfPixels, info->ThreadID, info->NumberOfThreads, begin, end );
+
+  std::vector< std::vector<double> > & values = str->Values[ info->ThreadID ];
+  const std::size_t numberOfTargets = str->Prefixes.size();
+  for( std::size_t i = begin; i < end; ++i )
+  {
+    if( str->MaskBuffer && !str->MaskBuffer[ i ] ) continue;
+    const double value = static_cast<double>( str->ImageBuffer[ i ] );
+    if( value != value ) continue;
+    const itk::uint64_t key = QuantileKey( value );
+
+    for( std::size_t t = 0; t < numberOfTargets; ++t )
+    {
+      if( ( key >> ( 64 - str->PrefixBits[ t ] ) ) == str->Prefixes[ t ] )
+      {
+        values[ t ].push_back( value );
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end QuantileGatherThreaderCallback()
+
+
+/**
+ * Compute approximate quantiles with one sketch per thread, which are
+ * merged afterwards. The fractions are in [0,1]. Returns the number of
+ * values that were taken into account.
+ */
+
+template<class TPixel, class TMask>
+itk::uint64_t ComputeApproximateQuantiles(
+  const TPixel * imageBuffer, const TMask * maskBuffer,
+  const std::size_t & numberOfPixels,
+  const std::vector<double> & fractions,
+  std::vector<double> & quantiles,
+  unsigned int k = 200 )
+{
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::ThreadIdType numberOfThreads = threader->GetNumberOfThreads();
+
+  QuantileThreadStruct<TPixel, TMask> str;
+  str.ImageBuffer = imageBuffer;
+  str.MaskBuffer = maskBuffer;
+  str.NumberOfPixels = numberOfPixels;
+  str.Sketches.resize( numberOfThreads, itktools::QuantileSketch( k ) );
+
+  threader->SetSingleMethod( QuantileSketchThreaderCallback<TPixel, TMask>, &str );
+  threader->SingleMethodExecute();
+
+  itktools::QuantileSketch sketch( k );
+  for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    sketch.Merge( str.Sketches[ t ] );
+  }
+  quantiles = sketch.GetQuantiles( fractions );
+
+  return sketch.GetCount();
+
+} // end ComputeApproximateQuantiles()
+
+
+/**
+ * Compute exact quantiles by a multi-threaded radix selection.
+ *
+ * The values are mapped to 64-bit keys with the same ordering. Every pass
+ * over the buffer determines the next 12 bits of the key of each requested
+ * rank, by a histogram of the keys that share the bits found so far.
+ * Once the number of candidates is small, they are gathered and the rank
+ * is found with std::nth_element. No copy of the image is made.
+ *
+ * The q-quantile is interpolated linearly between the order statistics
+ * around rank q (n - 1). Returns the number of values that were taken
+ * into account.
+ */
+
+template<class TPixel, class TMask>
+itk::uint64_t ComputeExactQuantiles(
+  const TPixel * imageBuffer, const TMask * maskBuffer,
+  const std::size_t & numberOfPixels,
+  const std::vector<double> & fractions,
+  std::vector<double> & quantiles )
+{
+  const unsigned int digitBits = 12;
+  const itk::uint64_t gatherThreshold = static_cast<itk::uint64_t>( 1 ) << 20;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::ThreadIdType numberOfThreads = threader->GetNumberOfThreads();
+
+  QuantileThreadStruct<TPixel, TMask> str;
+  str.ImageBuffer = imageBuffer;
+  str.MaskBuffer = maskBuffer;
+  str.NumberOfPixels = numberOfPixels;
+
+  /** Histogram of the first digit, to count the values. */
+  str.Prefixes.assign( 1, 0 );
+  str.PrefixBits.assign( 1, 0 );
+  str.DigitBits.assign( 1, digitBits );
+  str.Histograms.assign( numberOfThreads, std::vector< std::vector<itk::uint64_t> >(
+    1, std::vector<itk::uint64_t>( 1u << digitBits, 0 ) ) );
+  threader->SetSingleMethod( QuantileRadixThreaderCallback<TPixel, TMask>, &str );
+  threader->SingleMethodExecute();
+
+  std::vector<itk::uint64_t> firstHistogram( 1u << digitBits, 0 );
+  itk::uint64_t count = 0;
+  for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+  {
+    for( std::size_t b = 0; b < firstHistogram.size(); ++b )
+    {
+      firstHistogram[ b ] += str.Histograms[ t ][ 0 ][ b ];
+    }
+  }
+  for( std::size_t b = 0; b < firstHistogram.size(); ++b )
+  {
+    count += firstHistogram[ b ];
+  }
+
+  quantiles.assign( fractions.size(), 0.0 );
+  if( count == 0 ) return 0;
+
+  /** The ranks that are needed for the interpolation. */
+  std::vector<itk::uint64_t> ranks;
+  for( std::size_t j = 0; j < fractions.size(); ++j )
+  {
+    const double q = std::min( 1.0, std::max( 0.0, fractions[ j ] ) );
+    const double position = q * static_cast<double>( count - 1 );
+    const itk::uint64_t lower = static_cast<itk::uint64_t>( std::floor( position ) );
+    ranks.push_back( lower );
+    ranks.push_back( std::min( lower + 1, count - 1 ) );
+  }
+  std::sort( ranks.begin(), ranks.end() );
+  ranks.erase( std::unique( ranks.begin(), ranks.end() ), ranks.end() );
+  const std::size_t numberOfTargets = ranks.size();
+
+  /** Per target: the prefix found so far, the rank within the values
+   * that share the prefix, and their number.
+   */
+  std::vector<itk::uint64_t> prefixes( numberOfTargets, 0 );
+  std::vector<unsigned int> prefixBits( numberOfTargets, 0 );
+  std::vector<itk::uint64_t> residualRanks( ranks );
+  std::vector<itk::uint64_t> candidates( numberOfTargets, count );
+  std::vector<double> results( numberOfTargets, 0.0 );
+  std::vector<bool> done( numberOfTargets, false );
+
+  /** Select the bucket of a target in a merged histogram. */
+  std::vector< std::vector<itk::uint64_t> > histograms( numberOfTargets, firstHistogram );
+  std::vector<std::size_t> active( numberOfTargets );
+  for( std::size_t t = 0; t < numberOfTargets; ++t ) active[ t ] = t;
+
+  while( !active.empty() )
+  {
+    /** Descend one digit for the active targets. */
+    for( std::size_t a = 0; a < active.size(); ++a )
+    {
+      const std::size_t t = active[ a ];
+      const std::vector<itk::uint64_t> & histogram = histograms[ a ];
+      const unsigned int bits = std::min( digitBits, 64 - prefixBits[ t ] );
+      std::size_t b = 0;
+      while( residualRanks[ t ] >= histogram[ b ] )
+      {
+        residualRanks[ t ] -= histogram[ b ];
+        ++b;
+      }
+      prefixes[ t ] = ( prefixes[ t ] << bits ) | b;
+      prefixBits[ t ] += bits;
+      candidates[ t ] = histogram[ b ];
+
+      /** All values with this key are equal. */
+      if( prefixBits[ t ] == 64 )
+      {
+        results[ t ] = QuantileKeyToValue( prefixes[ t ] );
+        done[ t ] = true;
+      }
+    }
+
+    /** The targets that need another histogram pass. */
+    active.clear();
+    for( std::size_t t = 0; t < numberOfTargets; ++t )
+    {
+      if( !done[ t ] && candidates[ t ] > gatherThreshold ) active.push_back( t );
+    }
+    if( active.empty() ) break;
+
+    str.Prefixes.resize( active.size() );
+    str.PrefixBits.resize( active.size() );
+    str.DigitBits.resize( active.size() );
+    for( std::size_t a = 0; a < active.size(); ++a )
+    {
+      str.Prefixes[ a ] = prefixes[ active[ a ] ];
+      str.PrefixBits[ a ] = prefixBits[ active[ a ] ];
+      str.DigitBits[ a ] = std::min( digitBits, 64 - prefixBits[ active[ a ] ] );
+    }
+    str.Histograms.assign( numberOfThreads, std::vector< std::vector<itk::uint64_t> >(
+      active.size(), std::vector<itk::uint64_t>( 1u << digitBits, 0 ) ) );
+    threader->SingleMethodExecute();
+
+    histograms.assign( active.size(), std::vector<itk::uint64_t>( 1u << digitBits, 0 ) );
+    for( itk::ThreadIdType th = 0; th < numberOfThreads; ++th )
+    {
+      for( std::size_t a = 0; a < active.size(); ++a )
+      {
+        for( std::size_t b = 0; b < histograms[ a ].size(); ++b )
+        {
+          histograms[ a ][ b ] += str.Histograms[ th ][ a ][ b ];
+        }
+      }
+    }
+  }
+
+  /** Gather the remaining candidates and select. */
+  std::vector<std::size_t> gather;
+  for( std::size_t t = 0; t < numberOfTargets; ++t )
+  {
+    if( !done[ t ] ) gather.push_back( t );
+  }
+  if( !gather.empty() )
+  {
+    str.Prefixes.resize( gather.size() );
+    str.PrefixBits.resize( gather.size() );
+    for( std::size_t g = 0; g < gather.size(); ++g )
+    {
+      str.Prefixes[ g ] = prefixes[ gather[ g ] ];
+      str.PrefixBits[ g ] = prefixBits[ gather[ g ] ];
+    }
+    str.Values.assign( numberOfThreads,
+      std::vector< std::vector<double> >( gather.size() ) );
+    threader->SetSingleMethod( QuantileGatherThreaderCallback<TPixel, TMask>, &str );
+    threader->SingleMethodExecute();
+
+    for( std::size_t g = 0; g < gather.size(); ++g )
+    {
+      std::vector<double> values;
+      values.reserve( candidates[ gather[ g ] ] );
+      for( itk::ThreadIdType th = 0; th < numberOfThreads; ++th )
+      {
+        values.insert( values.end(),
+          str.Values[ th ][ g ].begin(), str.Values[ th ][ g ].end() );
+      }
+      const std::size_t t = gather[ g ];
+      std::nth_element( values.begin(), values.begin() + residualRanks[ t ], values.end() );
+      results[ t ] = values[ residualRanks[ t ] ];
+    }
+  }
+
+  /** Interpolate. */
+  for( std::size_t j = 0; j < fractions.size(); ++j )
+  {
+    const double q = std::min( 1.0, std::max( 0.0, fractions[ j ] ) );
+    const double position = q * static_cast<double>( count - 1 );
+    const itk::uint64_t lower = static_cast<itk::uint64_t>( std::floor( position ) );
+    const itk::uint64_t upper = std::min( lower + 1, count - 1 );
+    const double lowerValue = results[ std::lower_bound( ranks.begin(), ranks.end(), lower ) - ranks.begin() ];
+    const double upperValue = results[ std::lower_bound( ranks.begin(), ranks.end(), upper ) - ranks.begin() ];
+    const double weight = position - static_cast<double>( lower );
+    quantiles[ j ] = lowerValue + weight * ( upperValue - lowerValue );
+  }
+
+  return count;
+
+} // end ComputeExactQuantiles()
+
+
+#endif // #ifndef __statisticsquantiles_h_
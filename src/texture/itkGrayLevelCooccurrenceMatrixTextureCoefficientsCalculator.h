@@ -37,6 +37,8 @@
 #include "itkHistogram.h"
 #include "itkMacro.h"
 
+#include <vector>
+
 namespace itk {
 namespace Statistics {
 
@@ -147,6 +149,14 @@ public:
   /** Triggers the computation of the histogram. */
   virtual void Compute( void );
 
+  /** Compute the features from a dense co-occurrence matrix of
+   * binsPerAxis x binsPerAxis counts, instead of from the histogram.
+   * The first index runs fastest, as in the histogram, so that the
+   * results are the same as for the equivalent histogram.
+   */
+  virtual void Compute( const AbsoluteFrequencyType * matrix,
+    SizeValueType binsPerAxis );
+
   /** Connects the GLCM histogram over which the features are going to be computed. */
   itkSetObjectMacro( Histogram, HistogramType );
   itkGetObjectMacro( Histogram, HistogramType );
@@ -185,6 +195,12 @@ private:
 
   virtual void ResetFeatureValues( void );
 
+  /** Fill the tables below for the given number of bins, if needed. */
+  void InitializeTables( SizeValueType binsPerAxis );
+
+  /** Get count * log2( count ), from a table that grows on demand. */
+  double GetCountLogCount( AbsoluteFrequencyType count );
+
   /** The member variables: input histogram. */
   HistogramPointer  m_Histogram;
 
@@ -198,6 +214,17 @@ private:
   double            m_ClusterProminence;
   double            m_HaralickCorrelation;
 
+  /** Tables for Compute(), the calculator is reused for many windows.
+   * The powers 1 to 4 of the indices, the weights of the index
+   * difference for the InverseDifferenceMoment and Inertia, and
+   * count * log2( count ) for the Entropy.
+   */
+  std::vector<double> m_Powers;
+  std::vector<double> m_InverseDifferenceWeights;
+  std::vector<double> m_InertiaWeights;
+  std::vector<double> m_MarginalSums;
+  std::vector<double> m_CountLogCountTable;
+
 }; // end class GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator
 
 
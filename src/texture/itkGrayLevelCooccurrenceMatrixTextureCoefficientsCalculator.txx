@@ -38,6 +38,7 @@
 
 #include "itkNumericTraits.h"
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 namespace itk {
 namespace Statistics {
@@ -85,15 +86,53 @@ template< class THistogram >
 void
 GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator< THistogram >
 ::Compute( void )
+{
+  /** Copy the histogram to a dense matrix, in the order of the
+   * instance identifiers, i.e. the first index running fastest.
+   */
+  const SizeValueType binsPerAxis = this->m_Histogram->GetSize( 0 );
+  std::vector<AbsoluteFrequencyType> matrix( binsPerAxis * binsPerAxis, 0 );
+  HistogramConstIterator hit( this->m_Histogram );
+  for ( hit = this->m_Histogram->Begin(); hit != this->m_Histogram->End(); ++hit )
+  {
+    matrix[ hit.GetInstanceIdentifier() ] = hit.GetFrequency();
+  }
+
+  this->Compute( &matrix[ 0 ], binsPerAxis );
+
+} // end Compute()
+
+
+/**
+ * ********************* Compute ****************************
+ */
+
+template< class THistogram >
+void
+GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator< THistogram >
+::Compute( const AbsoluteFrequencyType * matrix, SizeValueType binsPerAxis )
 {
   /** Reset the feature values. */
   this->ResetFeatureValues();
 
-  /** Get the total histogram frequency and size. */
-  double totalFrequency = this->m_Histogram->GetTotalFrequency();
-  typename HistogramType::SizeValueType binsPerAxis = this->m_Histogram->GetSize( 0 );
+  /** Get the total frequency. */
+  const SizeValueType numberOfEntries = binsPerAxis * binsPerAxis;
+  double totalFrequency = 0.0;
+  for( SizeValueType i = 0; i < numberOfEntries; ++i )
+  {
+    totalFrequency += matrix[ i ];
+  }
+
+  if( totalFrequency == 0.0 ) return;
+
+  /** The tables that only depend on the number of bins. */
+  this->InitializeTables( binsPerAxis );
+  const double * power1 = &this->m_Powers[ 0 ];
+  const double * power2 = power1 + binsPerAxis;
+  const double * power3 = power2 + binsPerAxis;
+  const double * power4 = power3 + binsPerAxis;
 
-  /** Temporary variables. */
+  /** Temporary variables, sums of counts times powers of the indices. */
   double pixelSum_0, pixelSum_1, pixelSum_00, pixelSum_01, pixelSum_11,
     pixelSum_000, pixelSum_001, pixelSum_011, pixelSum_111,
     pixelSum_0000, pixelSum_0001, pixelSum_0011, pixelSum_0111, pixelSum_1111;
@@ -102,51 +141,98 @@ GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator< THistogram >
     = pixelSum_000 = pixelSum_001 = pixelSum_011 = pixelSum_111
     = pixelSum_0000 = pixelSum_0001 = pixelSum_0011
     = pixelSum_0111 = pixelSum_1111 = 0.0;
-  std::vector<double> marginalSums( binsPerAxis, 0.0 );
+  double energy = 0.0, inverseDifferenceMoment = 0.0, inertia = 0.0;
+  double countLogCount = 0.0, entropyCount = 0.0;
+  std::vector<double> & marginalSums = this->m_MarginalSums;
+  std::fill( marginalSums.begin(), marginalSums.end(), 0.0 );
+
+  /** Entries with a frequency below this do not count for the entropy. */
+  const double entropyThreshold = 0.0001 * totalFrequency;
+
+  /** Walk over the matrix once, row by row. Per row the counts are summed
+   * with the powers of the first index; the second index is constant and
+   * is multiplied in afterwards. The inner loops have no branches and read
+   * the weights of the difference of the indices contiguously.
+   */
+  for( SizeValueType i1 = 0; i1 < binsPerAxis; ++i1 )
+  {
+    const AbsoluteFrequencyType * counts = matrix + i1 * binsPerAxis;
+    const double * idmWeights = &this->m_InverseDifferenceWeights[ binsPerAxis - 1 - i1 ];
+    const double * inertiaWeights = &this->m_InertiaWeights[ binsPerAxis - 1 - i1 ];
+
+    double r0 = 0.0, r1 = 0.0, r2 = 0.0, r3 = 0.0, r4 = 0.0;
+    double rowEnergy = 0.0, rowIdm = 0.0, rowInertia = 0.0;
+    for( SizeValueType i0 = 0; i0 < binsPerAxis; ++i0 )
+    {
+      const double c = static_cast<double>( counts[ i0 ] );
+      r0 += c;
+      r1 += c * power1[ i0 ];
+      r2 += c * power2[ i0 ];
+      r3 += c * power3[ i0 ];
+      r4 += c * power4[ i0 ];
+      rowEnergy += c * c;
+      rowIdm += c * idmWeights[ i0 ];
+      rowInertia += c * inertiaWeights[ i0 ];
+      marginalSums[ i0 ] += c;
+    }
+    if( r0 == 0.0 ) continue;
+
+    const double p1 = power1[ i1 ], p2 = power2[ i1 ];
+    const double p3 = power3[ i1 ], p4 = power4[ i1 ];
+    pixelSum_0    += r1;
+    pixelSum_1    += p1 * r0;
+    pixelSum_00   += r2;
+    pixelSum_01   += p1 * r1;
+    pixelSum_11   += p2 * r0;
+    pixelSum_000  += r3;
+    pixelSum_001  += p1 * r2;
+    pixelSum_011  += p2 * r1;
+    pixelSum_111  += p3 * r0;
+    pixelSum_0000 += r4;
+    pixelSum_0001 += p1 * r3;
+    pixelSum_0011 += p2 * r2;
+    pixelSum_0111 += p3 * r1;
+    pixelSum_1111 += p4 * r0;
+    energy += rowEnergy;
+    inverseDifferenceMoment += rowIdm;
+    inertia += rowInertia;
+
+    /** The entropy, with c log2( c ) from a table for the integer counts. */
+    for( SizeValueType i0 = 0; i0 < binsPerAxis; ++i0 )
+    {
+      const AbsoluteFrequencyType count = counts[ i0 ];
+      if( static_cast<double>( count ) <= entropyThreshold ) continue;
+      countLogCount += this->GetCountLogCount( count );
+      entropyCount += static_cast<double>( count );
+    }
+  }
 
-  /** Walk over the histogram. Only once instead of 4! */
-  double log2 = vcl_log(2.);
-  HistogramConstIterator hit( this->m_Histogram );
-  for ( hit = this->m_Histogram->Begin(); hit != this->m_Histogram->End(); ++hit )
+  /** Normalize the sums. */
+  const double inverseTotal = 1.0 / totalFrequency;
+  pixelSum_0 *= inverseTotal;     pixelSum_1 *= inverseTotal;
+  pixelSum_00 *= inverseTotal;    pixelSum_01 *= inverseTotal;
+  pixelSum_11 *= inverseTotal;    pixelSum_000 *= inverseTotal;
+  pixelSum_001 *= inverseTotal;   pixelSum_011 *= inverseTotal;
+  pixelSum_111 *= inverseTotal;   pixelSum_0000 *= inverseTotal;
+  pixelSum_0001 *= inverseTotal;  pixelSum_0011 *= inverseTotal;
+  pixelSum_0111 *= inverseTotal;  pixelSum_1111 *= inverseTotal;
+  for( SizeValueType i = 0; i < binsPerAxis; ++i )
   {
-    /** Get the frequency of this histogram entry. */
-    AbsoluteFrequencyType frequencyCount = hit.GetFrequency();
-
-    /** No use doing these calculations if we're just multiplying by zero. */
-    if( frequencyCount == 0 ) continue;
-
-    /** Normalize frequency and get the index of this histogram entry. */
-    double frequency = static_cast<double>(frequencyCount) / totalFrequency;
-    IndexType index = this->m_Histogram->GetIndex( hit.GetInstanceIdentifier() );
-
-    /** Compute values that are needed later for the feature computation. */
-    pixelSum_0     += index[ 0 ] * frequency;
-    pixelSum_1     += index[ 1 ] * frequency;
-    pixelSum_00    += index[ 0 ] * index[ 0 ] * frequency;
-    pixelSum_01    += index[ 0 ] * index[ 1 ] * frequency;
-    pixelSum_11    += index[ 1 ] * index[ 1 ] * frequency;
-    pixelSum_000   += index[ 0 ] * index[ 0 ] * index[ 0 ] * frequency;
-    pixelSum_001   += index[ 0 ] * index[ 0 ] * index[ 1 ] * frequency;
-    pixelSum_011   += index[ 0 ] * index[ 1 ] * index[ 1 ] * frequency;
-    pixelSum_111   += index[ 1 ] * index[ 1 ] * index[ 1 ] * frequency;
-    pixelSum_0000  += index[ 0 ] * index[ 0 ] * index[ 0 ] * index[ 0 ] * frequency;
-    pixelSum_0001  += index[ 0 ] * index[ 0 ] * index[ 0 ] * index[ 1 ] * frequency;
-    pixelSum_0011  += index[ 0 ] * index[ 0 ] * index[ 1 ] * index[ 1 ] * frequency;
-    pixelSum_0111  += index[ 0 ] * index[ 1 ] * index[ 1 ] * index[ 1 ] * frequency;
-    pixelSum_1111  += index[ 1 ] * index[ 1 ] * index[ 1 ] * index[ 1 ] * frequency;
-
-    /** For the HaralickCorrelation. */
-    marginalSums[ index[ 0 ] ] += frequency;
-
-    /** Compute the features that can be computed in this loop immediately. */
-    this->m_Energy += frequency * frequency;
-    this->m_Entropy -= ( frequency > 0.0001 ) ? frequency * vcl_log( frequency ) / log2 : 0.0;
-    this->m_InverseDifferenceMoment += frequency /
-      ( 1.0 + ( index[ 0 ] - index[ 1 ] ) * ( index[ 0 ] - index[ 1 ] ) );
-    this->m_Inertia += ( index[ 0 ] - index[ 1 ] ) * ( index[ 0 ] - index[ 1 ] ) * frequency;
-    this->m_HaralickCorrelation += index[ 0 ] * index[ 1 ] * frequency;
+    marginalSums[ i ] *= inverseTotal;
   }
 
+  /** The features that follow directly from the sums:
+   * sum f^2, - sum f log2 f with f = c / T, i.e.
+   * - ( sum c log2 c - log2 T sum c ) / T, sum f / ( 1 + d^2 ),
+   * sum d^2 f, and sum i0 i1 f.
+   */
+  this->m_Energy = energy * inverseTotal * inverseTotal;
+  this->m_Entropy = -( countLogCount
+    - vcl_log( totalFrequency ) / vcl_log( 2.0 ) * entropyCount ) * inverseTotal;
+  this->m_InverseDifferenceMoment = inverseDifferenceMoment * inverseTotal;
+  this->m_Inertia = inertia * inverseTotal;
+  this->m_HaralickCorrelation = pixelSum_01;
+
   /** Compute intermediate values. */
   double pixelMean = pixelSum_0;
   double pixelMean2 = pixelMean * pixelMean;
@@ -202,6 +288,77 @@ GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator< THistogram >
 } // end Compute()
 
 
+/**
+ * ********************* InitializeTables ****************************
+ */
+
+template< class THistogram >
+void
+GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator< THistogram >
+::InitializeTables( SizeValueType binsPerAxis )
+{
+  if( this->m_MarginalSums.size() == binsPerAxis ) return;
+
+  /** Powers of the indices. */
+  this->m_Powers.resize( 4 * binsPerAxis );
+  for( SizeValueType i = 0; i < binsPerAxis; ++i )
+  {
+    const double x = static_cast<double>( i );
+    this->m_Powers[ i ] = x;
+    this->m_Powers[ binsPerAxis + i ] = x * x;
+    this->m_Powers[ 2 * binsPerAxis + i ] = x * x * x;
+    this->m_Powers[ 3 * binsPerAxis + i ] = x * x * x * x;
+  }
+
+  /** Weights of the difference d = i0 - i1, stored at d + binsPerAxis - 1. */
+  this->m_InverseDifferenceWeights.resize( 2 * binsPerAxis - 1 );
+  this->m_InertiaWeights.resize( 2 * binsPerAxis - 1 );
+  for( SizeValueType i = 0; i < 2 * binsPerAxis - 1; ++i )
+  {
+    const double d = static_cast<double>( i ) - static_cast<double>( binsPerAxis - 1 );
+    this->m_InverseDifferenceWeights[ i ] = 1.0 / ( 1.0 + d * d );
+    this->m_InertiaWeights[ i ] = d * d;
+  }
+
+  this->m_MarginalSums.resize( binsPerAxis );
+
+} // end InitializeTables()
+
+
+/**
+ * ********************* GetCountLogCount ****************************
+ */
+
+template< class THistogram >
+double
+GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator< THistogram >
+::GetCountLogCount( AbsoluteFrequencyType count )
+{
+  /** Counts are small integers in a local window; extend the table on demand. */
+  if( count >= this->m_CountLogCountTable.size() )
+  {
+    if( count > 65536 )
+    {
+      const double c = static_cast<double>( count );
+      return c * vcl_log( c ) / vcl_log( 2.0 );
+    }
+    const SizeValueType oldSize = this->m_CountLogCountTable.size();
+    const SizeValueType newSize = vnl_math_max(
+      static_cast<SizeValueType>( count ) + 1, 2 * oldSize );
+    this->m_CountLogCountTable.resize( newSize );
+    for( SizeValueType c = oldSize; c < newSize; ++c )
+    {
+      this->m_CountLogCountTable[ c ] = c > 0
+        ? static_cast<double>( c ) * vcl_log( static_cast<double>( c ) ) / vcl_log( 2.0 )
+        : 0.0;
+    }
+  }
+
+  return this->m_CountLogCountTable[ count ];
+
+} // end GetCountLogCount()
+
+
 /**
  * ********************* GetFeature ****************************
  */
@@ -32,9 +32,11 @@ namespace itk
  * on an image.
  *
  * The operations this filter performs several steps:\n
- * - for each pixel a neighborhood around that pixel is copied to an image \n
- * - from this local image a co-occurrence matrix is constructed, using the
- *   itk::kScalarImageToGreyLevelCooccurrenceMatrixGenerator class \n
+ * - the input image is quantized once to the histogram bins, with the
+ *   same bin boundaries as the itk::Statistics::Histogram \n
+ * - for each pixel a dense co-occurrence matrix is constructed over a
+ *   neighborhood around that pixel, and updated while sliding along a
+ *   scanline \n
  * - from the co-occurrence matrix several features are computed, using
  *   the itk::GreyLevelCooccurrenceMatrixTextureCoefficientsCalculator class \n
  * - each feature value is copied to the corresponding output image.
@@ -108,6 +110,20 @@ public:
   typedef Statistics::GrayLevelCooccurrenceMatrixTextureCoefficientsCalculator<
     HistogramType >                                 TextureCalculatorType;
 
+  /** Typedefs for the quantized image and the dense co-occurrence matrix. */
+  typedef unsigned short                            QuantizedPixelType;
+  typedef Image< QuantizedPixelType,
+    TInputImage::ImageDimension >                   QuantizedImageType;
+  typedef typename QuantizedImageType::Pointer      QuantizedImagePointer;
+  typedef typename HistogramType
+    ::AbsoluteFrequencyType                         AbsoluteFrequencyType;
+  typedef std::vector< AbsoluteFrequencyType >      CooccurrenceMatrixType;
+
+  /** Typedefs for the features computed at the samples only. */
+  typedef typename InputImageType::IndexType        InputImageIndexType;
+  typedef std::vector< InputImageIndexType >        SampleIndexContainerType;
+  typedef std::vector< OutputImagePixelType >       SampleFeatureContainerType;
+
   /** Input Image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int, TInputImage::ImageDimension );
 
@@ -122,6 +138,39 @@ public:
   /** Set the size of the neighborhood over which local texture is computed. */
   itkSetMacro( NeighborhoodRadius, unsigned int );
 
+  /** Set/Get the mask. Features are only computed for voxels inside the
+   * mask, the outputs are zero elsewhere. The mask has the geometry of the
+   * input. Pairs in the co-occurrence matrix are not restricted to the mask.
+   */
+  typedef Image< unsigned char, TInputImage::ImageDimension > MaskImageType;
+  typedef typename MaskImageType::ConstPointer                MaskImageConstPointer;
+  itkSetConstObjectMacro( MaskImage, MaskImageType );
+  itkGetConstObjectMacro( MaskImage, MaskImageType );
+
+  /** Set/Get the output stride. The features are computed every
+   * OutputStride voxels in each dimension, and the outputs are downsampled
+   * accordingly. Default 1, i.e. every voxel.
+   */
+  itkSetClampMacro( OutputStride, unsigned int, 1,
+    NumericTraits<unsigned int>::max() );
+  itkGetConstMacro( OutputStride, unsigned int );
+
+  /** Compute the features at the samples only, i.e. at the voxels every
+   * OutputStride voxels that lie inside the mask, without running the
+   * pipeline. No output images are allocated, so the memory only depends
+   * on the number of samples. The features of sample i are stored at
+   * i * NumberOfRequestedOutputs in GetSampleFeatures().
+   */
+  virtual void ComputeSamples( void );
+  const SampleIndexContainerType & GetSampleIndices( void ) const
+  {
+    return this->m_SampleIndices;
+  }
+  const SampleFeatureContainerType & GetSampleFeatures( void ) const
+  {
+    return this->m_SampleFeatures;
+  }
+
   /** *****
    * Functions that influence the co-occurrence matrix generation.
    *  *****
@@ -141,11 +190,6 @@ public:
   virtual void SetOffsetScales( const std::vector<unsigned int> & offsetScales );
   virtual const std::vector<unsigned int> & GetOffsetScales( void ) const;
 
-  /** Set the calculator to normalize the histogram. */
-  itkSetMacro( NormalizeHistogram, bool );
-  itkGetMacro( NormalizeHistogram, bool );
-  itkBooleanMacro( NormalizeHistogram );
-
   /** Set the minimum and maximum pixel value that will be
    * placed in the histogram. By default the minimum and maximum
    * of the input image.
@@ -172,9 +216,16 @@ protected:
    */
   virtual void EnlargeOutputRequestedRegion( DataObject * );
 
+  /** The outputs are downsampled by the output stride. */
+  virtual void GenerateOutputInformation( void );
+
+  /** This filter needs the whole input. */
+  virtual void GenerateInputRequestedRegion( void );
+
   /** Starts the image modeling process. */
   void BeforeThreadedGenerateData( void );
   void ThreadedGenerateData( const OutputImageRegionType & region, ThreadIdType threadId );
+  void AfterThreadedGenerateData( void );
 
 private:
 
@@ -188,9 +239,45 @@ private:
   virtual void ComputeDefaultOffsets( std::vector<unsigned int> scales );
   virtual void ComputeHistogramMinimumAndMaximum( void );
 
+  /** Set the geometry of an output, given the input and the stride. */
+  void ComputeOutputInformation( OutputImageType * output ) const;
+
+  /** Quantize the input image to the histogram bins. */
+  virtual void ComputeQuantizedImage( void );
+
+  /** Update the input, check the mask and quantize the input, as needed
+   * before computing features.
+   */
+  void PrepareFeatureComputation( void );
+
+  /** The neighborhood of a voxel, cropped by the input image. */
+  InputImageRegionType ComputeNeighborhoodRegion( const InputImageIndexType & index ) const;
+
+  /** Make the matrix that of the region, given that it is that of the
+   * previous region. On the same scanline the window is slid, by adding
+   * and removing faces, otherwise it is computed from scratch.
+   */
+  void MoveCooccurrenceMatrix( const InputImageRegionType & region,
+    const InputImageRegionType & previousRegion, bool previousRegionValid,
+    CooccurrenceMatrixType & matrix ) const;
+
+  /** Compute the features of a range of samples. */
+  void ThreadedComputeSamples( SizeValueType begin, SizeValueType end );
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE SamplesThreaderCallback( void * arg );
+
+  /** Add the co-occurrence pairs of which the first pixel lies in the
+   * region to a dense matrix, or remove them.
+   */
+  void UpdateCooccurrenceMatrix( const InputImageRegionType & region,
+    CooccurrenceMatrixType & matrix, bool add ) const;
+
   /** Private variables to store results. */
   unsigned int              m_NumberOfRequestedOutputs;
   unsigned int              m_NeighborhoodRadius;
+  unsigned int              m_OutputStride;
+  MaskImageConstPointer     m_MaskImage;
 
   /** Private variables for the offsets. */
   OffsetVectorPointer       m_Offsets;
@@ -203,7 +290,14 @@ private:
   InputImagePixelType       m_HistogramMaximum;
   bool                      m_HistogramMinimumSetManually;
   bool                      m_HistogramMaximumSetManually;
-  bool                      m_NormalizeHistogram;
+
+  /** Private variables for the quantized image and its offsets. */
+  QuantizedImagePointer     m_QuantizedImage;
+  std::vector<OffsetValueType> m_BufferOffsets;
+
+  /** Private variables for the features at the samples. */
+  SampleIndexContainerType    m_SampleIndices;
+  SampleFeatureContainerType  m_SampleFeatures;
 
 }; // end class TextureImageToImageFilter
 
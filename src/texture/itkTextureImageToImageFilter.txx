@@ -21,8 +21,11 @@
 #include "itkTextureImageToImageFilter.h"
 
 #include "../statisticsonimage/itkStatisticsImageFilterWithMask.h"
-#include "itkConstNeighborhoodIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkImageRegionIterator.h"
+
+#include <algorithm>
 #include "itkProgressReporter.h"
 
 
@@ -39,6 +42,8 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
 {
   this->m_NumberOfRequestedOutputs = 8;
   this->m_NeighborhoodRadius = 3;
+  this->m_OutputStride = 1;
+  this->m_MaskImage = 0;
 
   this->m_OffsetsSetManually = false;
   this->m_OffsetScales.resize( 1, 1 );
@@ -46,7 +51,6 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
   this->ComputeDefaultOffsets( this->m_OffsetScales );
 
   this->m_NumberOfHistogramBins = 64;
-  this->m_NormalizeHistogram = false;
   this->m_HistogramMinimum = NumericTraits< InputImagePixelType >::min();
   this->m_HistogramMaximum = NumericTraits< InputImagePixelType >::max();
   this->m_HistogramMinimumSetManually = false;
@@ -162,6 +166,96 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
 } // end GetOffsetScales()
 
 
+/**
+ * ********************* GenerateOutputInformation ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::GenerateOutputInformation( void )
+{
+  Superclass::GenerateOutputInformation();
+
+  for( unsigned int i = 0; i < this->GetNumberOfOutputs(); ++i )
+  {
+    if( this->GetOutput( i ) )
+    {
+      this->ComputeOutputInformation( this->GetOutput( i ) );
+    }
+  }
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * ********************* ComputeOutputInformation ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::ComputeOutputInformation( OutputImageType * output ) const
+{
+  /** The output samples the input every m_OutputStride voxels, starting
+   * at the first voxel. The output region starts at the same index.
+   */
+  const InputImageType * input = this->GetInput();
+  if( !input ) return;
+
+  const InputImageRegionType & inputRegion = input->GetLargestPossibleRegion();
+  const unsigned int stride = this->m_OutputStride;
+
+  typename OutputImageType::SpacingType spacing = input->GetSpacing();
+  typename OutputImageType::SizeType size;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    size[ i ] = ( inputRegion.GetSize()[ i ] + stride - 1 ) / stride;
+    spacing[ i ] *= stride;
+  }
+  OutputImageRegionType region( inputRegion.GetIndex(), size );
+  output->SetSpacing( spacing );
+  output->SetDirection( input->GetDirection() );
+  output->SetOrigin( input->GetOrigin() );
+
+  /** Shift the origin such that the first output voxel coincides with
+   * the first input voxel.
+   */
+  typename OutputImageType::PointType inputPoint, outputPoint;
+  input->TransformIndexToPhysicalPoint( inputRegion.GetIndex(), inputPoint );
+  output->TransformIndexToPhysicalPoint( region.GetIndex(), outputPoint );
+  typename OutputImageType::PointType origin = input->GetOrigin();
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    origin[ i ] += inputPoint[ i ] - outputPoint[ i ];
+  }
+  output->SetOrigin( origin );
+  output->SetLargestPossibleRegion( region );
+
+} // end ComputeOutputInformation()
+
+
+/**
+ * ********************* GenerateInputRequestedRegion ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion( void )
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  /** The whole input is needed, the output may be strided. */
+  InputImagePointer inputPtr = const_cast< InputImageType * >( this->GetInput() );
+  if( inputPtr )
+  {
+    inputPtr->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end GenerateInputRequestedRegion()
+
+
 /**
  * ********************* EnlargeOutputRequestedRegion ****************************
  */
@@ -191,15 +285,38 @@ template< class TInputImage, class TOutputImage >
 void
 TextureImageToImageFilter< TInputImage, TOutputImage >
 ::BeforeThreadedGenerateData( void )
+{
+  if( !this->GetInput() ) return;
+
+  /** Prepare the input. */
+  this->PrepareFeatureComputation();
+
+  /** Create outputs. */
+  this->SetAndCreateOutputs( this->m_NumberOfRequestedOutputs );
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ********************* PrepareFeatureComputation ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::PrepareFeatureComputation( void )
 {
   /** Make sure that the input image is completely up-to-date. */
   InputImagePointer inputPtr = const_cast< InputImageType * > ( this->GetInput() );
-  if( !inputPtr ) return;
   inputPtr->SetRegions( inputPtr->GetLargestPossibleRegion() );
   inputPtr->Update();
 
-  /** Create outputs. */
-  this->SetAndCreateOutputs( this->m_NumberOfRequestedOutputs );
+  /** Check the mask. */
+  if( this->m_MaskImage
+    && this->m_MaskImage->GetLargestPossibleRegion() != inputPtr->GetLargestPossibleRegion() )
+  {
+    itkExceptionMacro( << "The mask should have the same size as the input image." );
+  }
 
   /** Compute the minimum and maximum histogram entries. */
   this->ComputeHistogramMinimumAndMaximum();
@@ -207,7 +324,215 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
   /** Compute the offsets. */
   this->ComputeDefaultOffsets( this->m_OffsetScales );
 
-} // end BeforeThreadedGenerateData()
+  /** Quantize the input image. */
+  this->ComputeQuantizedImage();
+
+} // end PrepareFeatureComputation()
+
+
+/**
+ * ********************* ComputeSamples ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::ComputeSamples( void )
+{
+  typedef ImageRegionConstIteratorWithIndex< InputImageType > IteratorType;
+
+  InputImagePointer inputPtr = const_cast< InputImageType * > ( this->GetInput() );
+  if( !inputPtr )
+  {
+    itkExceptionMacro( << "No input image has been set." );
+  }
+  inputPtr->UpdateOutputInformation();
+  this->PrepareFeatureComputation();
+
+  /** Collect the samples: the voxels every m_OutputStride voxels,
+   * starting at the first voxel, that lie inside the mask.
+   */
+  const InputImageRegionType & largestRegion = inputPtr->GetLargestPossibleRegion();
+  const InputImageIndexType & start = largestRegion.GetIndex();
+  const OffsetValueType stride = static_cast<OffsetValueType>( this->m_OutputStride );
+  const MaskImageType * mask = this->m_MaskImage.GetPointer();
+  this->m_SampleIndices.clear();
+  for( IteratorType it( inputPtr, largestRegion ); !it.IsAtEnd(); ++it )
+  {
+    const InputImageIndexType & index = it.GetIndex();
+    bool onGrid = true;
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      if( ( index[ i ] - start[ i ] ) % stride != 0 )
+      {
+        onGrid = false;
+        break;
+      }
+    }
+    if( !onGrid || ( mask && mask->GetPixel( index ) == 0 ) ) continue;
+    this->m_SampleIndices.push_back( index );
+  }
+
+  /** Compute the features, each thread for a range of samples. */
+  this->m_SampleFeatures.assign( this->m_SampleIndices.size()
+    * this->m_NumberOfRequestedOutputs, NumericTraits<OutputImagePixelType>::Zero );
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod( SamplesThreaderCallback, this );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  /** Release the quantized image. */
+  this->m_QuantizedImage = 0;
+
+} // end ComputeSamples()
+
+
+/**
+ * ********************* SamplesThreaderCallback ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+ITK_THREAD_RETURN_TYPE
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::SamplesThreaderCallback( void * arg )
+{
+  typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  Self * filter = static_cast<Self *>( info->UserData );
+  const SizeValueType threadId = info->ThreadID;
+  const SizeValueType numberOfThreads = info->NumberOfThreads;
+  const SizeValueType numberOfSamples = filter->m_SampleIndices.size();
+
+  filter->ThreadedComputeSamples(
+    threadId * numberOfSamples / numberOfThreads,
+    ( threadId + 1 ) * numberOfSamples / numberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end SamplesThreaderCallback()
+
+
+/**
+ * ********************* ThreadedComputeSamples ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::ThreadedComputeSamples( SizeValueType begin, SizeValueType end )
+{
+  /** Setup the local dense co-occurrence matrix and feature calculator. */
+  const SizeValueType binsPerAxis = this->m_NumberOfHistogramBins;
+  CooccurrenceMatrixType cooccurrenceMatrix( binsPerAxis * binsPerAxis, 0 );
+  typename TextureCalculatorType::Pointer cmCalculator
+    = TextureCalculatorType::New();
+  const unsigned int noo = this->m_NumberOfRequestedOutputs;
+
+  /** The samples are in scanline order, so that the window can be slid
+   * between samples on the same scanline.
+   */
+  InputImageRegionType localRegion, previousRegion;
+  bool previousRegionValid = false;
+  for( SizeValueType s = begin; s < end; ++s )
+  {
+    localRegion = this->ComputeNeighborhoodRegion( this->m_SampleIndices[ s ] );
+    this->MoveCooccurrenceMatrix( localRegion, previousRegion,
+      previousRegionValid, cooccurrenceMatrix );
+    previousRegion = localRegion;
+    previousRegionValid = true;
+
+    cmCalculator->Compute( &cooccurrenceMatrix[ 0 ], binsPerAxis );
+    for( unsigned int ii = 0; ii < noo; ++ii )
+    {
+      this->m_SampleFeatures[ s * noo + ii ]
+        = static_cast<OutputImagePixelType>( cmCalculator->GetFeature( ii ) );
+    }
+  }
+
+} // end ThreadedComputeSamples()
+
+
+/**
+ * ********************* ComputeNeighborhoodRegion ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+typename TextureImageToImageFilter< TInputImage, TOutputImage >::InputImageRegionType
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::ComputeNeighborhoodRegion( const InputImageIndexType & index ) const
+{
+  /** Construct a local neighborhood over which GLCM computation takes place.
+   * The regions have to be cropped with the largest possible region
+   * of the input image, to avoid problems at the border.
+   * Note that a larger subimage than localRegion is actually used for
+   * computing the co-occurrence matrix, because of the offsets.
+   */
+  const long radius = static_cast<long>( this->m_NeighborhoodRadius );
+  InputImageIndexType localIndex;
+  InputImageSizeType localSize;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    localIndex[ i ] = index[ i ] - radius;
+    localSize[ i ] = 2 * radius + 1;
+  }
+  InputImageRegionType localRegion( localIndex, localSize );
+  localRegion.Crop( this->GetInput()->GetLargestPossibleRegion() );
+  return localRegion;
+
+} // end ComputeNeighborhoodRegion()
+
+
+/**
+ * ********************* MoveCooccurrenceMatrix ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::MoveCooccurrenceMatrix( const InputImageRegionType & localRegion,
+  const InputImageRegionType & previousRegion, bool previousRegionValid,
+  CooccurrenceMatrixType & cooccurrenceMatrix ) const
+{
+  /** Generate the co-occurrence over a local region only. At the start
+   * of a scanline the matrix is computed from scratch. Further along
+   * the scanline it is updated: the centers on the trailing face of the
+   * window are removed, the centers on the leading face are added. The
+   * matrix only depends on the set of centers, so this is exact.
+   * When the window jumps past the previous one (large strides, masked
+   * voxels), computing from scratch is cheaper.
+   */
+  bool sameScanline = previousRegionValid;
+  for( unsigned int i = 1; i < InputImageDimension && sameScanline; ++i )
+  {
+    sameScanline = localRegion.GetIndex()[ i ] == previousRegion.GetIndex()[ i ]
+      && localRegion.GetSize()[ i ] == previousRegion.GetSize()[ i ];
+  }
+  const long localBegin = localRegion.GetIndex()[ 0 ];
+  const long localEnd = localBegin
+    + static_cast<long>( localRegion.GetSize()[ 0 ] );
+  const long previousBegin = previousRegion.GetIndex()[ 0 ];
+  const long previousEnd = previousBegin
+    + static_cast<long>( previousRegion.GetSize()[ 0 ] );
+  if( !sameScanline || localBegin < previousBegin || localBegin >= previousEnd )
+  {
+    std::fill( cooccurrenceMatrix.begin(), cooccurrenceMatrix.end(), 0 );
+    this->UpdateCooccurrenceMatrix( localRegion, cooccurrenceMatrix, true );
+    return;
+  }
+
+  InputImageRegionType faceRegion = previousRegion;
+  faceRegion.SetSize( 0, 1 );
+  for( long x = previousBegin; x < localBegin; ++x )
+  {
+    faceRegion.SetIndex( 0, x );
+    this->UpdateCooccurrenceMatrix( faceRegion, cooccurrenceMatrix, false );
+  }
+  for( long x = previousEnd; x < localEnd; ++x )
+  {
+    faceRegion.SetIndex( 0, x );
+    this->UpdateCooccurrenceMatrix( faceRegion, cooccurrenceMatrix, true );
+  }
+
+} // end MoveCooccurrenceMatrix()
 
 
 /**
@@ -222,29 +547,26 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
   /** Support for progress methods/callbacks. */
   ProgressReporter progress( this, threadId, regionForThread.GetNumberOfPixels() );
 
-  /** Setup the local co-occurrence matrix generator. */
-  typename CooccurrenceMatrixGeneratorType::Pointer cmGenerator
-    = CooccurrenceMatrixGeneratorType::New();
-  cmGenerator->SetInput( this->GetInput() );
-  cmGenerator->SetOffsets( this->m_Offsets );
-  cmGenerator->SetNumberOfBinsPerAxis( this->m_NumberOfHistogramBins );
-  cmGenerator->SetPixelValueMinMax( this->m_HistogramMinimum, this->m_HistogramMaximum );
-  cmGenerator->SetNormalize( this->m_NormalizeHistogram );
+  /** Setup the local dense co-occurrence matrix. */
+  const SizeValueType binsPerAxis = this->m_NumberOfHistogramBins;
+  CooccurrenceMatrixType cooccurrenceMatrix( binsPerAxis * binsPerAxis, 0 );
 
   /** Setup local texture feature calculator. */
   typename TextureCalculatorType::Pointer cmCalculator
     = TextureCalculatorType::New();
 
   /** Typedefs. */
-  typedef ConstNeighborhoodIterator< InputImageType >         ConstNeighborhoodIteratorType;
-  typedef typename ConstNeighborhoodIteratorType::RadiusType  RadiusType;
-  typedef ImageRegionIterator< OutputImageType >              OutputIteratorType;
-
-  /** Setup a neigborhood iterator over the input image. */
-  RadiusType radius;
-  radius.Fill( this->m_NeighborhoodRadius );
-  ConstNeighborhoodIteratorType nit( radius, this->GetInput(), regionForThread );
-  nit.GoToBegin();
+  typedef ImageRegionConstIteratorWithIndex< OutputImageType > IndexIteratorType;
+  typedef typename InputImageType::IndexType                   IndexType;
+  typedef ImageRegionIterator< OutputImageType >               OutputIteratorType;
+
+  /** Setup an iterator over the first output image, only for the index. */
+  IndexIteratorType it( this->GetOutput( 0 ), regionForThread );
+  it.GoToBegin();
+  const InputImageRegionType & largestRegion
+    = this->GetInput()->GetLargestPossibleRegion();
+  const long stride = static_cast<long>( this->m_OutputStride );
+  const MaskImageType * mask = this->m_MaskImage.GetPointer();
 
   /** Setup iterators over the output images. */
   const unsigned int noo = this->GetNumberOfOutputs();
@@ -255,26 +577,50 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
     outputIterators[ i ].GoToBegin();
   }
 
-  /** Loop over the input region. */
-  InputImageRegionType localRegion;
-  while ( !nit.IsAtEnd() )
+  /** Loop over the output region. */
+  InputImageRegionType localRegion, previousRegion;
+  bool previousRegionValid = false;
+  while ( !it.IsAtEnd() )
   {
-    /** Construct a local neighborhood over which GLCM computation takes place.
-     * The regions have to be cropped with the largest possible region
-     * of the input image, to avoid problems at the border.
-     * Note that a larger subimage than localRegion is actually used for
-     * computing the co-occurrence matrix, because of the offsets.
+    /** The input voxel of this output voxel. The output region starts
+     * at the same index as the input region.
      */
-    localRegion = nit.GetBoundingBoxAsImageRegion();
-    localRegion.Crop( this->GetInput()->GetLargestPossibleRegion() );
+    const IndexType & outputIndex = it.GetIndex();
+    IndexType index;
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      index[ i ] = largestRegion.GetIndex()[ i ]
+        + ( outputIndex[ i ] - largestRegion.GetIndex()[ i ] ) * stride;
+    }
+    if( outputIndex[ 0 ] == regionForThread.GetIndex()[ 0 ] )
+    {
+      previousRegionValid = false;
+    }
 
-    /** Generate the co-occurrence over a local region only. */
-    cmGenerator->SetComputeRegion( localRegion );
-    cmGenerator->Compute();
+    /** Skip voxels outside the mask. */
+    if( mask && mask->GetPixel( index ) == 0 )
+    {
+      for( unsigned int ii = 0; ii < noo; ++ii )
+      {
+        outputIterators[ ii ].Set( NumericTraits<OutputImagePixelType>::Zero );
+        ++outputIterators[ ii ];
+      }
+      ++it;
+      progress.CompletedPixel();
+      continue;
+    }
+
+    /** Generate the co-occurrence over the local neighborhood, sliding
+     * the window along the scanline where possible.
+     */
+    localRegion = this->ComputeNeighborhoodRegion( index );
+    this->MoveCooccurrenceMatrix( localRegion, previousRegion,
+      previousRegionValid, cooccurrenceMatrix );
+    previousRegion = localRegion;
+    previousRegionValid = true;
 
     /** Compute texture features from this co-occurrence matrix. */
-    cmCalculator->SetHistogram( cmGenerator->GetOutput() );
-    cmCalculator->Compute();
+    cmCalculator->Compute( &cooccurrenceMatrix[ 0 ], binsPerAxis );
 
     /** Copy the requested texture features to the outputs and update iterators. */
     for( unsigned int ii = 0; ii < noo; ++ii )
@@ -282,7 +628,7 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
       outputIterators[ ii ].Set( cmCalculator->GetFeature( ii ) );
       ++outputIterators[ ii ];
     }
-    ++nit;
+    ++it;
 
     progress.CompletedPixel();
 
@@ -291,6 +637,87 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
 } // end ThreadedGenerateData()
 
 
+/**
+ * ********************* AfterThreadedGenerateData ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::AfterThreadedGenerateData( void )
+{
+  /** Release the quantized image. */
+  this->m_QuantizedImage = 0;
+
+} // end AfterThreadedGenerateData()
+
+
+/**
+ * ********************* UpdateCooccurrenceMatrix ****************************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::UpdateCooccurrenceMatrix( const InputImageRegionType & region,
+  CooccurrenceMatrixType & matrix, bool add ) const
+{
+  typedef ImageRegionConstIteratorWithIndex< QuantizedImageType > IteratorType;
+  typedef typename QuantizedImageType::IndexType                  IndexType;
+
+  const SizeValueType binsPerAxis = this->m_NumberOfHistogramBins;
+  const QuantizedPixelType outside = static_cast<QuantizedPixelType>( binsPerAxis );
+  const InputImageRegionType & largestRegion
+    = this->m_QuantizedImage->GetLargestPossibleRegion();
+  const IndexType & largestIndex = largestRegion.GetIndex();
+  const InputImageSizeType & largestSize = largestRegion.GetSize();
+  const unsigned int numberOfOffsets = this->m_Offsets->Size();
+
+  /** Add or remove both co-occurrence combinations of each pair. */
+  AbsoluteFrequencyType * m = &matrix[ 0 ];
+  const AbsoluteFrequencyType one = 1;
+  for( IteratorType it( this->m_QuantizedImage, region ); !it.IsAtEnd(); ++it )
+  {
+    const QuantizedPixelType center = it.Value();
+    if( center == outside ) continue;
+
+    const IndexType & index = it.GetIndex();
+    const QuantizedPixelType * centerPointer = &it.Value();
+    for( unsigned int k = 0; k < numberOfOffsets; ++k )
+    {
+      /** Skip pairs of which the second pixel lies outside the image. */
+      const OffsetType & offset = this->m_Offsets->ElementAt( k );
+      bool pixelInBounds = true;
+      for( unsigned int i = 0; i < InputImageDimension; ++i )
+      {
+        const OffsetValueType position = index[ i ] + offset[ i ] - largestIndex[ i ];
+        if( position < 0 || position >= static_cast<OffsetValueType>( largestSize[ i ] ) )
+        {
+          pixelInBounds = false;
+          break;
+        }
+      }
+      if( !pixelInBounds ) continue;
+
+      const QuantizedPixelType neighbor = centerPointer[ this->m_BufferOffsets[ k ] ];
+      if( neighbor == outside ) continue;
+
+      if( add )
+      {
+        m[ center + neighbor * binsPerAxis ] += one;
+        m[ neighbor + center * binsPerAxis ] += one;
+      }
+      else
+      {
+        m[ center + neighbor * binsPerAxis ] -= one;
+        m[ neighbor + center * binsPerAxis ] -= one;
+      }
+    }
+  }
+
+} // end UpdateCooccurrenceMatrix()
+
+
 /**
  * ********************* SetAndCreateOutputs ****************************
  */
@@ -327,7 +754,8 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
   for( unsigned int i = 0; i < numberOfOutputs; ++i )
   {
     OutputImagePointer output = this->GetOutput( i );
-    output->SetRegions( this->GetInput()->GetLargestPossibleRegion() );
+    this->ComputeOutputInformation( output );
+    output->SetRegions( output->GetLargestPossibleRegion() );
     output->Allocate();
   }
 
@@ -373,6 +801,85 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
 } // end ComputeHistogramMinimumAndMaximum()
 
 
+/**
+ * ********************* ComputeQuantizedImage ****************************
+ */
+
+template < class TInputImage, class TOutputImage >
+void
+TextureImageToImageFilter< TInputImage, TOutputImage >
+::ComputeQuantizedImage( void )
+{
+  /** The bins of a histogram as the co-occurrence matrix generator sets
+   * it up, so that each pixel lands in exactly the same bin. Pixels
+   * outside the histogram range get the value m_NumberOfHistogramBins.
+   */
+  const unsigned int binsPerAxis = this->m_NumberOfHistogramBins;
+  if( binsPerAxis == 0
+    || binsPerAxis >= NumericTraits<QuantizedPixelType>::max() )
+  {
+    itkExceptionMacro( << "The number of histogram bins should be between 1 and "
+      << NumericTraits<QuantizedPixelType>::max() - 1 << "." );
+  }
+
+  typename HistogramType::Pointer histogram = HistogramType::New();
+  histogram->SetMeasurementVectorSize( 2 );
+  typename HistogramType::SizeType size;
+  size.SetSize( 2 );
+  size.Fill( binsPerAxis );
+  typename HistogramType::MeasurementVectorType lowerBound, upperBound;
+  lowerBound.SetSize( 2 );
+  upperBound.SetSize( 2 );
+  lowerBound.Fill( this->m_HistogramMinimum );
+  upperBound.Fill( this->m_HistogramMaximum + 1 );
+  histogram->Initialize( size, lowerBound, upperBound );
+
+  /** Quantize. */
+  const InputImageType * input = this->GetInput();
+  this->m_QuantizedImage = QuantizedImageType::New();
+  this->m_QuantizedImage->CopyInformation( input );
+  this->m_QuantizedImage->SetRegions( input->GetLargestPossibleRegion() );
+  this->m_QuantizedImage->Allocate();
+
+  typedef ImageRegionConstIterator< InputImageType >  InputIteratorType;
+  typedef ImageRegionIterator< QuantizedImageType >   QuantizedIteratorType;
+  InputIteratorType it( input, input->GetLargestPossibleRegion() );
+  QuantizedIteratorType qit( this->m_QuantizedImage, input->GetLargestPossibleRegion() );
+  typename HistogramType::MeasurementVectorType measurement( 2 );
+  typename HistogramType::IndexType index( 2 );
+  const QuantizedPixelType outside = static_cast<QuantizedPixelType>( binsPerAxis );
+  for( ; !it.IsAtEnd(); ++it, ++qit )
+  {
+    const InputImagePixelType value = it.Value();
+    measurement.Fill( value );
+    if( value < this->m_HistogramMinimum || value > this->m_HistogramMaximum
+      || !histogram->GetIndex( measurement, index ) )
+    {
+      qit.Set( outside );
+    }
+    else
+    {
+      qit.Set( static_cast<QuantizedPixelType>( index[ 0 ] ) );
+    }
+  }
+
+  /** The offsets in the quantized image buffer. */
+  const unsigned int numberOfOffsets = this->m_Offsets->Size();
+  this->m_BufferOffsets.resize( numberOfOffsets );
+  for( unsigned int k = 0; k < numberOfOffsets; ++k )
+  {
+    const OffsetType & offset = this->m_Offsets->ElementAt( k );
+    OffsetValueType bufferOffset = 0;
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      bufferOffset += offset[ i ] * this->m_QuantizedImage->GetOffsetTable()[ i ];
+    }
+    this->m_BufferOffsets[ k ] = bufferOffset;
+  }
+
+} // end ComputeQuantizedImage()
+
+
 /**
  * ********************* ComputeDefaultOffsets ****************************
  */
@@ -426,6 +933,10 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
     << this->m_NeighborhoodRadius << std::endl;
   os << indent << "NumberOfRequestedOutputs: "
     << this->m_NumberOfRequestedOutputs << std::endl;
+  os << indent << "OutputStride: "
+    << this->m_OutputStride << std::endl;
+  os << indent << "MaskImage: "
+    << this->m_MaskImage.GetPointer() << std::endl;
 
   os << indent << "OffsetsSetManually: "
     << this->m_OffsetsSetManually << std::endl;
@@ -453,8 +964,6 @@ TextureImageToImageFilter< TInputImage, TOutputImage >
     << this->m_HistogramMinimumSetManually << std::endl;
   os << indent << "HistogramMaximumSetManually: "
     << this->m_HistogramMaximumSetManually << std::endl;
-  os << indent << "NormalizeHistogram: "
-    << this->m_NormalizeHistogram << std::endl;
 
 } // end PrintSelf()
 
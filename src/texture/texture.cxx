@@ -42,6 +42,11 @@ std::string GetHelpString( void )
     << "This program computes filter features based on the gray-level co-occurrence matrix (GLCM).\n"
     << "  -in      inputFilename\n"
     << "  [-out]   outputDirectory, default equal to the inputFilename directory\n"
+    << "  [-mask]  maskFilename, features are only computed inside the mask\n"
+    << "  [-stride] compute the features every stride voxels, the outputs are\n"
+    << "           downsampled accordingly, default 1\n"
+    << "  [-csv]   write the features of the (masked, strided) samples to this csv file,\n"
+    << "           instead of writing feature images; only the samples are computed\n"
     << "  [-r]     the radius of the neighborhood on which to construct the GLCM, default 3\n"
     << "  [-os]    the desired offset scales to compute the GLCM, default 1, but can be e.g. 1 2 4\n"
     << "  [-b]     the number of bins of the GLCM, default 128\n"
@@ -88,6 +93,15 @@ int main( int argc, char **argv )
   bool endslash = itksys::SystemTools::StringEndsWith( outputDirectory.c_str(), "/" );
   if( !endslash ) outputDirectory += "/";
 
+  std::string maskFileName = "";
+  parser->GetCommandLineArgument( "-mask", maskFileName );
+
+  unsigned int outputStride = 1;
+  parser->GetCommandLineArgument( "-stride", outputStride );
+
+  std::string csvFileName = "";
+  parser->GetCommandLineArgument( "-csv", csvFileName );
+
   unsigned int neighborhoodRadius = 3;
   parser->GetCommandLineArgument( "-r", neighborhoodRadius );
 
@@ -111,6 +125,13 @@ int main( int argc, char **argv )
     return EXIT_FAILURE;
   }
 
+  /** Check that outputStride >= 1. */
+  if( outputStride == 0 )
+  {
+    std::cerr << "ERROR: The stride should be at least 1." << std::endl;
+    return EXIT_FAILURE;
+  }
+
   /** Threads. */
   unsigned int maximumNumberOfThreads
     = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
@@ -156,6 +177,9 @@ int main( int argc, char **argv )
 
     /** Set the filter arguments. */
     filter->m_InputFileName = inputFileName;
+    filter->m_MaskFileName = maskFileName;
+    filter->m_CSVFileName = csvFileName;
+    filter->m_OutputStride = outputStride;
     filter->m_OutputDirectory = outputDirectory;
     filter->m_NeighborhoodRadius = neighborhoodRadius;
     filter->m_OffsetScales = offsetScales;
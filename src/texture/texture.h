@@ -26,6 +26,10 @@
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkMultiThreader.h"
+#include "ITKToolsPackedMask.h"
+
+#include <fstream>
+#include <iomanip>
 
 
 /** \class ITKToolsTextureBase
@@ -41,21 +45,27 @@ public:
   ITKToolsTextureBase()
   {
     this->m_InputFileName = "";
+    this->m_MaskFileName = "";
     this->m_OutputDirectory = "";
+    this->m_CSVFileName = "";
     this->m_NeighborhoodRadius = 0;
     this->m_NumberOfBins = 0;
     this->m_NumberOfOutputs = 0;
+    this->m_OutputStride = 1;
   };
   /** Destructor. */
   ~ITKToolsTextureBase(){};
 
   /** Input member parameters. */
   std::string m_InputFileName;
+  std::string m_MaskFileName;
   std::string m_OutputDirectory;
+  std::string m_CSVFileName;
   unsigned int m_NeighborhoodRadius;
   std::vector< unsigned int > m_OffsetScales;
   unsigned int m_NumberOfBins;
   unsigned int m_NumberOfOutputs;
+  unsigned int m_OutputStride;
 
 }; // end class ITKToolsTextureBase
 
@@ -103,6 +113,7 @@ public:
       InputImageType, OutputImageType >                   TextureFilterType;
     typedef itk::ImageFileReader< InputImageType >        ReaderType;
     typedef itk::ImageFileWriter< OutputImageType >       WriterType;
+    typedef typename TextureFilterType::MaskImageType     MaskImageType;
 
     /** Read the input. */
     typename ReaderType::Pointer reader = ReaderType::New();
@@ -114,8 +125,14 @@ public:
     textureFilter->SetNeighborhoodRadius( this->m_NeighborhoodRadius );
     textureFilter->SetOffsetScales( this->m_OffsetScales );
     textureFilter->SetNumberOfHistogramBins( this->m_NumberOfBins );
-    textureFilter->SetNormalizeHistogram( false );
     textureFilter->SetNumberOfRequestedOutputs( this->m_NumberOfOutputs );
+    textureFilter->SetOutputStride( this->m_OutputStride );
+    typename MaskImageType::Pointer mask = 0;
+    if( this->m_MaskFileName != "" )
+    {
+      mask = itktools::ReadMaskImage<MaskImageType>( this->m_MaskFileName );
+      textureFilter->SetMaskImage( mask );
+    }
 
     /** Create and attach a progress observer. */
     ShowProgressObject progressWatch( textureFilter );
@@ -135,6 +152,16 @@ public:
     outputFileNames[ 6 ] = this->m_OutputDirectory + "clusterProminence.mhd";
     outputFileNames[ 7 ] = this->m_OutputDirectory + "HaralickCorrelation.mhd";
 
+    /** Write the features of the samples to a csv file. Only the samples
+     * are computed, the output images are not allocated.
+     */
+    if( this->m_CSVFileName != "" )
+    {
+      textureFilter->ComputeSamples();
+      this->WriteCSV( textureFilter.GetPointer(), outputFileNames );
+      return;
+    }
+
     /** Setup and process the pipeline. */
     for( unsigned int i = 0; i < this->m_NumberOfOutputs; ++i )
     {
@@ -145,6 +172,52 @@ public:
     }
   } // end Run()
 
+  /** Write one line per sample inside the mask: the index and physical
+   * point of the input voxel, followed by the features.
+   */
+  template< class TTextureFilter >
+  void WriteCSV( TTextureFilter * textureFilter,
+    const std::vector< std::string > & outputFileNames )
+  {
+    typedef typename TTextureFilter::InputImageType       InputImageType;
+    typedef typename InputImageType::PointType            PointType;
+    typedef typename TTextureFilter::SampleIndexContainerType   SampleIndexContainerType;
+    typedef typename TTextureFilter::SampleFeatureContainerType SampleFeatureContainerType;
+
+    std::ofstream csv( this->m_CSVFileName.c_str() );
+    if( !csv.is_open() )
+    {
+      itkGenericExceptionMacro( << "Could not open " << this->m_CSVFileName << " for writing." );
+    }
+
+    /** The header. */
+    for( unsigned int d = 0; d < VDimension; ++d ) csv << "index" << d << ",";
+    for( unsigned int d = 0; d < VDimension; ++d ) csv << "point" << d << ",";
+    for( unsigned int i = 0; i < this->m_NumberOfOutputs; ++i )
+    {
+      std::string name = itksys::SystemTools::GetFilenameWithoutExtension( outputFileNames[ i ] );
+      csv << name << ( i + 1 < this->m_NumberOfOutputs ? "," : "\n" );
+    }
+
+    /** The samples. */
+    const InputImageType * input = textureFilter->GetInput();
+    const SampleIndexContainerType & indices = textureFilter->GetSampleIndices();
+    const SampleFeatureContainerType & features = textureFilter->GetSampleFeatures();
+    csv << std::setprecision( 10 );
+    for( std::size_t s = 0; s < indices.size(); ++s )
+    {
+      PointType point;
+      input->TransformIndexToPhysicalPoint( indices[ s ], point );
+      for( unsigned int d = 0; d < VDimension; ++d ) csv << indices[ s ][ d ] << ",";
+      for( unsigned int d = 0; d < VDimension; ++d ) csv << point[ d ] << ",";
+      for( unsigned int i = 0; i < this->m_NumberOfOutputs; ++i )
+      {
+        csv << features[ s * this->m_NumberOfOutputs + i ]
+          << ( i + 1 < this->m_NumberOfOutputs ? "," : "\n" );
+      }
+    }
+  } // end WriteCSV()
+
 }; // end class ITKToolsTexture
 
 
@@ -50,7 +50,8 @@
 #endif
 
 #include "itkImageToImageFilter.h"
-#include "itkOtsuThresholdCalculator.h"
+#include "itkOtsuThresholdWithMaskImageCalculator.h"
+#include "itkMultiThreader.h"
 #include "itkNumericTraits.h"
 
 #include "itkVector.h"
@@ -61,10 +62,27 @@
 #include "itkImageRandomNonRepeatingConstIteratorWithIndex.h"
 #include "itkBSplineScatteredDataPointSetToImageFilter.h"
 #include "itkVectorIndexSelectionCastImageFilter.h"
-#include "itkRegionOfInterestImageFilter.h"
+
+#include <vector>
 
 namespace itk {
 
+/** \class AdaptiveOtsuThresholdImageFilter
+ *
+ * Computes Otsu thresholds in windows of size m_Radius around a set of
+ * (random) sample points, fits a B-spline to these thresholds, and
+ * thresholds the input with the resulting threshold image.
+ *
+ * The local thresholds are computed with multiple threads directly from
+ * the input buffer. By default every window gets its own histogram, with
+ * the bins spanning the window's own intensity range. For dense sampling
+ * UseIntegralHistogram can be switched on: the image is then divided into
+ * tiles of size TileSize (default: half the radius), and an integral
+ * histogram over the tile grid is computed once, with the bins spanning
+ * the global intensity range. The histogram of a window, snapped to the
+ * tile grid, then costs O( 2^D * bins ) instead of O( window size ). The
+ * integral histogram takes ( tiles + 1 )^D * bins * 4 bytes of memory.
+ */
 template < class TInputImage, class TOutputImage >
 class ITK_EXPORT AdaptiveOtsuThresholdImageFilter :
   public ImageToImageFilter< TInputImage, TOutputImage >
@@ -112,13 +130,7 @@ public:
   typedef ImageRandomNonRepeatingConstIteratorWithIndex< InputImageType >
     RandomIteratorType;
 
-  typedef RegionOfInterestImageFilter< InputImageType, InputImageType >
-    ROIFilterType;
-  typedef typename ROIFilterType::Pointer
-    ROIFilterPointer;
-
-  typedef OtsuThresholdCalculator< InputImageType >       OtsuThresholdType;
-  typedef typename OtsuThresholdType::Pointer             OtsuThresholdPointer;
+  typedef OtsuThresholdWithMaskImageCalculator< InputImageType > OtsuThresholdType;
 
   typedef Vector< InputCoordType, 1 >         VectorType;
   typedef Image< VectorType, ImageDimension > VectorImageType;
@@ -162,6 +174,19 @@ public:
   itkSetMacro(SplineOrder, unsigned int);
   itkGetConstMacro(SplineOrder, unsigned int);
 
+  /** Compute the local histograms from a tiled integral histogram.
+   * Default is false.
+   */
+  itkSetMacro( UseIntegralHistogram, bool );
+  itkGetConstMacro( UseIntegralHistogram, bool );
+  itkBooleanMacro( UseIntegralHistogram );
+
+  /** Set/Get the tile size of the integral histogram. A zero size means
+   * half the radius in that dimension.
+   */
+  itkSetMacro( TileSize, InputSizeType );
+  itkGetConstReferenceMacro( TileSize, InputSizeType );
+
   itkSetMacro(OutsideValue, OutputPixelType);
   itkGetConstReferenceMacro(OutsideValue, OutputPixelType);
 
@@ -186,6 +211,44 @@ protected:
   void ComputeRandomPointSet();
   void GenerateData();
 
+  /** The whole input is needed, and the whole output is generated. */
+  void GenerateInputRequestedRegion();
+  void EnlargeOutputRequestedRegion( DataObject * output );
+
+  /** Compute the thresholds of the samples [begin, end). */
+  void ThreadedComputeSampleThresholds(
+    unsigned long begin, unsigned long end, ThreadIdType threadId );
+
+  /** Compute the histogram of a window from the input buffer, with the
+   * bins spanning the intensity range of the window. Returns false if the
+   * window has a single intensity, which is then returned in minimum.
+   */
+  bool ComputeWindowHistogram( const InputImageRegionType & window,
+    std::vector<double> & histogram,
+    double & minimum, double & binMultiplier ) const;
+
+  /** Compute the histogram of a window, snapped to the tile grid, from
+   * the integral histogram.
+   */
+  void ComputeWindowHistogramFromIntegral(
+    const InputImageRegionType & window,
+    std::vector<double> & histogram ) const;
+
+  /** Build the integral histogram, in three threaded steps. */
+  void ComputeIntegralHistogram();
+  void ThreadedComputeMinimumMaximum(
+    unsigned long begin, unsigned long end, ThreadIdType threadId );
+  void ThreadedComputeTileHistograms(
+    unsigned long begin, unsigned long end, ThreadIdType threadId );
+  void ThreadedComputeIntegralSums(
+    unsigned long begin, unsigned long end, unsigned int dimension );
+
+  /** Offset in the input buffer of the first pixel of a line
+   * of a window, the lines running along the first dimension.
+   */
+  OffsetValueType ComputeLineOffset(
+    const InputImageRegionType & window, SizeValueType line ) const;
+
   InputSizeType m_Radius;
   unsigned int m_NumberOfHistogramBins;
   unsigned int m_NumberOfControlPoints;
@@ -198,8 +261,51 @@ protected:
   PointSetPointer m_PointSet;
   OutputImagePointer m_Threshold;
 
+  bool          m_UseIntegralHistogram;
+  InputSizeType m_TileSize;
+
 private:
 
+  /** The steps that are executed with multiple threads. */
+  enum ThreadStepType
+    {
+    SampleThresholdsStep,
+    MinimumMaximumStep,
+    TileHistogramsStep,
+    IntegralSumsStep
+    };
+
+  /** Holds the arguments of the threads. */
+  struct ThreadStruct
+    {
+    Self *          Filter;
+    ThreadStepType  Step;
+    unsigned long   NumberOfItems;
+    unsigned int    Dimension;
+    };
+
+  /** Run a step, splitting NumberOfItems over the threads. */
+  void ExecuteStep( ThreadStepType step,
+    unsigned long numberOfItems, unsigned int dimension = 0 );
+
+  /** Thread callback. */
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void * arg );
+
+  /** The windows and thresholds of the samples. */
+  std::vector< InputImageRegionType > m_Windows;
+  std::vector< InputCoordType >       m_SampleThresholds;
+  std::vector< std::vector<double> >  m_ThreadHistograms;
+
+  /** The integral histogram: per grid point all bins, as counts. */
+  std::vector< unsigned int > m_IntegralHistogram;
+  InputSizeType               m_EffectiveTileSize;
+  InputSizeType               m_NumberOfTiles;
+  OffsetValueType             m_GridOffsetTable[ ImageDimension ];
+  std::vector< double >       m_ThreadMinimum;
+  std::vector< double >       m_ThreadMaximum;
+  double                      m_IntegralMinimum;
+  double                      m_IntegralBinMultiplier;
+
   AdaptiveOtsuThresholdImageFilter( const Self&);   // intentionally not implemented
   void operator=(const Self&);          // intentionally not implemented
 };
@@ -42,6 +42,9 @@
 #define __itkAdaptiveOtsuThresholdImageFilter_txx
 
 #include "itkAdaptiveOtsuThresholdImageFilter.h"
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
 
 namespace itk
 {
@@ -60,6 +63,12 @@ AdaptiveOtsuThresholdImageFilter()
   this->m_InsideValue = 1;
 
   this->m_PointSet = NULL;
+  this->m_UseIntegralHistogram = false;
+  this->m_TileSize.Fill( 0 );
+  this->m_EffectiveTileSize.Fill( 1 );
+  this->m_NumberOfTiles.Fill( 0 );
+  this->m_IntegralMinimum = 0.0;
+  this->m_IntegralBinMultiplier = 1.0;
 
   this->Superclass::SetNumberOfRequiredInputs( 1 );
   this->Superclass::SetNumberOfRequiredOutputs( 1 );
@@ -117,6 +126,29 @@ AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
     }
 }
 
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  InputImageType * input = const_cast< InputImageType * >( this->GetInput() );
+  if( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  Superclass::EnlargeOutputRequestedRegion( output );
+  output->SetRequestedRegionToLargestPossibleRegion();
+}
+
 template< class TInputImage, class TOutputImage >
 void
 AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
@@ -129,7 +161,6 @@ AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
   OutputImagePointer output = this->GetOutput();
   InputConstImagePointer input  = this->GetInput();
   InputImageRegionType inputRegion = input->GetLargestPossibleRegion();
-  InputSizeType inputSize = inputRegion.GetSize();
 
   InputIndexType startIndex;
   InputImageRegionType region;
@@ -146,25 +177,52 @@ AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
   PointsContainerPointer
     pointscontainer = this->m_PointSet->GetPoints();
   PointDataContainerPointer pointdatacontainer =  this->m_PointSet->GetPointData();
-  for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
-  {
+  if( !pointdatacontainer )
+    {
+    pointdatacontainer = PointDataContainer::New();
+    this->m_PointSet->SetPointData( pointdatacontainer );
+    }
+  const unsigned long numberOfSamples = pointscontainer->Size();
+
+  // The windows of the samples, read directly from the input buffer
+  this->m_Windows.resize( numberOfSamples );
+  this->m_SampleThresholds.resize( numberOfSamples );
+  for( unsigned long i = 0; i < numberOfSamples; i++ )
+    {
     point = pointscontainer->GetElement( i );
     input->TransformPhysicalPointToIndex( point, startIndex );
     region.SetIndex( startIndex );
+    region.SetSize( this->m_Radius );
+    if( !region.Crop( inputRegion ) )
+      {
+      InputSizeType emptySize;
+      emptySize.Fill( 0 );
+      region.SetSize( emptySize );
+      }
+    this->m_Windows[ i ] = region;
+    }
 
-    ROIFilterPointer roi = ROIFilterType::New();
-    roi->SetInput( input );
-    roi->SetRegionOfInterest( region );
-    roi->Update();
+  if( this->m_UseIntegralHistogram )
+    {
+    this->ComputeIntegralHistogram();
+    }
 
-    OtsuThresholdPointer otsu = OtsuThresholdType::New();
-    otsu->SetImage( roi->GetOutput() );
-    otsu->SetNumberOfHistogramBins( this->m_NumberOfHistogramBins);
-    otsu->Compute();
+  // Compute the local thresholds, each thread with its own histogram
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+  this->m_ThreadHistograms.assign( numberOfThreads,
+    std::vector<double>( this->m_NumberOfHistogramBins, 0.0 ) );
+  this->ExecuteStep( SampleThresholdsStep, numberOfSamples );
+  this->m_ThreadHistograms.clear();
+  this->m_IntegralHistogram.clear();
 
-    V[0] = static_cast<InputCoordType>( otsu->GetThreshold() );
+  pointdatacontainer->Reserve( numberOfSamples );
+  for( unsigned long i = 0; i < numberOfSamples; i++ )
+    {
+    V[0] = this->m_SampleThresholds[ i ];
     pointdatacontainer->SetElement( i, V );
-  }
+    }
+  this->m_Windows.clear();
+  this->m_SampleThresholds.clear();
 
   typename SDAFilterType::ArrayType ncps;
   ncps.Fill( this->m_NumberOfControlPoints );
@@ -214,6 +272,397 @@ AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
     }
 }
 
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ExecuteStep( ThreadStepType step,
+  unsigned long numberOfItems, unsigned int dimension )
+{
+  ThreadStruct str;
+  str.Filter = this;
+  str.Step = step;
+  str.NumberOfItems = numberOfItems;
+  str.Dimension = dimension;
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod( ThreaderCallback, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+}
+
+template< class TInputImage, class TOutputImage >
+ITK_THREAD_RETURN_TYPE
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ThreaderCallback( void * arg )
+{
+  typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  ThreadStruct * str = static_cast<ThreadStruct *>( info->UserData );
+  const ThreadIdType threadId = info->ThreadID;
+  const ThreadIdType numberOfThreads = info->NumberOfThreads;
+
+  // contiguous ranges of items
+  const unsigned long begin = threadId * str->NumberOfItems / numberOfThreads;
+  const unsigned long end = ( threadId + 1 ) * str->NumberOfItems / numberOfThreads;
+  if( begin >= end )
+    {
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  switch( str->Step )
+    {
+    case SampleThresholdsStep:
+      str->Filter->ThreadedComputeSampleThresholds( begin, end, threadId );
+      break;
+    case MinimumMaximumStep:
+      str->Filter->ThreadedComputeMinimumMaximum( begin, end, threadId );
+      break;
+    case TileHistogramsStep:
+      str->Filter->ThreadedComputeTileHistograms( begin, end, threadId );
+      break;
+    case IntegralSumsStep:
+      str->Filter->ThreadedComputeIntegralSums( begin, end, str->Dimension );
+      break;
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ThreadedComputeSampleThresholds(
+  unsigned long begin, unsigned long end, ThreadIdType threadId )
+{
+  std::vector<double> & histogram = this->m_ThreadHistograms[ threadId ];
+  const unsigned long numberOfBins = this->m_NumberOfHistogramBins;
+
+  for( unsigned long i = begin; i < end; i++ )
+    {
+    double minimum = this->m_IntegralMinimum;
+    double binMultiplier = this->m_IntegralBinMultiplier;
+    if( this->m_UseIntegralHistogram )
+      {
+      this->ComputeWindowHistogramFromIntegral( this->m_Windows[ i ], histogram );
+      }
+    else if( !this->ComputeWindowHistogram( this->m_Windows[ i ], histogram,
+      minimum, binMultiplier ) )
+      {
+      this->m_SampleThresholds[ i ] = static_cast<InputCoordType>( minimum );
+      continue;
+      }
+
+    const unsigned long maxBinNumber
+      = OtsuThresholdType::ComputeOtsuBin( &histogram[ 0 ], numberOfBins );
+    this->m_SampleThresholds[ i ] = static_cast<InputCoordType>(
+      static_cast<InputPixelType>( minimum + ( maxBinNumber + 1 ) / binMultiplier ) );
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+OffsetValueType
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ComputeLineOffset( const InputImageRegionType & window, SizeValueType line ) const
+{
+  const InputImageType * input = this->GetInput();
+  const OffsetValueType * offsetTable = input->GetOffsetTable();
+
+  OffsetValueType offset = input->ComputeOffset( window.GetIndex() );
+  for( unsigned int d = 1; d < ImageDimension; d++ )
+    {
+    const SizeValueType size = window.GetSize()[ d ];
+    offset += static_cast<OffsetValueType>( line % size ) * offsetTable[ d ];
+    line /= size;
+    }
+
+  return offset;
+}
+
+template< class TInputImage, class TOutputImage >
+bool
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ComputeWindowHistogram( const InputImageRegionType & window,
+  std::vector<double> & histogram,
+  double & minimum, double & binMultiplier ) const
+{
+  const InputPixelType * buffer = this->GetInput()->GetBufferPointer();
+  const SizeValueType lineLength = window.GetSize()[ 0 ];
+  const SizeValueType numberOfPixels = window.GetNumberOfPixels();
+  minimum = 0.0;
+  if( numberOfPixels == 0 )
+    {
+    return false;
+    }
+  const SizeValueType numberOfLines = numberOfPixels / lineLength;
+
+  // first pass: the intensity range of the window
+  InputPixelType windowMin = NumericTraits<InputPixelType>::max();
+  InputPixelType windowMax = NumericTraits<InputPixelType>::NonpositiveMin();
+  for( SizeValueType l = 0; l < numberOfLines; l++ )
+    {
+    const InputPixelType * it = buffer + this->ComputeLineOffset( window, l );
+    for( SizeValueType x = 0; x < lineLength; x++ )
+      {
+      const InputPixelType value = it[ x ];
+      windowMin = value < windowMin ? value : windowMin;
+      windowMax = windowMax < value ? value : windowMax;
+      }
+    }
+  minimum = static_cast<double>( windowMin );
+  if( windowMin >= windowMax )
+    {
+    return false;
+    }
+
+  // second pass: the histogram, binned as in the Otsu calculator
+  const unsigned long lastBin = this->m_NumberOfHistogramBins - 1;
+  binMultiplier = static_cast<double>( this->m_NumberOfHistogramBins )
+    / ( static_cast<double>( windowMax ) - minimum );
+  std::fill( histogram.begin(), histogram.end(), 0.0 );
+  for( SizeValueType l = 0; l < numberOfLines; l++ )
+    {
+    const InputPixelType * it = buffer + this->ComputeLineOffset( window, l );
+    for( SizeValueType x = 0; x < lineLength; x++ )
+      {
+      const InputPixelType value = it[ x ];
+      unsigned long binNumber = 0;
+      if( value != windowMin )
+        {
+        binNumber = (unsigned long) vcl_ceil( ( value - minimum ) * binMultiplier ) - 1;
+        if( binNumber > lastBin ) // in case of rounding errors
+          {
+          binNumber = lastBin;
+          }
+        }
+      histogram[ binNumber ] += 1.0;
+      }
+    }
+
+  return true;
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ComputeIntegralHistogram()
+{
+  const InputImageRegionType inputRegion = this->GetInput()->GetLargestPossibleRegion();
+  const unsigned int lastDimension = ImageDimension - 1;
+  const unsigned long numberOfBins = this->m_NumberOfHistogramBins;
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+
+  // the tile grid, with an extra zero plane in each dimension
+  unsigned long numberOfGridPoints = 1;
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    SizeValueType tileSize = this->m_TileSize[ d ];
+    if( tileSize == 0 )
+      {
+      tileSize = vnl_math_max( this->m_Radius[ d ] / 2, SizeValueType( 1 ) );
+      }
+    this->m_EffectiveTileSize[ d ] = tileSize;
+    this->m_NumberOfTiles[ d ] = ( inputRegion.GetSize()[ d ] + tileSize - 1 ) / tileSize;
+    this->m_GridOffsetTable[ d ] = numberOfGridPoints;
+    numberOfGridPoints *= this->m_NumberOfTiles[ d ] + 1;
+    }
+
+  // the global intensity range
+  this->m_ThreadMinimum.assign( numberOfThreads, NumericTraits<double>::max() );
+  this->m_ThreadMaximum.assign( numberOfThreads, NumericTraits<double>::NonpositiveMin() );
+  this->ExecuteStep( MinimumMaximumStep, inputRegion.GetSize()[ lastDimension ] );
+  double maximum = NumericTraits<double>::NonpositiveMin();
+  this->m_IntegralMinimum = NumericTraits<double>::max();
+  for( ThreadIdType i = 0; i < numberOfThreads; i++ )
+    {
+    this->m_IntegralMinimum = vnl_math_min( this->m_IntegralMinimum, this->m_ThreadMinimum[ i ] );
+    maximum = vnl_math_max( maximum, this->m_ThreadMaximum[ i ] );
+    }
+  this->m_IntegralBinMultiplier = 1.0;
+  if( maximum > this->m_IntegralMinimum )
+    {
+    this->m_IntegralBinMultiplier = static_cast<double>( numberOfBins )
+      / ( maximum - this->m_IntegralMinimum );
+    }
+
+  // the histograms of the tiles, each thread a range of tile layers
+  this->m_IntegralHistogram.assign( numberOfGridPoints * numberOfBins, 0 );
+  this->ExecuteStep( TileHistogramsStep, this->m_NumberOfTiles[ lastDimension ] );
+
+  // cumulative sums along each dimension, each thread a range of bins
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    this->ExecuteStep( IntegralSumsStep, numberOfBins, d );
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ThreadedComputeMinimumMaximum(
+  unsigned long begin, unsigned long end, ThreadIdType threadId )
+{
+  const InputImageType * input = this->GetInput();
+  const unsigned int lastDimension = ImageDimension - 1;
+
+  InputImageRegionType slab = input->GetLargestPossibleRegion();
+  slab.SetIndex( lastDimension, slab.GetIndex()[ lastDimension ] + begin );
+  slab.SetSize( lastDimension, end - begin );
+
+  double minimum = this->m_ThreadMinimum[ threadId ];
+  double maximum = this->m_ThreadMaximum[ threadId ];
+  for( InputIteratorType it( input, slab ); !it.IsAtEnd(); ++it )
+    {
+    const double value = static_cast<double>( it.Value() );
+    minimum = value < minimum ? value : minimum;
+    maximum = maximum < value ? value : maximum;
+    }
+  this->m_ThreadMinimum[ threadId ] = minimum;
+  this->m_ThreadMaximum[ threadId ] = maximum;
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ThreadedComputeTileHistograms(
+  unsigned long begin, unsigned long end, ThreadIdType itkNotUsed( threadId ) )
+{
+  const InputImageType * input = this->GetInput();
+  const InputPixelType * buffer = input->GetBufferPointer();
+  const unsigned int lastDimension = ImageDimension - 1;
+  const unsigned long numberOfBins = this->m_NumberOfHistogramBins;
+  const unsigned long lastBin = numberOfBins - 1;
+  const double minimum = this->m_IntegralMinimum;
+  const double binMultiplier = this->m_IntegralBinMultiplier;
+
+  // the pixels of the tile layers [begin, end) along the last dimension
+  const InputImageRegionType inputRegion = input->GetLargestPossibleRegion();
+  InputImageRegionType slab = inputRegion;
+  const SizeValueType layerSize = this->m_EffectiveTileSize[ lastDimension ];
+  const SizeValueType slabBegin = static_cast<SizeValueType>( begin ) * layerSize;
+  const SizeValueType slabEnd = vnl_math_min( static_cast<SizeValueType>( end ) * layerSize,
+    static_cast<SizeValueType>( inputRegion.GetSize()[ lastDimension ] ) );
+  slab.SetIndex( lastDimension, inputRegion.GetIndex()[ lastDimension ] + slabBegin );
+  slab.SetSize( lastDimension, slabEnd - slabBegin );
+
+  const SizeValueType lineLength = slab.GetSize()[ 0 ];
+  const SizeValueType numberOfLines = slab.GetNumberOfPixels() / lineLength;
+  const SizeValueType tileSize0 = this->m_EffectiveTileSize[ 0 ];
+  for( SizeValueType l = 0; l < numberOfLines; l++ )
+    {
+    // the grid point of the tile containing the first pixel of the line,
+    // shifted by one to leave the zero planes
+    OffsetValueType gridOffset = 0;
+    SizeValueType line = l;
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      const SizeValueType position = ( d == lastDimension ? slabBegin : 0 )
+        + line % slab.GetSize()[ d ];
+      line /= slab.GetSize()[ d ];
+      gridOffset += ( position / this->m_EffectiveTileSize[ d ] + 1 )
+        * this->m_GridOffsetTable[ d ];
+      }
+    unsigned int * lineHistogram = &this->m_IntegralHistogram[ 0 ]
+      + ( gridOffset + 1 ) * numberOfBins;
+
+    const InputPixelType * it = buffer + this->ComputeLineOffset( slab, l );
+    for( SizeValueType x = 0; x < lineLength; x++ )
+      {
+      const double value = static_cast<double>( it[ x ] );
+      unsigned long binNumber = 0;
+      if( value != minimum )
+        {
+        binNumber = (unsigned long) vcl_ceil( ( value - minimum ) * binMultiplier ) - 1;
+        if( binNumber > lastBin ) // in case of rounding errors
+          {
+          binNumber = lastBin;
+          }
+        }
+      lineHistogram[ ( x / tileSize0 ) * numberOfBins + binNumber ]++;
+      }
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ThreadedComputeIntegralSums(
+  unsigned long begin, unsigned long end, unsigned int dimension )
+{
+  // In memory order, so that the grid point one step back along the
+  // dimension already holds its cumulative sum.
+  const unsigned long numberOfBins = this->m_NumberOfHistogramBins;
+  const OffsetValueType step = this->m_GridOffsetTable[ dimension ];
+  const unsigned long numberOfGridPoints
+    = this->m_IntegralHistogram.size() / numberOfBins;
+  const SizeValueType gridSize = this->m_NumberOfTiles[ dimension ] + 1;
+
+  unsigned int * histogram = &this->m_IntegralHistogram[ 0 ];
+  for( unsigned long g = 0; g < numberOfGridPoints; g++ )
+    {
+    if( ( g / step ) % gridSize == 0 ) continue;
+    unsigned int * current = histogram + g * numberOfBins;
+    const unsigned int * previous = current - step * numberOfBins;
+    for( unsigned long b = begin; b < end; b++ )
+      {
+      current[ b ] += previous[ b ];
+      }
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>
+::ComputeWindowHistogramFromIntegral(
+  const InputImageRegionType & window,
+  std::vector<double> & histogram ) const
+{
+  const InputImageRegionType inputRegion = this->GetInput()->GetLargestPossibleRegion();
+  const unsigned long numberOfBins = this->m_NumberOfHistogramBins;
+
+  // snap the window to the tile grid, at least one tile wide
+  SizeValueType lower[ ImageDimension ];
+  SizeValueType upper[ ImageDimension ];
+  for( unsigned int d = 0; d < ImageDimension; d++ )
+    {
+    const double tileSize = static_cast<double>( this->m_EffectiveTileSize[ d ] );
+    const double start = static_cast<double>(
+      window.GetIndex()[ d ] - inputRegion.GetIndex()[ d ] );
+    const SizeValueType numberOfTiles = this->m_NumberOfTiles[ d ];
+    lower[ d ] = vnl_math_min( numberOfTiles - 1, static_cast<SizeValueType>(
+      vcl_floor( start / tileSize + 0.5 ) ) );
+    upper[ d ] = vnl_math_min( numberOfTiles, static_cast<SizeValueType>(
+      vcl_floor( ( start + window.GetSize()[ d ] ) / tileSize + 0.5 ) ) );
+    upper[ d ] = vnl_math_max( upper[ d ], lower[ d ] + 1 );
+    }
+
+  // inclusion-exclusion over the corners of the window
+  std::fill( histogram.begin(), histogram.end(), 0.0 );
+  const unsigned int numberOfCorners = 1 << ImageDimension;
+  for( unsigned int corner = 0; corner < numberOfCorners; corner++ )
+    {
+    OffsetValueType gridOffset = 0;
+    unsigned int numberOfLower = 0;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      if( corner & ( 1 << d ) )
+        {
+        gridOffset += upper[ d ] * this->m_GridOffsetTable[ d ];
+        }
+      else
+        {
+        gridOffset += lower[ d ] * this->m_GridOffsetTable[ d ];
+        numberOfLower++;
+        }
+      }
+    const double sign = ( numberOfLower % 2 ) ? -1.0 : 1.0;
+    const unsigned int * cumulative
+      = &this->m_IntegralHistogram[ 0 ] + gridOffset * numberOfBins;
+    for( unsigned long b = 0; b < numberOfBins; b++ )
+      {
+      histogram[ b ] += sign * cumulative[ b ];
+      }
+    }
+}
+
 template< class TInputImage, class TOutputImage >
 void
 AdaptiveOtsuThresholdImageFilter<TInputImage, TOutputImage>::
@@ -236,6 +685,10 @@ PrintSelf( std::ostream& os, Indent indent ) const
     std::endl;
   os << indent << "Outside value: " << GetOutsideValue() <<
     std::endl;
+  os << indent << "Use integral histogram: " << GetUseIntegralHistogram() <<
+    std::endl;
+  os << indent << "Tile size: " << GetTileSize() <<
+    std::endl;
 }
 
 } /* end namespace itk */
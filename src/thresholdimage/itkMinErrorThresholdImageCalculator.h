@@ -20,6 +20,7 @@
 #include "itkObject.h"
 #include "itkObjectFactory.h"
 #include "itkNumericTraits.h"
+#include "itkThresholdHistogramBuilder.h"
 
 namespace itk
 {
@@ -33,6 +34,11 @@ namespace itk
  * that fits the histogram with minimum error. This calculator provides two options for the mixture
  * which are a mixture of Gaussians and a mixture of Poissons. The minimum error threshold is the
  * one that minimizes the error criterion function, which depends on the chosen mixture type
+ *
+ * The histogram is computed by a ThresholdHistogramBuilder, optionally
+ * within a mask. The threshold can also be computed from the result of an
+ * existing builder, see ComputeFromHistogram().
+ *
  * \warning This method assumes that the input image consists of scalar pixel
  * types.
  *
@@ -70,12 +76,23 @@ public:
   /** Type definition for the input image region type. */
   typedef typename TInputImage::RegionType RegionType;
 
+  /** Typedefs for the mask and the histogram builder. */
+  typedef ThresholdHistogramBuilder<TInputImage>        HistogramBuilderType;
+  typedef typename HistogramBuilderType::MaskImageType  MaskImageType;
+  typedef typename MaskImageType::Pointer               MaskImagePointer;
+
   /** Set the input image. */
   itkSetConstObjectMacro(Image,ImageType);
 
+  /** Set the mask image */
+  itkSetObjectMacro( MaskImage, MaskImageType );
+
   /** Compute the MinError's threshold for the input image. */
   void Compute( void );
 
+  /** Compute the MinError's threshold from a computed histogram. */
+  void ComputeFromHistogram( const HistogramBuilderType * builder );
+
   /** This function sets the option to use a mixture of Gaussians */
   void UseGaussianMixture(bool);
 
@@ -110,6 +127,7 @@ private:
   PixelType            m_Threshold;
   unsigned long        m_NumberOfHistogramBins;
   ImageConstPointer    m_Image;
+  MaskImagePointer     m_MaskImage;
   RegionType           m_Region;
   bool                 m_RegionSetByUser;
   double         m_AlphaLeft;
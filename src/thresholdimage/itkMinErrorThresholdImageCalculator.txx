@@ -18,8 +18,6 @@
 #define _itkMinErrorThresholdImageCalculator_txx
 
 #include "itkMinErrorThresholdImageCalculator.h"
-#include "itkImageRegionConstIteratorWithIndex.h"
-#include "itkMinimumMaximumImageCalculator.h"
 
 #include "vnl/vnl_math.h"
 #include <limits>
@@ -35,6 +33,7 @@ MinErrorThresholdImageCalculator<TInputImage>
 ::MinErrorThresholdImageCalculator()
 {
   this->m_Image = NULL;
+  this->m_MaskImage = NULL;
   this->m_Threshold = NumericTraits<PixelType>::Zero;
   this->m_NumberOfHistogramBins = 128;
   this->m_RegionSetByUser = false;
@@ -78,26 +77,37 @@ MinErrorThresholdImageCalculator<TInputImage>
 ::Compute( void )
 {
 
-  unsigned int j, i;
-
   if( !m_Image ) { return; }
   if( !m_RegionSetByUser )
     {
     this->m_Region = this->m_Image->GetRequestedRegion();
     }
+  if( this->m_Region.GetNumberOfPixels() == 0 ) { return; }
 
-  double totalPixels = (double) this->m_Region.GetNumberOfPixels();
-  if( totalPixels == 0 ) { return; }
+  // create the histogram
+  typename HistogramBuilderType::Pointer builder = HistogramBuilderType::New();
+  builder->SetImage( this->m_Image );
+  builder->SetMaskImage( this->m_MaskImage );
+  builder->SetRegion( this->m_Region );
+  builder->SetNumberOfHistogramBins( this->m_NumberOfHistogramBins );
+  builder->Compute();
 
+  this->ComputeFromHistogram( builder );
+}
 
-  // compute image max and min
-  typedef MinimumMaximumImageCalculator<TInputImage> RangeCalculator;
-  typename RangeCalculator::Pointer rangeCalculator = RangeCalculator::New();
-  rangeCalculator->SetImage( this->m_Image );
-  rangeCalculator->Compute();
 
-  PixelType imageMin = rangeCalculator->GetMinimum();
-  PixelType imageMax = rangeCalculator->GetMaximum();
+/*
+ * Compute the MinError's threshold from the histogram
+ */
+template<class TInputImage>
+void
+MinErrorThresholdImageCalculator<TInputImage>
+::ComputeFromHistogram( const HistogramBuilderType * builder )
+{
+  unsigned int j, i;
+
+  PixelType imageMin = builder->GetMinimum();
+  PixelType imageMax = builder->GetMaximum();
 
   if( imageMin >= imageMax )
     {
@@ -105,47 +115,17 @@ MinErrorThresholdImageCalculator<TInputImage>
     return;
     }
 
-  // create the histogram and the error functions
-  std::vector<double> relativeFrequency;
-  std::vector<double> errorFunctionPois;
-  std::vector<double> errorFunctionGaus;
+  this->m_PriorLeft = this->m_PriorRight = 0.0;
+  this->m_AlphaLeft = this->m_AlphaRight = 0.0;
 
-  relativeFrequency.resize( this->m_NumberOfHistogramBins );
-  errorFunctionPois.resize( this->m_NumberOfHistogramBins );
-  errorFunctionGaus.resize( this->m_NumberOfHistogramBins );
-  for ( j = 0; j < this->m_NumberOfHistogramBins; j++ )
-    {
-    relativeFrequency[j] = errorFunctionPois[j] = errorFunctionGaus[j] = 0.0;
-    }
-
-  double binMultiplier = (double) this->m_NumberOfHistogramBins /
-    (double) ( imageMax - imageMin );
-
-  typedef ImageRegionConstIteratorWithIndex<TInputImage> Iterator;
-  Iterator iter( this->m_Image, this->m_Region );
-
-  while ( !iter.IsAtEnd() )
-    {
-    unsigned int binNumber;
-    PixelType value = iter.Get();
-
-    if( value == imageMin )
-      {
-      binNumber = 0;
-      }
-    else
-      {
-      binNumber = (unsigned int) vcl_ceil((value - imageMin) * binMultiplier ) - 1;
-      if( binNumber == this->m_NumberOfHistogramBins ) // in case of rounding errors
-        {
-        binNumber -= 1;
-        }
-      }
-
-    relativeFrequency[binNumber] += 1.0;
-    ++iter;
+  // the histogram and the error functions
+  this->m_NumberOfHistogramBins = builder->GetNumberOfHistogramBins();
+  std::vector<double> relativeFrequency = builder->GetHistogram();
+  std::vector<double> errorFunctionPois( this->m_NumberOfHistogramBins, 0.0 );
+  std::vector<double> errorFunctionGaus( this->m_NumberOfHistogramBins, 0.0 );
 
-    }
+  const double totalPixels = builder->GetTotalFrequency();
+  const double binMultiplier = builder->GetBinMultiplier();
 
   // normalize the histogram
   double totalMean = 0.0;
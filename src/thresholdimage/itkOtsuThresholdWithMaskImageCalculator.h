@@ -20,6 +20,7 @@
 #include "itkObject.h"
 #include "itkObjectFactory.h"
 #include "itkNumericTraits.h"
+#include "itkThresholdHistogramBuilder.h"
 
 namespace itk
 {
@@ -34,6 +35,10 @@ namespace itk
  *
  * This class is templated over the input image type.
  *
+ * The histogram is computed by a ThresholdHistogramBuilder. The threshold
+ * can also be computed from the result of an existing builder, see
+ * ComputeFromHistogram().
+ *
  * \warning This method assumes that the input image consists of scalar pixel
  * types.
  *
@@ -84,9 +89,24 @@ public:
   /** Set the mask image */
   itkSetObjectMacro( MaskImage, MaskImageType );
 
+  /** Typedef for the histogram builder. */
+  typedef ThresholdHistogramBuilder<TInputImage>    HistogramBuilderType;
+
   /** Compute the Otsu's threshold for the input image. */
   void Compute( void );
 
+  /** Compute the Otsu's threshold from a computed histogram. */
+  void ComputeFromHistogram( const HistogramBuilderType * builder );
+
+  /** Return the index of the last bin of the lower class, i.e. the bin
+   * that maximizes the between-class variance of the given frequencies.
+   * The frequencies need not be normalized. This is the kernel of
+   * ComputeFromHistogram(), exposed for filters that build many
+   * (local) histograms themselves.
+   */
+  static unsigned long ComputeOtsuBin(
+    const double * frequency, unsigned long numberOfBins );
+
   /** Return the Otsu's threshold value. */
   itkGetConstMacro(Threshold,PixelType);
 
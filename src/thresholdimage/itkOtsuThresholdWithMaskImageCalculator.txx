@@ -19,9 +19,6 @@
 
 #include "itkOtsuThresholdWithMaskImageCalculator.h"
 
-#include "itkImageRegionConstIteratorWithIndex.h"
-#include "itkImageRegionConstIterator.h"
-
 #include "vnl/vnl_math.h"
 
 namespace itk
@@ -50,127 +47,105 @@ void
 OtsuThresholdWithMaskImageCalculator<TInputImage>
 ::Compute( void )
 {
-  unsigned int j;
-
   if( !m_Image ) { return; }
   if( !m_RegionSetByUser )
   {
     this->m_Region = this->m_Image->GetRequestedRegion();
   }
+  if( this->m_Region.GetNumberOfPixels() == 0 ) { return; }
 
-  double totalPixels = (double) this->m_Region.GetNumberOfPixels();
-  if( totalPixels == 0 ) { return; }
-  totalPixels = 0.0;
+  // create a histogram
+  typename HistogramBuilderType::Pointer builder = HistogramBuilderType::New();
+  builder->SetImage( this->m_Image );
+  builder->SetMaskImage( this->m_MaskImage );
+  builder->SetRegion( this->m_Region );
+  builder->SetNumberOfHistogramBins( this->m_NumberOfHistogramBins );
+  builder->Compute();
 
-  typedef ImageRegionConstIteratorWithIndex<ImageType> IteratorType;
-  IteratorType iter( this->m_Image, this->m_Region );
-  iter.GoToBegin();
+  this->ComputeFromHistogram( builder );
 
-  typedef ImageRegionConstIterator<MaskImageType> MaskIteratorType;
-  MaskIteratorType itMask;
-  if( this->m_MaskImage )
-  {
-    itMask = MaskIteratorType( this->m_MaskImage, this->m_Region );
-    itMask.GoToBegin();
-  }
+} // end Compute()
 
-  // compute image max and min
-  PixelType imageMin = NumericTraits<PixelType>::max();
-  PixelType imageMax = NumericTraits<PixelType>::NonpositiveMin();
-  while ( !iter.IsAtEnd() )
-  {
-    if( this->m_MaskImage && itMask.Value() == 0 )
-    {
-      ++iter; ++itMask;
-      continue;
-    }
-
-    PixelType current = iter.Value();
-    imageMin = imageMin > current ? current : imageMin;
-    imageMax = imageMax < current ? current : imageMax;
-
-    ++iter;
-    if( this->m_MaskImage ) ++itMask;
-  }
 
+/*
+ * Compute the Otsu's threshold from the histogram
+ */
+template<class TInputImage>
+void
+OtsuThresholdWithMaskImageCalculator<TInputImage>
+::ComputeFromHistogram( const HistogramBuilderType * builder )
+{
+  const PixelType imageMin = builder->GetMinimum();
+  const PixelType imageMax = builder->GetMaximum();
   if( imageMin >= imageMax )
   {
     this->m_Threshold = imageMin;
     return;
   }
 
-  // create a histogram
-  std::vector<double> relativeFrequency;
-  relativeFrequency.resize( this->m_NumberOfHistogramBins );
-  for ( j = 0; j < this->m_NumberOfHistogramBins; j++ )
-    {
-    relativeFrequency[j] = 0.0;
-    }
-
-  double binMultiplier = (double) this->m_NumberOfHistogramBins /
-    (double) ( imageMax - imageMin );
-
-  iter.GoToBegin();
-  if( this->m_MaskImage ) itMask.GoToBegin();
-  while ( !iter.IsAtEnd() )
-  {
-    if( this->m_MaskImage && itMask.Value() == 0 )
-    {
-      ++iter; ++itMask;
-      continue;
-    }
+  this->m_NumberOfHistogramBins = builder->GetNumberOfHistogramBins();
+  const unsigned long maxBinNumber = ComputeOtsuBin(
+    &( builder->GetHistogram()[ 0 ] ), this->m_NumberOfHistogramBins );
 
-    unsigned int binNumber;
-    PixelType value = iter.Get();
+  this->m_Threshold = static_cast<PixelType>( imageMin +
+    ( maxBinNumber + 1 ) / builder->GetBinMultiplier() );
 
-    if( value == imageMin )
-      {
-      binNumber = 0;
-      }
-    else
-      {
-      binNumber = (unsigned int) vcl_ceil((value - imageMin) * binMultiplier ) - 1;
-      if( binNumber == this->m_NumberOfHistogramBins ) // in case of rounding errors
-        {
-        binNumber -= 1;
-        }
-      }
+} // end ComputeFromHistogram()
 
-    relativeFrequency[binNumber] += 1.0;
-    totalPixels += 1.0;
 
-    ++iter;
-    if( this->m_MaskImage ) ++itMask;
-  }
+/*
+ * Compute the bin that maximizes the between-class variance
+ */
+template<class TInputImage>
+unsigned long
+OtsuThresholdWithMaskImageCalculator<TInputImage>
+::ComputeOtsuBin( const double * frequency, unsigned long numberOfBins )
+{
+  unsigned long j;
 
   // normalize the frequencies
-  double totalMean = 0.0;
-  for ( j = 0; j < this->m_NumberOfHistogramBins; j++ )
+  double totalPixels = 0.0;
+  for ( j = 0; j < numberOfBins; j++ )
     {
-    relativeFrequency[j] /= totalPixels;
-    totalMean += (j+1) * relativeFrequency[j];
+    totalPixels += frequency[j];
     }
+  if( totalPixels <= 0.0 ) { return 0; }
 
+  double totalMean = 0.0;
+  for ( j = 0; j < numberOfBins; j++ )
+    {
+    totalMean += (j+1) * frequency[j] / totalPixels;
+    }
 
   // compute Otsu's threshold by maximizing the between-class
   // variance
-  double freqLeft = relativeFrequency[0];
+  double freqLeft = frequency[0] / totalPixels;
   double meanLeft = 1.0;
-  double meanRight = ( totalMean - freqLeft ) / ( 1.0 - freqLeft );
+  double meanRight = 0.0;
+  if( freqLeft < 1.0 )
+    {
+    meanRight = ( totalMean - freqLeft ) / ( 1.0 - freqLeft );
+    }
 
   double maxVarBetween = freqLeft * ( 1.0 - freqLeft ) *
     vnl_math_sqr( meanLeft - meanRight );
-  int maxBinNumber = 0;
+  unsigned long maxBinNumber = 0;
 
   double freqLeftOld = freqLeft;
   double meanLeftOld = meanLeft;
 
-  for ( j = 1; j < this->m_NumberOfHistogramBins; j++ )
+  for ( j = 1; j < numberOfBins; j++ )
     {
-    freqLeft += relativeFrequency[j];
+    const double relativeFrequency = frequency[j] / totalPixels;
+    freqLeft += relativeFrequency;
+    if( freqLeft <= 0.0 )
+      {
+      // no pixels to the left yet
+      continue;
+      }
     meanLeft = ( meanLeftOld * freqLeftOld +
-                 (j+1) * relativeFrequency[j] ) / freqLeft;
-    if(freqLeft == 1.0)
+                 (j+1) * relativeFrequency ) / freqLeft;
+    if( freqLeft >= 1.0 )
       {
       meanRight = 0.0;
       }
@@ -194,9 +169,10 @@ OtsuThresholdWithMaskImageCalculator<TInputImage>
 
     }
 
-  this->m_Threshold = static_cast<PixelType>( imageMin +
-                                        ( maxBinNumber + 1 ) / binMultiplier );
-}
+  return maxBinNumber;
+
+} // end ComputeOtsuBin()
+
 
 template<class TInputImage>
 void
@@ -0,0 +1,190 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkThresholdHistogramBuilder_h
+#define __itkThresholdHistogramBuilder_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkNumericTraits.h"
+#include "itkImage.h"
+#include <vector>
+
+namespace itk
+{
+
+/** \class ThresholdHistogramBuilder
+ * \brief Computes the intensity histogram on which histogram based
+ * threshold methods operate.
+ *
+ * The histogram has NumberOfHistogramBins bins of equal width between the
+ * minimum and maximum intensity of the (masked) region. The first sweep
+ * over the image computes the minimum and maximum, the second one the
+ * histogram. Both sweeps are multi-threaded, with a histogram per thread
+ * that are summed afterwards.
+ *
+ * If the image is the output of a pipeline, e.g. of an ImageFileReader
+ * on which UpdateOutputInformation() is called, the sweeps can be
+ * streamed in NumberOfStreamDivisions slabs along the last dimension,
+ * so that the image never has to be in memory completely. The mask
+ * is always assumed to be in memory.
+ *
+ * A threshold method, like the OtsuThresholdWithMaskImageCalculator or the
+ * MinErrorThresholdImageCalculator, computes its threshold from the result
+ * with ComputeFromHistogram().
+ *
+ * \ingroup Operators
+ */
+template <class TInputImage>
+class ITK_EXPORT ThresholdHistogramBuilder : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef ThresholdHistogramBuilder    Self;
+  typedef Object                       Superclass;
+  typedef SmartPointer<Self>           Pointer;
+  typedef SmartPointer<const Self>     ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ThresholdHistogramBuilder, Object);
+
+  /** Type definitions for the input image. */
+  typedef TInputImage                         ImageType;
+  typedef typename TInputImage::ConstPointer  ImageConstPointer;
+  typedef typename TInputImage::PixelType     PixelType;
+  typedef typename TInputImage::RegionType    RegionType;
+
+  /** Image related typedefs. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+    TInputImage::ImageDimension );
+  typedef Image< unsigned char,
+    itkGetStaticConstMacro( ImageDimension ) >      MaskImageType;
+  typedef typename MaskImageType::ConstPointer      MaskImageConstPointer;
+
+  /** The histogram type: the number of pixels per bin. */
+  typedef std::vector<double>                       HistogramType;
+
+  /** Set the input image. */
+  itkSetConstObjectMacro( Image, ImageType );
+
+  /** Set the mask image. */
+  itkSetConstObjectMacro( MaskImage, MaskImageType );
+
+  /** Set/Get the number of histogram bins. Default is 128. */
+  itkSetClampMacro( NumberOfHistogramBins, unsigned long, 1,
+                    NumericTraits<unsigned long>::max() );
+  itkGetConstMacro( NumberOfHistogramBins, unsigned long );
+
+  /** Set/Get the number of threads. Default is the global default. */
+  itkSetMacro( NumberOfThreads, ThreadIdType );
+  itkGetConstMacro( NumberOfThreads, ThreadIdType );
+
+  /** Set/Get the number of stream divisions. Default is 1. */
+  itkSetClampMacro( NumberOfStreamDivisions, unsigned int, 1,
+                    NumericTraits<unsigned int>::max() );
+  itkGetConstMacro( NumberOfStreamDivisions, unsigned int );
+
+  /** Set the region over which the histogram is computed. Default is the
+   * largest possible region of the image.
+   */
+  void SetRegion( const RegionType & region );
+
+  /** Compute the histogram. */
+  void Compute( void );
+
+  /** Get the results. */
+  itkGetConstMacro( Minimum, PixelType );
+  itkGetConstMacro( Maximum, PixelType );
+  itkGetConstMacro( TotalFrequency, double );
+  const HistogramType & GetHistogram( void ) const
+  {
+    return this->m_Histogram;
+  }
+
+  /** The number of bins per unit of intensity. */
+  double GetBinMultiplier( void ) const
+  {
+    return static_cast<double>( this->m_NumberOfHistogramBins )
+      / ( static_cast<double>( this->m_Maximum ) - static_cast<double>( this->m_Minimum ) );
+  }
+
+protected:
+  ThresholdHistogramBuilder();
+  virtual ~ThresholdHistogramBuilder() {};
+  void PrintSelf(std::ostream& os, Indent indent) const;
+
+  /** Compute the minimum and maximum, or the histogram, of a part
+   * of a slab.
+   */
+  void ThreadedComputeMinimumMaximum( const RegionType & region, ThreadIdType threadId );
+  void ThreadedComputeHistogram( const RegionType & region, ThreadIdType threadId );
+
+  /** Split a region along its last dimension with a size larger than 1.
+   * Returns the number of pieces that is actually used.
+   */
+  static unsigned int SplitRegion( const RegionType & region,
+    unsigned int i, unsigned int numberOfPieces, RegionType & piece );
+
+private:
+  ThresholdHistogramBuilder(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  /** Run a sweep over the region, slab by slab, with multiple threads. */
+  void Sweep( bool computeHistogram );
+
+  /** Thread callback of a sweep. */
+  static ITK_THREAD_RETURN_TYPE SweepThreaderCallback( void * arg );
+
+  /** Holds the arguments of the sweep threads. */
+  struct SweepThreadStruct
+  {
+    Self *      Builder;
+    RegionType  Slab;
+    bool        ComputeHistogram;
+  };
+
+  ImageConstPointer     m_Image;
+  MaskImageConstPointer m_MaskImage;
+  RegionType            m_Region;
+  bool                  m_RegionSetByUser;
+  unsigned long         m_NumberOfHistogramBins;
+  ThreadIdType          m_NumberOfThreads;
+  unsigned int          m_NumberOfStreamDivisions;
+
+  PixelType             m_Minimum;
+  PixelType             m_Maximum;
+  double                m_TotalFrequency;
+  HistogramType         m_Histogram;
+
+  /** Per thread results. */
+  std::vector<PixelType>      m_ThreadMinimum;
+  std::vector<PixelType>      m_ThreadMaximum;
+  std::vector<HistogramType>  m_ThreadHistogram;
+
+};
+
+} // end namespace itk
+
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkThresholdHistogramBuilder.txx"
+#endif
+
+#endif
@@ -0,0 +1,330 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __itkThresholdHistogramBuilder_txx
+#define __itkThresholdHistogramBuilder_txx
+
+#include "itkThresholdHistogramBuilder.h"
+
+#include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
+
+#include "vnl/vnl_math.h"
+
+namespace itk
+{
+
+/**
+ * Constructor
+ */
+template<class TInputImage>
+ThresholdHistogramBuilder<TInputImage>
+::ThresholdHistogramBuilder()
+{
+  this->m_Image = NULL;
+  this->m_MaskImage = NULL;
+  this->m_RegionSetByUser = false;
+  this->m_NumberOfHistogramBins = 128;
+  this->m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->m_NumberOfStreamDivisions = 1;
+  this->m_Minimum = NumericTraits<PixelType>::Zero;
+  this->m_Maximum = NumericTraits<PixelType>::Zero;
+  this->m_TotalFrequency = 0.0;
+}
+
+
+/*
+ * Compute the histogram in two sweeps
+ */
+template<class TInputImage>
+void
+ThresholdHistogramBuilder<TInputImage>
+::Compute( void )
+{
+  if( !this->m_Image ) { return; }
+  if( !this->m_RegionSetByUser )
+  {
+    this->m_Region = this->m_Image->GetLargestPossibleRegion();
+  }
+
+  const ThreadIdType numberOfThreads = vnl_math_max( this->m_NumberOfThreads, ThreadIdType( 1 ) );
+  this->m_Histogram.assign( this->m_NumberOfHistogramBins, 0.0 );
+  this->m_TotalFrequency = 0.0;
+
+  // first sweep: the minimum and maximum
+  this->m_ThreadMinimum.assign( numberOfThreads, NumericTraits<PixelType>::max() );
+  this->m_ThreadMaximum.assign( numberOfThreads, NumericTraits<PixelType>::NonpositiveMin() );
+  this->Sweep( false );
+
+  this->m_Minimum = NumericTraits<PixelType>::max();
+  this->m_Maximum = NumericTraits<PixelType>::NonpositiveMin();
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_Minimum = vnl_math_min( this->m_Minimum, this->m_ThreadMinimum[ i ] );
+    this->m_Maximum = vnl_math_max( this->m_Maximum, this->m_ThreadMaximum[ i ] );
+  }
+  if( this->m_Minimum >= this->m_Maximum ) { return; }
+
+  // second sweep: the histogram, per thread
+  this->m_ThreadHistogram.assign( numberOfThreads, this->m_Histogram );
+  this->Sweep( true );
+
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    const HistogramType & threadHistogram = this->m_ThreadHistogram[ i ];
+    for( unsigned long j = 0; j < this->m_NumberOfHistogramBins; ++j )
+    {
+      this->m_Histogram[ j ] += threadHistogram[ j ];
+    }
+  }
+  this->m_ThreadHistogram.clear();
+
+  for( unsigned long j = 0; j < this->m_NumberOfHistogramBins; ++j )
+  {
+    this->m_TotalFrequency += this->m_Histogram[ j ];
+  }
+
+} // end Compute()
+
+
+/*
+ * Sweep over the region, slab by slab
+ */
+template<class TInputImage>
+void
+ThresholdHistogramBuilder<TInputImage>
+::Sweep( bool computeHistogram )
+{
+  typename MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( this->m_ThreadMinimum.size() );
+
+  SweepThreadStruct str;
+  str.Builder = this;
+  str.ComputeHistogram = computeHistogram;
+
+  const unsigned int lastDimension = ImageDimension - 1;
+  const SizeValueType size = this->m_Region.GetSize()[ lastDimension ];
+  const unsigned int numberOfSlabs = static_cast<unsigned int>(
+    vnl_math_max( SizeValueType( 1 ), vnl_math_min(
+    static_cast<SizeValueType>( this->m_NumberOfStreamDivisions ), size ) ) );
+  for( unsigned int s = 0; s < numberOfSlabs; ++s )
+  {
+    const SizeValueType begin = s * size / numberOfSlabs;
+    const SizeValueType end = ( s + 1 ) * size / numberOfSlabs;
+    str.Slab = this->m_Region;
+    str.Slab.SetIndex( lastDimension, this->m_Region.GetIndex()[ lastDimension ] + begin );
+    str.Slab.SetSize( lastDimension, end - begin );
+
+    // bring the slab into memory, as the StreamingImageFilter does
+    if( this->m_Image->GetSource() )
+    {
+      ImageType * image = const_cast<ImageType *>( this->m_Image.GetPointer() );
+      image->SetRequestedRegion( str.Slab );
+      image->PropagateRequestedRegion();
+      image->UpdateOutputData();
+    }
+
+    threader->SetSingleMethod( SweepThreaderCallback, &str );
+    threader->SingleMethodExecute();
+  }
+
+} // end Sweep()
+
+
+/*
+ * Thread callback of a sweep
+ */
+template<class TInputImage>
+ITK_THREAD_RETURN_TYPE
+ThresholdHistogramBuilder<TInputImage>
+::SweepThreaderCallback( void * arg )
+{
+  typedef MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  SweepThreadStruct * str = static_cast<SweepThreadStruct *>( info->UserData );
+  const ThreadIdType threadId = info->ThreadID;
+
+  RegionType piece;
+  const unsigned int total = SplitRegion( str->Slab, threadId, info->NumberOfThreads, piece );
+  if( threadId < total )
+  {
+    if( str->ComputeHistogram )
+    {
+      str->Builder->ThreadedComputeHistogram( piece, threadId );
+    }
+    else
+    {
+      str->Builder->ThreadedComputeMinimumMaximum( piece, threadId );
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end SweepThreaderCallback()
+
+
+/*
+ * Split a region along its last non-trivial dimension
+ */
+template<class TInputImage>
+unsigned int
+ThresholdHistogramBuilder<TInputImage>
+::SplitRegion( const RegionType & region,
+  unsigned int i, unsigned int numberOfPieces, RegionType & piece )
+{
+  piece = region;
+
+  int splitAxis = ImageDimension - 1;
+  while( splitAxis > 0 && region.GetSize()[ splitAxis ] == 1 )
+  {
+    --splitAxis;
+  }
+
+  const SizeValueType range = region.GetSize()[ splitAxis ];
+  const unsigned int valuesPerPiece = static_cast<unsigned int>(
+    vcl_ceil( range / static_cast<double>( numberOfPieces ) ) );
+  const unsigned int maxPieceUsed = static_cast<unsigned int>(
+    vcl_ceil( range / static_cast<double>( valuesPerPiece ) ) ) - 1;
+
+  if( i < maxPieceUsed )
+  {
+    piece.SetIndex( splitAxis, region.GetIndex()[ splitAxis ] + i * valuesPerPiece );
+    piece.SetSize( splitAxis, valuesPerPiece );
+  }
+  else if( i == maxPieceUsed )
+  {
+    piece.SetIndex( splitAxis, region.GetIndex()[ splitAxis ] + i * valuesPerPiece );
+    piece.SetSize( splitAxis, range - i * valuesPerPiece );
+  }
+
+  return maxPieceUsed + 1;
+
+} // end SplitRegion()
+
+
+/*
+ * Compute the minimum and maximum of a part of a slab
+ */
+template<class TInputImage>
+void
+ThresholdHistogramBuilder<TInputImage>
+::ThreadedComputeMinimumMaximum( const RegionType & region, ThreadIdType threadId )
+{
+  PixelType imageMin = this->m_ThreadMinimum[ threadId ];
+  PixelType imageMax = this->m_ThreadMaximum[ threadId ];
+
+  ImageRegionConstIterator<ImageType> iter( this->m_Image, region );
+  if( this->m_MaskImage )
+  {
+    ImageRegionConstIterator<MaskImageType> itMask( this->m_MaskImage, region );
+    for( ; !iter.IsAtEnd(); ++iter, ++itMask )
+    {
+      if( itMask.Value() == 0 ) continue;
+      const PixelType current = iter.Value();
+      imageMin = imageMin > current ? current : imageMin;
+      imageMax = imageMax < current ? current : imageMax;
+    }
+  }
+  else
+  {
+    for( ; !iter.IsAtEnd(); ++iter )
+    {
+      const PixelType current = iter.Value();
+      imageMin = imageMin > current ? current : imageMin;
+      imageMax = imageMax < current ? current : imageMax;
+    }
+  }
+
+  this->m_ThreadMinimum[ threadId ] = imageMin;
+  this->m_ThreadMaximum[ threadId ] = imageMax;
+
+} // end ThreadedComputeMinimumMaximum()
+
+
+/*
+ * Compute the histogram of a part of a slab
+ */
+template<class TInputImage>
+void
+ThresholdHistogramBuilder<TInputImage>
+::ThreadedComputeHistogram( const RegionType & region, ThreadIdType threadId )
+{
+  HistogramType & histogram = this->m_ThreadHistogram[ threadId ];
+  const PixelType imageMin = this->m_Minimum;
+  const double binMultiplier = this->GetBinMultiplier();
+  const unsigned long lastBin = this->m_NumberOfHistogramBins - 1;
+
+  ImageRegionConstIterator<ImageType> iter( this->m_Image, region );
+  ImageRegionConstIterator<MaskImageType> itMask;
+  if( this->m_MaskImage )
+  {
+    itMask = ImageRegionConstIterator<MaskImageType>( this->m_MaskImage, region );
+  }
+
+  for( ; !iter.IsAtEnd(); ++iter )
+  {
+    if( this->m_MaskImage )
+    {
+      const bool inside = itMask.Value() != 0;
+      ++itMask;
+      if( !inside ) continue;
+    }
+
+    const PixelType value = iter.Get();
+    unsigned long binNumber = 0;
+    if( value != imageMin )
+    {
+      binNumber = (unsigned long) vcl_ceil( ( value - imageMin ) * binMultiplier ) - 1;
+      if( binNumber > lastBin ) // in case of rounding errors
+      {
+        binNumber = lastBin;
+      }
+    }
+    histogram[ binNumber ] += 1.0;
+  }
+
+} // end ThreadedComputeHistogram()
+
+
+template<class TInputImage>
+void
+ThresholdHistogramBuilder<TInputImage>
+::SetRegion( const RegionType & region )
+{
+  this->m_Region = region;
+  this->m_RegionSetByUser = true;
+}
+
+
+template<class TInputImage>
+void
+ThresholdHistogramBuilder<TInputImage>
+::PrintSelf( std::ostream& os, Indent indent ) const
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "NumberOfHistogramBins: " << this->m_NumberOfHistogramBins << std::endl;
+  os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "NumberOfStreamDivisions: " << this->m_NumberOfStreamDivisions << std::endl;
+  os << indent << "Minimum: " << this->m_Minimum << std::endl;
+  os << indent << "Maximum: " << this->m_Maximum << std::endl;
+  os << indent << "Image: " << this->m_Image.GetPointer() << std::endl;
+}
+
+} // end namespace itk
+
+#endif
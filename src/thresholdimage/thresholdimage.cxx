@@ -42,7 +42,9 @@ std::string GetHelpString( void )
     << "pxthresholdimage\n"
     << "  -in        inputFilename\n"
     << "  [-out]     outputFilename; default in + THRESHOLDED.mhd\n"
-    << "  [-mask]    maskFilename, optional for \"OtsuThreshold\", required for \"KappaSigmaThreshold\"\n"
+    << "  [-mask]    maskFilename, optional for \"OtsuThreshold\" and \"MinErrorThreshold\",\n"
+    << "             required for \"KappaSigmaThreshold\"\n"
+    << "             packed masks (.pmask) are also accepted\n"
     << "  [-m]       method, choose one of \n"
     << "               {Threshold, OtsuThreshold, OtsuMultipleThreshold,\n"
     << "               AdaptiveOtsuThreshold, RobustAutomaticThreshold,\n"
@@ -60,11 +62,17 @@ std::string GetHelpString( void )
     << "  [-l]       number of levels, for \"AdaptiveOtsuThreshold\", default 3\n"
     << "  [-s]       number of samples, for \"AdaptiveOtsuThreshold\", default 5000\n"
     << "  [-o]       spline order, for \"AdaptiveOtsuThreshold\", default 3\n"
+    << "  [-integral] use a tiled integral histogram, for \"AdaptiveOtsuThreshold\",\n"
+    << "             faster for many samples; the windows are snapped to the tiles\n"
+    << "  [-tile]    tile size of the integral histogram, default half the radius\n"
     << "  [-p]       power, for \"RobustAutomaticThreshold\", default 1\n"
     << "  [-sigma]   sigma factor, for \"KappaSigmaThreshold\", default 2\n"
     << "  [-iter]    number of iterations, for \"KappaSigmaThreshold\", default 2\n"
     << "  [-mv]      mask value, for \"KappaSigmaThreshold\", default 1\n"
+    << "             ignored for packed masks, whose foreground is always 1\n"
     << "  [-mt]      mixture type (1 - Gaussians, 2 - Poissons), for \"MinErrorThreshold\", default 1\n"
+    << "  [-streams] number of streams, for \"OtsuThreshold\" and \"MinErrorThreshold\", default 1\n"
+    << "             the histogram and the output are computed piece by piece\n"
     << "  [-z]       compression flag; if provided, the output image is compressed\n\n"
     << "Supported: 2D, 3D, 4D, (unsigned) char, (unsigned) short, float, double.";
 
@@ -143,6 +151,11 @@ int main( int argc, char **argv )
   unsigned int splineOrder = 3;
   parser->GetCommandLineArgument( "-o", splineOrder );
 
+  bool useIntegralHistogram = parser->ArgumentExists( "-integral" );
+
+  unsigned int tileSize = 0;
+  parser->GetCommandLineArgument( "-tile", tileSize );
+
   double pow = 1.0;
   parser->GetCommandLineArgument( "-p", pow );
 
@@ -158,6 +171,9 @@ int main( int argc, char **argv )
   unsigned int mixtureType = 1;
   parser->GetCommandLineArgument( "-mt", mixtureType );
 
+  unsigned int numberOfStreams = 1;
+  parser->GetCommandLineArgument( "-streams", numberOfStreams );
+
   bool useCompression = parser->ArgumentExists( "-z" );
 
   /** Checks. */
@@ -230,21 +246,29 @@ int main( int argc, char **argv )
 
     /** Set the filter arguments. */
     filter->m_Bins = bins;
+    filter->m_ControlPoints = controlPoints;
     filter->m_InputFileName = inputFileName;
     filter->m_Inside = inside;
     filter->m_Iterations = iterations;
+    filter->m_Levels = levels;
     filter->m_MaskFileName = maskFileName;
     filter->m_MaskValue = maskValue;
     filter->m_Method = method;
     filter->m_MixtureType = mixtureType;
     filter->m_NumThresholds = numThresholds;
+    filter->m_NumberOfStreams = numberOfStreams;
     filter->m_OutputFileName = outputFileName;
     filter->m_Outside = outside;
     filter->m_Pow = pow;
+    filter->m_Radius = radius;
+    filter->m_Samples = samples;
     filter->m_Sigma = sigma;
+    filter->m_SplineOrder = splineOrder;
     filter->m_Threshold1 = threshold1;
     filter->m_Threshold2 = threshold2;
+    filter->m_TileSize = tileSize;
     filter->m_UseCompression = useCompression;
+    filter->m_UseIntegralHistogram = useIntegralHistogram;
 
     filter->Run();
 
@@ -36,22 +36,30 @@ public:
   ITKToolsThresholdImageBase()
   {
     this->m_Bins = 0;
+    this->m_ControlPoints = 0;
     this->m_InputFileName = "";
     this->m_Inside = 0.0f;
     this->m_Iterations = 0;
+    this->m_Levels = 0;
     this->m_MaskFileName = "";
     this->m_MaskValue = 0;
     this->m_Method = "";
     this->m_MixtureType = 0;
     this->m_NumThresholds = 0;
+    this->m_NumberOfStreams = 1;
     this->m_OutputFileName = "";
     this->m_Outside = 0.0f;
     this->m_Pow = 0.0f;
+    this->m_Radius = 0;
+    this->m_Samples = 0;
     this->m_Sigma = 0.0f;
+    this->m_SplineOrder = 0;
     this->m_Supported = false;
     this->m_Threshold1 = 0.0f;
     this->m_Threshold2 = 0.0f;
+    this->m_TileSize = 0;
     this->m_UseCompression = false;
+    this->m_UseIntegralHistogram = false;
   };
   /** Destructor. */
   ~ITKToolsThresholdImageBase(){};
@@ -73,11 +81,19 @@ public:
   unsigned int  m_Iterations;
   unsigned int  m_MaskValue;
   unsigned int  m_MixtureType;
+  unsigned int  m_NumberOfStreams;
+  unsigned int  m_Radius;
+  unsigned int  m_ControlPoints;
+  unsigned int  m_Levels;
+  unsigned int  m_Samples;
+  unsigned int  m_SplineOrder;
+  unsigned int  m_TileSize;
 
   double        m_Pow;
   double        m_Sigma;
   bool          m_Supported;
   bool          m_UseCompression;
+  bool          m_UseIntegralHistogram;
 
 }; // end class ITKToolsThresholdImageBase
 
@@ -118,7 +134,7 @@ public:
       this->OtsuThresholdImage(
         this->m_InputFileName, this->m_OutputFileName, this->m_MaskFileName,
         this->m_Inside, this->m_Outside,
-        this->m_Bins,
+        this->m_Bins, this->m_NumberOfStreams,
         this->m_UseCompression );
     }
     else if( this->m_Method == "OtsuMultipleThreshold" )
@@ -129,6 +145,17 @@ public:
         this->m_Bins, this->m_NumThresholds,
         this->m_UseCompression );
     }
+    else if( this->m_Method == "AdaptiveOtsuThreshold" )
+    {
+      this->AdaptiveOtsuThresholdImage(
+        this->m_InputFileName, this->m_OutputFileName,
+        this->m_Inside, this->m_Outside,
+        this->m_Radius, this->m_Bins,
+        this->m_ControlPoints, this->m_Levels,
+        this->m_Samples, this->m_SplineOrder,
+        this->m_UseIntegralHistogram, this->m_TileSize,
+        this->m_UseCompression );
+    }
     else if( this->m_Method == "RobustAutomaticThreshold" )
     {
       this->RobustAutomaticThresholdImage(
@@ -148,9 +175,9 @@ public:
     else if( this->m_Method == "MinErrorThreshold" )
     {
       this->MinErrorThresholdImage(
-        this->m_InputFileName, this->m_OutputFileName,
+        this->m_InputFileName, this->m_OutputFileName, this->m_MaskFileName,
         this->m_Inside, this->m_Outside,
-        this->m_Bins, this->m_MixtureType,
+        this->m_Bins, this->m_MixtureType, this->m_NumberOfStreams,
         this->m_UseCompression );
     }
     else
@@ -172,7 +199,7 @@ public:
     const std::string & inputFileName, const std::string & outputFileName,
     const std::string & maskFileName,
     const double & inside, const double & outside,
-    const unsigned int & bins,
+    const unsigned int & bins, const unsigned int & numberOfStreams,
     const bool & useCompression );
 
   /** Function to perform Otsu thresholding with multiple thresholds. */
@@ -184,11 +211,14 @@ public:
     const bool & useCompression );
 
   /** Function to perform Otsu thresholding with an adaptive threshold. */
-//   void AdaptiveOtsuThresholdImage(
-//     const std::string & inputFileName, const std::string & outputFileName,
-//     const unsigned int & radius, const unsigned int & bins,
-//     const unsigned int & controlPoints, const unsigned int & levels,
-//     const unsigned int & samples, const unsigned int & splineOrder );
+  void AdaptiveOtsuThresholdImage(
+    const std::string & inputFileName, const std::string & outputFileName,
+    const double & inside, const double & outside,
+    const unsigned int & radius, const unsigned int & bins,
+    const unsigned int & controlPoints, const unsigned int & levels,
+    const unsigned int & samples, const unsigned int & splineOrder,
+    const bool & useIntegralHistogram, const unsigned int & tileSize,
+    const bool & useCompression );
 
   /** Function to perform thresholding using .. . */
   void RobustAutomaticThresholdImage(
@@ -207,8 +237,10 @@ public:
   /** Function to perform thresholding using .. . */
   void MinErrorThresholdImage(
     const std::string & inputFileName, const std::string & outputFileName,
+    const std::string & maskFileName,
     const double & inside, const double & outside,
     const unsigned int & bins, const unsigned int & mixtureType,
+    const unsigned int & numberOfStreams,
     const bool & useCompression );
 
 }; // end class ITKToolsThresholdImage
@@ -29,6 +29,10 @@
 #include "itkRobustAutomaticThresholdImageFilter.h"
 #include "itkKappaSigmaThresholdImageFilter.h"
 #include "itkMinErrorThresholdImageFilter.h"
+#include "itkThresholdHistogramBuilder.h"
+#include "itkOtsuThresholdWithMaskImageCalculator.h"
+#include "itkMinErrorThresholdImageCalculator.h"
+#include "ITKToolsPackedMask.h"
 
 
 /**
@@ -98,6 +102,7 @@ ITKToolsThresholdImage< VDimension, TComponentType >
   const double & inside,
   const double & outside,
   const unsigned int & bins,
+  const unsigned int & numberOfStreams,
   const bool & useCompression )
 {
   /** Typedef's. */
@@ -109,35 +114,52 @@ ITKToolsThresholdImage< VDimension, TComponentType >
   typedef itk::Image< MaskPixelType, ImageDimension >   MaskImageType;
   typedef itk::Image< OutputPixelType, ImageDimension > OutputImageType;
   typedef itk::ImageFileReader< InputImageType >        ReaderType;
-  typedef itk::ImageFileReader< MaskImageType >         MaskReaderType;
-  typedef itk::OtsuThresholdWithMaskImageFilter<
-    InputImageType, OutputImageType>                    ThresholderType;
+  typedef itk::ThresholdHistogramBuilder<
+    InputImageType >                                    HistogramBuilderType;
+  typedef itk::OtsuThresholdWithMaskImageCalculator<
+    InputImageType >                                    CalculatorType;
+  typedef itk::BinaryThresholdImageFilter<
+    InputImageType, OutputImageType >                   ThresholderType;
   typedef itk::ImageFileWriter< OutputImageType >       WriterType;
 
   /** Declarations. */
   typename ReaderType::Pointer reader1 = ReaderType::New();
-  typename MaskReaderType::Pointer reader2 = MaskReaderType::New();
+  typename HistogramBuilderType::Pointer histogram = HistogramBuilderType::New();
+  typename CalculatorType::Pointer calculator = CalculatorType::New();
   typename ThresholderType::Pointer thresholder = ThresholderType::New();
   typename WriterType::Pointer writer = WriterType::New();
 
-  /** Read in the inputImage. */
+  /** Read in the image information only, the pixels are streamed. */
   reader1->SetFileName( inputFileName.c_str() );
+  reader1->UpdateOutputInformation();
+
+  /** Compute the histogram, sweeping the input per stream division. */
+  histogram->SetImage( reader1->GetOutput() );
+  histogram->SetNumberOfHistogramBins( bins );
+  histogram->SetNumberOfStreamDivisions( numberOfStreams );
+  if( maskFileName != "" )
+  {
+    histogram->SetMaskImage(
+      itktools::ReadMaskImage<MaskImageType>( maskFileName ) );
+  }
+  histogram->Compute();
+
+  /** Compute the threshold. */
+  calculator->ComputeFromHistogram( histogram );
 
   /** Apply the threshold. */
-  thresholder->SetNumberOfHistogramBins( bins );
+  thresholder->SetLowerThreshold(
+    itk::NumericTraits<InputPixelType>::NonpositiveMin() );
+  thresholder->SetUpperThreshold( calculator->GetThreshold() );
   thresholder->SetInsideValue( static_cast<OutputPixelType>( inside ) );
   thresholder->SetOutsideValue( static_cast<OutputPixelType>( outside ) );
   thresholder->SetInput( reader1->GetOutput() );
-  if( maskFileName != "" )
-  {
-    reader2->SetFileName( maskFileName.c_str() );
-    thresholder->SetMaskImage( reader2->GetOutput() );
-  }
 
   /** Write the output image. */
   writer->SetInput( thresholder->GetOutput() );
   writer->SetFileName( outputFileName.c_str() );
   writer->SetUseCompression( useCompression );
+  writer->SetNumberOfStreamDivisions( numberOfStreams );
   writer->Update();
 
 } // end OtsuThresholdImage()
@@ -204,60 +226,69 @@ ITKToolsThresholdImage< VDimension, TComponentType >
 } // end OtsuMultipleThresholdImage()
 
 
-// /**
-//  * ******************* AdaptiveOtsuThresholdImage *******************
-//  */
-//
-// template< unsigned int VDimension, class TComponentType >
-// void
-// ITKToolsThresholdImage< VDimension, TComponentType >
-// ::AdaptiveOtsuThresholdImage(
-//   const std::string & inputFileName,
-//   const std::string & outputFileName,
-//   const unsigned int & radius,
-//   const unsigned int & bins,
-//   const unsigned int & controlPoints,
-//   const unsigned int & levels,
-//   const unsigned int & samples,
-//   const unsigned int & splineOrder )
-// {
-//   /** Typedef's. */
-//   const unsigned int ImageDimension = InputImageType::ImageDimension;
-//
-//   typedef unsigned char                                 OutputPixelType;
-//   typedef itk::Image< OutputPixelType, ImageDimension > OutputImageType;
-//   typedef itk::ImageFileReader< InputImageType >        ReaderType;
-//   typedef itk::AdaptiveOtsuThresholdImageFilter<
-//     InputImageType, OutputImageType>                    ThresholderType;
-//   typedef itk::ImageFileWriter< OutputImageType >       WriterType;
-//   typedef ThresholderType::InputSizeType                RadiusType;
-//
-//   /** Declarations. */
-//   typename ReaderType::Pointer reader = ReaderType::New();
-//   typename ThresholderType::Pointer thresholder = ThresholderType::New();
-//   typename WriterType::Pointer writer = WriterType::New();
-//   RadiusType Radius; Radius.Fill( radius );
-//
-//   /** Read in the inputImage. */
-//   reader->SetFileName( inputFileName.c_str() );
-//
-//   /** Apply the threshold. */
-//   thresholder->SetRadius( Radius );
-//   thresholder->SetNumberOfHistogramBins( bins );
-//   thresholder->SetNumberOfControlPoints( controlPoints );
-//   thresholder->SetNumberOfLevels( levels );
-//   thresholder->SetNumberOfSamples( samples );
-//   thresholder->SetSplineOrder( splineOrder );
-//   thresholder->SetInsideValue( 1 );
-//   thresholder->SetOutsideValue( 0 );
-//   thresholder->SetInput( reader->GetOutput() );
-//
-//   /** Write the output image. */
-//   writer->SetInput( thresholder->GetOutput() );
-//   writer->SetFileName( outputFileName.c_str() );
-//   writer->Update();
-//
-// } // end AdaptiveOtsuThresholdImage()
+/**
+ * ******************* AdaptiveOtsuThresholdImage *******************
+ */
+
+template< unsigned int VDimension, class TComponentType >
+void
+ITKToolsThresholdImage< VDimension, TComponentType >
+::AdaptiveOtsuThresholdImage(
+  const std::string & inputFileName,
+  const std::string & outputFileName,
+  const double & inside,
+  const double & outside,
+  const unsigned int & radius,
+  const unsigned int & bins,
+  const unsigned int & controlPoints,
+  const unsigned int & levels,
+  const unsigned int & samples,
+  const unsigned int & splineOrder,
+  const bool & useIntegralHistogram,
+  const unsigned int & tileSize,
+  const bool & useCompression )
+{
+  /** Typedef's. */
+  const unsigned int ImageDimension = InputImageType::ImageDimension;
+
+  typedef unsigned char                                 OutputPixelType;
+  typedef itk::Image< OutputPixelType, ImageDimension > OutputImageType;
+  typedef itk::ImageFileReader< InputImageType >        ReaderType;
+  typedef itk::AdaptiveOtsuThresholdImageFilter<
+    InputImageType, OutputImageType>                    ThresholderType;
+  typedef itk::ImageFileWriter< OutputImageType >       WriterType;
+  typedef typename ThresholderType::InputSizeType       RadiusType;
+
+  /** Declarations. */
+  typename ReaderType::Pointer reader = ReaderType::New();
+  typename ThresholderType::Pointer thresholder = ThresholderType::New();
+  typename WriterType::Pointer writer = WriterType::New();
+  RadiusType Radius; Radius.Fill( radius );
+  RadiusType TileSize; TileSize.Fill( tileSize );
+
+  /** Read in the inputImage. */
+  reader->SetFileName( inputFileName.c_str() );
+
+  /** Apply the threshold. */
+  thresholder->SetRadius( Radius );
+  thresholder->SetNumberOfHistogramBins( bins );
+  thresholder->SetNumberOfControlPoints( controlPoints );
+  thresholder->SetNumberOfLevels( levels );
+  thresholder->SetNumberOfSamples( samples );
+  thresholder->SetSplineOrder( splineOrder );
+  thresholder->SetUseIntegralHistogram( useIntegralHistogram );
+  thresholder->SetTileSize( TileSize );
+  thresholder->SetInsideValue( static_cast<OutputPixelType>( inside ) );
+  thresholder->SetOutsideValue( static_cast<OutputPixelType>( outside ) );
+  thresholder->SetInput( reader->GetOutput() );
+
+  /** Write the output image. */
+  writer->SetInput( thresholder->GetOutput() );
+  writer->SetFileName( outputFileName.c_str() );
+  writer->SetUseCompression( useCompression );
+  writer->Update();
+
+} // end AdaptiveOtsuThresholdImage()
 
 
 /**
@@ -347,29 +378,36 @@ ITKToolsThresholdImage< VDimension, TComponentType >
   typedef itk::Image< MaskPixelType, ImageDimension >   MaskImageType;
   typedef itk::Image< OutputPixelType, ImageDimension > OutputImageType;
   typedef itk::ImageFileReader< InputImageType >        ReaderType;
-  typedef itk::ImageFileReader< MaskImageType >         MaskReaderType;
   typedef itk::KappaSigmaThresholdImageFilter<
     InputImageType, MaskImageType, OutputImageType >    ThresholderType;
   typedef itk::ImageFileWriter< OutputImageType >       WriterType;
 
   /** Declarations. */
   typename ReaderType::Pointer reader1 = ReaderType::New();
-  typename MaskReaderType::Pointer reader2 = MaskReaderType::New();
   typename ThresholderType::Pointer thresholder = ThresholderType::New();
   typename WriterType::Pointer writer = WriterType::New();
 
   /** Read in the inputImage. */
   reader1->SetFileName( inputFileName.c_str() );
-  reader2->SetFileName( maskFileName.c_str() );
+  typename MaskImageType::Pointer maskImage
+    = itktools::ReadMaskImage<MaskImageType>( maskFileName );
 
-  /** Apply the threshold. */
-  thresholder->SetMaskValue( maskValue );
+  /** Apply the threshold. A packed mask is unpacked to 0/1,
+   * so its foreground is always 1, whatever the mask value. */
+  if( itktools::IsPackedMaskFile( maskFileName ) )
+  {
+    thresholder->SetMaskValue( 1 );
+  }
+  else
+  {
+    thresholder->SetMaskValue( maskValue );
+  }
   thresholder->SetSigmaFactor( sigma );
   thresholder->SetNumberOfIterations( iterations );
   thresholder->SetInsideValue( static_cast<OutputPixelType>( inside ) );
   thresholder->SetOutsideValue( static_cast<OutputPixelType>( outside ) );
   thresholder->SetInput( reader1->GetOutput() );
-  thresholder->SetMaskImage( reader2->GetOutput() );
+  thresholder->SetMaskImage( maskImage );
 
   /** Write the output image. */
   writer->SetInput( thresholder->GetOutput() );
@@ -390,10 +428,12 @@ ITKToolsThresholdImage< VDimension, TComponentType >
 ::MinErrorThresholdImage(
   const std::string & inputFileName,
   const std::string & outputFileName,
+  const std::string & maskFileName,
   const double & inside,
   const double & outside,
   const unsigned int & bins,
   const unsigned int & mixtureType,
+  const unsigned int & numberOfStreams,
   const bool & useCompression )
 {
   /** Typedef's. */
@@ -401,24 +441,50 @@ ITKToolsThresholdImage< VDimension, TComponentType >
 
   typedef typename InputImageType::PixelType            InputPixelType;
   typedef unsigned char                                 OutputPixelType;
+  typedef unsigned char                                 MaskPixelType;
+  typedef itk::Image< MaskPixelType, ImageDimension >   MaskImageType;
   typedef itk::Image< OutputPixelType, ImageDimension > OutputImageType;
   typedef itk::ImageFileReader< InputImageType >        ReaderType;
-  typedef itk::MinErrorThresholdImageFilter<
+  typedef itk::ThresholdHistogramBuilder<
+    InputImageType >                                    HistogramBuilderType;
+  typedef itk::MinErrorThresholdImageCalculator<
+    InputImageType >                                    CalculatorType;
+  typedef itk::BinaryThresholdImageFilter<
     InputImageType, OutputImageType >                   ThresholderType;
   typedef itk::ImageFileWriter< OutputImageType >       WriterType;
 
   /** Declarations. */
   typename ReaderType::Pointer reader = ReaderType::New();
-
+  typename HistogramBuilderType::Pointer histogram = HistogramBuilderType::New();
+  typename CalculatorType::Pointer calculator = CalculatorType::New();
   typename ThresholderType::Pointer thresholder = ThresholderType::New();
   typename WriterType::Pointer writer = WriterType::New();
 
-  /** Read in the inputImage. */
+  /** Read in the image information only, the pixels are streamed. */
   reader->SetFileName( inputFileName.c_str() );
+  reader->UpdateOutputInformation();
+
+  /** Compute the histogram, sweeping the input per stream division. */
+  histogram->SetImage( reader->GetOutput() );
+  histogram->SetNumberOfHistogramBins( bins );
+  histogram->SetNumberOfStreamDivisions( numberOfStreams );
+  if( maskFileName != "" )
+  {
+    histogram->SetMaskImage(
+      itktools::ReadMaskImage<MaskImageType>( maskFileName ) );
+  }
+  histogram->Compute();
+
+  /** Compute the threshold. Same mixture type convention as the
+   * MinErrorThresholdImageFilter.
+   */
+  calculator->UseGaussianMixture( mixtureType != 1 );
+  calculator->ComputeFromHistogram( histogram );
 
   /** Apply the threshold. */
-  thresholder->SetNumberOfHistogramBins( bins );
-  thresholder->SetMixtureType( mixtureType );
+  thresholder->SetLowerThreshold(
+    itk::NumericTraits<InputPixelType>::NonpositiveMin() );
+  thresholder->SetUpperThreshold( calculator->GetThreshold() );
   thresholder->SetInsideValue( static_cast<OutputPixelType>( inside ) );
   thresholder->SetOutsideValue( static_cast<OutputPixelType>( outside ) );
   thresholder->SetInput( reader->GetOutput() );
@@ -427,6 +493,7 @@ ITKToolsThresholdImage< VDimension, TComponentType >
   writer->SetInput( thresholder->GetOutput() );
   writer->SetFileName( outputFileName.c_str() );
   writer->SetUseCompression( useCompression );
+  writer->SetNumberOfStreamDivisions( numberOfStreams );
   writer->Update();
 
 } // end MinErrorThresholdImage()
@@ -22,6 +22,7 @@
  */
 #include "itkCommandLineArgumentParser.h"
 #include "ITKToolsHelpers.h"
+#include "ITKToolsTTest.h"
 
 #include <vector>
 #include <fstream>
@@ -180,9 +181,11 @@ int main( int argc, char **argv )
   //std::cout << "t: " << tValue << std::endl;
 
   /** Compute the p-value. */
+  const unsigned int dof = type == 2
+    ? samples1.size() + samples2.size() - 2 : samples1.size() - 1;
   typedef itk::Statistics::TDistribution    DistributionType;
   DistributionType::Pointer distributionFunction = DistributionType::New();
-  distributionFunction->SetDegreesOfFreedom( samples1.size() - 1 );
+  distributionFunction->SetDegreesOfFreedom( dof );
   //double pValue = distributionFunction->EvaluateCDF( tValue );
   double pValue = distributionFunction->EvaluateCDF( -vcl_abs( tValue ) );
 
@@ -201,7 +204,7 @@ int main( int argc, char **argv )
     std::cout << "samples 1:  " << mean1 << " " << std1 << std::endl;
     std::cout << "samples 2:  " << mean2 << " " << std2 << std::endl;
     std::cout << "difference: " << meandiff << " " << stddiff << std::endl;
-    std::cout << "dof = " << samples1.size() - 1
+    std::cout << "dof = " << dof
       << ", t = " << tValue
       << ", p = " << pValue << std::endl;
   }
@@ -314,9 +317,35 @@ bool ComputeTValue( const std::vector<double> & samples1,
     /** Compute the t-value. */
     tValue = meandiff * vcl_sqrt( static_cast<double>( samples1.size() ) ) / stddiff;
   }
+  else if( type == 2 )
+  {
+    /** This type is a two-sample t-test with equal variances, using the
+     * pooled variance, see itktools::ComputeTwoSampleTValue().
+     */
+    ComputeMeanAndStandardDeviation(
+      samples1, samples2,
+      mean1, mean2, meandiff,
+      std1, std2, stddiff );
+
+    double s1 = 0.0, ss1 = 0.0;
+    for( unsigned int i = 0; i < samples1.size(); ++i )
+    {
+      s1  += samples1[ i ];
+      ss1 += samples1[ i ] * samples1[ i ];
+    }
+    double s2 = 0.0, ss2 = 0.0;
+    for( unsigned int i = 0; i < samples2.size(); ++i )
+    {
+      s2  += samples2[ i ];
+      ss2 += samples2[ i ] * samples2[ i ];
+    }
+    tValue = itktools::ComputeTwoSampleTValue(
+      static_cast<double>( samples1.size() ), s1, ss1,
+      static_cast<double>( samples2.size() ), s2, ss2 );
+  }
   else
   {
-    std::cerr << "ERROR: This type is not supported. Choose one of {1}." << std::endl;
+    std::cerr << "ERROR: This type is not supported. Choose one of {1,2}." << std::endl;
     return false;
   }
 
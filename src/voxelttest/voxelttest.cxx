@@ -0,0 +1,229 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+/** \file
+ \brief Perform a voxelwise t-test or F-test on a set of images.
+
+ \verbinclude voxelttest.help
+ */
+
+/** Setup Mevislab DicomTiff IO support */
+#include "itkUseMevisDicomTiff.h"
+
+#include "itkCommandLineArgumentParser.h"
+#include "ITKToolsHelpers.h"
+#include "voxelttest.h"
+
+
+/**
+ * ******************* GetHelpString *******************
+ */
+
+std::string GetHelpString( void )
+{
+  std::stringstream ss;
+  ss << "ITKTools v" << itktools::GetITKToolsVersion() << "\n"
+    << "This program performs a voxelwise t-test or F-test on a set of images,\n"
+    << "using the general linear model y = X b + e.\n"
+    << "Usage:\n"
+    << "pxvoxelttest\n"
+    << "  -in        list of inputFilenames, one per subject\n"
+    << "  [-mask]    maskFilename, may be a packed mask (.pmask)\n"
+    << "  [-g]       group of each subject, 1 or 2, for a two-sample t-test\n"
+    << "  [-d]       design matrix file: one row per subject, columns separated by spaces\n"
+    << "  [-c]       contrast, the rows of the contrast matrix after each other,\n"
+    << "             default for -g is \"1 -1\"\n"
+    << "  [-cr]      number of rows of the contrast, default 1;\n"
+    << "             more than one row gives an F-test\n"
+    << "  -out       outputFilename for the t or F image; always written as float\n"
+    << "  [-outp]    outputFilename for the uncorrected p-values, only for a t-test\n"
+    << "  [-outfwe]  outputFilename for the family-wise error corrected p-values\n"
+    << "  [-perm]    number of permutations for -outfwe, default 0\n"
+    << "  [-seed]    the seed of the permutations, default 0\n"
+    << "  [-tail]    one or two tailed t-test, default = 2\n"
+    << "  [-s]       number of streams, default 1\n"
+    << "  [-z]       compression flag; if provided, the output image is compressed\n"
+    << "Either -g or -d should be given. A design of two groups gives the two-sample\n"
+    << "equal variance t-test. The images are read in slabs, so that more streams\n"
+    << "need less memory. FWE corrected p-values are computed from the maximum\n"
+    << "statistic within the mask of every permutation of the design.\n"
+    << "Supported: 2D, 3D, (unsigned) char, (unsigned) short, float, double.";
+
+  return ss.str();
+
+} // end GetHelpString()
+
+
+//-------------------------------------------------------------------------------------
+
+int main( int argc, char **argv )
+{
+  RegisterMevisDicomTiff();
+
+  /** Create a command line argument parser. */
+  itk::CommandLineArgumentParser::Pointer parser = itk::CommandLineArgumentParser::New();
+  parser->SetCommandLineArguments( argc, argv );
+  parser->SetProgramHelpText( GetHelpString() );
+
+  parser->MarkArgumentAsRequired( "-in", "The input filenames." );
+  parser->MarkArgumentAsRequired( "-out", "The output filename." );
+
+  itk::CommandLineArgumentParser::ReturnValue validateArguments = parser->CheckForRequiredArguments();
+
+  if( validateArguments == itk::CommandLineArgumentParser::FAILED )
+  {
+    return EXIT_FAILURE;
+  }
+  else if( validateArguments == itk::CommandLineArgumentParser::HELPREQUESTED )
+  {
+    return EXIT_SUCCESS;
+  }
+
+  /** Get arguments. */
+  std::vector<std::string> inputFileNames;
+  parser->GetCommandLineArgument( "-in", inputFileNames );
+
+  std::string maskFileName = "";
+  parser->GetCommandLineArgument( "-mask", maskFileName );
+
+  std::vector<unsigned int> groups;
+  bool retg = parser->GetCommandLineArgument( "-g", groups );
+
+  std::string designFileName = "";
+  bool retd = parser->GetCommandLineArgument( "-d", designFileName );
+
+  std::vector<double> contrast;
+  parser->GetCommandLineArgument( "-c", contrast );
+
+  unsigned int numberOfContrastRows = 1;
+  parser->GetCommandLineArgument( "-cr", numberOfContrastRows );
+
+  std::string outputFileName = "";
+  parser->GetCommandLineArgument( "-out", outputFileName );
+
+  std::string outputPValueFileName = "";
+  parser->GetCommandLineArgument( "-outp", outputPValueFileName );
+
+  std::string outputFWEFileName = "";
+  parser->GetCommandLineArgument( "-outfwe", outputFWEFileName );
+
+  unsigned int numberOfPermutations = 0;
+  parser->GetCommandLineArgument( "-perm", numberOfPermutations );
+
+  unsigned int seed = 0;
+  parser->GetCommandLineArgument( "-seed", seed );
+
+  unsigned int tail = 2;
+  parser->GetCommandLineArgument( "-tail", tail );
+
+  unsigned int numberOfStreams = 1;
+  parser->GetCommandLineArgument( "-s", numberOfStreams );
+
+  /** Use compression */
+  const bool useCompression = parser->ArgumentExists( "-z" );
+
+  /** Check command line arguments. */
+  if( retg == retd )
+  {
+    std::cerr << "ERROR: You should specify either \"-g\" or \"-d\"." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( retd && contrast.size() == 0 )
+  {
+    std::cerr << "ERROR: You should specify a contrast with \"-c\" for a design matrix." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( tail != 1 && tail != 2 )
+  {
+    std::cerr << "ERROR: tail should be 1 or 2." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( outputFWEFileName != "" && numberOfPermutations == 0 )
+  {
+    std::cerr << "ERROR: You should specify the number of permutations with \"-perm\"." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Determine image properties. */
+  itk::ImageIOBase::IOPixelType pixelType = itk::ImageIOBase::UNKNOWNPIXELTYPE;
+  itk::ImageIOBase::IOComponentType componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  unsigned int dim = 0;
+  unsigned int numberOfComponents = 0;
+  bool retgip = itktools::GetImageProperties(
+    inputFileNames[ 0 ], pixelType, componentType, dim, numberOfComponents );
+  if( !retgip ) return EXIT_FAILURE;
+
+  /** Check for vector images. */
+  bool retNOCCheck = itktools::NumberOfComponentsCheck( numberOfComponents );
+  if( !retNOCCheck ) return EXIT_FAILURE;
+
+  /** Class that does the work. */
+  ITKToolsVoxelTTestBase * filter = 0;
+
+  try
+  {
+    // now call all possible template combinations.
+    if( !filter ) filter = ITKToolsVoxelTTest< 2, char >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 2, unsigned char >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 2, short >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 2, unsigned short >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 2, float >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 2, double >::New( dim, componentType );
+
+#ifdef ITKTOOLS_3D_SUPPORT
+    if( !filter ) filter = ITKToolsVoxelTTest< 3, char >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 3, unsigned char >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 3, short >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 3, unsigned short >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 3, float >::New( dim, componentType );
+    if( !filter ) filter = ITKToolsVoxelTTest< 3, double >::New( dim, componentType );
+#endif
+    /** Check if filter was instantiated. */
+    bool supported = itktools::IsFilterSupportedCheck( filter, dim, componentType );
+    if( !supported ) return EXIT_FAILURE;
+
+    /** Set the filter arguments. */
+    filter->m_InputFileNames = inputFileNames;
+    filter->m_MaskFileName = maskFileName;
+    filter->m_Groups = groups;
+    filter->m_DesignFileName = designFileName;
+    filter->m_Contrast = contrast;
+    filter->m_NumberOfContrastRows = numberOfContrastRows;
+    filter->m_OutputFileName = outputFileName;
+    filter->m_OutputPValueFileName = outputPValueFileName;
+    filter->m_OutputFWEFileName = outputFWEFileName;
+    filter->m_NumberOfPermutations = numberOfPermutations;
+    filter->m_Seed = seed;
+    filter->m_Tail = tail;
+    filter->m_NumberOfStreams = numberOfStreams;
+    filter->m_UseCompression = useCompression;
+
+    filter->Run();
+
+    delete filter;
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "ERROR: Caught ITK exception: " << excp << std::endl;
+    delete filter;
+    return EXIT_FAILURE;
+  }
+
+  /** End program. */
+  return EXIT_SUCCESS;
+
+} // end main
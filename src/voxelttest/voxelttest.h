@@ -0,0 +1,166 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __voxelttest_h_
+#define __voxelttest_h_
+
+#include "ITKToolsBase.h"
+
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "vnl/vnl_matrix.h"
+#include "vnl/vnl_vector.h"
+#include <string>
+#include <vector>
+
+
+/** \class ITKToolsVoxelTTestBase
+ *
+ * Untemplated pure virtual base class that holds
+ * the Run() function and all required parameters.
+ */
+
+class ITKToolsVoxelTTestBase : public itktools::ITKToolsBase
+{
+public:
+  /** Constructor. */
+  ITKToolsVoxelTTestBase()
+  {
+    this->m_InputFileNames = std::vector<std::string>();
+    this->m_MaskFileName = "";
+    this->m_Groups = std::vector<unsigned int>();
+    this->m_DesignFileName = "";
+    this->m_Contrast = std::vector<double>();
+    this->m_NumberOfContrastRows = 1;
+    this->m_OutputFileName = "";
+    this->m_OutputPValueFileName = "";
+    this->m_OutputFWEFileName = "";
+    this->m_NumberOfPermutations = 0;
+    this->m_Seed = 0;
+    this->m_Tail = 2;
+    this->m_NumberOfStreams = 1;
+    this->m_UseCompression = false;
+  };
+  /** Destructor. */
+  ~ITKToolsVoxelTTestBase(){};
+
+  /** Input member parameters. */
+  std::vector<std::string>  m_InputFileNames;
+  std::string               m_MaskFileName;
+  std::vector<unsigned int> m_Groups;
+  std::string               m_DesignFileName;
+  std::vector<double>       m_Contrast;
+  unsigned int              m_NumberOfContrastRows;
+  std::string               m_OutputFileName;
+  std::string               m_OutputPValueFileName;
+  std::string               m_OutputFWEFileName;
+  unsigned int              m_NumberOfPermutations;
+  unsigned int              m_Seed;
+  unsigned int              m_Tail;
+  unsigned int              m_NumberOfStreams;
+  bool                      m_UseCompression;
+
+}; // end class ITKToolsVoxelTTestBase
+
+
+/** \class ITKToolsVoxelTTest
+ *
+ * Templated class that implements the Run() function
+ * and the New() function for its creation.
+ *
+ * Fits the general linear model y = X b + e in every voxel, where y holds
+ * the intensities of the subjects and X is the design matrix, and tests
+ * the contrast C b = 0. For a single contrast row this is a t-test, for
+ * multiple rows an F-test. A design of two group indicators with contrast
+ * [a -a] gives the two-sample equal variance t-test, which is then
+ * computed directly from the group sums, as pxttest -type 2 does.
+ *
+ * The subject images are streamed in slabs along the last dimension.
+ * Optionally the rows of the design are permuted, and the maximum
+ * statistic over the mask of every permutation gives family-wise error
+ * corrected p-values. All permuted designs are precomputed, and every
+ * slab of subject data is reused for all permutations.
+ */
+
+template< unsigned int VDimension, class TComponentType >
+class ITKToolsVoxelTTest : public ITKToolsVoxelTTestBase
+{
+public:
+  /** Standard ITKTools stuff. */
+  typedef ITKToolsVoxelTTest Self;
+  itktoolsOneTypeNewMacro( Self );
+
+  ITKToolsVoxelTTest(){};
+  ~ITKToolsVoxelTTest(){};
+
+  /** Typedefs. */
+  typedef itk::Image< TComponentType, VDimension >  InputImageType;
+  typedef itk::Image< float, VDimension >           OutputImageType;
+  typedef itk::Image< unsigned char, VDimension >   MaskImageType;
+  typedef typename InputImageType::RegionType       RegionType;
+  typedef itk::MultiThreader::ThreadInfoStruct      ThreadInfoType;
+  typedef vnl_matrix<double>                        MatrixType;
+  typedef vnl_vector<double>                        VectorType;
+
+  /** Holds the data of a slab and the precomputed designs for the
+   * multi-threaded computation of the statistics.
+   */
+  struct SlabStruct
+  {
+    /** Subject data, subject-major: Data[ i * NumberOfVoxels + v ]. */
+    const double *        Data;
+    unsigned int          NumberOfSubjects;
+    itk::SizeValueType    NumberOfVoxels;
+
+    /** For every permutation the p x n matrix (X'X)^+ X_perm', such that
+     * b = Pinv[ perm ] y. Permutation 0 is the unpermuted design.
+     */
+    const MatrixType *    Pinv;
+    unsigned int          NumberOfPermutations;
+    /** For the two-sample t-test, for every permutation the subjects in
+     * group 1; 0 for a general design.
+     */
+    const std::vector<unsigned int> * GroupOneSubjects;
+    double                ContrastSign;
+    const MatrixType *    XtX;
+    const MatrixType *    Contrast;
+    const MatrixType *    ContrastWeights;
+    double                DegreesOfFreedom;
+    bool                  AbsoluteStatistic;
+
+    /** Statistic of the unpermuted design, per voxel of the slab. */
+    float *               Statistic;
+    /** Per thread the maximum statistic of every permutation. */
+    std::vector< std::vector<double> > * ThreadMaxima;
+  };
+
+  /** Run function. */
+  void Run( void );
+
+  /** Read a design matrix from a text file, one row per subject. */
+  static bool ReadDesignMatrix( const std::string & fileName, MatrixType & design );
+
+  /** Thread callback that computes the statistic of a contiguous part
+   * of the voxels of a slab, for all permutations.
+   */
+  static ITK_THREAD_RETURN_TYPE ComputeStatisticsCallback( void * arg );
+
+}; // end class ITKToolsVoxelTTest
+
+#include "voxelttest.hxx"
+
+#endif // end #ifndef __voxelttest_h_
@@ -0,0 +1,618 @@
+/*=========================================================================
+*
+* Copyright Marius Staring, Stefan Klein, David Doria. 2011.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0.txt
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*=========================================================================*/
+#ifndef __voxelttest_hxx_
+#define __voxelttest_hxx_
+
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkTDistribution.h"
+#include "ITKToolsPackedMask.h"
+#include "ITKToolsTTest.h"
+#include "vnl/algo/vnl_svd.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+
+/**
+ * ******************* Run *******************
+ */
+
+template< unsigned int VDimension, class TComponentType >
+void
+ITKToolsVoxelTTest< VDimension, TComponentType >
+::Run( void )
+{
+  /** TYPEDEF's. */
+  typedef itk::ImageFileReader< InputImageType >        ReaderType;
+  typedef itk::ImageFileWriter< OutputImageType >       WriterType;
+  typedef typename OutputImageType::Pointer             OutputImagePointer;
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+
+  const unsigned int nrInputs = this->m_InputFileNames.size();
+
+  /** Create the design matrix, one row per subject. */
+  MatrixType design;
+  MatrixType contrast;
+  if( this->m_DesignFileName != "" )
+  {
+    if( !ReadDesignMatrix( this->m_DesignFileName, design ) )
+    {
+      itkGenericExceptionMacro( << "ERROR: could not read the design matrix \""
+        << this->m_DesignFileName << "\"." );
+    }
+  }
+  else
+  {
+    /** Two groups: one indicator column per group. */
+    if( this->m_Groups.size() != nrInputs )
+    {
+      itkGenericExceptionMacro( << "ERROR: the number of group labels should equal the number of input images." );
+    }
+    design.set_size( nrInputs, 2 );
+    design.fill( 0.0 );
+    for( unsigned int i = 0; i < nrInputs; ++i )
+    {
+      if( this->m_Groups[ i ] != 1 && this->m_Groups[ i ] != 2 )
+      {
+        itkGenericExceptionMacro( << "ERROR: group labels should be 1 or 2." );
+      }
+      design( i, this->m_Groups[ i ] - 1 ) = 1.0;
+    }
+    if( this->m_Contrast.size() == 0 )
+    {
+      this->m_Contrast.push_back( 1.0 );
+      this->m_Contrast.push_back( -1.0 );
+      this->m_NumberOfContrastRows = 1;
+    }
+  }
+
+  const unsigned int nrRegressors = design.cols();
+  const unsigned int nrContrastRows = this->m_NumberOfContrastRows;
+  if( design.rows() != nrInputs )
+  {
+    itkGenericExceptionMacro( << "ERROR: the design matrix has " << design.rows()
+      << " rows, but there are " << nrInputs << " input images." );
+  }
+  if( nrContrastRows == 0
+    || this->m_Contrast.size() != nrContrastRows * nrRegressors )
+  {
+    itkGenericExceptionMacro( << "ERROR: the contrast should have "
+      << nrContrastRows << " rows of " << nrRegressors << " values." );
+  }
+  contrast.set_size( nrContrastRows, nrRegressors );
+  contrast.copy_in( &this->m_Contrast[ 0 ] );
+
+  /** Precompute (X'X)^+, the degrees of freedom, and the weights
+   * (C (X'X)^+ C')^-1 of the contrast.
+   */
+  const MatrixType XtX = design.transpose() * design;
+  vnl_svd<double> svdXtX( XtX );
+  const MatrixType XtXinv = svdXtX.pinverse();
+  const int dof = static_cast<int>( nrInputs ) - static_cast<int>( svdXtX.rank() );
+  if( dof <= 0 )
+  {
+    itkGenericExceptionMacro( << "ERROR: the design leaves no degrees of freedom." );
+  }
+  const MatrixType CVC = contrast * XtXinv * contrast.transpose();
+  vnl_svd<double> svdCVC( CVC );
+  if( svdCVC.rank() < nrContrastRows )
+  {
+    itkGenericExceptionMacro( << "ERROR: the contrast is not estimable with this design." );
+  }
+  const MatrixType contrastWeights = svdCVC.pinverse();
+
+  /** Two groups with the contrast [a -a] give the two-sample equal variance
+   * t-test, up to the sign of a. That only needs the sums over group 1 per
+   * permutation, see itktools::ComputeTwoSampleTValue().
+   */
+  const bool twoSample = this->m_DesignFileName == "" && nrContrastRows == 1
+    && this->m_Contrast[ 0 ] != 0.0 && this->m_Contrast[ 0 ] == -this->m_Contrast[ 1 ];
+
+  /** Precompute the permuted designs. Since X'X does not change when the
+   * rows of X are permuted, only X' has to be permuted. For the two-sample
+   * t-test only the subjects in group 1 are stored.
+   */
+  const unsigned int nrPermutations = this->m_NumberOfPermutations + 1;
+  std::vector<MatrixType> pinv( nrPermutations );
+  std::vector< std::vector<unsigned int> > groupOne( twoSample ? nrPermutations : 0 );
+  if( twoSample )
+  {
+    for( unsigned int i = 0; i < nrInputs; ++i )
+    {
+      if( this->m_Groups[ i ] == 1 ) groupOne[ 0 ].push_back( i );
+    }
+  }
+  else
+  {
+    pinv[ 0 ] = XtXinv * design.transpose();
+  }
+  if( nrPermutations > 1 )
+  {
+    RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::New();
+    randomGenerator->Initialize( this->m_Seed );
+
+    std::vector<unsigned int> permutation( nrInputs );
+    MatrixType permutedDesign( nrInputs, nrRegressors );
+    for( unsigned int p = 1; p < nrPermutations; ++p )
+    {
+      /** Fisher-Yates shuffle. */
+      for( unsigned int i = 0; i < nrInputs; ++i ) permutation[ i ] = i;
+      for( unsigned int i = nrInputs - 1; i > 0; --i )
+      {
+        std::swap( permutation[ i ], permutation[ randomGenerator->GetIntegerVariate( i ) ] );
+      }
+      if( twoSample )
+      {
+        for( unsigned int i = 0; i < nrInputs; ++i )
+        {
+          if( this->m_Groups[ permutation[ i ] ] == 1 ) groupOne[ p ].push_back( i );
+        }
+        continue;
+      }
+      for( unsigned int i = 0; i < nrInputs; ++i )
+      {
+        permutedDesign.set_row( i, design.get_row( permutation[ i ] ) );
+      }
+      pinv[ p ] = XtXinv * permutedDesign.transpose();
+    }
+  }
+
+  /** Get the image information from the first input. */
+  typename ReaderType::Pointer infoReader = ReaderType::New();
+  infoReader->SetFileName( this->m_InputFileNames[ 0 ].c_str() );
+  infoReader->UpdateOutputInformation();
+  const RegionType largestRegion = infoReader->GetOutput()->GetLargestPossibleRegion();
+  const typename RegionType::SizeType size = largestRegion.GetSize();
+  const itk::SizeValueType numberOfPixels = largestRegion.GetNumberOfPixels();
+
+  /** Read the mask, if given. */
+  typename MaskImageType::Pointer mask;
+  const unsigned char * maskBuffer = 0;
+  if( this->m_MaskFileName != "" )
+  {
+    mask = itktools::ReadMaskImage<MaskImageType>( this->m_MaskFileName );
+    if( mask->GetLargestPossibleRegion().GetSize() != size )
+    {
+      itkGenericExceptionMacro( << "ERROR: the mask and the input images differ in size." );
+    }
+    maskBuffer = mask->GetBufferPointer();
+  }
+
+  /** Create the statistic image. */
+  OutputImagePointer statisticImage = OutputImageType::New();
+  statisticImage->CopyInformation( infoReader->GetOutput() );
+  statisticImage->SetRegions( largestRegion );
+  statisticImage->Allocate();
+  statisticImage->FillBuffer( 0.0f );
+  float * statistic = statisticImage->GetBufferPointer();
+
+  /** Setup the threads. */
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  std::vector< std::vector<double> > threadMaxima( threader->GetNumberOfThreads(),
+    std::vector<double>( nrPermutations, -itk::NumericTraits<double>::max() ) );
+
+  SlabStruct str;
+  str.NumberOfSubjects = nrInputs;
+  str.Pinv = &pinv[ 0 ];
+  str.GroupOneSubjects = twoSample ? &groupOne[ 0 ] : 0;
+  str.ContrastSign = this->m_Contrast[ 0 ] > 0.0 ? 1.0 : -1.0;
+  str.NumberOfPermutations = nrPermutations;
+  str.XtX = &XtX;
+  str.Contrast = &contrast;
+  str.ContrastWeights = &contrastWeights;
+  str.DegreesOfFreedom = static_cast<double>( dof );
+  str.AbsoluteStatistic = nrContrastRows == 1 && this->m_Tail == 2;
+  str.ThreadMaxima = &threadMaxima;
+
+  /** Process the images in slabs along the last dimension. Slabs are
+   * contiguous in memory, so a voxel of a slab has the same linear offset
+   * in the full image.
+   */
+  const unsigned int lastDimension = VDimension - 1;
+  const itk::SizeValueType slabStride = numberOfPixels / size[ lastDimension ];
+  const unsigned int nrStreams = std::max( 1u, std::min(
+    this->m_NumberOfStreams, static_cast<unsigned int>( size[ lastDimension ] ) ) );
+
+  std::vector<itk::SizeValueType> offsets;
+  std::vector<double> data;
+  std::vector<float> slabStatistic;
+  for( unsigned int s = 0; s < nrStreams; ++s )
+  {
+    const itk::SizeValueType begin = s * size[ lastDimension ] / nrStreams;
+    const itk::SizeValueType end = ( s + 1 ) * size[ lastDimension ] / nrStreams;
+    RegionType slab = largestRegion;
+    slab.SetIndex( lastDimension, largestRegion.GetIndex( lastDimension ) + begin );
+    slab.SetSize( lastDimension, end - begin );
+
+    /** Find the voxels of the slab inside the mask. */
+    offsets.clear();
+    for( itk::SizeValueType j = begin * slabStride; j < end * slabStride; ++j )
+    {
+      if( maskBuffer == 0 || maskBuffer[ j ] != 0 ) offsets.push_back( j );
+    }
+    const itk::SizeValueType nrVoxels = offsets.size();
+    if( nrVoxels == 0 ) continue;
+
+    /** Read the slab of all subjects. */
+    if( nrStreams > 1 )
+    {
+      std::cout << "Processing slab " << s + 1 << " of " << nrStreams << std::endl;
+    }
+    data.resize( nrInputs * nrVoxels );
+    for( unsigned int i = 0; i < nrInputs; ++i )
+    {
+      typename ReaderType::Pointer reader = ReaderType::New();
+      reader->SetFileName( this->m_InputFileNames[ i ].c_str() );
+      reader->UpdateOutputInformation();
+      if( reader->GetOutput()->GetLargestPossibleRegion().GetSize() != size )
+      {
+        itkGenericExceptionMacro( << "ERROR: the size of " << this->m_InputFileNames[ i ]
+          << " differs from the first image." );
+      }
+      reader->GetOutput()->SetRequestedRegion( slab );
+      reader->Update();
+
+      itk::ImageRegionConstIterator<InputImageType> it( reader->GetOutput(), slab );
+      double * subjectData = &data[ i * nrVoxels ];
+      itk::SizeValueType j = begin * slabStride;
+      itk::SizeValueType v = 0;
+      for( it.GoToBegin(); !it.IsAtEnd(); ++it, ++j )
+      {
+        if( v < nrVoxels && offsets[ v ] == j )
+        {
+          subjectData[ v++ ] = static_cast<double>( it.Get() );
+        }
+      }
+    }
+
+    /** Compute the statistics of this slab for all permutations. */
+    slabStatistic.resize( nrVoxels );
+    str.Data = &data[ 0 ];
+    str.NumberOfVoxels = nrVoxels;
+    str.Statistic = &slabStatistic[ 0 ];
+    threader->SetSingleMethod( ComputeStatisticsCallback, &str );
+    threader->SingleMethodExecute();
+
+    for( itk::SizeValueType v = 0; v < nrVoxels; ++v )
+    {
+      statistic[ offsets[ v ] ] = slabStatistic[ v ];
+    }
+  }
+
+  /** Write the statistic image. */
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( this->m_OutputFileName.c_str() );
+  writer->SetInput( statisticImage );
+  writer->SetUseCompression( this->m_UseCompression );
+  writer->Update();
+
+  /** Write the uncorrected p-values, which are only available for t. */
+  if( this->m_OutputPValueFileName != "" )
+  {
+    if( nrContrastRows > 1 )
+    {
+      std::cerr << "WARNING: uncorrected p-values are only computed for a t-test." << std::endl;
+    }
+    else
+    {
+      typedef itk::Statistics::TDistribution    DistributionType;
+      DistributionType::Pointer distributionFunction = DistributionType::New();
+      distributionFunction->SetDegreesOfFreedom( dof );
+
+      OutputImagePointer pImage = OutputImageType::New();
+      pImage->CopyInformation( statisticImage );
+      pImage->SetRegions( largestRegion );
+      pImage->Allocate();
+      float * pValues = pImage->GetBufferPointer();
+      for( itk::SizeValueType j = 0; j < numberOfPixels; ++j )
+      {
+        if( maskBuffer != 0 && maskBuffer[ j ] == 0 )
+        {
+          pValues[ j ] = 1.0f;
+          continue;
+        }
+        const double t = statistic[ j ];
+        double pValue = distributionFunction->EvaluateCDF(
+          this->m_Tail == 2 ? -vcl_abs( t ) : -t );
+        if( this->m_Tail == 2 ) pValue *= 2.0;
+        pValues[ j ] = static_cast<float>( pValue );
+      }
+
+      writer->SetFileName( this->m_OutputPValueFileName.c_str() );
+      writer->SetInput( pImage );
+      writer->Update();
+    }
+  }
+
+  /** Write the FWE corrected p-values: the fraction of permutations, the
+   * unpermuted design included, whose maximum statistic is at least
+   * the statistic of the voxel.
+   */
+  if( this->m_OutputFWEFileName != "" && nrPermutations > 1 )
+  {
+    std::vector<double> maxima( nrPermutations - 1 );
+    for( unsigned int p = 1; p < nrPermutations; ++p )
+    {
+      double maximum = -itk::NumericTraits<double>::max();
+      for( unsigned int t = 0; t < threadMaxima.size(); ++t )
+      {
+        maximum = std::max( maximum, threadMaxima[ t ][ p ] );
+      }
+      maxima[ p - 1 ] = maximum;
+    }
+    std::sort( maxima.begin(), maxima.end() );
+
+    OutputImagePointer fweImage = OutputImageType::New();
+    fweImage->CopyInformation( statisticImage );
+    fweImage->SetRegions( largestRegion );
+    fweImage->Allocate();
+    float * pValues = fweImage->GetBufferPointer();
+    for( itk::SizeValueType j = 0; j < numberOfPixels; ++j )
+    {
+      if( maskBuffer != 0 && maskBuffer[ j ] == 0 )
+      {
+        pValues[ j ] = 1.0f;
+        continue;
+      }
+      const double value = str.AbsoluteStatistic
+        ? vcl_abs( statistic[ j ] ) : statistic[ j ];
+      const std::size_t exceeding = maxima.end()
+        - std::lower_bound( maxima.begin(), maxima.end(), value );
+      pValues[ j ] = static_cast<float>( exceeding + 1 )
+        / static_cast<float>( nrPermutations );
+    }
+
+    writer->SetFileName( this->m_OutputFWEFileName.c_str() );
+    writer->SetInput( fweImage );
+    writer->Update();
+  }
+
+} // end Run()
+
+
+/**
+ * ******************* ReadDesignMatrix *******************
+ *
+ * Each line of the file holds the regressors of one subject,
+ * separated by spaces or tabs. Empty lines are skipped.
+ */
+
+template< unsigned int VDimension, class TComponentType >
+bool
+ITKToolsVoxelTTest< VDimension, TComponentType >
+::ReadDesignMatrix( const std::string & fileName, MatrixType & design )
+{
+  std::ifstream file( fileName.c_str() );
+  if( !file.is_open() ) return false;
+
+  std::vector< std::vector<double> > rows;
+  std::string line;
+  while( std::getline( file, line ) )
+  {
+    std::istringstream lineSS( line.c_str() );
+    std::vector<double> row;
+    double value;
+    while( lineSS >> value ) row.push_back( value );
+    if( row.empty() ) continue;
+    if( !rows.empty() && row.size() != rows[ 0 ].size() ) return false;
+    rows.push_back( row );
+  }
+  if( rows.empty() ) return false;
+
+  design.set_size( rows.size(), rows[ 0 ].size() );
+  for( unsigned int i = 0; i < rows.size(); ++i )
+  {
+    for( unsigned int j = 0; j < rows[ i ].size(); ++j )
+    {
+      design( i, j ) = rows[ i ][ j ];
+    }
+  }
+
+  return true;
+
+} // end ReadDesignMatrix()
+
+
+/**
+ * ******************* ComputeStatisticsCallback *******************
+ *
+ * The voxels are processed in small blocks. For every permutation the
+ * estimates b = Pinv y of a block are accumulated subject by subject,
+ * in an inner loop over contiguous voxels, and then
+ *   RSS = y'y - b' X'X b,   s^2 = RSS / dof,
+ *   t = c b / sqrt( s^2 c (X'X)^+ c' ),
+ *   F = (C b)' ( C (X'X)^+ C' )^-1 (C b) / ( r s^2 ).
+ * For the two-sample t-test only the sum and the sum of squares over
+ * group 1 are accumulated per permutation.
+ */
+
+template< unsigned int VDimension, class TComponentType >
+ITK_THREAD_RETURN_TYPE
+ITKToolsVoxelTTest< VDimension, TComponentType >
+::ComputeStatisticsCallback( void * arg )
+{
+  ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+  const SlabStruct * str = static_cast<SlabStruct *>( info->UserData );
+
+  const itk::SizeValueType chunk = str->NumberOfVoxels / info->NumberOfThreads;
+  const itk::SizeValueType begin = info->ThreadID * chunk;
+  const itk::SizeValueType end = ( info->ThreadID == info->NumberOfThreads - 1 )
+    ? str->NumberOfVoxels : begin + chunk;
+
+  const unsigned int blockSize = 64;
+  const unsigned int nrSubjects = str->NumberOfSubjects;
+  const unsigned int nrRegressors = str->XtX->rows();
+  const unsigned int nrContrastRows = str->Contrast->rows();
+  const itk::SizeValueType nrVoxels = str->NumberOfVoxels;
+  const MatrixType & XtX = *str->XtX;
+  const MatrixType & C = *str->Contrast;
+  const MatrixType & W = *str->ContrastWeights;
+  std::vector<double> & maxima = ( *str->ThreadMaxima )[ info->ThreadID ];
+
+  std::vector<double> beta( nrRegressors * blockSize );
+  std::vector<double> yy( blockSize );
+  std::vector<double> ys( blockSize );
+  std::vector<double> s1( blockSize );
+  std::vector<double> ss1( blockSize );
+  std::vector<double> statistics( blockSize );
+  std::vector<double> Cb( nrContrastRows );
+
+  const bool twoSample = str->GroupOneSubjects != 0;
+  const double n1 = twoSample ? static_cast<double>( str->GroupOneSubjects[ 0 ].size() ) : 0.0;
+  const double n2 = static_cast<double>( nrSubjects ) - n1;
+
+  for( itk::SizeValueType v0 = begin; v0 < end; v0 += blockSize )
+  {
+    const unsigned int nrBlockVoxels
+      = static_cast<unsigned int>( std::min<itk::SizeValueType>( blockSize, end - v0 ) );
+
+    /** y'y, and for the two-sample t-test the sum of y, do not depend
+     * on the permutation.
+     */
+    std::fill( yy.begin(), yy.end(), 0.0 );
+    std::fill( ys.begin(), ys.end(), 0.0 );
+    for( unsigned int i = 0; i < nrSubjects; ++i )
+    {
+      const double * y = str->Data + i * nrVoxels + v0;
+      for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+      {
+        yy[ b ] += y[ b ] * y[ b ];
+      }
+      if( !twoSample ) continue;
+      for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+      {
+        ys[ b ] += y[ b ];
+      }
+    }
+
+    for( unsigned int p = 0; p < str->NumberOfPermutations; ++p )
+    {
+      if( twoSample )
+      {
+        /** The sums over group 1; group 2 is the rest. */
+        const std::vector<unsigned int> & groupOne = str->GroupOneSubjects[ p ];
+        std::fill( s1.begin(), s1.end(), 0.0 );
+        std::fill( ss1.begin(), ss1.end(), 0.0 );
+        for( unsigned int j = 0; j < groupOne.size(); ++j )
+        {
+          const double * y = str->Data + groupOne[ j ] * nrVoxels + v0;
+          for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+          {
+            s1[ b ] += y[ b ];
+            ss1[ b ] += y[ b ] * y[ b ];
+          }
+        }
+        for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+        {
+          statistics[ b ] = str->ContrastSign * itktools::ComputeTwoSampleTValue(
+            n1, s1[ b ], ss1[ b ], n2, ys[ b ] - s1[ b ], yy[ b ] - ss1[ b ] );
+        }
+      }
+      else
+      {
+        const MatrixType & pinv = str->Pinv[ p ];
+
+        /** b = Pinv y, for all voxels of the block. */
+        std::fill( beta.begin(), beta.end(), 0.0 );
+        for( unsigned int i = 0; i < nrSubjects; ++i )
+        {
+          const double * y = str->Data + i * nrVoxels + v0;
+          for( unsigned int k = 0; k < nrRegressors; ++k )
+          {
+            const double m = pinv( k, i );
+            double * betak = &beta[ k * blockSize ];
+            for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+            {
+              betak[ b ] += m * y[ b ];
+            }
+          }
+        }
+
+        /** The statistic per voxel. */
+        for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+        {
+          double fitted = 0.0;
+          for( unsigned int k = 0; k < nrRegressors; ++k )
+          {
+            double XtXb = 0.0;
+            for( unsigned int l = 0; l < nrRegressors; ++l )
+            {
+              XtXb += XtX( k, l ) * beta[ l * blockSize + b ];
+            }
+            fitted += beta[ k * blockSize + b ] * XtXb;
+          }
+          const double variance = std::max( 0.0, yy[ b ] - fitted ) / str->DegreesOfFreedom;
+
+          for( unsigned int r = 0; r < nrContrastRows; ++r )
+          {
+            Cb[ r ] = 0.0;
+            for( unsigned int k = 0; k < nrRegressors; ++k )
+            {
+              Cb[ r ] += C( r, k ) * beta[ k * blockSize + b ];
+            }
+          }
+
+          double statistic = 0.0;
+          if( variance > 0.0 )
+          {
+            if( nrContrastRows == 1 )
+            {
+              statistic = Cb[ 0 ] * vcl_sqrt( W( 0, 0 ) / variance );
+            }
+            else
+            {
+              for( unsigned int r = 0; r < nrContrastRows; ++r )
+              {
+                for( unsigned int q = 0; q < nrContrastRows; ++q )
+                {
+                  statistic += Cb[ r ] * W( r, q ) * Cb[ q ];
+                }
+              }
+              statistic /= nrContrastRows * variance;
+            }
+          }
+          statistics[ b ] = statistic;
+        }
+      }
+
+      /** Store the statistic, or update the maximum of the permutation. */
+      for( unsigned int b = 0; b < nrBlockVoxels; ++b )
+      {
+        if( p == 0 )
+        {
+          str->Statistic[ v0 + b ] = static_cast<float>( statistics[ b ] );
+        }
+        else
+        {
+          const double value = str->AbsoluteStatistic ? vcl_abs( statistics[ b ] ) : statistics[ b ];
+          if( value > maxima[ p ] ) maxima[ p ] = value;
+        }
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeStatisticsCallback()
+
+
+#endif // end #ifndef __voxelttest_hxx_
@@ -23,8 +23,9 @@
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
-#include "itkNaryAddImageFilter.h"
-#include "itkMultiplyImageFilter.h"
+#include "itkMultiThreader.h"
+
+#include <sstream>
 
 
 /** \class ITKToolsWeightedAdditionBase
@@ -69,56 +70,187 @@ public:
   ITKToolsWeightedAddition(){};
   ~ITKToolsWeightedAddition(){};
 
-  /** Run function. */
-  void Run( void )
+  /** Typedefs. */
+  typedef itk::Image< TComponentType, VDimension >      ImageType;
+  typedef typename ImageType::Pointer                   ImagePointer;
+  typedef itk::ImageFileReader< ImageType >             ReaderType;
+  typedef itk::ImageFileWriter< ImageType >             WriterType;
+  typedef itk::MultiThreader::ThreadInfoStruct          ThreadInfoType;
+
+  /** Holds an input image and its weight image, which are read by
+   * a separate thread while the previous pair is being accumulated.
+   */
+  struct PrefetchStruct
   {
-    /** TYPEDEF's. */
-    typedef itk::Image< TComponentType, VDimension >      InputImageType;
-    typedef itk::ImageFileReader< InputImageType >        ReaderType;
-    typedef itk::MultiplyImageFilter<
-      InputImageType, InputImageType, InputImageType>     MultiplierType;
-    typedef itk::NaryAddImageFilter<
-      InputImageType, InputImageType >                    AdderType;
-    typedef itk::ImageFileWriter< InputImageType >        WriterType;
-    typedef typename InputImageType::PixelType            PixelType;
-    typedef typename ReaderType::Pointer                  ReaderPointer;
-    typedef typename MultiplierType::Pointer              MultiplierPointer;
-    typedef typename AdderType::Pointer                   AdderPointer;
-    typedef typename WriterType::Pointer                  WriterPointer;
+    std::string   InputFileName;
+    std::string   WeightFileName;
+    ImagePointer  Input;
+    ImagePointer  Weight;
+    std::string   ErrorMessage;
+  };
 
+  /** Holds the buffers for the multi-threaded accumulation. */
+  struct AccumulateStruct
+  {
+    TComponentType *        Sum;
+    const TComponentType *  Input;
+    const TComponentType *  Weight;
+    itk::SizeValueType      NumberOfPixels;
+  };
+
+  /** Run function.
+   * The output sum_i w_i(x) * I_i(x) is accumulated image by image into
+   * a single float image. While a pair is accumulated by multiple threads,
+   * the next pair is already read from disk. Memory therefore does not
+   * depend on the number of images: at most two pairs and the
+   * accumulator are in memory.
+   */
+  void Run( void )
+  {
     /** DECLARATION'S. */
-    unsigned int nrInputs = this->m_InputFileNames.size();
+    const unsigned int nrInputs = this->m_InputFileNames.size();
     if( this->m_WeightFileNames.size() != nrInputs )
     {
       itkGenericExceptionMacro( << "ERROR: Number of weight images does not equal number of input images!" );
     }
+    if( nrInputs == 0 ) return;
 
-    std::vector< ReaderPointer > inReaders( nrInputs );
-    std::vector< ReaderPointer > wReaders( nrInputs );
-    std::vector< MultiplierPointer > multipliers( nrInputs );
-    AdderPointer adder = AdderType::New();
-    WriterPointer writer = WriterType::New();
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    itk::MultiThreader::Pointer prefetcher = itk::MultiThreader::New();
 
+    /** Read the first pair. */
+    PrefetchStruct current;
+    current.InputFileName = this->m_InputFileNames[ 0 ];
+    current.WeightFileName = this->m_WeightFileNames[ 0 ];
+    ReadPair( current );
+    if( current.ErrorMessage != "" )
+    {
+      itkGenericExceptionMacro( << current.ErrorMessage );
+    }
+
+    /** Create the accumulator. */
+    ImagePointer sum = ImageType::New();
+    sum->CopyInformation( current.Input );
+    sum->SetRegions( current.Input->GetLargestPossibleRegion() );
+    sum->Allocate();
+    sum->FillBuffer( itk::NumericTraits<TComponentType>::Zero );
+    const itk::SizeValueType numberOfPixels
+      = sum->GetLargestPossibleRegion().GetNumberOfPixels();
+
+    /** Loop over all pairs. */
     for( unsigned int i = 0; i < nrInputs; ++i )
     {
-      inReaders[ i ] = ReaderType::New();
-      inReaders[ i ]->SetFileName( this->m_InputFileNames[ i ].c_str() );
-      wReaders[ i ] = ReaderType::New();
-      wReaders[ i ]->SetFileName( this->m_WeightFileNames[ i ].c_str() );
-      multipliers[ i ] = MultiplierType::New();
-      multipliers[ i ]->SetInput(0, inReaders[ i ]->GetOutput() );
-      multipliers[ i ]->SetInput(1, wReaders[ i ]->GetOutput() );
-      multipliers[ i ]->InPlaceOn();
-      adder->SetInput(i, multipliers[ i ]->GetOutput() );
+      if( current.ErrorMessage != "" )
+      {
+        itkGenericExceptionMacro( << current.ErrorMessage );
+      }
+      if( current.Input->GetLargestPossibleRegion().GetSize()
+          != sum->GetLargestPossibleRegion().GetSize()
+        || current.Weight->GetLargestPossibleRegion().GetSize()
+          != sum->GetLargestPossibleRegion().GetSize() )
+      {
+        itkGenericExceptionMacro( << "ERROR: The size of " << current.InputFileName
+          << " or " << current.WeightFileName << " differs from the first image!" );
+      }
+
+      /** Start reading the next pair. */
+      PrefetchStruct next;
+      int prefetchThreadId = -1;
+      if( i + 1 < nrInputs )
+      {
+        next.InputFileName = this->m_InputFileNames[ i + 1 ];
+        next.WeightFileName = this->m_WeightFileNames[ i + 1 ];
+        prefetchThreadId = prefetcher->SpawnThread( PrefetchCallback, &next );
+      }
+
+      /** Accumulate the current pair. */
+      std::cout << "Adding " << current.InputFileName
+        << " with weight " << current.WeightFileName << std::endl;
+      AccumulateStruct str;
+      str.Sum = sum->GetBufferPointer();
+      str.Input = current.Input->GetBufferPointer();
+      str.Weight = current.Weight->GetBufferPointer();
+      str.NumberOfPixels = numberOfPixels;
+      threader->SetSingleMethod( AccumulateCallback, &str );
+      threader->SingleMethodExecute();
+
+      /** Wait for the next pair, and release the current one. */
+      if( prefetchThreadId >= 0 )
+      {
+        prefetcher->TerminateThread( prefetchThreadId );
+      }
+      current = next;
     }
 
     /** Write the output image. */
+    typename WriterType::Pointer writer = WriterType::New();
     writer->SetFileName( this->m_OutputFileName.c_str() );
-    writer->SetInput( adder->GetOutput() );
+    writer->SetInput( sum );
     writer->Update();
 
   } // end Run()
 
+  /** Read an input image and its weight. Errors are stored in the struct,
+   * since this function may be called from the prefetch thread.
+   */
+  static void ReadPair( PrefetchStruct & pair )
+  {
+    try
+    {
+      pair.Input = ReadImage( pair.InputFileName );
+      pair.Weight = ReadImage( pair.WeightFileName );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      std::ostringstream message;
+      message << excp;
+      pair.ErrorMessage = message.str();
+    }
+  } // end ReadPair()
+
+  /** Read an image and disconnect it from the reader. */
+  static ImagePointer ReadImage( const std::string & fileName )
+  {
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( fileName.c_str() );
+    reader->Update();
+    ImagePointer image = reader->GetOutput();
+    image->DisconnectPipeline();
+    return image;
+  } // end ReadImage()
+
+  /** Thread callback that reads the next pair. */
+  static ITK_THREAD_RETURN_TYPE PrefetchCallback( void * arg )
+  {
+    ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+    PrefetchStruct * pair = static_cast<PrefetchStruct *>( info->UserData );
+    ReadPair( *pair );
+    return ITK_THREAD_RETURN_VALUE;
+  } // end PrefetchCallback()
+
+  /** Thread callback that adds a contiguous part of a weighted image. */
+  static ITK_THREAD_RETURN_TYPE AccumulateCallback( void * arg )
+  {
+    ThreadInfoType * info = static_cast<ThreadInfoType *>( arg );
+    const AccumulateStruct * str
+      = static_cast<AccumulateStruct *>( info->UserData );
+
+    const itk::SizeValueType chunk = str->NumberOfPixels / info->NumberOfThreads;
+    const itk::SizeValueType begin = info->ThreadID * chunk;
+    const itk::SizeValueType end = ( info->ThreadID == info->NumberOfThreads - 1 )
+      ? str->NumberOfPixels : begin + chunk;
+
+    TComponentType * sum = str->Sum;
+    const TComponentType * input = str->Input;
+    const TComponentType * weight = str->Weight;
+    for( itk::SizeValueType j = begin; j < end; ++j )
+    {
+      sum[ j ] += weight[ j ] * input[ j ];
+    }
+
+    return ITK_THREAD_RETURN_VALUE;
+  } // end AccumulateCallback()
+
 }; // end class ITKToolsWeightedAddition
 
 